@@ -1,14 +1,32 @@
 package main
 
 import (
+	"bufio"
+	"encoding/json"
+	"errors"
+	"iter"
 	"log/slog"
 	"os"
+	"strconv"
+	"sync"
 
 	"github.com/gin-gonic/gin"
 	"github.com/randolphcyg/gowireshark/pkg"
 )
 
 func main() {
+	// WORKERS > 0 serves full scans, pages and streams from a pool of dissection
+	// worker processes, so concurrent requests run on separate cores.
+	if n, _ := strconv.Atoi(os.Getenv("WORKERS")); n > 0 {
+		p, err := pkg.NewWorkerPool(pkg.WithWorkers(n))
+		if err != nil {
+			slog.Error("Failed to start worker pool", "error", err)
+			os.Exit(1)
+		}
+		defer p.Close()
+		pool = p
+	}
+
 	// Initialize the Gin engine with default middleware (logger and recovery)
 	r := gin.Default()
 
@@ -19,7 +37,7 @@ func main() {
 		api.GET("/version/wireshark", getWiresharkVersion)
 
 		// Packet Parsing Endpoints
-		// 1. Full Scan: Parses the entire file. Warning: High memory usage for large files.
+		// 1. Full Scan: Parses the entire file, streaming frames out as they are dissected.
 		api.POST("/frames/all", getAllFrames)
 
 		// 2. Pagination: Optimized single-pass I/O. Highly recommended for large PCAP files.
@@ -35,6 +53,9 @@ func main() {
 		api.POST("/frames/stream", getStreamData)
 
 		api.GET("/interfaces", getInterfaces)
+
+		// Per-worker state and utilisation of the dissection worker pool.
+		api.GET("/workers", getWorkers)
 	}
 
 	// Start the HTTP server on port 8090
@@ -48,10 +69,18 @@ func main() {
 
 // baseRequest contains common parameters required for parsing logic.
 type baseRequest struct {
-	Filepath  string `json:"filepath" binding:"required"` // Absolute path to the .pcap/.pcapng file inside the container
-	IsDebug   bool   `json:"isDebug"`                     // If true, enables verbose C-level logging
-	IgnoreErr bool   `json:"ignoreErr"`                   // If true, parsing continues even if a single frame is malformed
-	BpfFilter string `json:"bpfFilter"`                   // Wireshark display filter syntax
+	Filepath  string   `json:"filepath" binding:"required"` // Absolute path to the .pcap/.pcapng file inside the container
+	IsDebug   bool     `json:"isDebug"`                     // If true, enables verbose C-level logging
+	IgnoreErr bool     `json:"ignoreErr"`                   // If true, parsing continues even if a single frame is malformed
+	BpfFilter string   `json:"bpfFilter"`                   // Wireshark display filter syntax
+	Fields    []string `json:"fields"`                      // Return only these fields as flat records (e.g. ["ip.src", "tcp.stream"])
+}
+
+// getAllRequest handles full scan parameters.
+type getAllRequest struct {
+	baseRequest
+	Shards       int `json:"shards"`       // Split the scan over this many workers (requires WORKERS, 0: no sharding)
+	ShardOverlap int `json:"shardOverlap"` // Warm-up frames before each shard (0: library default)
 }
 
 // getByPageRequest handles pagination parameters.
@@ -97,6 +126,14 @@ type ListData struct {
 	Total int `json:"total"`
 }
 
+// ShardedListData is ListData for a sharded scan; Edges lists the frames that may
+// differ from a sequential scan.
+type ShardedListData struct {
+	List  any             `json:"list"`
+	Total int             `json:"total"`
+	Edges []pkg.ShardEdge `json:"edges"`
+}
+
 // PageData represents a standard paginated response (Infinite scroll / Load more style).
 type PageData struct {
 	List    any  `json:"list"`
@@ -105,6 +142,57 @@ type PageData struct {
 	Size    int  `json:"size"`
 }
 
+// --- Capture Sessions ---
+
+// sessions caches one capture session per file (filepath -> *pkg.Session), so the
+// page, idx, hex and stream requests the UI issues against one pcap share its
+// first pass. Idle sessions close themselves (pkg.WithIdleTimeout), and so do
+// sessions whose file changed on disk.
+//
+// Only one session holds the process's epan session at a time: requests that
+// alternate between files, or that run one-shot calls in between, make each
+// session replay its first pass. The cache pays off for runs of requests on one
+// file; with WORKERS set, one-shot calls run in the worker processes instead.
+var sessions sync.Map
+
+// getSession returns the cached session of path, opening it if needed.
+func getSession(path string) (*pkg.Session, error) {
+	if s, ok := sessions.Load(path); ok {
+		return s.(*pkg.Session), nil
+	}
+
+	s, err := pkg.OpenCapture(path)
+	if err != nil {
+		return nil, err
+	}
+	if actual, loaded := sessions.LoadOrStore(path, s); loaded {
+		_ = s.Close()
+		return actual.(*pkg.Session), nil
+	}
+	return s, nil
+}
+
+// withSession runs fn on the session of path, reopening it once if it was
+// evicted or its file changed in between.
+func withSession(path string, fn func(s *pkg.Session) error) error {
+	for attempt := 0; ; attempt++ {
+		s, err := getSession(path)
+		if err != nil {
+			return err
+		}
+
+		err = fn(s)
+		if errors.Is(err, pkg.ErrSessionClosed) && attempt == 0 {
+			sessions.CompareAndDelete(path, s)
+			continue
+		}
+		return err
+	}
+}
+
+// pool is the dissection worker pool, nil when WORKERS is unset.
+var pool *pkg.WorkerPool
+
 // --- Route Handlers ---
 
 func getWiresharkVersion(c *gin.Context) {
@@ -115,26 +203,84 @@ func getWiresharkVersion(c *gin.Context) {
 
 // getAllFrames parses the entire file and returns all frames.
 func getAllFrames(c *gin.Context) {
-	var req baseRequest
+	var req getAllRequest
 	if err := c.ShouldBindJSON(&req); err != nil {
 		HandleError(c, 400, "invalid param", err)
 		return
 	}
 
-	frames, err := pkg.GetAllFrames(req.Filepath,
+	opts := []pkg.Option{
 		pkg.WithDebug(req.IsDebug),
 		pkg.IgnoreError(req.IgnoreErr),
 		pkg.WithBpfFilter(req.BpfFilter),
-	)
-	if err != nil {
+		pkg.WithFields(req.Fields),
+	}
+
+	if pool != nil && req.Shards > 1 {
+		if req.ShardOverlap > 0 {
+			opts = append(opts, pkg.WithShardOverlap(req.ShardOverlap))
+		}
+		res, err := pool.GetAllFramesSharded(req.Filepath, req.Shards, opts...)
+		if err != nil {
+			HandleError(c, 500, "wireshark parse err", err)
+			return
+		}
+		Success(c, ShardedListData{
+			List:  res.Frames,
+			Total: len(res.Frames),
+			Edges: res.Edges,
+		})
+		return
+	}
+
+	if pool != nil {
+		streamFrameList(c, pool.IterFrames(req.Filepath, opts...))
+	} else {
+		streamFrameList(c, pkg.IterFrames(req.Filepath, opts...))
+	}
+}
+
+// streamFrameList writes a ListData response while the frames are still being
+// dissected, so a full scan holds only the frames in flight. "code" and "msg"
+// follow "data": an error part way through ends the list and is reported there.
+func streamFrameList(c *gin.Context, frames iter.Seq2[*pkg.FrameData, error]) {
+	next, stop := iter.Pull2(frames)
+	defer stop()
+
+	frame, err, ok := next()
+	if ok && err != nil {
 		HandleError(c, 500, "wireshark parse err", err)
 		return
 	}
 
-	Success(c, ListData{
-		List:  frames,
-		Total: len(frames),
-	})
+	c.Header("Content-Type", "application/json; charset=utf-8")
+	c.Status(200)
+	w := bufio.NewWriter(c.Writer)
+	defer w.Flush()
+
+	w.WriteString(`{"data":{"list":[`)
+	total := 0
+	for ; ok && err == nil; frame, err, ok = next() {
+		b, mErr := json.Marshal(frame)
+		if mErr != nil {
+			err = mErr
+			break
+		}
+		if total > 0 {
+			w.WriteByte(',')
+		}
+		w.Write(b)
+		total++
+	}
+	w.WriteString(`],"total":` + strconv.Itoa(total) + `}`)
+
+	if err != nil {
+		slog.Error("wireshark parse err", slog.Any("error", err))
+		msg, _ := json.Marshal(err.Error())
+		w.WriteString(`,"code":500,"msg":"wireshark parse err","error":` + string(msg) + `}`)
+		return
+	}
+	w.WriteString(`,"code":0,"msg":"ok"}`)
 }
 
 // getFramesByPage performs an optimized paginated query.
@@ -154,11 +300,24 @@ func getFramesByPage(c *gin.Context) {
 		return
 	}
 
-	frames, hasMore, err := pkg.GetFramesByPage(req.Filepath, req.Page, req.Size,
+	opts := []pkg.Option{
 		pkg.WithDebug(req.IsDebug),
 		pkg.IgnoreError(req.IgnoreErr),
 		pkg.WithBpfFilter(req.BpfFilter),
-	)
+		pkg.WithFields(req.Fields),
+	}
+
+	var frames []*pkg.FrameData
+	var hasMore bool
+	var err error
+	if pool != nil {
+		frames, hasMore, err = pool.GetFramesByPage(req.Filepath, req.Page, req.Size, opts...)
+	} else {
+		err = withSession(req.Filepath, func(s *pkg.Session) (err error) {
+			frames, hasMore, err = s.GetPage(req.Page, req.Size, opts...)
+			return err
+		})
+	}
 	if err != nil {
 		HandleError(c, 500, "wireshark parse err", err)
 		return
@@ -180,10 +339,15 @@ func getFramesByIdxs(c *gin.Context) {
 		return
 	}
 
-	frames, err := pkg.GetFramesByIdxs(req.Filepath, req.FrameIdxs,
-		pkg.WithDebug(req.IsDebug),
-		pkg.IgnoreError(req.IgnoreErr),
-	)
+	var frames []*pkg.FrameData
+	err := withSession(req.Filepath, func(s *pkg.Session) (err error) {
+		frames, err = s.GetByIdxs(req.FrameIdxs,
+			pkg.WithDebug(req.IsDebug),
+			pkg.IgnoreError(req.IgnoreErr),
+			pkg.WithFields(req.Fields),
+		)
+		return err
+	})
 	if err != nil {
 		HandleError(c, 500, "wireshark parse err", err)
 		return
@@ -203,11 +367,14 @@ func getFrameHex(c *gin.Context) {
 		return
 	}
 
-	hexData, err := pkg.GetHexDataByIdx(req.Filepath, req.FrameIdx,
-		pkg.WithDebug(req.IsDebug),
-		pkg.IgnoreError(req.IgnoreErr),
-	)
-
+	var hexData *pkg.HexData
+	err := withSession(req.Filepath, func(s *pkg.Session) (err error) {
+		hexData, err = s.GetHex(req.FrameIdx,
+			pkg.WithDebug(req.IsDebug),
+			pkg.IgnoreError(req.IgnoreErr),
+		)
+		return err
+	})
 	if err != nil {
 		HandleError(c, 500, "wireshark parse hex err", err)
 		return
@@ -224,10 +391,21 @@ func getStreamData(c *gin.Context) {
 		return
 	}
 
-	res, err := pkg.GetStreamData(req.Filepath, req.BpfFilter, req.Protocol,
+	opts := []pkg.Option{
 		pkg.WithDebug(req.IsDebug),
 		pkg.IgnoreError(req.IgnoreErr),
-	)
+	}
+
+	var res *pkg.StreamResult
+	var err error
+	if pool != nil {
+		res, err = pool.GetStreamData(req.Filepath, req.BpfFilter, req.Protocol, opts...)
+	} else {
+		err = withSession(req.Filepath, func(s *pkg.Session) (err error) {
+			res, err = s.GetStream(req.BpfFilter, req.Protocol, opts...)
+			return err
+		})
+	}
 	if err != nil {
 		HandleError(c, 500, "wireshark parse stream err", err)
 		return
@@ -250,6 +428,20 @@ func getInterfaces(c *gin.Context) {
 	})
 }
 
+// getWorkers reports the state of the dissection worker pool.
+func getWorkers(c *gin.Context) {
+	if pool == nil {
+		Success(c, ListData{List: []pkg.WorkerStats{}, Total: 0})
+		return
+	}
+
+	stats := pool.Stats()
+	Success(c, ListData{
+		List:  stats,
+		Total: len(stats),
+	})
+}
+
 // --- Helper Functions ---
 
 // HandleError returns a standardized error response.
@@ -0,0 +1,38 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+// Counts heap allocations per thread for the serializer benchmarks. Built with
+// the alloccount tag (alloc_count.go), malloc, calloc and realloc are wrapped
+// for the whole process, including libwireshark and GLib; otherwise nothing is
+// counted and heap_alloc_count returns -1.
+
+#ifdef GOWIRESHARK_ALLOC_COUNT
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static __thread int64_t thread_allocs;
+
+void *malloc(size_t size) {
+    thread_allocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    thread_allocs++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    thread_allocs++;
+    return __libc_realloc(ptr, size);
+}
+
+int64_t heap_alloc_count(void) { return thread_allocs; }
+
+#else
+
+int64_t heap_alloc_count(void) { return -1; }
+
+#endif
@@ -0,0 +1,11 @@
+//go:build alloccount
+
+package pkg
+
+// Building with -tags alloccount makes BenchmarkSerializeFrameJSON report the
+// heap allocations of the C serializer, see alloc_count.c.
+
+/*
+#cgo CFLAGS: -DGOWIRESHARK_ALLOC_COUNT
+*/
+import "C"
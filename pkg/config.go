@@ -6,6 +6,7 @@ import (
 	"os"
 	"reflect"
 	"strings"
+	"time"
 
 	"github.com/bytedance/sonic"
 )
@@ -26,14 +27,82 @@ type TlsConf struct {
 }
 
 type Conf struct {
-	IgnoreError     bool    // Whether to ignore errors (default: true)
-	Debug           bool    // Debug mode (default: from environment variable DEBUG)
-	PrintCJson      bool    // Whether to print C JSON (default: false)
-	BpfFilter       string  // BPF filter
-	Tls             TlsConf // TLS configuration
-	PrintTcpStreams bool    // Whether to print TCP stream (default: false)
+	IgnoreError     bool          // Whether to ignore errors (default: true)
+	Debug           bool          // Debug mode (default: from environment variable DEBUG)
+	PrintCJson      bool          // Whether to print C JSON (default: false)
+	BpfFilter       string        // BPF filter
+	Tls             TlsConf       // TLS configuration
+	PrintTcpStreams bool          // Whether to print TCP stream (default: false)
+	FrameIndex      bool          // Use a persistent frame-offset index for random access (default: false)
+	ContextFrames   int           // Frames dissected before each random-access target (default: 0)
+	IdleTimeout     time.Duration // Idle time after which a Session releases its file (default: 5m, 0 disables)
+	ShardOverlap    int           // Warm-up frames dissected before each shard of a sharded pass (default: 1000)
+	BinaryFrames    bool          // Pass frames from C as binary node arrays instead of JSON (default: false)
+	Fields          []string      // Fields to dissect and return as flat records, empty for full trees
+	BatchFrames     int           // Frames handed from C to Go per callback (default: 64, 1 disables batching)
+	BatchBytes      int           // Bytes after which a batch is handed over early (default: 1 MiB)
+	MaxInFlight     int           // Frames IterFrames buffers ahead of the consumer (default: 1024)
+	KeepLayers      bool          // Keep FrameData.Layers next to BaseLayers (default: true)
+	TypedValues     bool          // Emit numbers and booleans in frame JSON natively instead of as strings (default: false)
+	MaxOpenStreams  int           // Stream files ExtractAllStreams keeps open at once (default: 256)
+
+	Reassembler      *TCPReassembler `json:"-"` // Receives the TCP segments of this capture (default: none)
+	ReassemblyFilter string          // Display filter of the segments passed to Reassembler
+
+	Snaplen        int        // Bytes kept per packet in live captures (default: 65535)
+	BufferSize     int        // Kernel buffer of live captures in bytes, the mmap ring on Linux (default: libpcap's, 2 MiB)
+	ImmediateMode  bool       // Deliver live packets as they arrive instead of per filled buffer block (default: false)
+	NanoTimestamps bool       // Request nanosecond timestamps in live captures (default: false)
+	RingSize       int        // Bytes of the ring between live capture and dissection (default: 64 MiB)
+	RingPolicy     RingPolicy // What a live capture does when its ring is full (default: RingDropNewest)
+	LiveWorkers    int        // Pool workers a WorkerPool live capture dissects on (default: all but one)
+
+	Rollover RolloverPolicy // When live captures start a fresh dissection session (default: never)
+
+	LiveParsers    int        // Goroutines decoding the frames of a live capture (default: one per CPU)
+	LiveQueue      int        // Frames of a live capture waiting to be decoded or delivered (default: 4096)
+	LivePolicy     LivePolicy // What a live capture does when the decoding falls behind (default: LiveDrop)
+	LiveSampleRate int        // With LiveSample, one frame in this many is kept under load (default: 10)
 }
 
+// RolloverPolicy says when a live capture replaces its dissection session with a
+// fresh one. libwireshark keeps conversations, reassembly state and per-capture
+// allocations until the session ends, so a capture that runs for days grows
+// without bound unless it rolls over. Zero fields are off; the first limit
+// reached triggers the rollover.
+//
+// A due rollover waits up to Grace (default: 1s) for a moment when no packets
+// are waiting, so that few conversations are cut off mid-reassembly. Frames
+// keep their numbering across sessions, but conversations that span a rollover
+// are dissected as new ones from then on.
+type RolloverPolicy struct {
+	Packets  int           // Packets dissected per session
+	Interval time.Duration // Age of a session
+	MaxRSS   int64         // Resident memory of the process in bytes (Linux), checked once a second
+	Grace    time.Duration // Longest wait for a lull once a rollover is due
+}
+
+// RingPolicy says what a live capture does with a packet when the ring between
+// the capture and the dissection thread is full.
+type RingPolicy int
+
+const (
+	RingDropNewest RingPolicy = iota // Discard the captured packet
+	RingDropOldest                   // Discard the oldest packets waiting for dissection
+	RingBlock                        // Wait for the dissection thread; the kernel drops instead
+)
+
+// LivePolicy says what a live capture does with a dissected frame when the Go
+// side falls behind: when the queue in front of the parsers is full, and when
+// the interface channel is.
+type LivePolicy int
+
+const (
+	LiveDrop   LivePolicy = iota // Discard the frame
+	LiveBlock                    // Wait, holding up the dissection; RingPolicy decides from there
+	LiveSample                   // Keep one frame in LiveSampleRate once the queue is half full, then drop
+)
+
 type Option func(*Conf)
 
 // IgnoreError Whether to ignore the errors
@@ -78,6 +147,228 @@ func WithBpfFilter(filter string) Option {
 	}
 }
 
+// WithFrameIndex controls whether random access (GetFrameByIdx, GetFramesByIdxs, GetHexDataByIdx)
+// seeks through a persistent frame-offset index instead of reading from frame 1.
+//
+// A seek skips the dissection of the frames before the target, so fields that
+// depend on earlier frames (tcp.stream, reassembled PDUs, conversation data) may
+// differ from a sequential pass unless WithContextFrames dissects enough of them
+// first. The index is written next to the capture, at FrameIndexPath(path)
+// (path + ".gwidx"), and rebuilt when the capture changes; if that directory is
+// not writable, it is kept in memory only.
+func WithFrameIndex(use bool) Option {
+	return func(c *Conf) {
+		c.FrameIndex = use
+	}
+}
+
+// WithContextFrames sets how many frames are dissected before each random-access target,
+// so reassembly-dependent layers come out as they would in a sequential pass.
+func WithContextFrames(n int) Option {
+	return func(c *Conf) {
+		if n < 0 {
+			n = 0
+		}
+		c.ContextFrames = n
+	}
+}
+
+// WithIdleTimeout sets how long a Session may stay unused before it closes itself
+// and releases the file handle and frame state. 0 keeps it open until Close.
+func WithIdleTimeout(d time.Duration) Option {
+	return func(c *Conf) {
+		if d < 0 {
+			d = 0
+		}
+		c.IdleTimeout = d
+	}
+}
+
+// WithShardOverlap sets how many frames before each shard of a sharded pass are
+// dissected, without being returned, so reassembly state converges at the shard edge.
+func WithShardOverlap(n int) Option {
+	return func(c *Conf) {
+		if n < 0 {
+			n = 0
+		}
+		c.ShardOverlap = n
+	}
+}
+
+// WithBinaryFrames controls whether dissected frames cross from C as compact binary
+// node arrays, decoded straight into FrameData, instead of JSON text. PrintCJson
+// has no effect in binary mode.
+func WithBinaryFrames(binary bool) Option {
+	return func(c *Conf) {
+		c.BinaryFrames = binary
+	}
+}
+
+// WithFields restricts dissection to the given fields, like "ip.src" or "tcp.stream".
+// Frames then come back as flat records in FrameData.Fields, without Layers, and
+// only the requested fields are built in the proto tree. frame.number is always
+// included. Unknown field names are rejected.
+func WithFields(fields []string) Option {
+	return func(c *Conf) {
+		c.Fields = fields
+	}
+}
+
+// WithBatch sets how many frames, or bytes of frames, the C dissection loops
+// collect before handing them to Go in one callback. frames <= 1 delivers every
+// frame on its own.
+func WithBatch(frames, bytes int) Option {
+	return func(c *Conf) {
+		c.BatchFrames = frames
+		c.BatchBytes = bytes
+	}
+}
+
+// WithMaxInFlight bounds how many frames IterFrames dissects ahead of its consumer.
+// Dissection pauses while that many are parsed or waiting to be yielded.
+func WithMaxInFlight(n int) Option {
+	return func(c *Conf) {
+		if n < 1 {
+			n = 1
+		}
+		c.MaxInFlight = n
+	}
+}
+
+// WithLayers controls whether parsed frames keep their full Layers. Without them
+// only BaseLayers is filled and the rest of each frame is dropped right after
+// parsing, which saves memory when only the common layers are needed.
+func WithLayers(keep bool) Option {
+	return func(c *Conf) {
+		c.KeepLayers = keep
+	}
+}
+
+// WithTypedValues controls whether the JSON of dissected frames carries integer,
+// float and boolean fields as native JSON values, like "tcp.srcport": 443, instead
+// of strings. Integers displayed in hex or a custom format stay strings. The
+// output is smaller and BaseLayers decode without string conversions; Layers and
+// Fields then hold numbers and booleans for those fields.
+func WithTypedValues(typed bool) Option {
+	return func(c *Conf) {
+		c.TypedValues = typed
+	}
+}
+
+// WithMaxOpenStreams bounds how many per-stream files ExtractAllStreams keeps open.
+// The least recently written one is flushed and closed to make room, and reopened
+// for appending when its stream continues.
+func WithMaxOpenStreams(n int) Option {
+	return func(c *Conf) {
+		if n < 1 {
+			n = 1
+		}
+		c.MaxOpenStreams = n
+	}
+}
+
+// WithReassembler feeds the TCP segments of the capture to r, restricted to those
+// matching the display filter (empty for all). Every capture or session gets its
+// own tcp_follow listener, so captures with different reassemblers do not mix
+// their streams. The reassembler is not passed to WorkerPool workers.
+func WithReassembler(r *TCPReassembler, filter string) Option {
+	return func(c *Conf) {
+		c.Reassembler = r
+		c.ReassemblyFilter = filter
+	}
+}
+
+// WithSnaplen sets how many bytes of each packet a live capture keeps.
+func WithSnaplen(n int) Option {
+	return func(c *Conf) {
+		c.Snaplen = n
+	}
+}
+
+// WithBufferSize sets the kernel buffer of a live capture. On Linux this is the
+// size of the memory-mapped packet ring; bursts larger than it are dropped.
+func WithBufferSize(bytes int) Option {
+	return func(c *Conf) {
+		c.BufferSize = bytes
+	}
+}
+
+// WithImmediateMode makes a live capture hand every packet over as soon as it
+// arrives, instead of waiting for a ring block to fill or the read timeout.
+// It lowers latency at the cost of more wakeups under load.
+func WithImmediateMode(immediate bool) Option {
+	return func(c *Conf) {
+		c.ImmediateMode = immediate
+	}
+}
+
+// WithNanoTimestamps requests nanosecond packet timestamps from a live capture.
+// Devices without support keep microseconds; CaptureStats.NanoTimestamps says
+// which precision the capture got.
+func WithNanoTimestamps(nano bool) Option {
+	return func(c *Conf) {
+		c.NanoTimestamps = nano
+	}
+}
+
+// WithRingSize sets the bytes of the ring that holds captured packets until the
+// dissection thread takes them. It absorbs bursts the dissector cannot keep up with.
+func WithRingSize(bytes int) Option {
+	return func(c *Conf) {
+		c.RingSize = bytes
+	}
+}
+
+// WithRingPolicy sets what a live capture does when its ring is full.
+func WithRingPolicy(p RingPolicy) Option {
+	return func(c *Conf) {
+		c.RingPolicy = p
+	}
+}
+
+// WithLiveWorkers sets how many workers a WorkerPool live capture takes for as
+// long as it runs. The default leaves one worker to other jobs.
+func WithLiveWorkers(n int) Option {
+	return func(c *Conf) {
+		c.LiveWorkers = n
+	}
+}
+
+// WithRollover makes live captures replace their dissection session whenever a
+// limit of p is reached, which bounds their memory over long runs. With a
+// WorkerPool, every worker applies p to its own session and process.
+func WithRollover(p RolloverPolicy) Option {
+	return func(c *Conf) {
+		c.Rollover = p
+	}
+}
+
+// WithLiveParsers sets how many goroutines decode the frames of a live capture.
+// With more than one, frames are still delivered in dissection order.
+func WithLiveParsers(n int) Option {
+	return func(c *Conf) {
+		c.LiveParsers = n
+	}
+}
+
+// WithLiveQueue sets how many frames of a live capture may wait between the
+// dissection and the interface channel.
+func WithLiveQueue(frames int) Option {
+	return func(c *Conf) {
+		c.LiveQueue = frames
+	}
+}
+
+// WithLivePolicy sets what a live capture does when its frames are not decoded
+// or consumed fast enough. rate is the sampling rate of LiveSample; other
+// policies ignore it.
+func WithLivePolicy(p LivePolicy, rate int) Option {
+	return func(c *Conf) {
+		c.LivePolicy = p
+		c.LiveSampleRate = rate
+	}
+}
+
 // getDefaultDebug reads the DEBUG environment variable to determine whether debug mode should be enabled.
 func getDefaultDebug() bool {
 	return os.Getenv("DEBUG") == "true"
@@ -89,6 +380,14 @@ func NewConfig(opts ...Option) *Conf {
 		PrintCJson:      false,             // Default: Do not print C JSON
 		PrintTcpStreams: false,             // Default: Do not print TCP stream
 		IgnoreError:     true,              // Default: Ignore errors
+		FrameIndex:      false,             // Default: Read from frame 1, as a sequential pass would
+		IdleTimeout:     5 * time.Minute,   // Default: Close idle sessions after 5 minutes
+		ShardOverlap:    1000,              // Default: Warm up each shard with 1000 frames
+		BatchFrames:     64,                // Default: Hand frames over 64 at a time
+		BatchBytes:      1 << 20,           // Default: ... or once a batch reaches 1 MiB
+		MaxInFlight:     1024,              // Default: Buffer up to 1024 frames ahead of IterFrames
+		KeepLayers:      true,              // Default: Keep the full layers
+		MaxOpenStreams:  256,               // Default: Keep up to 256 stream files open
 		Debug:           getDefaultDebug(), // Default: Check DEBUG environment variable for debug mode
 	}
 	for _, opt := range opts {
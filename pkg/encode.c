@@ -0,0 +1,247 @@
+#include "encode.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define ENCODE_X86 1
+#include <immintrin.h>
+#endif
+
+static const char hex_digits[16] = {'0', '1', '2', '3', '4', '5', '6', '7',
+                                    '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+
+static const char base64_alphabet[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// --- Scalar Kernels ---
+
+static size_t hex_scalar(char *dst, const uint8_t *src, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        dst[2 * i] = hex_digits[src[i] >> 4];
+        dst[2 * i + 1] = hex_digits[src[i] & 0xf];
+    }
+    return 2 * len;
+}
+
+static size_t ascii_scalar(char *dst, const uint8_t *src, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = (src[i] >= ' ' && src[i] < 0x7f) ? (char)src[i] : '.';
+    }
+    return len;
+}
+
+static size_t base64_scalar(char *dst, const uint8_t *src, size_t len) {
+    char *out = dst;
+    size_t i = 0;
+
+    for (; i + 3 <= len; i += 3) {
+        uint32_t v = (uint32_t)src[i] << 16 | (uint32_t)src[i + 1] << 8 | src[i + 2];
+        *out++ = base64_alphabet[v >> 18];
+        *out++ = base64_alphabet[(v >> 12) & 0x3f];
+        *out++ = base64_alphabet[(v >> 6) & 0x3f];
+        *out++ = base64_alphabet[v & 0x3f];
+    }
+    if (i < len) {
+        uint32_t v = (uint32_t)src[i] << 16;
+        if (i + 1 < len) {
+            v |= (uint32_t)src[i + 1] << 8;
+        }
+        *out++ = base64_alphabet[v >> 18];
+        *out++ = base64_alphabet[(v >> 12) & 0x3f];
+        *out++ = i + 1 < len ? base64_alphabet[(v >> 6) & 0x3f] : '=';
+        *out++ = '=';
+    }
+    return (size_t)(out - dst);
+}
+
+#ifdef ENCODE_X86
+
+// --- SSE2 Kernels ---
+
+// Nibbles 0..15 to '0'..'9', 'a'..'f': add '0', plus 'a' - '0' - 10 above 9.
+static inline __m128i hex_digits_sse2(__m128i nibbles) {
+    __m128i above9 = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')),
+                        _mm_and_si128(above9, _mm_set1_epi8('a' - '0' - 10)));
+}
+
+static size_t hex_sse2(char *dst, const uint8_t *src, size_t len) {
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i hi = hex_digits_sse2(_mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i lo = hex_digits_sse2(_mm_and_si128(v, mask));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    hex_scalar(dst + 2 * i, src + i, len - i);
+    return 2 * len;
+}
+
+static size_t ascii_sse2(char *dst, const uint8_t *src, size_t len) {
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        // Signed compares: bytes from 0x80 up are negative and fail the first.
+        __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1f)),
+                                          _mm_cmplt_epi8(v, _mm_set1_epi8(0x7f)));
+        __m128i out = _mm_or_si128(_mm_and_si128(printable, v),
+                                   _mm_andnot_si128(printable, _mm_set1_epi8('.')));
+        _mm_storeu_si128((__m128i *)(dst + i), out);
+    }
+    ascii_scalar(dst + i, src + i, len - i);
+    return len;
+}
+
+// --- AVX2 Kernels ---
+
+__attribute__((target("avx2"))) static inline __m256i hex_digits_avx2(__m256i nibbles) {
+    __m256i above9 = _mm256_cmpgt_epi8(nibbles, _mm256_set1_epi8(9));
+    return _mm256_add_epi8(_mm256_add_epi8(nibbles, _mm256_set1_epi8('0')),
+                           _mm256_and_si256(above9, _mm256_set1_epi8('a' - '0' - 10)));
+}
+
+__attribute__((target("avx2"))) static size_t hex_avx2(char *dst, const uint8_t *src,
+                                                       size_t len) {
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i hi = hex_digits_avx2(_mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+        __m256i lo = hex_digits_avx2(_mm256_and_si256(v, mask));
+        // The unpacks work per 128-bit lane: a holds bytes 0-7 and 16-23, b
+        // holds bytes 8-15 and 24-31.
+        __m256i a = _mm256_unpacklo_epi8(hi, lo);
+        __m256i b = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i + 32),
+                            _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    hex_sse2(dst + 2 * i, src + i, len - i);
+    return 2 * len;
+}
+
+__attribute__((target("avx2"))) static size_t ascii_avx2(char *dst, const uint8_t *src,
+                                                         size_t len) {
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i printable = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(0x1f)),
+                                             _mm256_cmpgt_epi8(_mm256_set1_epi8(0x7f), v));
+        _mm256_storeu_si256((__m256i *)(dst + i),
+                            _mm256_blendv_epi8(_mm256_set1_epi8('.'), v, printable));
+    }
+    ascii_sse2(dst + i, src + i, len - i);
+    return len;
+}
+
+// Spread 24 bytes, loaded 4 bytes early so each lane holds 12 of them at bytes
+// 4..15 and 0..11, over 32 bytes of 6-bit values (Muła's method).
+__attribute__((target("avx2"))) static inline __m256i base64_reshuffle_avx2(__m256i input) {
+    const __m256i in = _mm256_shuffle_epi8(
+        input, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1, 14, 15, 13,
+                               14, 11, 12, 10, 11, 8, 9, 7, 8, 5, 6, 4, 5));
+
+    const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00));
+    const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0));
+    const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    return _mm256_or_si256(t1, t3);
+}
+
+// Map 6-bit values to the alphabet by adding the offset of their range:
+// A-Z +65, a-z +71, 0-9 -4, '+' -19, '/' -16.
+__attribute__((target("avx2"))) static inline __m256i base64_translate_avx2(__m256i in) {
+    const __m256i lut = _mm256_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19,
+                                         -16, 0, 0, 65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4,
+                                         -4, -19, -16, 0, 0);
+
+    // 0 for A-Z, 1 for a-z, 2..11 for 0-9, 12 and 13 for '+' and '/'.
+    __m256i indices = _mm256_subs_epu8(in, _mm256_set1_epi8(51));
+    indices = _mm256_sub_epi8(indices, _mm256_cmpgt_epi8(in, _mm256_set1_epi8(25)));
+    return _mm256_add_epi8(in, _mm256_shuffle_epi8(lut, indices));
+}
+
+__attribute__((target("avx2"))) static size_t base64_avx2(char *dst, const uint8_t *src,
+                                                          size_t len) {
+    size_t i = 0;
+
+    // Every block reads 4 bytes before and after its 24, so the first one is
+    // assembled from two 16-byte loads.
+    if (len >= 28) {
+        __m128i lo = _mm_slli_si128(_mm_loadu_si128((const __m128i *)src), 4);
+        __m128i hi = _mm_loadu_si128((const __m128i *)(src + 12));
+        __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        _mm256_storeu_si256((__m256i *)dst, base64_translate_avx2(base64_reshuffle_avx2(in)));
+        i = 24;
+
+        for (; i + 28 <= len; i += 24) {
+            in = _mm256_loadu_si256((const __m256i *)(src + i - 4));
+            _mm256_storeu_si256((__m256i *)(dst + i / 3 * 4),
+                                base64_translate_avx2(base64_reshuffle_avx2(in)));
+        }
+    }
+    return i / 3 * 4 + base64_scalar(dst + i / 3 * 4, src + i, len - i);
+}
+
+#endif  // ENCODE_X86
+
+// --- Dispatch ---
+
+static struct {
+    const char *name;
+    size_t (*hex)(char *dst, const uint8_t *src, size_t len);
+    size_t (*ascii)(char *dst, const uint8_t *src, size_t len);
+    size_t (*base64)(char *dst, const uint8_t *src, size_t len);
+} kernels = {"scalar", hex_scalar, ascii_scalar, base64_scalar};
+
+/**
+ * Pick the kernels for the running CPU. SSE2 has no byte shuffle, so its
+ * base64 stays scalar.
+ */
+__attribute__((constructor)) static void encode_init(void) {
+#ifdef ENCODE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.name = "avx2";
+        kernels.hex = hex_avx2;
+        kernels.ascii = ascii_avx2;
+        kernels.base64 = base64_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        kernels.name = "sse2";
+        kernels.hex = hex_sse2;
+        kernels.ascii = ascii_sse2;
+    }
+#endif
+}
+
+size_t encode_hex(char *dst, const uint8_t *src, size_t len) {
+    return kernels.hex(dst, src, len);
+}
+
+size_t encode_ascii(char *dst, const uint8_t *src, size_t len) {
+    return kernels.ascii(dst, src, len);
+}
+
+size_t encode_base64(char *dst, const uint8_t *src, size_t len) {
+    return kernels.base64(dst, src, len);
+}
+
+void encode_hex_append(GString *dst, const uint8_t *src, size_t len) {
+    gsize at = dst->len;
+    g_string_set_size(dst, at + 2 * len);
+    encode_hex(dst->str + at, src, len);
+}
+
+void encode_base64_append(GString *dst, const uint8_t *src, size_t len) {
+    gsize at = dst->len;
+    g_string_set_size(dst, at + ENCODE_BASE64_LEN(len));
+    encode_base64(dst->str + at, src, len);
+}
+
+const char *encode_kernel(void) { return kernels.name; }
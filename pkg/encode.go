@@ -0,0 +1,46 @@
+package pkg
+
+/*
+#cgo pkg-config: glib-2.0
+#include "encode.h"
+*/
+import "C"
+import "unsafe"
+
+// Go entry points to the C hex, ASCII and base64 kernels, used by the tests and
+// benchmarks to check them against the standard library.
+
+// encodeHex returns the lowercase hex of src.
+func encodeHex(src []byte) []byte {
+	dst := make([]byte, 2*len(src))
+	if len(src) > 0 {
+		C.encode_hex((*C.char)(unsafe.Pointer(&dst[0])), (*C.uint8_t)(unsafe.Pointer(&src[0])),
+			C.size_t(len(src)))
+	}
+	return dst
+}
+
+// encodeASCII returns src with every non-printable byte replaced by '.'.
+func encodeASCII(src []byte) []byte {
+	dst := make([]byte, len(src))
+	if len(src) > 0 {
+		C.encode_ascii((*C.char)(unsafe.Pointer(&dst[0])), (*C.uint8_t)(unsafe.Pointer(&src[0])),
+			C.size_t(len(src)))
+	}
+	return dst
+}
+
+// encodeBase64 returns the padded standard base64 of src.
+func encodeBase64(src []byte) []byte {
+	dst := make([]byte, (len(src)+2)/3*4)
+	if len(src) > 0 {
+		C.encode_base64((*C.char)(unsafe.Pointer(&dst[0])), (*C.uint8_t)(unsafe.Pointer(&src[0])),
+			C.size_t(len(src)))
+	}
+	return dst
+}
+
+// encodeKernel names the kernels picked for this CPU: "avx2", "sse2" or "scalar".
+func encodeKernel() string {
+	return C.GoString(C.encode_kernel())
+}
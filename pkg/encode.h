@@ -0,0 +1,33 @@
+#ifndef ENCODE_H
+#define ENCODE_H
+
+#include <glib.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Byte-to-text kernels for payload output. Each has an AVX2, an SSE2 and a
+// scalar implementation, picked once for the running CPU. The kernels write
+// straight into dst and do not NUL-terminate it.
+
+// Length of the padded base64 encoding of n bytes.
+#define ENCODE_BASE64_LEN(n) (((n) + 2) / 3 * 4)
+
+// Write the lowercase hex of src, 2 * len chars. Returns the chars written.
+size_t encode_hex(char *dst, const uint8_t *src, size_t len);
+
+// Write src with every byte outside 0x20..0x7e replaced by '.', len chars.
+size_t encode_ascii(char *dst, const uint8_t *src, size_t len);
+
+// Write the padded standard base64 of src, ENCODE_BASE64_LEN(len) chars.
+size_t encode_base64(char *dst, const uint8_t *src, size_t len);
+
+// Append the lowercase hex of src to dst, growing it once.
+void encode_hex_append(GString *dst, const uint8_t *src, size_t len);
+
+// Append the padded standard base64 of src to dst, growing it once.
+void encode_base64_append(GString *dst, const uint8_t *src, size_t len);
+
+// Name of the kernels in use: "avx2", "sse2" or "scalar".
+const char *encode_kernel(void);
+
+#endif  // ENCODE_H
@@ -0,0 +1,71 @@
+package pkg
+
+import (
+	"bytes"
+	"encoding/base64"
+	"encoding/hex"
+	"fmt"
+	"math/rand"
+	"testing"
+)
+
+func asciiReference(src []byte) []byte {
+	dst := make([]byte, len(src))
+	for i, c := range src {
+		if c >= ' ' && c < 0x7f {
+			dst[i] = c
+		} else {
+			dst[i] = '.'
+		}
+	}
+	return dst
+}
+
+// TestEncodeKernels checks the C kernels against the standard library around
+// every vector width, at unaligned offsets.
+func TestEncodeKernels(t *testing.T) {
+	t.Logf("kernel: %s", encodeKernel())
+
+	buf := make([]byte, 1100)
+	rand.New(rand.NewSource(1)).Read(buf)
+
+	for n := 0; n <= 1024; n++ {
+		for off := 0; off < 3; off++ {
+			src := buf[off : off+n]
+			if got, want := encodeHex(src), []byte(hex.EncodeToString(src)); !bytes.Equal(got, want) {
+				t.Fatalf("hex len %d off %d: got %q, want %q", n, off, got, want)
+			}
+			if got, want := encodeASCII(src), asciiReference(src); !bytes.Equal(got, want) {
+				t.Fatalf("ascii len %d off %d: got %q, want %q", n, off, got, want)
+			}
+			if got, want := encodeBase64(src), []byte(base64.StdEncoding.EncodeToString(src)); !bytes.Equal(got, want) {
+				t.Fatalf("base64 len %d off %d: got %q, want %q", n, off, got, want)
+			}
+		}
+	}
+}
+
+// BenchmarkEncode measures kernel throughput on MB-sized payloads.
+func BenchmarkEncode(b *testing.B) {
+	kernels := []struct {
+		name string
+		fn   func([]byte) []byte
+	}{
+		{"hex", encodeHex},
+		{"ascii", encodeASCII},
+		{"base64", encodeBase64},
+	}
+
+	for _, size := range []int{1 << 20, 16 << 20} {
+		src := make([]byte, size)
+		rand.New(rand.NewSource(1)).Read(src)
+		for _, k := range kernels {
+			b.Run(fmt.Sprintf("%s/%s/%dMiB", k.name, encodeKernel(), size>>20), func(b *testing.B) {
+				b.SetBytes(int64(size))
+				for i := 0; i < b.N; i++ {
+					k.fn(src)
+				}
+			})
+		}
+	}
+}
@@ -0,0 +1,523 @@
+package pkg
+
+/*
+#cgo pkg-config: glib-2.0
+#include "offline.h"
+*/
+import "C"
+import (
+	"encoding/binary"
+	"math"
+	"reflect"
+	"strconv"
+	"strings"
+	"sync"
+
+	"github.com/pkg/errors"
+)
+
+var (
+	ErrParseBinaryFrame = errors.New("malformed binary frame")
+	ErrBinaryFrameKeys  = errors.New("binary frame encoded with different field registrations")
+)
+
+const (
+	binaryFrameMagic = uint32(C.FRAME_BINARY_MAGIC)
+
+	nodeHasValue   = uint8(C.FRAME_NODE_HAS_VALUE)
+	nodeNumInt     = uint8(C.FRAME_NODE_NUM_INT)
+	nodeNumUint    = uint8(C.FRAME_NODE_NUM_UINT)
+	nodeNumDouble  = uint8(C.FRAME_NODE_NUM_DOUBLE)
+	nodeTextOnly   = uint8(C.FRAME_NODE_TEXT_ONLY)
+	nodeKey        = uint8(C.FRAME_NODE_KEY)
+	nodeValue      = uint8(C.FRAME_NODE_VALUE)
+	nodeValueNum   = uint8(C.FRAME_NODE_VALUE_NUM)
+	nodeNumMask    = nodeNumInt | nodeNumUint | nodeNumDouble
+	ftypeProtocol  = uint8(C.FT_PROTOCOL)
+	nodeFixedBytes = 4*4 + 1 + 1
+)
+
+// BinaryNode is one proto tree item of a binary frame (see WithBinaryFrames).
+type BinaryNode struct {
+	HfId   int32  // Header field id
+	Parent int32  // Index of the parent node, -1 for top-level protocols
+	FType  uint8  // Field type (ftenum)
+	Flags  uint8  // FRAME_NODE_* flags
+	Start  int32  // Byte offset in the frame
+	Length int32  // Byte length
+	Num    uint64 // Typed value bits, see Int, Uint and Float
+	Key    string // Field abbreviation, or the representation of text-only items
+	Value  string // Value as rendered in the JSON output, "" without HasValue except for protocols
+}
+
+func (n *BinaryNode) HasValue() bool  { return n.Flags&nodeHasValue != 0 }
+func (n *BinaryNode) TextOnly() bool  { return n.Flags&nodeTextOnly != 0 }
+func (n *BinaryNode) IsNumeric() bool { return n.Flags&nodeNumMask != 0 }
+func (n *BinaryNode) Int() int64      { return int64(n.Num) }
+func (n *BinaryNode) Uint() uint64    { return n.Num }
+func (n *BinaryNode) Float() float64  { return math.Float64frombits(n.Num) }
+
+// isBinaryFrame reports whether src is a binary frame rather than JSON.
+func isBinaryFrame(src []byte) bool {
+	return len(src) >= 4 && binary.NativeEndian.Uint32(src) == binaryFrameMagic
+}
+
+// binaryFrameReader reads the fields of a binary frame, remembering the first error.
+type binaryFrameReader struct {
+	src []byte
+	err error
+}
+
+func (r *binaryFrameReader) next(n int) []byte {
+	if r.err != nil {
+		return nil
+	}
+	if n < 0 || n > len(r.src) {
+		r.err = ErrParseBinaryFrame
+		return nil
+	}
+	b := r.src[:n]
+	r.src = r.src[n:]
+	return b
+}
+
+func (r *binaryFrameReader) u8() uint8 {
+	if b := r.next(1); b != nil {
+		return b[0]
+	}
+	return 0
+}
+
+func (r *binaryFrameReader) u16() uint16 {
+	if b := r.next(2); b != nil {
+		return binary.NativeEndian.Uint16(b)
+	}
+	return 0
+}
+
+func (r *binaryFrameReader) u32() uint32 {
+	if b := r.next(4); b != nil {
+		return binary.NativeEndian.Uint32(b)
+	}
+	return 0
+}
+
+func (r *binaryFrameReader) u64() uint64 {
+	if b := r.next(8); b != nil {
+		return binary.NativeEndian.Uint64(b)
+	}
+	return 0
+}
+
+func (r *binaryFrameReader) str(n int) string {
+	return string(r.next(n))
+}
+
+var staticKeyCache sync.Map // int32 -> string
+
+// staticKey returns the abbreviation of a field registered at init, which
+// binary frames leave out (see frame_static_key).
+func staticKey(hfid int32) (string, bool) {
+	if key, ok := staticKeyCache.Load(hfid); ok {
+		return key.(string), true
+	}
+	ckey := C.frame_static_key(C.int32_t(hfid))
+	if ckey == nil {
+		return "", false
+	}
+	key := C.GoString(ckey)
+	staticKeyCache.Store(hfid, key)
+	return key, true
+}
+
+// DecodeBinaryNodes decodes a binary frame into its "_index" value and its
+// nodes, in pre-order.
+func DecodeBinaryNodes(src []byte) (index string, nodes []BinaryNode, err error) {
+	r := &binaryFrameReader{src: src}
+	if r.u32() != binaryFrameMagic {
+		return "", nil, ErrParseBinaryFrame
+	}
+	count := int(r.u32())
+	if keys := r.u32(); r.err == nil && keys != uint32(C.frame_static_key_count()) {
+		return "", nil, ErrBinaryFrameKeys
+	}
+	index = r.str(int(r.u16()))
+
+	// Every node takes at least its fixed part, which bounds count on garbage input.
+	if r.err != nil || count > len(r.src)/nodeFixedBytes {
+		return "", nil, ErrParseBinaryFrame
+	}
+
+	nodes = make([]BinaryNode, count)
+	for i := range nodes {
+		n := &nodes[i]
+		n.HfId = int32(r.u32())
+		n.Parent = int32(r.u32())
+		n.Start = int32(r.u32())
+		n.Length = int32(r.u32())
+		if b := r.next(2); b != nil {
+			n.FType, n.Flags = b[0], b[1]
+		}
+		if n.Flags&nodeNumMask != 0 {
+			n.Num = r.u64()
+		}
+		if n.Flags&nodeKey != 0 {
+			n.Key = r.str(int(r.u16()))
+		} else if key, ok := staticKey(n.HfId); ok {
+			n.Key = key
+		} else {
+			return "", nil, ErrParseBinaryFrame
+		}
+		switch {
+		case n.Flags&nodeValue != 0:
+			n.Value = r.str(int(r.u32()))
+		case n.Flags&nodeValueNum == 0:
+		case n.Flags&nodeNumInt != 0:
+			n.Value = strconv.FormatInt(n.Int(), 10)
+		case n.Flags&nodeNumUint != 0:
+			n.Value = strconv.FormatUint(n.Uint(), 10)
+		}
+
+		if r.err != nil || n.Parent < -1 || int(n.Parent) >= i {
+			return "", nil, ErrParseBinaryFrame
+		}
+	}
+	return index, nodes, nil
+}
+
+// binaryTree is the decoded node array of a frame with its child lists.
+type binaryTree struct {
+	nodes    []BinaryNode
+	children [][]int // children of each node
+	roots    []int   // top-level protocol nodes
+}
+
+func newBinaryTree(nodes []BinaryNode) *binaryTree {
+	t := &binaryTree{nodes: nodes, children: make([][]int, len(nodes))}
+	for i := range nodes {
+		if p := nodes[i].Parent; p < 0 {
+			t.roots = append(t.roots, i)
+		} else {
+			t.children[p] = append(t.children[p], i)
+		}
+	}
+	return t
+}
+
+// DecodeBinaryFrame builds FrameData from a binary frame. Layers has the same
+// shape as the JSON output; BaseLayers is filled straight from the nodes, using
+// their typed values.
+func DecodeBinaryFrame(src []byte) (*FrameData, error) {
+	return decodeBinaryFrame(src, true)
+}
+
+// decodeBinaryFrame is DecodeBinaryFrame; without keepLayers, Layers is never built.
+func decodeBinaryFrame(src []byte, keepLayers bool) (*FrameData, error) {
+	index, nodes, err := DecodeBinaryNodes(src)
+	if err != nil {
+		return nil, err
+	}
+	t := newBinaryTree(nodes)
+
+	frame := &FrameData{Index: index}
+	if keepLayers {
+		frame.Layers = t.object(t.roots)
+	}
+	t.fillBaseLayers(frame)
+	return frame, nil
+}
+
+// --- Layers ---
+
+// object renders a list of sibling nodes like the JSON writer: siblings sharing
+// a key are merged into an array, a node with a value and children gets its
+// children under key+"_tree".
+func (t *binaryTree) object(list []int) map[string]any {
+	obj := make(map[string]any, len(list))
+
+	var keys []string
+	groups := make(map[string][]int, len(list))
+	for _, i := range list {
+		key := t.nodes[i].Key
+		if _, ok := groups[key]; !ok {
+			keys = append(keys, key)
+		}
+		groups[key] = append(groups[key], i)
+	}
+
+	for _, key := range keys {
+		group := groups[key]
+		hasValue := t.nodes[group[0]].HasValue()
+		hasChildren := false
+		for _, i := range group {
+			if len(t.children[i]) > 0 {
+				hasChildren = true
+				break
+			}
+		}
+
+		if hasValue {
+			obj[key] = t.values(group, t.value)
+		}
+		if hasChildren {
+			suffix := ""
+			if hasValue {
+				suffix = "_tree"
+			}
+			obj[key+suffix] = t.values(group, func(i int) any {
+				if len(t.children[i]) > 0 {
+					return t.object(t.children[i])
+				}
+				return t.noValue(i)
+			})
+		}
+		if !hasValue && !hasChildren {
+			obj[key] = t.values(group, func(i int) any { return t.noValue(i) })
+		}
+	}
+	return obj
+}
+
+// values renders a group of nodes as a single value, or an array of several.
+func (t *binaryTree) values(group []int, value func(i int) any) any {
+	if len(group) == 1 {
+		return value(group[0])
+	}
+	arr := make([]any, len(group))
+	for j, i := range group {
+		arr[j] = value(i)
+	}
+	return arr
+}
+
+// value is what the JSON writer renders for a node of a group with a value: its
+// JSON representation, null if the field has none.
+func (t *binaryTree) value(i int) any {
+	n := &t.nodes[i]
+	if n.Flags&(nodeValue|nodeValueNum) == 0 {
+		return nil
+	}
+	return n.Value
+}
+
+// noValue is what the JSON writer renders for a node without value or children:
+// the protocol name for protocols, an empty string otherwise.
+func (t *binaryTree) noValue(i int) string {
+	n := &t.nodes[i]
+	if n.FType == ftypeProtocol && !n.HasValue() {
+		return n.Value
+	}
+	return ""
+}
+
+// --- Base Layers ---
+
+// layerField is a field of a base layer struct, addressed by its json tag.
+type layerField struct {
+	index int
+	kind  reflect.Kind
+}
+
+var layerFieldCache sync.Map // reflect.Type -> map[string]layerField
+
+// layerFields maps the json tags of a base layer struct to its fields.
+func layerFields(typ reflect.Type) map[string]layerField {
+	if fields, ok := layerFieldCache.Load(typ); ok {
+		return fields.(map[string]layerField)
+	}
+
+	fields := make(map[string]layerField, typ.NumField())
+	for i := 0; i < typ.NumField(); i++ {
+		f := typ.Field(i)
+		tag, _, _ := strings.Cut(f.Tag.Get("json"), ",")
+		if tag == "" || tag == "-" {
+			continue
+		}
+		kind := f.Type.Kind()
+		switch {
+		case f.Type == reflect.TypeOf((*[]string)(nil)):
+			kind = reflect.Slice
+		case kind == reflect.String, kind == reflect.Int, kind == reflect.Int64,
+			kind == reflect.Float64, kind == reflect.Bool:
+		default:
+			continue // Nested lists like Dns.Queries are filled by their layer
+		}
+		fields[tag] = layerField{index: i, kind: kind}
+	}
+	layerFieldCache.Store(typ, fields)
+	return fields
+}
+
+// fillLayer sets the fields of the struct dst points to from the direct children
+// of a layer node whose key matches a json tag.
+func (t *binaryTree) fillLayer(dst any, layer int) {
+	v := reflect.ValueOf(dst).Elem()
+	fields := layerFields(v.Type())
+	seen := make(map[string]bool, len(t.children[layer]))
+
+	for _, i := range t.children[layer] {
+		n := &t.nodes[i]
+		f, ok := fields[n.Key]
+		if !ok {
+			continue
+		}
+		// Repeated scalar fields keep their first value.
+		if seen[n.Key] && f.kind != reflect.Slice {
+			continue
+		}
+		seen[n.Key] = true
+		t.setField(v.Field(f.index), f.kind, n)
+	}
+}
+
+func (t *binaryTree) setField(fv reflect.Value, kind reflect.Kind, n *BinaryNode) {
+	value := n.Value
+	if !n.HasValue() {
+		value = ""
+	}
+
+	switch kind {
+	case reflect.String:
+		fv.SetString(value)
+	case reflect.Int, reflect.Int64:
+		switch {
+		case n.Flags&(nodeNumInt|nodeNumUint) != 0:
+			fv.SetInt(n.Int())
+		case n.Flags&nodeNumDouble != 0:
+			fv.SetInt(int64(n.Float()))
+		default:
+			i, _ := strconv.Atoi(value)
+			fv.SetInt(int64(i))
+		}
+	case reflect.Float64:
+		switch {
+		case n.Flags&nodeNumDouble != 0:
+			fv.SetFloat(n.Float())
+		case n.Flags&nodeNumInt != 0:
+			fv.SetFloat(float64(n.Int()))
+		case n.Flags&nodeNumUint != 0:
+			fv.SetFloat(float64(n.Uint()))
+		default:
+			f, _ := strconv.ParseFloat(value, 64)
+			fv.SetFloat(f)
+		}
+	case reflect.Bool:
+		if n.IsNumeric() {
+			fv.SetBool(n.Num != 0)
+		} else {
+			b, _ := strconv.ParseBool(value)
+			fv.SetBool(b)
+		}
+	case reflect.Slice: // *[]string
+		if fv.IsNil() {
+			fv.Set(reflect.ValueOf(&[]string{}))
+		}
+		list := fv.Interface().(*[]string)
+		*list = append(*list, value)
+	}
+}
+
+// fillBaseLayers fills frame.BaseLayers from the top-level protocol nodes.
+func (t *binaryTree) fillBaseLayers(frame *FrameData) {
+	b := &frame.BaseLayers
+	for _, i := range t.roots {
+		switch t.nodes[i].Key {
+		case "frame":
+			if b.Frame == nil {
+				b.Frame = &Frame{}
+				t.fillLayer(b.Frame, i)
+			}
+		case "_ws.col":
+			if b.WsCol == nil {
+				b.WsCol = &WsCol{}
+				t.fillLayer(b.WsCol, i)
+			}
+		case "eth":
+			if b.Eth == nil {
+				b.Eth = &Eth{}
+				t.fillLayer(b.Eth, i)
+			}
+		case "ip":
+			if b.Ip == nil {
+				b.Ip = &Ip{}
+				t.fillLayer(b.Ip, i)
+			}
+		case "udp":
+			if b.Udp == nil {
+				b.Udp = &Udp{}
+				t.fillLayer(b.Udp, i)
+			}
+		case "tcp":
+			if b.Tcp == nil {
+				b.Tcp = &Tcp{}
+				t.fillLayer(b.Tcp, i)
+			}
+		case "http":
+			b.Http = append(b.Http, t.http(i))
+		case "dns":
+			if b.Dns == nil {
+				b.Dns = t.dns(i)
+			}
+		}
+	}
+}
+
+func (t *binaryTree) http(layer int) *Http {
+	http := &Http{}
+	t.fillLayer(http, layer)
+
+	// Response line item, keyed by its text like "HTTP/1.1 404 Not Found\r\n"
+	for _, i := range t.children[layer] {
+		if !t.nodes[i].TextOnly() || !strings.HasPrefix(t.nodes[i].Key, "HTTP/") {
+			continue
+		}
+		for _, j := range t.children[i] {
+			n := &t.nodes[j]
+			switch n.Key {
+			case "http.response.version":
+				http.ResponseVersion = n.Value
+			case "http.response.code":
+				http.ResponseCode = n.Value
+			case "http.response.code.desc":
+				http.ResponseCodeDesc = n.Value
+			case "http.response.phrase":
+				http.ResponsePhrase = n.Value
+			}
+		}
+	}
+	return http
+}
+
+func (t *binaryTree) dns(layer int) *Dns {
+	dns := &Dns{}
+	t.fillLayer(dns, layer)
+
+	for _, i := range t.children[layer] {
+		if !t.nodes[i].TextOnly() {
+			continue
+		}
+		switch t.nodes[i].Key {
+		case "Queries":
+			for _, q := range t.children[i] {
+				var query DnsQuery
+				t.fillLayer(&query, q)
+				dns.Queries = append(dns.Queries, query)
+			}
+		case "Answers":
+			for _, a := range t.children[i] {
+				var answer DnsAnswer
+				t.fillLayer(&answer, a)
+				dns.Answers = append(dns.Answers, answer)
+			}
+		}
+	}
+
+	// Like the JSON path, which sizes the lists by the counts in the header.
+	for len(dns.Queries) < dns.QueriesCount {
+		dns.Queries = append(dns.Queries, DnsQuery{})
+	}
+	for len(dns.Answers) < dns.AnswersCount {
+		dns.Answers = append(dns.Answers, DnsAnswer{})
+	}
+	return dns
+}
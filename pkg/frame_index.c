@@ -0,0 +1,244 @@
+#include "frame_index.h"
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lib.h"
+
+#define FRAME_INDEX_MAGIC 0x58444957u /* "WIDX" */
+#define FRAME_INDEX_VERSION 2
+#define FRAME_INDEX_INITIAL_CAPACITY 4096
+
+// On-disk header, followed by count frame_index_entry records.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int64_t file_size;
+    int64_t file_mtime;  // nanoseconds since the epoch
+    uint32_t count;
+    uint32_t entry_size;
+} frame_index_header;
+
+static bool stat_capture(const char *filepath, int64_t *size, int64_t *mtime) {
+    struct stat st;
+
+    if (stat(filepath, &st) != 0) {
+        return false;
+    }
+    *size = (int64_t)st.st_size;
+    *mtime = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    return true;
+}
+
+static bool frame_index_append(frame_index *idx, const frame_index_entry *entry) {
+    if (idx->count == idx->capacity) {
+        uint32_t capacity = idx->capacity ? idx->capacity * 2 : FRAME_INDEX_INITIAL_CAPACITY;
+        frame_index_entry *entries = g_try_renew(frame_index_entry, idx->entries, capacity);
+        if (entries == NULL) {
+            return false;
+        }
+        idx->entries = entries;
+        idx->capacity = capacity;
+    }
+    idx->entries[idx->count++] = *entry;
+    return true;
+}
+
+/**
+ * Build a frame-offset index with one sequential wtap_read pass.
+ * Records are only read, never dissected, so this is I/O bound.
+ *
+ *  @param filepath the pcap file path
+ *  @param err set to the wiretap error code (or errno) on failure
+ *  @return the index, NULL if the file cannot be read to its end
+ */
+frame_index *frame_index_build(const char *filepath, int *err) {
+    gchar *err_info = NULL;
+    int64_t data_offset = 0;
+    frame_index_entry entry;
+    wtap_rec rec;
+
+    *err = 0;
+    frame_index *idx = g_new0(frame_index, 1);
+    if (!stat_capture(filepath, &idx->file_size, &idx->file_mtime)) {
+        *err = errno;
+        g_free(idx);
+        return NULL;
+    }
+
+    wtap *wth = wtap_open_offline(filepath, WTAP_TYPE_AUTO, err, &err_info, FALSE);
+    if (wth == NULL) {
+        g_free(err_info);
+        g_free(idx);
+        return NULL;
+    }
+
+    bool complete = true;
+    wtap_rec_init(&rec, 1514);
+    while (wtap_read(wth, &rec, err, &err_info, &data_offset)) {
+        entry.offset = data_offset;
+        entry.flags = 0;
+        entry.secs = 0;
+        entry.nsecs = 0;
+        if (rec.presence_flags & WTAP_HAS_TS) {
+            entry.secs = (int64_t)rec.ts.secs;
+            entry.nsecs = rec.ts.nsecs;
+            entry.flags |= FRAME_INDEX_HAS_TS;
+        }
+        if (!frame_index_append(idx, &entry)) {
+            *err = ENOMEM;
+            complete = false;
+            break;
+        }
+        wtap_rec_reset(&rec);
+    }
+
+    // A capture cut off in its last record still yields a usable index of the
+    // frames before it, which matches what a sequential pass would return. Any
+    // other error would leave frames unreachable, so there is no index then.
+    if (complete && *err == WTAP_ERR_SHORT_READ) {
+        *err = 0;
+    }
+    g_free(err_info);
+    wtap_rec_cleanup(&rec);
+    wtap_close(wth);
+
+    if (!complete || *err != 0) {
+        frame_index_free(idx);
+        return NULL;
+    }
+    return idx;
+}
+
+frame_index *frame_index_load(const char *index_path, int64_t file_size, int64_t file_mtime) {
+    frame_index_header hdr;
+    FILE *fp = fopen(index_path, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != FRAME_INDEX_MAGIC ||
+        hdr.version != FRAME_INDEX_VERSION || hdr.entry_size != sizeof(frame_index_entry) ||
+        hdr.file_size != file_size || hdr.file_mtime != file_mtime) {
+        fclose(fp);
+        return NULL;
+    }
+
+    frame_index *idx = g_new0(frame_index, 1);
+    idx->file_size = hdr.file_size;
+    idx->file_mtime = hdr.file_mtime;
+    if (hdr.count > 0) {
+        idx->entries = g_try_new(frame_index_entry, hdr.count);
+        if (idx->entries == NULL ||
+            fread(idx->entries, sizeof(frame_index_entry), hdr.count, fp) != hdr.count) {
+            fclose(fp);
+            frame_index_free(idx);
+            return NULL;
+        }
+    }
+    idx->count = hdr.count;
+    idx->capacity = hdr.count;
+
+    fclose(fp);
+    return idx;
+}
+
+bool frame_index_save(const frame_index *idx, const char *index_path) {
+    frame_index_header hdr;
+    bool ok;
+
+    // Unique temporary name: indexes are built without the epan lock, so two
+    // callers may persist the same capture at once.
+    char *tmp_path = g_strdup_printf("%s.XXXXXX", index_path);
+    int fd = g_mkstemp(tmp_path);
+    if (fd < 0) {
+        g_free(tmp_path);
+        return false;
+    }
+    fchmod(fd, 0644);
+    FILE *fp = fdopen(fd, "wb");
+    if (fp == NULL) {
+        close(fd);
+        remove(tmp_path);
+        g_free(tmp_path);
+        return false;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = FRAME_INDEX_MAGIC;
+    hdr.version = FRAME_INDEX_VERSION;
+    hdr.file_size = idx->file_size;
+    hdr.file_mtime = idx->file_mtime;
+    hdr.count = idx->count;
+    hdr.entry_size = sizeof(frame_index_entry);
+
+    ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+         (idx->count == 0 ||
+          fwrite(idx->entries, sizeof(frame_index_entry), idx->count, fp) == idx->count);
+    ok = (fclose(fp) == 0) && ok;
+
+    // Rename only complete files so a concurrent reader never sees a torn index.
+    if (ok) {
+        ok = rename(tmp_path, index_path) == 0;
+    }
+    if (!ok) {
+        remove(tmp_path);
+    }
+    g_free(tmp_path);
+
+    return ok;
+}
+
+/**
+ * Open the frame index of a capture.
+ *
+ *  @param filepath the pcap file path
+ *  @param index_path the sidecar path, may be NULL to skip persistence
+ *  @param err set to an error code on failure
+ *  @return the index, NULL if the capture cannot be read
+ */
+frame_index *frame_index_open(const char *filepath, const char *index_path, int *err) {
+    int64_t size, mtime;
+
+    *err = 0;
+    if (!stat_capture(filepath, &size, &mtime)) {
+        *err = errno;
+        return NULL;
+    }
+
+    if (index_path != NULL && strlen(index_path) > 0) {
+        frame_index *idx = frame_index_load(index_path, size, mtime);
+        if (idx != NULL) {
+            return idx;
+        }
+    }
+
+    frame_index *idx = frame_index_build(filepath, err);
+    if (idx == NULL) {
+        return NULL;
+    }
+
+    // Persisting is best effort: read-only capture directories still get an
+    // in-memory index.
+    if (index_path != NULL && strlen(index_path) > 0 && !frame_index_save(idx, index_path)) {
+        fprintf(stderr, "Warning: could not write frame index %s\n", index_path);
+    }
+
+    return idx;
+}
+
+const frame_index_entry *frame_index_get(const frame_index *idx, uint32_t num) {
+    if (idx == NULL || num == 0 || num > idx->count) {
+        return NULL;
+    }
+    return &idx->entries[num - 1];
+}
+
+void frame_index_free(frame_index *idx) {
+    if (idx == NULL) {
+        return;
+    }
+    g_free(idx->entries);
+    g_free(idx);
+}
@@ -0,0 +1,159 @@
+package pkg
+
+/*
+#cgo pkg-config: glib-2.0
+#include <stdlib.h>
+#include "frame_index.h"
+*/
+import "C"
+import (
+	"log/slog"
+	"os"
+	"slices"
+	"strconv"
+	"sync"
+	"unsafe"
+
+	"github.com/pkg/errors"
+)
+
+// FrameIndexSuffix is appended to a capture path to form its sidecar index path.
+const FrameIndexSuffix = ".gwidx"
+
+// maxCachedFrameIndexes bounds how many loaded indexes stay in memory.
+const maxCachedFrameIndexes = 8
+
+// cachedFrameIndex is a loaded index shared by concurrent readers. An entry
+// dropped from the cache is freed once its last reader releases it.
+type cachedFrameIndex struct {
+	path    string
+	idx     *C.frame_index
+	refs    int
+	evicted bool
+}
+
+// frameIndexCache holds recently used indexes, most recent first.
+var (
+	frameIndexCache []*cachedFrameIndex
+	muFrameIndex    sync.Mutex
+)
+
+// FrameIndexPath returns the sidecar index path of a capture file.
+func FrameIndexPath(path string) string {
+	return path + FrameIndexSuffix
+}
+
+// evictLocked drops an entry from the cache. Caller must hold muFrameIndex.
+func (c *cachedFrameIndex) evictLocked() {
+	c.evicted = true
+	if c.refs == 0 {
+		C.frame_index_free(c.idx)
+	}
+}
+
+// release returns an index obtained from loadFrameIndex. It is a no-op on nil,
+// so callers may defer it unconditionally.
+func (c *cachedFrameIndex) release() {
+	if c == nil {
+		return
+	}
+	muFrameIndex.Lock()
+	defer muFrameIndex.Unlock()
+
+	c.refs--
+	if c.evicted && c.refs == 0 {
+		C.frame_index_free(c.idx)
+	}
+}
+
+// loadFrameIndex returns the frame-offset index of a capture. It is served from
+// memory if the capture is unchanged, else loaded from the sidecar, else built
+// with one wtap_read pass and persisted. Building only touches wiretap, not the
+// epan session, so it runs without EpanMutex and indexes of different files are
+// built concurrently. The caller must release the returned index.
+func loadFrameIndex(path string) (*cachedFrameIndex, error) {
+	info, err := os.Stat(path)
+	if err != nil {
+		return nil, errors.Wrap(ErrFileNotFound, path)
+	}
+
+	muFrameIndex.Lock()
+	for i, c := range frameIndexCache {
+		if c.path != path {
+			continue
+		}
+		if int64(c.idx.file_size) == info.Size() && int64(c.idx.file_mtime) == info.ModTime().UnixNano() {
+			frameIndexCache = slices.Delete(frameIndexCache, i, i+1)
+			frameIndexCache = slices.Insert(frameIndexCache, 0, c)
+			c.refs++
+			muFrameIndex.Unlock()
+			return c, nil
+		}
+		// Capture was rewritten: drop the stale index.
+		frameIndexCache = slices.Delete(frameIndexCache, i, i+1)
+		c.evictLocked()
+		break
+	}
+	muFrameIndex.Unlock()
+
+	cPath := C.CString(path)
+	cIndexPath := C.CString(FrameIndexPath(path))
+	defer C.free(unsafe.Pointer(cPath))
+	defer C.free(unsafe.Pointer(cIndexPath))
+
+	var cErr C.int
+	idx := C.frame_index_open(cPath, cIndexPath, &cErr)
+	if idx == nil {
+		return nil, errors.Wrap(ErrReadFile, strconv.Itoa(int(cErr)))
+	}
+
+	muFrameIndex.Lock()
+	defer muFrameIndex.Unlock()
+
+	// Another caller may have loaded the same capture meanwhile; the newest wins.
+	frameIndexCache = slices.DeleteFunc(frameIndexCache, func(c *cachedFrameIndex) bool {
+		if c.path == path {
+			c.evictLocked()
+			return true
+		}
+		return false
+	})
+
+	c := &cachedFrameIndex{path: path, idx: idx, refs: 1}
+	frameIndexCache = slices.Insert(frameIndexCache, 0, c)
+	if len(frameIndexCache) > maxCachedFrameIndexes {
+		for _, old := range frameIndexCache[maxCachedFrameIndexes:] {
+			old.evictLocked()
+		}
+		frameIndexCache = frameIndexCache[:maxCachedFrameIndexes]
+	}
+
+	return c, nil
+}
+
+// frameIndexFor returns the index to use for random access, or nil when the
+// index is disabled or unavailable, in which case callers fall back to a
+// sequential pass. The caller must release the returned index.
+func frameIndexFor(path string, conf *Conf) *cachedFrameIndex {
+	if !conf.FrameIndex {
+		return nil
+	}
+	idx, err := loadFrameIndex(path)
+	if err != nil {
+		slog.Warn("frame index unavailable, falling back to sequential read", "path", path, "err", err)
+		return nil
+	}
+	return idx
+}
+
+// BuildFrameIndex builds (or validates) the sidecar frame index of a capture ahead
+// of time and returns the number of frames it covers.
+func BuildFrameIndex(path string) (count int, err error) {
+	idx, err := loadFrameIndex(path)
+	if err != nil {
+		return 0, err
+	}
+	defer idx.release()
+
+	return int(idx.idx.count), nil
+}
@@ -0,0 +1,46 @@
+#ifndef FRAME_INDEX_H
+#define FRAME_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FRAME_INDEX_HAS_TS 0x1
+
+// One entry per frame, in frame order (frame N lives at entries[N - 1]).
+typedef struct {
+    int64_t offset;  // seek offset accepted by wtap_seek_read
+    int64_t secs;    // absolute timestamp
+    int32_t nsecs;
+    uint32_t flags;  // FRAME_INDEX_HAS_TS
+} frame_index_entry;
+
+typedef struct {
+    int64_t file_size;   // size of the capture the index was built from
+    int64_t file_mtime;  // mtime of the capture the index was built from, in ns
+    uint32_t count;
+    uint32_t capacity;
+    frame_index_entry *entries;
+} frame_index;
+
+// Load the sidecar index at index_path if it still matches the capture's size
+// and mtime; otherwise build it with a single wtap_read pass and try to
+// persist it. Returns NULL (and sets *err) if the capture cannot be read.
+frame_index *frame_index_open(const char *filepath, const char *index_path, int *err);
+
+// Build an index with a single wtap_read pass (no dissection). Returns NULL
+// (and sets *err) unless the pass reaches the end of the capture, or a record
+// cut short at its end.
+frame_index *frame_index_build(const char *filepath, int *err);
+
+// Load a sidecar index, returning NULL if it is missing, corrupt or stale.
+frame_index *frame_index_load(const char *index_path, int64_t file_size, int64_t file_mtime);
+
+// Write the index to index_path (via a temporary file and rename).
+bool frame_index_save(const frame_index *idx, const char *index_path);
+
+// Returns the entry of frame num (1-based), NULL if out of range.
+const frame_index_entry *frame_index_get(const frame_index *idx, uint32_t num);
+
+void frame_index_free(frame_index *idx);
+
+#endif  // FRAME_INDEX_H
@@ -0,0 +1,241 @@
+package pkg
+
+import (
+	"iter"
+	"log/slog"
+	"sync"
+)
+
+// reorderRing hands out consecutive sequence numbers and releases the results
+// stored under them in sequence order, whatever order they complete in. At most
+// len(slots) sequence numbers are outstanding: reserve blocks until the oldest
+// one has been released, which bounds the work in flight.
+type reorderRing[T any] struct {
+	mu       sync.Mutex
+	cond     sync.Cond
+	slots    []T
+	ready    []bool
+	head     uint64 // sequence number released next
+	tail     uint64 // sequence number reserved next
+	finished bool   // no more sequence numbers will be reserved
+	closed   bool   // the consumer is gone
+}
+
+func newReorderRing[T any](size int) *reorderRing[T] {
+	r := &reorderRing[T]{
+		slots: make([]T, size),
+		ready: make([]bool, size),
+	}
+	r.cond.L = &r.mu
+	return r
+}
+
+// reserve returns the next sequence number, waiting while the ring is full.
+// ok is false once the consumer has closed the ring.
+func (r *reorderRing[T]) reserve() (seq uint64, ok bool) {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	for !r.closed && r.tail-r.head >= uint64(len(r.slots)) {
+		r.cond.Wait()
+	}
+	if r.closed {
+		return 0, false
+	}
+	seq = r.tail
+	r.tail++
+	return seq, true
+}
+
+// tryReserve is reserve without the wait: ok is false while the ring is full.
+func (r *reorderRing[T]) tryReserve() (seq uint64, ok bool) {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	if r.closed || r.tail-r.head >= uint64(len(r.slots)) {
+		return 0, false
+	}
+	seq = r.tail
+	r.tail++
+	return seq, true
+}
+
+// outstanding returns how many sequence numbers are reserved but not released.
+func (r *reorderRing[T]) outstanding() int {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	return int(r.tail - r.head)
+}
+
+// put stores the result of the reserved sequence number seq.
+func (r *reorderRing[T]) put(seq uint64, v T) {
+	r.mu.Lock()
+	i := seq % uint64(len(r.slots))
+	r.slots[i] = v
+	r.ready[i] = true
+	r.mu.Unlock()
+	r.cond.Broadcast()
+}
+
+// next returns the result of the oldest outstanding sequence number as soon as
+// it is stored. ok is false once the ring is finished and drained, or closed.
+func (r *reorderRing[T]) next() (v T, ok bool) {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	i := r.head % uint64(len(r.slots))
+	for !r.ready[i] {
+		if r.closed || (r.finished && r.head == r.tail) {
+			return v, false
+		}
+		r.cond.Wait()
+	}
+	v = r.slots[i]
+	var zero T
+	r.slots[i] = zero
+	r.ready[i] = false
+	r.head++
+	r.cond.Broadcast()
+	return v, true
+}
+
+// finish marks that every reserved sequence number has been put.
+func (r *reorderRing[T]) finish() {
+	r.mu.Lock()
+	r.finished = true
+	r.mu.Unlock()
+	r.cond.Broadcast()
+}
+
+// close releases a producer waiting in reserve once the consumer is gone.
+func (r *reorderRing[T]) close() {
+	r.mu.Lock()
+	r.closed = true
+	r.mu.Unlock()
+	r.cond.Broadcast()
+}
+
+// parsedBatch is a batch of raw frames after ParseFrameData, frame by frame.
+type parsedBatch struct {
+	frames []*FrameData
+	errs   []error
+}
+
+func parseBatch(batch [][]byte, keepLayers bool) parsedBatch {
+	res := parsedBatch{
+		frames: make([]*FrameData, len(batch)),
+		errs:   make([]error, len(batch)),
+	}
+	for i, raw := range batch {
+		res.frames[i], res.errs[i] = parseFrameData(raw, keepLayers)
+	}
+	return res
+}
+
+// seqBatch is a raw batch tagged with the sequence number it was emitted under.
+type seqBatch struct {
+	seq   uint64
+	batch [][]byte
+}
+
+// IterFrames dissects all frames of a capture and yields them in frame order
+// while the dissection is still running, instead of collecting them like
+// GetAllFrames. At most MaxInFlight frames (WithMaxInFlight) are dissected ahead
+// of the consumer; beyond that the C loop waits, so memory stays flat however
+// large the capture is. Breaking out of the loop stops the dissection.
+//
+// Parse errors are yielded in place of their frame unless IgnoreError is set;
+// an error of the dissection itself is yielded last. EpanMutex is held until the
+// iteration ends, so the loop body must not start another dissection in this
+// process; WorkerPool.IterFrames has no such restriction.
+func IterFrames(path string, opts ...Option) iter.Seq2[*FrameData, error] {
+	return func(yield func(*FrameData, error) bool) {
+		conf := NewConfig(opts...)
+
+		if err := validateFrameConf(conf); err != nil {
+			yield(nil, err)
+			return
+		}
+
+		count := iterFrames(conf, cFrameSource(runAllFrames(path, conf)), yield)
+
+		if conf.Debug {
+			slog.Info("IterFrames Dissect end", "PCAP_FILE", path, "COUNT", count)
+		}
+	}
+}
+
+// iterFrames parses the batches of src concurrently and yields their frames in
+// the order src emitted them. Each batch is tagged with a sequence number as it
+// is emitted and released from a reorder ring once it and all batches before it
+// are parsed. The ring holds conf.MaxInFlight frames, rounded up to whole
+// batches: emit blocks src while it is full and tells src to stop once the
+// consumer is gone. It returns the number of frames yielded.
+func iterFrames(conf *Conf, src frameSource, yield func(*FrameData, error) bool) (count int) {
+	inFlight := max(conf.MaxInFlight/max(conf.BatchFrames, 1), 1)
+	ring := newReorderRing[parsedBatch](inFlight)
+	work := make(chan seqBatch, inFlight)
+
+	var parseWg sync.WaitGroup
+	workerNum := getOptimalWorkerNum(inFlight)
+	parseWg.Add(workerNum)
+	for i := 0; i < workerNum; i++ {
+		go func() {
+			defer parseWg.Done()
+			for b := range work {
+				ring.put(b.seq, parseBatch(b.batch, conf.KeepLayers))
+			}
+		}()
+	}
+
+	var srcErr error
+	srcDone := make(chan struct{})
+	go func() {
+		defer close(srcDone)
+		srcErr = src(func(batch [][]byte) bool {
+			seq, ok := ring.reserve()
+			if !ok {
+				return false
+			}
+			work <- seqBatch{seq: seq, batch: batch}
+			return true
+		})
+		close(work)
+		parseWg.Wait()
+		ring.finish()
+	}()
+
+	// Let src wind down and release EpanMutex before returning.
+	defer func() {
+		ring.close()
+		<-srcDone
+	}()
+
+	for {
+		b, ok := ring.next()
+		if !ok {
+			break
+		}
+		for i, frame := range b.frames {
+			if err := b.errs[i]; err != nil {
+				if conf.IgnoreError {
+					if conf.Debug {
+						slog.Warn("Parse frame error", "err", err)
+					}
+					continue
+				}
+				if !yield(nil, err) {
+					return count
+				}
+				continue
+			}
+			count++
+			if !yield(frame, nil) {
+				return count
+			}
+		}
+	}
+
+	<-srcDone
+	if srcErr != nil {
+		yield(nil, srcErr)
+	}
+	return count
+}
@@ -1,6 +1,7 @@
 package pkg
 
 import (
+	"bytes"
 	"encoding/json"
 	"fmt"
 	"strconv"
@@ -15,13 +16,57 @@ var (
 	ErrLayerNotFound = errors.New("layer not found")
 )
 
+// Layers holds the dissected protocol layers of a frame by name. ParseFrameData
+// keeps each layer as the json.RawMessage it arrived in and decodes it only when
+// an accessor (Frame, Tcp, ...), Decode or Layer asks for it, in a single pass
+// into the target. Layers built in Go, like those of DecodeBinaryFrame, hold
+// decoded trees instead; both marshal to the same JSON.
 type Layers map[string]any
 
+// Decode decodes layer name into v, which is typically a pointer to a struct
+// with json tags like `json:"tcp.srcport"`.
+func (l Layers) Decode(name string, v any) error {
+	src, ok := l[name]
+	if !ok {
+		return errors.Wrap(ErrLayerNotFound, name)
+	}
+	return decodeLayer(src, v)
+}
+
+// Layer returns layer name as a generic tree of map[string]any, []any and
+// string values, the form Layers held before it kept raw JSON.
+func (l Layers) Layer(name string) (any, error) {
+	var v any
+	if err := l.Decode(name, &v); err != nil {
+		return nil, err
+	}
+	return v, nil
+}
+
+// layerJSON returns the JSON of a layer: the raw message ParseFrameData stored,
+// or the encoding of a decoded tree.
+func layerJSON(src any) (json.RawMessage, error) {
+	if raw, ok := src.(json.RawMessage); ok {
+		return raw, nil
+	}
+	return sonic.Marshal(src)
+}
+
+// decodeLayer decodes a layer value into v.
+func decodeLayer(src any, v any) error {
+	raw, err := layerJSON(src)
+	if err != nil {
+		return err
+	}
+	return sonic.Unmarshal(raw, v)
+}
+
 // FrameData Dissect results of each frame of data
 type FrameData struct {
-	Index      string   `json:"_index"`
-	Layers     Layers   `json:"layers"` // source
-	BaseLayers struct { // common layers
+	Index      string         `json:"_index"`
+	Layers     Layers         `json:"layers"`           // source
+	Fields     map[string]any `json:"fields,omitempty"` // flat record with WithFields, instead of layers
+	BaseLayers struct {       // common layers
 		Frame *Frame
 		WsCol *WsCol
 		Eth   *Eth
@@ -39,22 +84,95 @@ func parseFieldAsArray(raw json.RawMessage) (*[]string, error) {
 		return nil, nil // 如果字段缺失或为空，返回 nil
 	}
 
-	var singleValue string
-	var multiValue []string
-
 	// single value
-	if sonic.Unmarshal(raw, &singleValue) == nil {
-		return &[]string{singleValue}, nil
+	if raw[0] != '[' && raw[0] != '{' {
+		var singleValue jsonText
+		if err := singleValue.UnmarshalJSON(raw); err != nil {
+			return nil, errors.New("fail to parse field")
+		}
+		return &[]string{string(singleValue)}, nil
 	}
 
 	// multiple value
+	var multiValue []jsonText
 	if sonic.Unmarshal(raw, &multiValue) == nil {
-		return &multiValue, nil
+		values := make([]string, len(multiValue))
+		for i, v := range multiValue {
+			values[i] = string(v)
+		}
+		return &values, nil
 	}
 
 	return nil, errors.New("fail to parse field")
 }
 
+// Layer values arrive as JSON strings, or as native numbers and booleans with
+// WithTypedValues. The json* types decode either form in the same pass, so the
+// accessors read both. A value that does not parse as the target type decodes
+// to its zero value, as the strconv fallbacks always did.
+
+// jsonText is a JSON string, number or boolean, kept as text.
+type jsonText string
+
+// jsonInt is an integer or a string holding one; true and false count as 1 and 0.
+type jsonInt int
+
+// jsonFloat is a number or a string holding one.
+type jsonFloat float64
+
+// jsonBool is a boolean, or a string or number like "1" or 0.
+type jsonBool bool
+
+// jsonScalar returns the text of a JSON scalar without its quotes.
+func jsonScalar(b []byte) (string, error) {
+	if len(b) == 0 || b[0] != '"' {
+		if string(b) == "null" {
+			return "", nil
+		}
+		return string(b), nil
+	}
+	if bytes.IndexByte(b, '\\') < 0 {
+		return string(b[1 : len(b)-1]), nil
+	}
+	var str string
+	err := sonic.Unmarshal(b, &str)
+	return str, err
+}
+
+func (v *jsonText) UnmarshalJSON(b []byte) error {
+	str, err := jsonScalar(b)
+	*v = jsonText(str)
+	return err
+}
+
+func (v *jsonInt) UnmarshalJSON(b []byte) error {
+	str, err := jsonScalar(b)
+	switch str {
+	case "true":
+		*v = 1
+	case "false":
+		*v = 0
+	default:
+		n, _ := strconv.Atoi(str)
+		*v = jsonInt(n)
+	}
+	return err
+}
+
+func (v *jsonFloat) UnmarshalJSON(b []byte) error {
+	str, err := jsonScalar(b)
+	f, _ := strconv.ParseFloat(str, 64)
+	*v = jsonFloat(f)
+	return err
+}
+
+func (v *jsonBool) UnmarshalJSON(b []byte) error {
+	str, err := jsonScalar(b)
+	ok, _ := strconv.ParseBool(str)
+	*v = jsonBool(ok)
+	return err
+}
+
 // Frame wireshark frame
 type Frame struct {
 	// Common fields
@@ -90,73 +208,54 @@ func (l Layers) Frame() (frame any, err error) {
 	}
 
 	type tmpFrame struct {
-		SectionNumber      string `json:"frame.section_number"`
-		InterfaceID        string `json:"frame.interface_id"`
-		EncapType          string `json:"frame.encap_type"`
-		Time               string `json:"frame.time"`
-		TimeUTC            string `json:"frame.time_utc"`
-		TimeEpoch          string `json:"frame.time_epoch"`
-		OffsetShift        string `json:"frame.offset_shift"`
-		TimeDelta          string `json:"frame.time_delta"`
-		TimeDeltaDisplayed string `json:"frame.time_delta_displayed"`
-		TimeRelative       string `json:"frame.time_relative"`
-		Number             string `json:"frame.number"`
-		Len                string `json:"frame.len"`
-		CapLen             string `json:"frame.cap_len"`
-		Marked             string `json:"frame.marked"`
-		Ignored            string `json:"frame.ignored"`
-		Protocols          string `json:"frame.protocols"`
-
-		Length        string `json:"frame.length"`
-		Checksum      string `json:"frame.checksum"`
-		CaptureLength string `json:"frame.capture_length"`
-		FrameType     string `json:"frame.type"`
+		SectionNumber      jsonInt   `json:"frame.section_number"`
+		InterfaceID        jsonInt   `json:"frame.interface_id"`
+		EncapType          jsonText  `json:"frame.encap_type"`
+		Time               jsonText  `json:"frame.time"`
+		TimeUTC            jsonText  `json:"frame.time_utc"`
+		TimeEpoch          jsonFloat `json:"frame.time_epoch"`
+		OffsetShift        jsonText  `json:"frame.offset_shift"`
+		TimeDelta          jsonText  `json:"frame.time_delta"`
+		TimeDeltaDisplayed jsonText  `json:"frame.time_delta_displayed"`
+		TimeRelative       jsonText  `json:"frame.time_relative"`
+		Number             jsonInt   `json:"frame.number"`
+		Len                jsonInt   `json:"frame.len"`
+		CapLen             jsonInt   `json:"frame.cap_len"`
+		Marked             jsonBool  `json:"frame.marked"`
+		Ignored            jsonBool  `json:"frame.ignored"`
+		Protocols          jsonText  `json:"frame.protocols"`
+		Length             jsonInt   `json:"frame.length"`
+		Checksum           jsonText  `json:"frame.checksum"`
+		CaptureLength      jsonInt   `json:"frame.capture_length"`
+		FrameType          jsonText  `json:"frame.type"`
 	}
-
 	var tmp tmpFrame
 
-	jsonData, err := sonic.Marshal(src)
-	if err != nil {
+	if err = decodeLayer(src, &tmp); err != nil {
 		return nil, errors.Wrapf(err, "frame: %s", ErrParseFrame)
 	}
 
-	err = sonic.Unmarshal(jsonData, &tmp)
-	if err != nil {
-		return nil, errors.Wrapf(err, "frame: %s", ErrParseFrame)
-	}
-
-	sectionNumber, _ := strconv.Atoi(tmp.SectionNumber)
-	interfaceID, _ := strconv.Atoi(tmp.InterfaceID)
-	num, _ := strconv.Atoi(tmp.Number)
-	lenValue, _ := strconv.Atoi(tmp.Len)
-	capLen, _ := strconv.Atoi(tmp.CapLen)
-	marked, _ := strconv.ParseBool(tmp.Marked)
-	ignored, _ := strconv.ParseBool(tmp.Ignored)
-	timeEpoch, _ := strconv.ParseFloat(tmp.TimeEpoch, 64)
-	length, _ := strconv.Atoi(tmp.Length)
-	captureLength, _ := strconv.Atoi(tmp.CaptureLength)
-
 	return &Frame{
-		SectionNumber:      sectionNumber,
-		InterfaceID:        interfaceID,
-		EncapType:          tmp.EncapType,
-		Time:               tmp.Time,
-		TimeUTC:            tmp.TimeUTC,
-		TimeEpoch:          timeEpoch,
-		OffsetShift:        tmp.OffsetShift,
-		TimeDelta:          tmp.TimeDelta,
-		TimeDeltaDisplayed: tmp.TimeDeltaDisplayed,
-		TimeRelative:       tmp.TimeRelative,
-		Number:             num,
-		Len:                lenValue,
-		CapLen:             capLen,
-		Marked:             marked,
-		Ignored:            ignored,
-		Protocols:          tmp.Protocols,
-		Length:             length,
-		Checksum:           tmp.Checksum,
-		CaptureLength:      captureLength,
-		FrameType:          tmp.FrameType,
+		SectionNumber:      int(tmp.SectionNumber),
+		InterfaceID:        int(tmp.InterfaceID),
+		EncapType:          string(tmp.EncapType),
+		Time:               string(tmp.Time),
+		TimeUTC:            string(tmp.TimeUTC),
+		TimeEpoch:          float64(tmp.TimeEpoch),
+		OffsetShift:        string(tmp.OffsetShift),
+		TimeDelta:          string(tmp.TimeDelta),
+		TimeDeltaDisplayed: string(tmp.TimeDeltaDisplayed),
+		TimeRelative:       string(tmp.TimeRelative),
+		Number:             int(tmp.Number),
+		Len:                int(tmp.Len),
+		CapLen:             int(tmp.CapLen),
+		Marked:             bool(tmp.Marked),
+		Ignored:            bool(tmp.Ignored),
+		Protocols:          string(tmp.Protocols),
+		Length:             int(tmp.Length),
+		Checksum:           string(tmp.Checksum),
+		CaptureLength:      int(tmp.CaptureLength),
+		FrameType:          string(tmp.FrameType),
 	}, nil
 }
 
@@ -178,35 +277,26 @@ func (l Layers) WsCol() (wsCol any, err error) {
 	}
 
 	type tmpWsCol struct {
-		Num       string `json:"_ws.col.number"`
-		DefSrc    string `json:"_ws.col.def_src"`
-		DefDst    string `json:"_ws.col.def_dst"`
-		Protocol  string `json:"_ws.col.protocol"`
-		PacketLen string `json:"_ws.col.packet_length"`
-		Info      string `json:"_ws.col.info"`
+		Num       jsonInt  `json:"_ws.col.number"`
+		DefSrc    jsonText `json:"_ws.col.def_src"`
+		DefDst    jsonText `json:"_ws.col.def_dst"`
+		Protocol  jsonText `json:"_ws.col.protocol"`
+		PacketLen jsonInt  `json:"_ws.col.packet_length"`
+		Info      jsonText `json:"_ws.col.info"`
 	}
 	var tmp tmpWsCol
 
-	jsonData, err := sonic.Marshal(src)
-	if err != nil {
+	if err = decodeLayer(src, &tmp); err != nil {
 		return nil, errors.Wrapf(err, "_ws.col: %s", ErrParseFrame)
 	}
 
-	err = sonic.Unmarshal(jsonData, &tmp)
-	if err != nil {
-		return nil, errors.Wrapf(err, "_ws.col: %s", ErrParseFrame)
-	}
-
-	num, err := strconv.Atoi(tmp.Num)
-	packetLen, err := strconv.Atoi(tmp.PacketLen)
-
 	return &WsCol{
-		Num:       num,
-		DefSrc:    tmp.DefSrc,
-		DefDst:    tmp.DefDst,
-		Protocol:  tmp.Protocol,
-		PacketLen: packetLen,
-		Info:      tmp.Info,
+		Num:       int(tmp.Num),
+		DefSrc:    string(tmp.DefSrc),
+		DefDst:    string(tmp.DefDst),
+		Protocol:  string(tmp.Protocol),
+		PacketLen: int(tmp.PacketLen),
+		Info:      string(tmp.Info),
 	}, nil
 }
 
@@ -232,54 +322,42 @@ func (l Layers) Eth() (eth any, err error) {
 	if !ok {
 		return nil, errors.Wrap(ErrLayerNotFound, "eth")
 	}
+
 	type tmpEth struct {
-		Src            string `json:"eth.src"`
-		SrcResolved    string `json:"eth.src_tree.addr_resolved"`
-		SrcOui         string `json:"eth.src_tree.addr.oui"`
-		SrcOuiResolved string `json:"eth.src_tree.addr.oui_resolved"`
-		SrcIG          string `json:"eth.src_tree.ig"`
-		SrcLG          string `json:"eth.src_tree.lg"`
-		Dst            string `json:"eth.dst"`
-		DstResolved    string `json:"eth.dst_tree.addr_resolved"`
-		DstOui         string `json:"eth.dst_tree.addr.oui"`
-		DstOuiResolved string `json:"eth.dst_tree.addr.oui_resolved"`
-		DstIG          string `json:"eth.dst_tree.ig"`
-		DstLG          string `json:"eth.dst_tree.lg"`
-		Type           string `json:"eth.type"`
+		Src            jsonText `json:"eth.src"`
+		SrcResolved    jsonText `json:"eth.src_tree.addr_resolved"`
+		SrcOui         jsonInt  `json:"eth.src_tree.addr.oui"`
+		SrcOuiResolved jsonText `json:"eth.src_tree.addr.oui_resolved"`
+		SrcIG          jsonInt  `json:"eth.src_tree.ig"`
+		SrcLG          jsonInt  `json:"eth.src_tree.lg"`
+		Dst            jsonText `json:"eth.dst"`
+		DstResolved    jsonText `json:"eth.dst_tree.addr_resolved"`
+		DstOui         jsonInt  `json:"eth.dst_tree.addr.oui"`
+		DstOuiResolved jsonText `json:"eth.dst_tree.addr.oui_resolved"`
+		DstIG          jsonInt  `json:"eth.dst_tree.ig"`
+		DstLG          jsonInt  `json:"eth.dst_tree.lg"`
+		Type           jsonText `json:"eth.type"`
 	}
 	var tmp tmpEth
 
-	jsonData, err := sonic.Marshal(src)
-	if err != nil {
+	if err = decodeLayer(src, &tmp); err != nil {
 		return nil, errors.Wrapf(err, "eth: %s", ErrParseFrame)
 	}
 
-	err = sonic.Unmarshal(jsonData, &tmp)
-	if err != nil {
-		return nil, errors.Wrapf(err, "eth: %s", ErrParseFrame)
-	}
-
-	srcOui, err := strconv.Atoi(tmp.SrcOui)
-	srcIG, err := strconv.Atoi(tmp.SrcIG)
-	srcLG, err := strconv.Atoi(tmp.SrcLG)
-	dstOui, err := strconv.Atoi(tmp.DstOui)
-	dstIG, err := strconv.Atoi(tmp.DstIG)
-	dstLG, err := strconv.Atoi(tmp.DstLG)
-
 	return &Eth{
-		Src:            tmp.Src,
-		SrcResolved:    tmp.SrcResolved,
-		SrcOui:         srcOui,
-		SrcOuiResolved: tmp.SrcOuiResolved,
-		SrcIG:          srcIG,
-		SrcLG:          srcLG,
-		Dst:            tmp.Dst,
-		DstResolved:    tmp.DstResolved,
-		DstOui:         dstOui,
-		DstOuiResolved: tmp.DstOuiResolved,
-		DstIG:          dstIG,
-		DstLG:          dstLG,
-		Type:           tmp.Type,
+		Src:            string(tmp.Src),
+		SrcResolved:    string(tmp.SrcResolved),
+		SrcOui:         int(tmp.SrcOui),
+		SrcOuiResolved: string(tmp.SrcOuiResolved),
+		SrcIG:          int(tmp.SrcIG),
+		SrcLG:          int(tmp.SrcLG),
+		Dst:            string(tmp.Dst),
+		DstResolved:    string(tmp.DstResolved),
+		DstOui:         int(tmp.DstOui),
+		DstOuiResolved: string(tmp.DstOuiResolved),
+		DstIG:          int(tmp.DstIG),
+		DstLG:          int(tmp.DstLG),
+		Type:           string(tmp.Type),
 	}, nil
 }
 
@@ -312,56 +390,44 @@ func (l Layers) Ip() (ip any, err error) {
 	}
 
 	type tmpIp struct {
-		HdrLen         string `json:"ip.hdr_len"`
-		ID             string `json:"ip.id"`
-		Proto          string `json:"ip.proto"`
-		Checksum       string `json:"ip.checksum"`
-		Src            string `json:"ip.src"`
-		Dst            string `json:"ip.dst"`
-		Len            string `json:"ip.len"`
-		DsField        string `json:"ip.dsfield"`
-		Flags          string `json:"ip.flags"`
-		FragOffset     string `json:"ip.frag_offset"`
-		Ttl            string `json:"ip.ttl"`
-		Version        string `json:"ip.version"`
-		ChecksumStatus string `json:"ip.checksum.status"`
-		Options        string `json:"ip.options"`
-		IpHeaderType   string `json:"ip.header_type"`
+		HdrLen         jsonInt  `json:"ip.hdr_len"`
+		ID             jsonText `json:"ip.id"`
+		Proto          jsonText `json:"ip.proto"`
+		Checksum       jsonText `json:"ip.checksum"`
+		Src            jsonText `json:"ip.src"`
+		Dst            jsonText `json:"ip.dst"`
+		Len            jsonInt  `json:"ip.len"`
+		DsField        jsonText `json:"ip.dsfield"`
+		Flags          jsonText `json:"ip.flags"`
+		FragOffset     jsonInt  `json:"ip.frag_offset"`
+		Ttl            jsonInt  `json:"ip.ttl"`
+		Version        jsonInt  `json:"ip.version"`
+		ChecksumStatus jsonText `json:"ip.checksum.status"`
+		Options        jsonText `json:"ip.options"`
+		IpHeaderType   jsonText `json:"ip.header_type"`
 	}
 	var tmp tmpIp
 
-	jsonData, err := sonic.Marshal(src)
-	if err != nil {
-		return nil, errors.Wrapf(err, "IP: %s", ErrParseFrame)
-	}
-
-	err = sonic.Unmarshal(jsonData, &tmp)
-	if err != nil {
+	if err = decodeLayer(src, &tmp); err != nil {
 		return nil, errors.Wrapf(err, "IP: %s", ErrParseFrame)
 	}
 
-	hdrLen, _ := strconv.Atoi(tmp.HdrLen)
-	length, _ := strconv.Atoi(tmp.Len)
-	fragOffset, _ := strconv.Atoi(tmp.FragOffset)
-	ttl, _ := strconv.Atoi(tmp.Ttl)
-	version, _ := strconv.Atoi(tmp.Version)
-
 	return &Ip{
-		HdrLen:         hdrLen,
-		ID:             tmp.ID,
-		Proto:          tmp.Proto,
-		Checksum:       tmp.Checksum,
-		Src:            tmp.Src,
-		Dst:            tmp.Dst,
-		Len:            length,
-		DsField:        tmp.DsField,
-		Flags:          tmp.Flags,
-		FragOffset:     fragOffset,
-		Ttl:            ttl,
-		Version:        version,
-		ChecksumStatus: tmp.ChecksumStatus,
-		Options:        tmp.Options,
-		IpHeaderType:   tmp.IpHeaderType,
+		HdrLen:         int(tmp.HdrLen),
+		ID:             string(tmp.ID),
+		Proto:          string(tmp.Proto),
+		Checksum:       string(tmp.Checksum),
+		Src:            string(tmp.Src),
+		Dst:            string(tmp.Dst),
+		Len:            int(tmp.Len),
+		DsField:        string(tmp.DsField),
+		Flags:          string(tmp.Flags),
+		FragOffset:     int(tmp.FragOffset),
+		Ttl:            int(tmp.Ttl),
+		Version:        int(tmp.Version),
+		ChecksumStatus: string(tmp.ChecksumStatus),
+		Options:        string(tmp.Options),
+		IpHeaderType:   string(tmp.IpHeaderType),
 	}, nil
 }
 
@@ -397,35 +463,23 @@ func (l Layers) Udp() (udp any, err error) {
 	}
 
 	type tmpUdp struct {
-		SrcPort        string          `json:"udp.srcport"`
-		DstPort        string          `json:"udp.dstport"`
-		Length         string          `json:"udp.length"`
-		ChecksumStatus string          `json:"udp.checksum.status"`
+		SrcPort        jsonInt         `json:"udp.srcport"`
+		DstPort        jsonInt         `json:"udp.dstport"`
+		Length         jsonInt         `json:"udp.length"`
+		ChecksumStatus jsonText        `json:"udp.checksum.status"`
+		Checksum       jsonText        `json:"udp.checksum"`
 		Port           json.RawMessage `json:"udp.port"`
-		Checksum       string          `json:"udp.checksum"`
-		Stream         string          `json:"udp.stream"`
-		DataLength     string          `json:"udp.data_length"`
-		Timestamp      string          `json:"udp.timestamp"`
-		Payload        string          `json:"udp.payload"`
+		Stream         jsonInt         `json:"udp.stream"`
+		DataLength     jsonInt         `json:"udp.data_length"`
+		Timestamp      jsonText        `json:"udp.timestamp"`
+		Payload        jsonText        `json:"udp.payload"`
 	}
 	var tmp tmpUdp
 
-	jsonData, err := sonic.Marshal(src)
-	if err != nil {
-		return nil, errors.Wrapf(err, "UDP: %s", ErrParseFrame)
-	}
-
-	err = sonic.Unmarshal(jsonData, &tmp)
-	if err != nil {
+	if err = decodeLayer(src, &tmp); err != nil {
 		return nil, errors.Wrapf(err, "UDP: %s", ErrParseFrame)
 	}
 
-	srcPort, _ := strconv.Atoi(tmp.SrcPort)
-	dstPort, _ := strconv.Atoi(tmp.DstPort)
-	length, _ := strconv.Atoi(tmp.Length)
-	stream, _ := strconv.Atoi(tmp.Stream)
-	dataLength, _ := strconv.Atoi(tmp.DataLength)
-
 	// Parse Port as array
 	port, err := parseFieldAsArray(tmp.Port)
 	if err != nil {
@@ -433,16 +487,16 @@ func (l Layers) Udp() (udp any, err error) {
 	}
 
 	return &Udp{
-		SrcPort:        srcPort,
-		DstPort:        dstPort,
-		Length:         length,
-		ChecksumStatus: tmp.ChecksumStatus,
-		Checksum:       tmp.Checksum,
+		SrcPort:        int(tmp.SrcPort),
+		DstPort:        int(tmp.DstPort),
+		Length:         int(tmp.Length),
+		ChecksumStatus: string(tmp.ChecksumStatus),
+		Checksum:       string(tmp.Checksum),
 		Port:           port,
-		Stream:         stream,
-		DataLength:     dataLength,
-		Timestamp:      tmp.Timestamp,
-		Payload:        tmp.Payload,
+		Stream:         int(tmp.Stream),
+		DataLength:     int(tmp.DataLength),
+		Timestamp:      string(tmp.Timestamp),
+		Payload:        string(tmp.Payload),
 	}, nil
 }
 
@@ -486,85 +540,56 @@ func (l Layers) Tcp() (tcp any, err error) {
 	}
 
 	type tmpTcp struct {
-		SrcPort        string          `json:"tcp.srcport"`
-		DstPort        string          `json:"tcp.dstport"`
-		SeqRaw         string          `json:"tcp.seq_raw"`
-		AckRaw         string          `json:"tcp.ack_raw"`
-		Seq            string          `json:"tcp.seq"`
-		NextSeq        string          `json:"tcp.next_seq"`
-		UrgentPointer  string          `json:"tcp.urgent_pointer"`
-		HdrLen         string          `json:"tcp.hdr_len"`
-		Len            string          `json:"tcp.len"`
-		WinSize        string          `json:"tcp.window_size"`
-		WinSizeVal     string          `json:"tcp.window_size_value"`
-		ChecksumStatus string          `json:"tcp.checksum.status"`
-		Checksum       string          `json:"tcp.checksum"`
-		Flags          string          `json:"tcp.flags"`
+		SrcPort        jsonInt         `json:"tcp.srcport"`
+		DstPort        jsonInt         `json:"tcp.dstport"`
+		SeqRaw         jsonInt         `json:"tcp.seq_raw"`
+		AckRaw         jsonInt         `json:"tcp.ack_raw"`
+		Seq            jsonInt         `json:"tcp.seq"`
+		NextSeq        jsonInt         `json:"tcp.next_seq"`
+		UrgentPointer  jsonInt         `json:"tcp.urgent_pointer"`
+		HdrLen         jsonInt         `json:"tcp.hdr_len"`
+		Len            jsonInt         `json:"tcp.len"`
+		WinSize        jsonInt         `json:"tcp.window_size"`
+		WinSizeVal     jsonInt         `json:"tcp.window_size_value"`
+		ChecksumStatus jsonText        `json:"tcp.checksum.status"`
+		Checksum       jsonText        `json:"tcp.checksum"`
+		Flags          jsonText        `json:"tcp.flags"`
 		Port           json.RawMessage `json:"tcp.port"`
-		Stream         string          `json:"tcp.stream"`
-		Payload        string          `json:"tcp.payload"`
-		Completeness   string          `json:"tcp.completeness"`
+		Stream         jsonInt         `json:"tcp.stream"`
+		Payload        jsonText        `json:"tcp.payload"`
+		Completeness   jsonText        `json:"tcp.completeness"`
 	}
 	var tmp tmpTcp
 
-	// Convert source to JSON and then unmarshal it
-	jsonData, err := sonic.Marshal(src)
-	if err != nil {
+	if err = decodeLayer(src, &tmp); err != nil {
 		return nil, errors.Wrapf(err, "TCP: %s", ErrParseFrame)
 	}
 
-	err = sonic.Unmarshal(jsonData, &tmp)
-	if err != nil {
-		return nil, errors.Wrapf(err, "TCP: %s", ErrParseFrame)
-	}
-
-	// Parsing the fields in the order of the Tcp struct
-	srcPort, _ := strconv.Atoi(tmp.SrcPort)
-	dstPort, _ := strconv.Atoi(tmp.DstPort)
-	seqRaw, _ := strconv.Atoi(tmp.SeqRaw)
-	ackRaw, _ := strconv.Atoi(tmp.AckRaw)
-	seq, _ := strconv.Atoi(tmp.Seq)
-	nextSeq, _ := strconv.Atoi(tmp.NextSeq)
-	urgentPointer, _ := strconv.Atoi(tmp.UrgentPointer)
-	hdrLen, _ := strconv.Atoi(tmp.HdrLen)
-	length, _ := strconv.Atoi(tmp.Len)
-	winSize, _ := strconv.Atoi(tmp.WinSize)
-	winSizeVal, _ := strconv.Atoi(tmp.WinSizeVal)
-	checksumStatus := tmp.ChecksumStatus
-	checksum := tmp.Checksum
-	flags := tmp.Flags
-
 	// Parse Port as array
 	port, err := parseFieldAsArray(tmp.Port)
 	if err != nil {
 		return nil, errors.Wrapf(err, "TCP: %s", "fail to parse tcp.port")
 	}
 
-	// Parsing stream and payload
-	stream, _ := strconv.Atoi(tmp.Stream)
-	payload := tmp.Payload
-	completeness := tmp.Completeness
-
-	// Return Tcp struct with parsed fields
 	return &Tcp{
-		SrcPort:        srcPort,
-		DstPort:        dstPort,
-		SeqRaw:         seqRaw,
-		AckRaw:         ackRaw,
-		Seq:            seq,
-		NextSeq:        nextSeq,
-		UrgentPointer:  urgentPointer,
-		HdrLen:         hdrLen,
-		Len:            length,
-		WinSize:        winSize,
-		WinSizeVal:     winSizeVal,
-		ChecksumStatus: checksumStatus,
-		Checksum:       checksum,
-		Flags:          flags,
+		SrcPort:        int(tmp.SrcPort),
+		DstPort:        int(tmp.DstPort),
+		SeqRaw:         int(tmp.SeqRaw),
+		AckRaw:         int(tmp.AckRaw),
+		Seq:            int(tmp.Seq),
+		NextSeq:        int(tmp.NextSeq),
+		UrgentPointer:  int(tmp.UrgentPointer),
+		HdrLen:         int(tmp.HdrLen),
+		Len:            int(tmp.Len),
+		WinSize:        int(tmp.WinSize),
+		WinSizeVal:     int(tmp.WinSizeVal),
+		ChecksumStatus: string(tmp.ChecksumStatus),
+		Checksum:       string(tmp.Checksum),
+		Flags:          string(tmp.Flags),
 		Port:           port,
-		Stream:         stream,
-		Payload:        payload,
-		Completeness:   completeness,
+		Stream:         int(tmp.Stream),
+		Payload:        string(tmp.Payload),
+		Completeness:   string(tmp.Completeness),
 	}, nil
 }
 
@@ -619,88 +644,91 @@ func (l Layers) Http() (any, error) {
 		return nil, errors.Wrap(ErrLayerNotFound, "http")
 	}
 
-	switch v := src.(type) {
-	case map[string]any:
-		http, err := parseSingleHttp(v)
-		if err != nil {
-			return nil, err
+	raw, err := layerJSON(src)
+	if err != nil {
+		return nil, errors.Wrapf(err, "HTTP: %s", ErrParseFrame)
+	}
+
+	// Several HTTP messages in one frame come as an array of layers.
+	if len(raw) > 0 && raw[0] == '[' {
+		var items []json.RawMessage
+		if err := sonic.Unmarshal(raw, &items); err != nil {
+			return nil, errors.Wrapf(err, "HTTP: %s", ErrParseFrame)
 		}
-		return []*Http{http}, nil
-	case []any:
-		return parseMultipleHttp(v)
-	default:
-		return nil, errors.Wrapf(ErrParseFrame, "HTTP: unexpected type %T", src)
+		return parseMultipleHttp(items)
 	}
+
+	http, err := parseSingleHttp(raw)
+	if err != nil {
+		return nil, err
+	}
+	return []*Http{http}, nil
 }
 
-func parseSingleHttp(src map[string]any) (*Http, error) {
+func parseSingleHttp(src json.RawMessage) (*Http, error) {
 	type tmpHttp struct {
-		Date                string `json:"http.date"`
-		Host                string `json:"http.host"`
-		UserAgent           string `json:"http.user_agent"`
-		Accept              string `json:"http.accept"`
-		LastModified        string `json:"http.last_modified"`
-		ContentType         string `json:"http.content_type"`
-		ContentLengthHeader string `json:"http.content_length_header"`
-		ContentLength       string `json:"http.content_length"`
-		FileData            string `json:"http.file_data"`
-		Server              string `json:"http.server"`
-		Time                string `json:"http.time"`
-
-		Request        string          `json:"http.request"`
+		Date                jsonText `json:"http.date"`
+		Host                jsonText `json:"http.host"`
+		UserAgent           jsonText `json:"http.user_agent"`
+		Accept              jsonText `json:"http.accept"`
+		LastModified        jsonText `json:"http.last_modified"`
+		ContentType         jsonText `json:"http.content_type"`
+		ContentLengthHeader jsonText `json:"http.content_length_header"`
+		ContentLength       jsonText `json:"http.content_length"`
+		FileData            jsonText `json:"http.file_data"`
+		Server              jsonText `json:"http.server"`
+		Time                jsonText `json:"http.time"`
+
+		Request        jsonText        `json:"http.request"`
 		RequestLine    json.RawMessage `json:"http.request.line"`
-		RequestIn      string          `json:"http.request_in"`
-		RequestUri     string          `json:"http.request.uri"`
-		RequestFullUri string          `json:"http.request.full_uri"`
-
-		Response         string          `json:"http.response"`
-		ResponseVersion  string          `json:"http.response.version"`
-		ResponseCode     string          `json:"http.response.code"`
-		ResponseCodeDesc string          `json:"http.response.code.desc"`
-		ResponsePhrase   string          `json:"http.response.phrase"`
+		RequestIn      jsonText        `json:"http.request_in"`
+		RequestUri     jsonText        `json:"http.request.uri"`
+		RequestFullUri jsonText        `json:"http.request.full_uri"`
+
+		Response         jsonText        `json:"http.response"`
+		ResponseVersion  jsonText        `json:"http.response.version"`
+		ResponseCode     jsonText        `json:"http.response.code"`
+		ResponseCodeDesc jsonText        `json:"http.response.code.desc"`
+		ResponsePhrase   jsonText        `json:"http.response.phrase"`
 		ResponseLine     json.RawMessage `json:"http.response.line"`
-		ResponseUrl      string          `json:"http.response_for.uri"`
-		ResponseNumber   string          `json:"http.response_number"`
+		ResponseUrl      jsonText        `json:"http.response_for.uri"`
+		ResponseNumber   jsonText        `json:"http.response_number"`
 
-		Connection       string `json:"http.connection"`
-		CacheControl     string `json:"http.cache_control"`
-		Cookie           string `json:"http.cookie"`
-		AcceptEncoding   string `json:"http.accept_encoding"`
-		AcceptLanguage   string `json:"http.accept_language"`
-		Referer          string `json:"http.referer"`
-		TransferEncoding string `json:"http.transfer_encoding"`
-		Origin           string `json:"http.origin"`
+		Connection       jsonText `json:"http.connection"`
+		CacheControl     jsonText `json:"http.cache_control"`
+		Cookie           jsonText `json:"http.cookie"`
+		AcceptEncoding   jsonText `json:"http.accept_encoding"`
+		AcceptLanguage   jsonText `json:"http.accept_language"`
+		Referer          jsonText `json:"http.referer"`
+		TransferEncoding jsonText `json:"http.transfer_encoding"`
+		Origin           jsonText `json:"http.origin"`
 	}
 
 	var tmp tmpHttp
-	jsonData, err := sonic.Marshal(src)
-	if err != nil {
+	if err := sonic.Unmarshal(src, &tmp); err != nil {
 		return nil, errors.Wrapf(err, "HTTP: %s", ErrParseFrame)
 	}
 
-	err = sonic.Unmarshal(jsonData, &tmp)
-	if err != nil {
+	// dynamic key like: "HTTP/1.1 404 Not Found\\r\\n"
+	type tmpResponseLine struct {
+		Version  *jsonText `json:"http.response.version"`
+		Code     *jsonText `json:"http.response.code"`
+		CodeDesc *jsonText `json:"http.response.code.desc"`
+		Phrase   *jsonText `json:"http.response.phrase"`
+	}
+	var keys map[string]json.RawMessage
+	if err := sonic.Unmarshal(src, &keys); err != nil {
 		return nil, errors.Wrapf(err, "HTTP: %s", ErrParseFrame)
 	}
-
-	// dynamic key like: "HTTP/1.1 404 Not Found\\r\\n"
-	for key, value := range src {
-		if strings.HasPrefix(key, "HTTP/") {
-			if nested, ok := value.(map[string]any); ok {
-				if version, ok := nested["http.response.version"].(string); ok {
-					tmp.ResponseVersion = version
-				}
-				if code, ok := nested["http.response.code"].(string); ok {
-					tmp.ResponseCode = code
-				}
-				if desc, ok := nested["http.response.code.desc"].(string); ok {
-					tmp.ResponseCodeDesc = desc
-				}
-				if phrase, ok := nested["http.response.phrase"].(string); ok {
-					tmp.ResponsePhrase = phrase
-				}
-			}
+	for key, value := range keys {
+		var line tmpResponseLine
+		if !strings.HasPrefix(key, "HTTP/") || sonic.Unmarshal(value, &line) != nil {
+			continue
 		}
+		setIfPresent(&tmp.ResponseVersion, line.Version)
+		setIfPresent(&tmp.ResponseCode, line.Code)
+		setIfPresent(&tmp.ResponseCodeDesc, line.CodeDesc)
+		setIfPresent(&tmp.ResponsePhrase, line.Phrase)
 	}
 
 	reqLine, err := parseFieldAsArray(tmp.RequestLine)
@@ -714,53 +742,52 @@ func parseSingleHttp(src map[string]any) (*Http, error) {
 	}
 
 	return &Http{
-		Date:                tmp.Date,
-		Host:                tmp.Host,
-		UserAgent:           tmp.UserAgent,
-		Accept:              tmp.Accept,
-		LastModified:        tmp.LastModified,
-		ContentType:         tmp.ContentType,
-		ContentLengthHeader: tmp.ContentLengthHeader,
-		ContentLength:       tmp.ContentLength,
-		FileData:            tmp.FileData,
-		Server:              tmp.Server,
-		Time:                tmp.Time,
-
-		Request:        tmp.Request,
+		Date:                string(tmp.Date),
+		Host:                string(tmp.Host),
+		UserAgent:           string(tmp.UserAgent),
+		Accept:              string(tmp.Accept),
+		LastModified:        string(tmp.LastModified),
+		ContentType:         string(tmp.ContentType),
+		ContentLengthHeader: string(tmp.ContentLengthHeader),
+		ContentLength:       string(tmp.ContentLength),
+		FileData:            string(tmp.FileData),
+		Server:              string(tmp.Server),
+		Time:                string(tmp.Time),
+
+		Request:        string(tmp.Request),
 		RequestLine:    reqLine,
-		RequestIn:      tmp.RequestIn,
-		RequestUri:     tmp.RequestUri,
-		RequestFullUri: tmp.RequestFullUri,
-
-		Response:         tmp.Response,
-		ResponseVersion:  tmp.ResponseVersion,
-		ResponseCode:     tmp.ResponseCode,
-		ResponseCodeDesc: tmp.ResponseCodeDesc,
-		ResponsePhrase:   tmp.ResponsePhrase,
+		RequestIn:      string(tmp.RequestIn),
+		RequestUri:     string(tmp.RequestUri),
+		RequestFullUri: string(tmp.RequestFullUri),
+
+		Response:         string(tmp.Response),
+		ResponseVersion:  string(tmp.ResponseVersion),
+		ResponseCode:     string(tmp.ResponseCode),
+		ResponseCodeDesc: string(tmp.ResponseCodeDesc),
+		ResponsePhrase:   string(tmp.ResponsePhrase),
 		ResponseLine:     respLine,
-		ResponseUrl:      tmp.ResponseUrl,
-		ResponseNumber:   tmp.ResponseNumber,
-
-		Connection:       tmp.Connection,
-		CacheControl:     tmp.CacheControl,
-		Cookie:           tmp.Cookie,
-		AcceptEncoding:   tmp.AcceptEncoding,
-		AcceptLanguage:   tmp.AcceptLanguage,
-		Referer:          tmp.Referer,
-		TransferEncoding: tmp.TransferEncoding,
-		Origin:           tmp.Origin,
+		ResponseUrl:      string(tmp.ResponseUrl),
+		ResponseNumber:   string(tmp.ResponseNumber),
+
+		Connection:       string(tmp.Connection),
+		CacheControl:     string(tmp.CacheControl),
+		Cookie:           string(tmp.Cookie),
+		AcceptEncoding:   string(tmp.AcceptEncoding),
+		AcceptLanguage:   string(tmp.AcceptLanguage),
+		Referer:          string(tmp.Referer),
+		TransferEncoding: string(tmp.TransferEncoding),
+		Origin:           string(tmp.Origin),
 	}, nil
 }
 
-func parseMultipleHttp(src []any) ([]*Http, error) {
+func parseMultipleHttp(src []json.RawMessage) ([]*Http, error) {
 	var httpLayers []*Http
 	for _, item := range src {
-		itemMap, ok := item.(map[string]any)
-		if !ok {
-			return nil, errors.Wrapf(ErrParseFrame, "HTTP: unexpected type %T in array", item)
+		if len(item) == 0 || item[0] != '{' {
+			return nil, errors.Wrapf(ErrParseFrame, "HTTP: unexpected layer %.16s in array", item)
 		}
 
-		http, err := parseSingleHttp(itemMap)
+		http, err := parseSingleHttp(item)
 		if err != nil {
 			return nil, err
 		}
@@ -769,6 +796,13 @@ func parseMultipleHttp(src []any) ([]*Http, error) {
 	return httpLayers, nil
 }
 
+// setIfPresent sets *dst to *v when v was present in the decoded JSON.
+func setIfPresent(dst *jsonText, v *jsonText) {
+	if v != nil {
+		*dst = *v
+	}
+}
+
 type DnsFlags struct {
 	Response           bool `json:"dns.flags.response"`
 	Authoritative      bool `json:"dns.flags.authoritative"`
@@ -810,66 +844,64 @@ func (l Layers) Dns() (dns any, err error) {
 		return nil, errors.Wrap(ErrLayerNotFound, "dns")
 	}
 
+	type tmpDnsQuery struct {
+		DnsQryName     jsonText `json:"dns.qry.name"`
+		DnsQryNameLen  jsonText `json:"dns.qry.name.len"`
+		DnsCountLabels jsonText `json:"dns.count.labels"`
+		DnsQryType     jsonText `json:"dns.qry.type"`
+		DnsQryClass    jsonText `json:"dns.qry.class"`
+	}
+	type tmpDnsAnswer struct {
+		DnsA         jsonText `json:"dns.a"`
+		DnsRespName  jsonText `json:"dns.resp.name"`
+		DnsRespType  jsonText `json:"dns.resp.type"`
+		DnsRespClass jsonText `json:"dns.resp.class"`
+		DnsRespTtl   jsonText `json:"dns.resp.ttl"`
+		DnsRespLen   jsonText `json:"dns.resp.len"`
+	}
 	type tmpDns struct {
-		DnsID        string `json:"dns.id"`
-		Flags        string `json:"dns.flags"`
-		QueriesCount string `json:"dns.count.queries"`
-		Queries      any    `json:"Queries"`
-		AnswersCount string `json:"dns.count.answers"`
-		Answers      any    `json:"Answers"`
+		DnsID        jsonText                `json:"dns.id"`
+		Flags        jsonText                `json:"dns.flags"`
+		QueriesCount jsonInt                 `json:"dns.count.queries"`
+		Queries      map[string]tmpDnsQuery  `json:"Queries"`
+		AnswersCount jsonInt                 `json:"dns.count.answers"`
+		Answers      map[string]tmpDnsAnswer `json:"Answers"`
 	}
 	var tmp tmpDns
 
-	jsonData, err := sonic.Marshal(src)
-	if err != nil {
+	if err = decodeLayer(src, &tmp); err != nil {
 		return nil, errors.Wrapf(err, "DNS: %s", ErrParseFrame)
 	}
 
-	err = sonic.Unmarshal(jsonData, &tmp)
-	if err != nil {
-		return nil, errors.Wrapf(err, "DNS: %s", ErrParseFrame)
+	queries := make([]DnsQuery, 0, int(tmp.QueriesCount))
+	for _, q := range tmp.Queries {
+		queries = append(queries, DnsQuery{
+			DnsQryName:     string(q.DnsQryName),
+			DnsQryNameLen:  string(q.DnsQryNameLen),
+			DnsCountLabels: string(q.DnsCountLabels),
+			DnsQryType:     string(q.DnsQryType),
+			DnsQryClass:    string(q.DnsQryClass),
+		})
 	}
 
-	queriesCount, _ := strconv.Atoi(tmp.QueriesCount)
-	queries := make([]DnsQuery, queriesCount)
-	if m, ok := tmp.Queries.(map[string]any); ok {
-		if len(m) == 0 {
-			return
-		}
-
-		mCount := 0
-		for _, v := range m {
-			var queryTmp DnsQuery
-			jsonBytes, _ := sonic.Marshal(v)
-			_ = sonic.Unmarshal(jsonBytes, &queryTmp)
-			queries[mCount] = queryTmp
-			mCount++
-		}
-	}
-
-	answersCount, _ := strconv.Atoi(tmp.AnswersCount)
-	answers := make([]DnsAnswer, answersCount)
-	if m, ok := tmp.Answers.(map[string]any); ok {
-		if len(m) == 0 {
-			return
-		}
-
-		mCount := 0
-		for _, v := range m {
-			var answerTmp DnsAnswer
-			jsonBytes, _ := sonic.Marshal(v)
-			_ = sonic.Unmarshal(jsonBytes, &answerTmp)
-			answers[mCount] = answerTmp
-			mCount++
-		}
+	answers := make([]DnsAnswer, 0, int(tmp.AnswersCount))
+	for _, a := range tmp.Answers {
+		answers = append(answers, DnsAnswer{
+			DnsA:         string(a.DnsA),
+			DnsRespName:  string(a.DnsRespName),
+			DnsRespType:  string(a.DnsRespType),
+			DnsRespClass: string(a.DnsRespClass),
+			DnsRespTtl:   string(a.DnsRespTtl),
+			DnsRespLen:   string(a.DnsRespLen),
+		})
 	}
 
 	return &Dns{
-		DnsID:        tmp.DnsID,
-		Flags:        tmp.Flags,
-		QueriesCount: queriesCount,
+		DnsID:        string(tmp.DnsID),
+		Flags:        string(tmp.Flags),
+		QueriesCount: int(tmp.QueriesCount),
 		Queries:      queries,
-		AnswersCount: answersCount,
+		AnswersCount: int(tmp.AnswersCount),
 		Answers:      answers,
 	}, nil
 }
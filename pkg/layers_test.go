@@ -1,6 +1,7 @@
 package pkg
 
 import (
+	"encoding/json"
 	"testing"
 
 	"github.com/bytedance/sonic"
@@ -198,3 +199,76 @@ func TestParseCustomProtocol(t *testing.T) {
 
 	t.Log("Parsed MySQL layer, mysql.passwd:", mysqlLayer.LoginRequest.Password)
 }
+
+/*
+Lazy layers: raw JSON until touched, decoded in one pass
+*/
+func TestParseFrameData_LazyLayers(t *testing.T) {
+	src := []byte(`{"_index":"packets-2024-01-01","layers":{` +
+		`"frame":{"frame.number":"7","frame.len":"60"},` +
+		`"tcp":{"tcp.srcport":"443","tcp.dstport":"51000","tcp.port":["443","51000"]},` +
+		`"http":[{"http.host":"a.example"},{"http.response":"1","HTTP/1.1 200 OK\\r\\n":{"http.response.code":"200"}}]}}`)
+
+	frame, err := ParseFrameData(src)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if _, ok := frame.Layers["tcp"].(json.RawMessage); !ok {
+		t.Errorf("tcp layer is %T, want json.RawMessage", frame.Layers["tcp"])
+	}
+	if frame.BaseLayers.Frame.Number != 7 || frame.BaseLayers.Tcp.SrcPort != 443 {
+		t.Errorf("got frame %d, tcp.srcport %d", frame.BaseLayers.Frame.Number, frame.BaseLayers.Tcp.SrcPort)
+	}
+	if len(frame.BaseLayers.Http) != 2 || frame.BaseLayers.Http[1].ResponseCode != "200" {
+		t.Errorf("http layers not decoded: %+v", frame.BaseLayers.Http)
+	}
+
+	tcp, err := frame.Layers.Layer("tcp")
+	if err != nil {
+		t.Fatal(err)
+	}
+	if m, ok := tcp.(map[string]any); !ok || m["tcp.dstport"] != "51000" {
+		t.Errorf("Layer(tcp) = %v", tcp)
+	}
+
+	bare, err := parseFrameData(src, false)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if bare.Layers != nil || bare.BaseLayers.Tcp == nil || bare.BaseLayers.Tcp.DstPort != 51000 {
+		t.Errorf("without layers: got layers %v, tcp %+v", bare.Layers, bare.BaseLayers.Tcp)
+	}
+}
+
+/*
+Typed values: numbers and booleans decode like their string forms
+*/
+func TestParseFrameData_TypedValues(t *testing.T) {
+	quoted := []byte(`{"_index":"packets-2024-01-01","layers":{` +
+		`"frame":{"frame.number":"7","frame.time_epoch":"1700000000.5","frame.marked":"1"},` +
+		`"ip":{"ip.proto":"6","ip.ttl":"64"},` +
+		`"tcp":{"tcp.srcport":"443","tcp.port":["443","51000"]}}}`)
+	typed := []byte(`{"_index":"packets-2024-01-01","layers":{` +
+		`"frame":{"frame.number":7,"frame.time_epoch":1700000000.5,"frame.marked":true},` +
+		`"ip":{"ip.proto":6,"ip.ttl":64},` +
+		`"tcp":{"tcp.srcport":443,"tcp.port":[443,51000]}}}`)
+
+	want, err := ParseFrameData(quoted)
+	if err != nil {
+		t.Fatal(err)
+	}
+	got, err := ParseFrameData(typed)
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	if *got.BaseLayers.Frame != *want.BaseLayers.Frame {
+		t.Errorf("frame: got %+v, want %+v", *got.BaseLayers.Frame, *want.BaseLayers.Frame)
+	}
+	if *got.BaseLayers.Ip != *want.BaseLayers.Ip {
+		t.Errorf("ip: got %+v, want %+v", *got.BaseLayers.Ip, *want.BaseLayers.Ip)
+	}
+	if got.BaseLayers.Tcp.SrcPort != 443 || (*got.BaseLayers.Tcp.Port)[1] != "51000" {
+		t.Errorf("tcp: got %+v", *got.BaseLayers.Tcp)
+	}
+}
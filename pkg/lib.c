@@ -11,27 +11,20 @@ void free_c_string(char *str) {
 #define HEX_DUMP_LEN (BYTES_PER_LINE * 3)
 /* max number of characters hex dump takes -
    2 digits plus trailing blank */
-#define DATA_DUMP_LEN (HEX_DUMP_LEN + 2 + BYTES_PER_LINE)
-/* number of characters those bytes take;
-   3 characters per byte of hex dump,
-   2 blanks separating hex from ASCII,
-   1 character per byte of ASCII dump */
-#define MAX_LINE_LEN (MAX_OFFSET_LEN + 2 + DATA_DUMP_LEN)
-/* number of characters per line;
-   offset, 2 blanks separating offset
-   from data dump, data dump */
+
+// Start the next element of a JSON array that began with '['.
+static void json_array_next(GString *array) {
+    if (array->len > 1) {
+        g_string_append_c(array, ',');
+    }
+}
 
 // Helper to format hex buffer
-static gboolean get_hex_data_buffer(const guchar *cp, guint length, cJSON *cjson_offset,
-                                    cJSON *cjson_hex, cJSON *cjson_ascii) {
-    register unsigned int ad, i, j, k, l;
-    guchar c;
-    gchar line[MAX_LINE_LEN + 1];
-    gchar line_offset[MAX_LINE_LEN + 1];
+static gboolean get_hex_data_buffer(const guchar *cp, guint length, GString *offsets,
+                                    GString *hex, GString *ascii) {
     unsigned int use_digits;
-
-    static gchar binhex[16] = {'0', '1', '2', '3', '4', '5', '6', '7',
-                               '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+    gchar offset_str[MAX_OFFSET_LEN];
+    gchar hex_line[HEX_DUMP_LEN];
 
     /*
      * How many of the leading digits of the offset will we supply?
@@ -49,70 +42,51 @@ static gboolean get_hex_data_buffer(const guchar *cp, guint length, cJSON *cjson
     else
         use_digits = 4; /* we'll supply 4 digits */
 
-    ad = 0;
-    i = 0;
-    j = 0;
-    k = 0;
-    while (i < length) {
-        if ((i & 15) == 0) {
-            /*
-             * Start of a new line.
-             */
-            j = 0;
-            l = use_digits;
-            do {
-                l--;
-                c = (ad >> (l * 4)) & 0xF;
-                line[j] = binhex[c];
-                // offset data
-                line_offset[j] = binhex[c];
-                line_offset[j + 1] = '\0';
-                j++;
-            } while (l != 0);
-            // add offset to json obj
-            cJSON_AddItemToArray(cjson_offset, cJSON_CreateString(line_offset));
-            line[j++] = ' ';
-            line[j++] = ' ';
-            memset(line + j, ' ', DATA_DUMP_LEN);
-
-            /*
-             * Offset in line of ASCII dump.
-             */
-            k = j + HEX_DUMP_LEN + 2;
+    // Encode the whole buffer in one go, then cut it into lines.
+    gchar *hex_all = g_malloc(3 * (gsize)length);
+    gchar *ascii_all = hex_all + 2 * (gsize)length;
+    encode_hex(hex_all, cp, length);
+    encode_ascii(ascii_all, cp, length);
+
+    for (guint ad = 0; ad < length; ad += BYTES_PER_LINE) {
+        guint n = MIN(BYTES_PER_LINE, length - ad);
+
+        for (guint l = 0; l < use_digits; l++) {
+            offset_str[l] = "0123456789abcdef"[(ad >> ((use_digits - 1 - l) * 4)) & 0xF];
         }
-        c = *cp++;
-        line[j++] = binhex[c >> 4];
-        line[j++] = binhex[c & 0xf];
-        j++;
-
-        line[k++] = ((c >= ' ') && (c < 0x7f)) ? c : '.';
-        i++;
-        if (((i & 15) == 0) || (i == length)) {
-            /*
-             * We'll be starting a new line, or
-             * we're finished printing this buffer;
-             * dump out the line we've constructed,
-             * and advance the offset.
-             */
-            line[k] = '\0';
-
-            // hex data
-            char line_hex[48];
-            strncpy(line_hex, line + use_digits + 2, 48);
-            line_hex[47] = '\0';
-            // add hex to json obj
-            cJSON_AddItemToArray(cjson_hex, cJSON_CreateString(line_hex));
-
-            // ascii str data
-            char line_ascii[17];
-            strncpy(line_ascii, line + use_digits + 52, 17);
-            line_ascii[16] = '\0';
-            // add ascii to json obj
-            cJSON_AddItemToArray(cjson_ascii, cJSON_CreateString(line_ascii));
-
-            ad += 16;
+        json_array_next(offsets);
+        g_string_append_c(offsets, '"');
+        g_string_append_len(offsets, offset_str, use_digits);
+        g_string_append_c(offsets, '"');
+
+        // "xx xx .. xx", a short last line padded with blanks to full width
+        memset(hex_line, ' ', HEX_DUMP_LEN - 1);
+        for (guint b = 0; b < n; b++) {
+            memcpy(hex_line + 3 * b, hex_all + 2 * (ad + b), 2);
         }
+        json_array_next(hex);
+        g_string_append_c(hex, '"');
+        g_string_append_len(hex, hex_line, HEX_DUMP_LEN - 1);
+        g_string_append_c(hex, '"');
+
+        // Only '"' and '\' of the printable characters need escaping.
+        const gchar *line_ascii = ascii_all + ad;
+        json_array_next(ascii);
+        g_string_append_c(ascii, '"');
+        if (memchr(line_ascii, '"', n) == NULL && memchr(line_ascii, '\\', n) == NULL) {
+            g_string_append_len(ascii, line_ascii, n);
+        } else {
+            for (guint b = 0; b < n; b++) {
+                if (line_ascii[b] == '"' || line_ascii[b] == '\\') {
+                    g_string_append_c(ascii, '\\');
+                }
+                g_string_append_c(ascii, line_ascii[b]);
+            }
+        }
+        g_string_append_c(ascii, '"');
     }
+
+    g_free(hex_all);
     return TRUE;
 }
 
@@ -120,9 +94,10 @@ static gboolean get_hex_data_buffer(const guchar *cp, guint length, cJSON *cjson
  * Get hex part of data.
  *
  *  @param edt epan_dissect_t type
- *  @return cjson_offset、cjson_hex、cjson_ascii;
+ *  @param json appended {"offset":[...],"hex":[...],"ascii":[...]}, one element
+ *  per line of 16 bytes
  */
-bool get_hex_data(epan_dissect_t *edt, cJSON *cjson_offset, cJSON *cjson_hex, cJSON *cjson_ascii) {
+bool get_hex_data(epan_dissect_t *edt, GString *json) {
     gboolean multiple_sources;
     GSList *src_le;
     tvbuff_t *tvb;
@@ -130,6 +105,21 @@ bool get_hex_data(epan_dissect_t *edt, cJSON *cjson_offset, cJSON *cjson_hex, cJ
     const guchar *cp;
     guint length;
     struct data_source *src;
+    bool ok = true;
+
+    // Size the arrays for all sources up front.
+    gsize lines = 0;
+    for (src_le = edt->pi.data_src; src_le != NULL; src_le = src_le->next) {
+        src = (struct data_source *)src_le->data;
+        lines += (tvb_captured_length(get_data_source_tvb(src)) + BYTES_PER_LINE - 1) /
+                 BYTES_PER_LINE;
+    }
+    GString *offsets = g_string_sized_new(lines * (MAX_OFFSET_LEN + 3) + 2);
+    GString *hex = g_string_sized_new(lines * (HEX_DUMP_LEN + 2) + 2);
+    GString *ascii = g_string_sized_new(lines * (BYTES_PER_LINE + 3) + 2);
+    g_string_append_c(offsets, '[');
+    g_string_append_c(hex, '[');
+    g_string_append_c(ascii, '[');
 
     /*
      * Set "multiple_sources" iff this frame has more than one
@@ -149,11 +139,26 @@ bool get_hex_data(epan_dissect_t *edt, cJSON *cjson_offset, cJSON *cjson_hex, cJ
             g_free(line);
         }
         length = tvb_captured_length(tvb);
-        if (length == 0) return true;
+        if (length == 0) break;
         cp = tvb_get_ptr(tvb, 0, length);
-        if (!get_hex_data_buffer(cp, length, cjson_offset, cjson_hex, cjson_ascii)) return false;
+        if (!get_hex_data_buffer(cp, length, offsets, hex, ascii)) {
+            ok = false;
+            break;
+        }
     }
-    return true;
+
+    g_string_append(json, "{\"offset\":");
+    g_string_append_len(json, offsets->str, offsets->len);
+    g_string_append(json, "],\"hex\":");
+    g_string_append_len(json, hex->str, hex->len);
+    g_string_append(json, "],\"ascii\":");
+    g_string_append_len(json, ascii->str, ascii->len);
+    g_string_append(json, "]}");
+
+    g_string_free(offsets, TRUE);
+    g_string_free(hex, TRUE);
+    g_string_free(ascii, TRUE);
+    return ok;
 }
 
 /**
@@ -28,8 +28,17 @@
 #include <wsutil/privileges.h>
 #include <wsutil/wslog.h>
 
-// Callback function type for returning JSON strings to Go
-typedef void (*FrameCallback)(char *json, int len, int err);
+#include "encode.h"
+
+// Callback function type for returning JSON strings to Go.
+// ctx is the routing handle of the capture context that produced the frame.
+// Returns nonzero when the consumer wants no more frames.
+typedef int (*FrameCallback)(char *json, int len, int err, void *ctx);
+
+// Callback function type for returning a batch of frames to Go in one call.
+// Receives count frames at once: frame i is data[offsets[i]..offsets[i + 1]).
+// Returns nonzero when the consumer wants no more frames.
+typedef int (*FrameBatchCallback)(char *data, uint32_t *offsets, int count, void *ctx);
 
 // Free C string memory (wrapper for g_free)
 void free_c_string(char *str);
@@ -46,7 +55,7 @@ void tls_prefs_apply(const char *keysList, int desegmentSslRecords,
                      int desegmentSslApplicationData);
 
 // Extract hex data from a dissection result
-bool get_hex_data(epan_dissect_t *edt, cJSON *cjson_offset, cJSON *cjson_hex, cJSON *cjson_ascii);
+bool get_hex_data(epan_dissect_t *edt, GString *json);
 
 // Provider callbacks required by Wireshark's epan module
 const nstime_t *cap_file_provider_get_frame_ts(struct packet_provider_data *prov,
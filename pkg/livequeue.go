@@ -0,0 +1,176 @@
+package pkg
+
+import (
+	"log/slog"
+	"runtime"
+	"sync"
+	"sync/atomic"
+)
+
+// liveQueue decodes the frames of a live capture off the thread that dissects
+// them. push only reserves a place in a reorder ring and queues the raw bytes,
+// so the dissection thread never waits for ParseFrameData; a pool of parsers
+// decodes them concurrently and a single deliverer hands them to the interface
+// channel in the order they were pushed.
+type liveQueue struct {
+	policy     LivePolicy
+	sampleRate uint64
+	keepLayers bool
+
+	ring *reorderRing[*FrameData] // nil for frames that failed to parse
+	work chan seqFrame
+	out  chan FrameData
+
+	stopping    chan struct{} // closed by stop: the deliverer no longer waits for the consumer
+	stopOnce    sync.Once
+	mu          sync.RWMutex // held for reading by push, so stop cannot close work underneath it
+	closed      bool
+	parseWg     sync.WaitGroup
+	deliverDone chan struct{}
+
+	sampleSeq    atomic.Uint64
+	queueDropped atomic.Uint64
+	queueSampled atomic.Uint64
+	chanDropped  atomic.Uint64
+	parseErrors  atomic.Uint64
+}
+
+// seqFrame is a raw frame tagged with the sequence number it was pushed under.
+type seqFrame struct {
+	seq  uint64
+	data []byte
+}
+
+// newLiveQueue starts the parsers and the deliverer of a live capture. Frames
+// come out of out, which is closed once the queue is stopped and drained.
+func newLiveQueue(conf *Conf) *liveQueue {
+	size := conf.LiveQueue
+	if size <= 0 {
+		size = 4096
+	}
+	parsers := conf.LiveParsers
+	if parsers <= 0 {
+		parsers = runtime.NumCPU()
+	}
+	sampleRate := conf.LiveSampleRate
+	if sampleRate <= 0 {
+		sampleRate = 10
+	}
+
+	q := &liveQueue{
+		policy:      conf.LivePolicy,
+		sampleRate:  uint64(sampleRate),
+		keepLayers:  conf.KeepLayers,
+		ring:        newReorderRing[*FrameData](size),
+		work:        make(chan seqFrame, size),
+		out:         make(chan FrameData, 1000),
+		stopping:    make(chan struct{}),
+		deliverDone: make(chan struct{}),
+	}
+
+	q.parseWg.Add(parsers)
+	for i := 0; i < parsers; i++ {
+		go func() {
+			defer q.parseWg.Done()
+			for f := range q.work {
+				frame, err := parseFrameData(f.data, q.keepLayers)
+				if err != nil {
+					q.parseErrors.Add(1)
+					slog.Warn("Error parsing frame data", "err", err)
+				}
+				q.ring.put(f.seq, frame)
+			}
+		}()
+	}
+	go q.deliver()
+	return q
+}
+
+// push queues a raw frame, or discards it as the policy says when the parsers
+// are behind. Frames pushed after stop are discarded.
+func (q *liveQueue) push(data []byte) {
+	q.mu.RLock()
+	defer q.mu.RUnlock()
+	if q.closed {
+		return
+	}
+
+	var seq uint64
+	var ok bool
+	switch q.policy {
+	case LiveBlock:
+		seq, ok = q.ring.reserve()
+	case LiveSample:
+		if q.ring.outstanding() >= len(q.ring.slots)/2 && q.sampleSeq.Add(1)%q.sampleRate != 0 {
+			q.queueSampled.Add(1)
+			return
+		}
+		seq, ok = q.ring.tryReserve()
+	default:
+		seq, ok = q.ring.tryReserve()
+	}
+	if !ok {
+		q.queueDropped.Add(1)
+		return
+	}
+	// Never blocks: work holds as many frames as there are sequence numbers.
+	q.work <- seqFrame{seq: seq, data: data}
+}
+
+// deliver sends the parsed frames to out in push order until the queue is
+// stopped and drained. Under LiveBlock it waits for the consumer, holding up
+// the parsers and in turn the dissection, until the queue is stopped; otherwise
+// frames that find out full are dropped.
+func (q *liveQueue) deliver() {
+	defer close(q.deliverDone)
+	defer close(q.out)
+	for {
+		frame, ok := q.ring.next()
+		if !ok {
+			return
+		}
+		if frame == nil {
+			continue
+		}
+		if q.policy == LiveBlock {
+			select {
+			case q.out <- *frame:
+				continue
+			case <-q.stopping:
+			}
+		}
+		select {
+		case q.out <- *frame:
+		default:
+			q.chanDropped.Add(1)
+		}
+	}
+}
+
+// release lets a deliverer blocked on the consumer drop frames instead, which
+// in turn unblocks the producers waiting in push.
+func (q *liveQueue) release() {
+	q.stopOnce.Do(func() { close(q.stopping) })
+}
+
+// stop drains the queue once no producer can push anymore, and closes out. The
+// producers blocked in push are released first, or they would never let go of
+// the lock.
+func (q *liveQueue) stop() {
+	q.release()
+	q.mu.Lock()
+	q.closed = true
+	q.mu.Unlock()
+	close(q.work)
+	q.parseWg.Wait()
+	q.ring.finish()
+	<-q.deliverDone
+}
+
+// fillStats copies the counters of the queue into st.
+func (q *liveQueue) fillStats(st *CaptureStats) {
+	st.QueueDropped = q.queueDropped.Load()
+	st.QueueSampled = q.queueSampled.Load()
+	st.ChanDropped = q.chanDropped.Load()
+	st.ParseErrors = q.parseErrors.Load()
+}
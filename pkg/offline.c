@@ -1,17 +1,16 @@
+#include <inttypes.h>
+#include <math.h>
+
 #include "offline.h"
 #include "reassembly.h"
 
-// Global capture file variable
-capture_file cf;
-
 static guint hexdump_source_option =
     HEXDUMP_SOURCE_MULTI; /* Default - Enable legacy multi-source mode */
 static guint hexdump_ascii_option =
     HEXDUMP_ASCII_INCLUDE; /* Default - Enable legacy undelimited ASCII dump */
 
 // --- Internal Helper Prototypes ---
-void clean();
-bool read_packet(epan_dissect_t **edt_r);
+static bool read_packet(capture_ctx *ctx, epan_dissect_t **edt_r);
 
 typedef struct {
     GSList *src_list;
@@ -19,16 +18,21 @@ typedef struct {
     pf_flags filter_flags;
     gboolean print_hex;
     gboolean print_text;
-    proto_node_children_grouper_func node_children_grouper;
     json_dumper *dumper;
+    bool typed_values;
+    wmem_allocator_t *scope;  // per-frame arena of the grouping arrays and value strings
+    proto_node *repr_node;    // node whose string value is already in repr
+    char *repr;
 } write_json_data;
 
 typedef void (*proto_node_value_writer)(proto_node *, write_json_data *);
 static void write_json_index(json_dumper *dumper, epan_dissect_t *edt);
-static void write_json_proto_node_list(GSList *proto_node_list_head, write_json_data *pdata);
-static void write_json_proto_node(GSList *node_values_head, const char *suffix,
-                                  proto_node_value_writer value_writer, write_json_data *data);
-static void write_json_proto_node_value_list(GSList *node_values_head,
+static void write_json_proto_node_group(const char *json_key, proto_node **values, guint count,
+                                        write_json_data *pdata);
+static void write_json_proto_node(const char *json_key, const char *suffix, proto_node **values,
+                                  guint count, proto_node_value_writer value_writer,
+                                  write_json_data *data);
+static void write_json_proto_node_value_list(proto_node **values, guint count,
                                              proto_node_value_writer value_writer,
                                              write_json_data *data);
 static void write_json_proto_node_children(proto_node *node, write_json_data *data);
@@ -36,104 +40,33 @@ static void write_json_proto_node_value(proto_node *node, write_json_data *data)
 static void write_json_proto_node_no_value(proto_node *node, write_json_data *pdata);
 static const char *proto_node_to_json_key(proto_node *node);
 
-// --- Cleanup Functions ---
-
-/**
- * Clean the capture file struct and epan mod.
- */
-void clean() {
-    if (cf.provider.frames != NULL) {
-        /*
-         * Free a frame_data_sequence and all the frame_data structures in it.
-         */
-        free_frame_data_sequence(cf.provider.frames);
-        cf.provider.frames = NULL;
-    }
-    if (cf.provider.wth != NULL) {
-        /** Closes any open file handles and frees the memory associated with wth.
-         */
-        wtap_close(cf.provider.wth);
-        cf.provider.wth = NULL;
-    }
-    if (cf.epan != NULL) {
-        epan_free(cf.epan);
-    }
-    /** cleanup the whole epan module, this is used to be called only once in a
-     * program */
-    epan_cleanup();
-}
-
-/**
- * Clean the capture file struct.
- */
-void close_cf() {
-    cf.stop_flag = FALSE;
-    if (cf.provider.wth) {
-        wtap_close(cf.provider.wth);
-        cf.provider.wth = NULL;
-    }
-
-    /* We have no file open... */
-    if (cf.filename != NULL) {
-        g_free(cf.filename);
-        cf.filename = NULL;
-    }
-
-    /* ...which means we have no changes to that file to save. */
-    cf.unsaved_changes = FALSE;
-
-    /* no open_routine type */
-    cf.open_type = WTAP_TYPE_AUTO;
-
-    /* Clean up the record metadata. */
-    wtap_rec_cleanup(&cf.rec);
-
-    cf.rfcode = NULL;
-    if (cf.provider.frames != NULL) {
-        free_frame_data_sequence(cf.provider.frames);
-        cf.provider.frames = NULL;
-    }
-    if (cf.provider.frames_modified_blocks) {
-        g_tree_destroy(cf.provider.frames_modified_blocks);
-        cf.provider.frames_modified_blocks = NULL;
-    }
-
-    /* No frames, no frame selected, no field in that frame selected. */
-    cf.count = 0;
-    cf.current_frame = NULL;
-    cf.finfo_selected = NULL;
-
-    /* No frame link-layer types, either. */
-    if (cf.linktypes != NULL) {
-        g_array_free(cf.linktypes, TRUE);
-        cf.linktypes = NULL;
-    }
-
-    cf.f_datalen = 0;
-    nstime_set_zero(&cf.elapsed_time);
-
-    reset_tap_listeners();
-
-    epan_free(cf.epan);
-    cf.epan = NULL;
-
-    /* We have no file open. */
-    cf.state = FILE_CLOSED;
-}
-
 // --- Initialization ---
 
+static const struct packet_provider_funcs provider_funcs = {
+    cap_file_provider_get_frame_ts,
+    cap_file_provider_get_interface_name,
+    cap_file_provider_get_interface_description,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+};
+
 /**
- * Init and fill the capture file struct.
+ * Parse the JSON options passed from Go and apply the TLS preferences.
  *
- *  @param filepath the pcap file path
- *  @return 0 if init correctly
+ *  @param options JSON options, may be NULL or empty
+ *  @param printTcpStreams set to whether the tcp_follow tap was requested, may be NULL
+ *  @return 0 on success, -1 if the options cannot be parsed
  */
-int init_cf(char *filepath, char *options) {
+static int apply_capture_options(const char *options, int *printTcpStreams) {
     char *keysList = NULL;
     int desegmentSslRecords = 0;
     int desegmentSslApplicationData = 0;
-    int printTcpStreams = 0;
+
+    if (printTcpStreams != NULL) {
+        *printTcpStreams = 0;
+    }
 
     // handle conf
     if (!is_empty_json(options)) {
@@ -163,57 +96,220 @@ int init_cf(char *filepath, char *options) {
             cJSON_IsBool(desegmentSslRecordsJson) && cJSON_IsTrue(desegmentSslRecordsJson);
         desegmentSslApplicationData = cJSON_IsBool(desegmentSslApplicationDataJson) &&
                                       cJSON_IsTrue(desegmentSslApplicationDataJson);
-        printTcpStreams = cJSON_IsBool(printTcpStreamsJson) && cJSON_IsTrue(printTcpStreamsJson);
+        if (printTcpStreams != NULL) {
+            *printTcpStreams =
+                cJSON_IsBool(printTcpStreamsJson) && cJSON_IsTrue(printTcpStreamsJson);
+        }
 
         cJSON_Delete(json);
     }
 
-    int err = 0;
-    gchar *err_info = NULL;
-    e_prefs *prefs_p;
-
-    /* Initialize the capture file struct */
-    memset(&cf, 0, sizeof(capture_file));
-    cf.filename = g_strdup(filepath);
-    cf.provider.wth = wtap_open_offline(cf.filename, WTAP_TYPE_AUTO, &err, &err_info, TRUE);
-    if (err != 0 || cf.provider.wth == NULL) {
-        clean();
-        return err;
-    }
-    cf.count = 0;
-    cf.provider.frames = new_frame_data_sequence();
-    static const struct packet_provider_funcs funcs = {
-        cap_file_provider_get_frame_ts,
-        cap_file_provider_get_interface_name,
-        cap_file_provider_get_interface_description,
-        NULL,
-        NULL,
-        NULL,
-        NULL,
-    };
-
     // Apply TLS preferences
     tls_prefs_apply(keysList, desegmentSslRecords, desegmentSslApplicationData);
     if (keysList != NULL) {
         free(keysList);
     }
 
-    cf.epan = epan_new(&cf.provider, &funcs);
+    return 0;
+}
+
+// --- Capture Contexts ---
+
+// libwireshark keeps a single set of file-scoped dissection state (wmem file
+// scope, conversation and reassembly tables) per process, so only one epan
+// session may be live at a time. Contexts hand it over on demand.
+static capture_ctx *epan_owner = NULL;
+
+/**
+ * Free the epan session of a context. The frame_data sequence and wtap handle
+ * are kept, but every frame is marked unvisited so that the next epan session
+ * runs them through a fresh first pass.
+ */
+static void capture_ctx_release_epan(capture_ctx *ctx) {
+    if (ctx->tcp_tap != NULL) {
+        tcp_follow_tap_detach(ctx->tcp_tap);
+    }
+    if (ctx->cf.epan != NULL) {
+        epan_dissect_cleanup(&ctx->edt);
+        epan_dissect_cleanup(&ctx->edt_bare);
+        epan_dissect_cleanup(&ctx->edt_fields);
+        epan_free(ctx->cf.epan);
+        ctx->cf.epan = NULL;
+    }
+    if (epan_owner == ctx) {
+        epan_owner = NULL;
+    }
+
+    for (uint32_t num = 1; num <= ctx->visited; num++) {
+        frame_data *fd = frame_data_sequence_find(ctx->cf.provider.frames, num);
+        if (fd != NULL) {
+            frame_data_reset(fd);
+        }
+    }
+    ctx->visited = 0;
+    ctx->cum_bytes = 0;
+    ctx->cf.provider.ref = NULL;
+    ctx->cf.provider.prev_dis = NULL;
+    ctx->cf.provider.prev_cap = NULL;
+    nstime_set_zero(&ctx->cf.elapsed_time);
+}
+
+void capture_ctx_release_epan_owner() {
+    if (epan_owner != NULL) {
+        capture_ctx_release_epan(epan_owner);
+    }
+}
+
+/**
+ * Make ctx the owner of the process-wide epan session, re-applying its
+ * preferences since those are global as well.
+ *
+ *  @param printTcpStreams set to whether the tcp_follow tap was requested, may be NULL
+ *  @return 0 on success, -1 if the options cannot be parsed
+ */
+static int capture_ctx_acquire_epan(capture_ctx *ctx, int *printTcpStreams) {
+    if (epan_owner == ctx && ctx->cf.epan != NULL) {
+        return 0;
+    }
+    capture_ctx_release_epan_owner();
+
+    if (apply_capture_options(ctx->options, printTcpStreams) != 0) {
+        return -1;
+    }
+    ctx->cf.epan = epan_new(&ctx->cf.provider, &provider_funcs);
+    epan_owner = ctx;
+
+    // Dissection contexts are bound to the epan session; like the live loop,
+    // frames reuse them and reset them instead of allocating one per frame.
+    epan_dissect_init(&ctx->edt, ctx->cf.epan, TRUE, TRUE);
+    epan_dissect_init(&ctx->edt_bare, ctx->cf.epan, FALSE, FALSE);
+    epan_dissect_init(&ctx->edt_fields, ctx->cf.epan, TRUE, FALSE);
+
+    // Tap listeners are process-wide too; only the owner's listener is attached.
+    // Its filter compiled when it was set, so it compiles again here.
+    if (ctx->tcp_tap != NULL) {
+        g_free(tcp_follow_tap_attach(ctx->tcp_tap));
+    }
+
+    return 0;
+}
+
+/**
+ * Open a capture file into a new context.
+ *
+ *  @param filepath the pcap file path
+ *  @param options JSON options (TLS preferences, printTcpStreams)
+ *  @param err set to the wiretap error code on failure, -1 for bad options
+ *  @return the context, NULL on failure
+ */
+capture_ctx *capture_ctx_open(const char *filepath, const char *options, int *err) {
+    int printTcpStreams = 0;
+    gchar *err_info = NULL;
+    e_prefs *prefs_p;
+
+    *err = 0;
+    capture_ctx *ctx = g_new0(capture_ctx, 1);
+    ctx->cf.filename = g_strdup(filepath);
+    ctx->cf.provider.wth =
+        wtap_open_offline(ctx->cf.filename, WTAP_TYPE_AUTO, err, &err_info, TRUE);
+    if (*err != 0 || ctx->cf.provider.wth == NULL) {
+        g_free(err_info);
+        g_free(ctx->cf.filename);
+        g_free(ctx);
+        if (*err == 0) *err = -1;
+        return NULL;
+    }
+    ctx->cf.provider.frames = new_frame_data_sequence();
+    ctx->options = g_strdup(options ? options : "");
+    wtap_rec_init(&ctx->rec, 1514);
+    ctx->frame_buf = g_byte_array_new();
+    ctx->json_buf = g_string_new(NULL);
+    ctx->json_scope = wmem_allocator_new(WMEM_ALLOCATOR_BLOCK_FAST);
+    ctx->batch_buf = g_byte_array_new();
+    ctx->batch_offsets = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+
+    if (capture_ctx_acquire_epan(ctx, &printTcpStreams) != 0) {
+        capture_ctx_close(ctx);
+        *err = -1;
+        return NULL;
+    }
 
-    // setup tcp follow tap
+    // printTcpStreams reports to the callback of setTcpTapDataCallbackWithCtx
     if (printTcpStreams) {
-        setup_tcp_follow_tap();
+        g_free(capture_ctx_set_tcp_tap(ctx, NULL, NULL, NULL));
     }
 
     prefs_p = epan_load_settings();
-    build_column_format_array(&cf.cinfo, prefs_p->num_cols, TRUE);
-    return 0;
+    build_column_format_array(&ctx->cf.cinfo, prefs_p->num_cols, TRUE);
+
+    return ctx;
 }
 
-static void write_json_index(json_dumper *dumper, epan_dissect_t *edt) {
+/**
+ * Close a context and free everything it holds.
+ */
+void capture_ctx_close(capture_ctx *ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+
+    if (epan_owner == ctx) {
+        reset_tap_listeners();
+    }
+    capture_ctx_release_epan(ctx);
+    tcp_follow_tap_free(ctx->tcp_tap);
+
+    if (ctx->cf.provider.frames != NULL) {
+        free_frame_data_sequence(ctx->cf.provider.frames);
+        ctx->cf.provider.frames = NULL;
+    }
+    if (ctx->cf.provider.wth != NULL) {
+        wtap_close(ctx->cf.provider.wth);
+        ctx->cf.provider.wth = NULL;
+    }
+    col_cleanup(&ctx->cf.cinfo);
+    wtap_rec_cleanup(&ctx->rec);
+    if (ctx->frame_buf != NULL) {
+        g_byte_array_free(ctx->frame_buf, TRUE);
+    }
+    g_string_free(ctx->json_buf, TRUE);
+    wmem_destroy_allocator(ctx->json_scope);
+    if (ctx->fields != NULL) {
+        g_ptr_array_free(ctx->fields, TRUE);
+    }
+    g_byte_array_free(ctx->batch_buf, TRUE);
+    g_array_free(ctx->batch_offsets, TRUE);
+    g_free(ctx->cf.filename);
+    g_free(ctx->options);
+    g_free(ctx);
+}
+
+/**
+ * Replace the tcp_follow listener of ctx, attaching it right away if ctx owns
+ * the epan session.
+ */
+char *capture_ctx_set_tcp_tap(capture_ctx *ctx, TcpTapBatchCallback callback, void *cb_ctx,
+                              const char *filter) {
+    tcp_follow_tap_free(ctx->tcp_tap);
+    ctx->tcp_tap = tcp_follow_tap_new(callback, cb_ctx, filter);
+    if (epan_owner != ctx) {
+        return NULL;
+    }
+
+    char *error = tcp_follow_tap_attach(ctx->tcp_tap);
+    if (error != NULL) {
+        tcp_follow_tap_free(ctx->tcp_tap);
+        ctx->tcp_tap = NULL;
+    }
+    return error;
+}
+
+/**
+ * Returns the "_index" value of a frame, "packets-<capture date>" (needs g_free).
+ */
+static char *frame_index_name(epan_dissect_t *edt) {
     char ts[30];
     struct tm *timeinfo;
-    char *str;
 
     timeinfo = localtime(&edt->pi.abs_ts.secs);
     if (timeinfo != NULL) {
@@ -222,8 +318,13 @@ static void write_json_index(json_dumper *dumper, epan_dissect_t *edt) {
         (void)g_strlcpy(ts, "XXXX-XX-XX",
                         sizeof(ts)); /* XXX - better way of saying "Not representable"? */
     }
+    return ws_strdup_printf("packets-%s", ts);
+}
+
+static void write_json_index(json_dumper *dumper, epan_dissect_t *edt) {
+    char *str = frame_index_name(edt);
+
     json_dumper_set_member_name(dumper, "_index");
-    str = ws_strdup_printf("packets-%s", ts);
     json_dumper_value_string(dumper, str);
     g_free(str);
 }
@@ -251,36 +352,93 @@ static const char *proto_node_to_json_key(proto_node *node) {
 }
 
 /**
- * Returns a boolean telling us whether that node list contains any node which
- * has children
+ * Returns a boolean telling us whether any of the values has children
  */
-static bool any_has_children(GSList *node_values_list) {
-    GSList *current_node = node_values_list;
-    while (current_node != NULL) {
-        proto_node *current_value = (proto_node *)current_node->data;
-        if (current_value->first_child != NULL) {
+static bool any_has_children(proto_node **values, guint count) {
+    for (guint i = 0; i < count; i++) {
+        if (values[i]->first_child != NULL) {
             return true;
         }
-        current_node = current_node->next;
     }
     return false;
 }
 
+/**
+ * Writes the value of a numeric or boolean field as a native JSON number or
+ * boolean. Integers displayed in hex, octal or a custom format keep their
+ * string form, so a typed value never reads differently from its string.
+ *
+ *  @return false if the field has no native JSON form and nothing was written
+ */
+static bool write_json_typed_value(json_dumper *dumper, field_info *fi) {
+    header_field_info *hfinfo = fi->hfinfo;
+    enum ftenum ftype = hfinfo->type;
+
+    if (fi->value == NULL) {
+        return false;
+    }
+    if (ftype == FT_BOOLEAN) {
+        json_dumper_value_anyf(dumper, "%s", fvalue_get_uinteger64(fi->value) ? "true" : "false");
+        return true;
+    }
+    if (ftype == FT_FLOAT || ftype == FT_DOUBLE) {
+        double d = fvalue_get_floating(fi->value);
+        if (!isfinite(d)) {
+            return false;
+        }
+        json_dumper_value_double(dumper, d);
+        return true;
+    }
+    if (ftype == FT_CHAR || !(FT_IS_INT(ftype) || FT_IS_UINT(ftype))) {
+        return false;
+    }
+
+    switch (FIELD_DISPLAY(hfinfo->display)) {
+        case BASE_NONE:
+        case BASE_DEC:
+        case BASE_DEC_HEX:
+        case BASE_PT_UDP:
+        case BASE_PT_TCP:
+        case BASE_PT_DCCP:
+        case BASE_PT_SCTP:
+            break;
+        default:
+            return false;
+    }
+
+    if (FT_IS_INT32(ftype)) {
+        json_dumper_value_anyf(dumper, "%" PRId32, fvalue_get_sinteger(fi->value));
+    } else if (FT_IS_INT64(ftype)) {
+        json_dumper_value_anyf(dumper, "%" PRId64, fvalue_get_sinteger64(fi->value));
+    } else if (FT_IS_UINT32(ftype)) {
+        json_dumper_value_anyf(dumper, "%" PRIu32, fvalue_get_uinteger(fi->value));
+    } else {
+        json_dumper_value_anyf(dumper, "%" PRIu64, fvalue_get_uinteger64(fi->value));
+    }
+    return true;
+}
+
 /**
  * Writes the value of a node to the output.
  */
 static void write_json_proto_node_value(proto_node *node, write_json_data *pdata) {
     field_info *fi = node->finfo;
-    // Get the actual value of the node as a string.
-    char *value_string_repr =
-        fvalue_to_string_repr(NULL, fi->value, FTREPR_JSON, fi->hfinfo->display);
+    if (pdata->typed_values && write_json_typed_value(pdata->dumper, fi)) {
+        return;
+    }
+
+    // Get the actual value of the node as a string, unless the group writer
+    // already did to find out whether the node has one.
+    char *value_string_repr = pdata->repr;
+    if (node != pdata->repr_node) {
+        value_string_repr =
+            fvalue_to_string_repr(pdata->scope, fi->value, FTREPR_JSON, fi->hfinfo->display);
+    }
 
     // TODO: Have FTREPR_JSON include quotes where appropriate and use
     // json_dumper_value_anyf() here,
     //  so we can output booleans and numbers and not only strings.
     json_dumper_value_string(pdata->dumper, value_string_repr);
-
-    wmem_free(NULL, value_string_repr);
 }
 
 /**
@@ -315,154 +473,177 @@ static void write_json_proto_node_dynamic(proto_node *node, write_json_data *dat
 /**
  * Writes a single node as a key:value pair. The value_writer param can be used
  * to specify how the node's value should be written.
- * @param node_values_head Linked list containing all nodes associated with the
- * same json key in this object.
+ * @param json_key json key shared by all values.
  * @param suffix Suffix that should be added to the json key.
+ * @param values All nodes associated with the same json key in this object.
+ * @param count Number of values.
  * @param value_writer A function which writes the actual values of the node
  * json key.
  * @param pdata json writing metadata
  */
-static void write_json_proto_node(GSList *node_values_head, const char *suffix,
-                                  proto_node_value_writer value_writer, write_json_data *pdata) {
-    // Retrieve json key from first value.
-    proto_node *first_value = (proto_node *)node_values_head->data;
-    const char *json_key = proto_node_to_json_key(first_value);
-    char *json_key_suffix = ws_strdup_printf("%s%s", json_key, suffix);
-    json_dumper_set_member_name(pdata->dumper, json_key_suffix);
-    g_free(json_key_suffix);
-    write_json_proto_node_value_list(node_values_head, value_writer, pdata);
+static void write_json_proto_node(const char *json_key, const char *suffix, proto_node **values,
+                                  guint count, proto_node_value_writer value_writer,
+                                  write_json_data *pdata) {
+    if (*suffix != '\0') {
+        json_key = wmem_strconcat(pdata->scope, json_key, suffix, NULL);
+    }
+    json_dumper_set_member_name(pdata->dumper, json_key);
+    write_json_proto_node_value_list(values, count, value_writer, pdata);
 }
 
 /**
  * Writes a list of values of a single json key. If multiple values are passed
  * they are wrapped in a json array.
- * @param node_values_head Linked list containing all values that should be
- * written.
+ * @param values All values that should be written.
+ * @param count Number of values.
  * @param value_writer Function which writes the separate values.
  * @param pdata json writing metadata
  */
-static void write_json_proto_node_value_list(GSList *node_values_head,
+static void write_json_proto_node_value_list(proto_node **values, guint count,
                                              proto_node_value_writer value_writer,
                                              write_json_data *pdata) {
-    GSList *current_value = node_values_head;
-
     // Write directly if only a single value is passed. Wrap in json array
     // otherwise.
-    if (current_value->next == NULL) {
-        value_writer((proto_node *)current_value->data, pdata);
+    if (count == 1) {
+        value_writer(values[0], pdata);
     } else {
         json_dumper_begin_array(pdata->dumper);
-
-        while (current_value != NULL) {
-            value_writer((proto_node *)current_value->data, pdata);
-            current_value = current_value->next;
+        for (guint i = 0; i < count; i++) {
+            value_writer(values[i], pdata);
         }
         json_dumper_end_array(pdata->dumper);
     }
 }
 
 /**
- * Write a json object containing a list of key:value pairs where each key:value
- * pair corresponds to a different json key and its associated nodes in the
- * proto_tree.
- * @param proto_node_list_head A 2-dimensional list containing a list of values
- * for each different node json key. The elements themselves are a linked list
- * of values associated with the same json key.
+ * Writes the key:value pairs of one json key. Whether the key has a value is
+ * decided by its first node; the key of the children gets a "_tree" suffix if
+ * it does.
+ * @param json_key json key shared by all values.
+ * @param values All nodes associated with the json key, in tree order.
+ * @param count Number of values.
  * @param pdata json writing metadata
  */
-static void write_json_proto_node_list(GSList *proto_node_list_head, write_json_data *pdata) {
-    json_dumper_begin_object(pdata->dumper);
-
-    // hash table
-    GHashTable *key_nodes = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, NULL);
+static void write_json_proto_node_group(const char *json_key, proto_node **values, guint count,
+                                        write_json_data *pdata) {
+    field_info *fi = values[0]->finfo;
+    bool has_value = false;
+
+    // A descriptive label "name: value" counts as a value without converting
+    // the field; otherwise the string form is kept for writing the first value.
+    if (!fi->rep) {
+        gchar label_str[ITEM_LABEL_LENGTH];
+        proto_item_fill_label(fi, label_str, NULL);
+        has_value = strstr(label_str, ": ") != NULL;
+    }
+    if (!has_value) {
+        pdata->repr_node = values[0];
+        pdata->repr =
+            fvalue_to_string_repr(pdata->scope, fi->value, FTREPR_JSON, fi->hfinfo->display);
+        has_value = pdata->repr != NULL;
+    }
 
-    // First traversal: Group nodes with the same key
-    GSList *current_node = proto_node_list_head;
-    while (current_node != NULL) {
-        GSList *node_values_list = (GSList *)current_node->data;
-        proto_node *first_value = (proto_node *)node_values_list->data;
-        const char *json_key = proto_node_to_json_key(first_value);
+    bool has_children = any_has_children(values, count);
 
-        GSList *existing_list = g_hash_table_lookup(key_nodes, json_key);
-        if (existing_list == NULL) {
-            g_hash_table_insert(key_nodes, (gpointer)json_key, node_values_list);
-        } else {
-            // Merge the list of nodes with the same key
-            GSList *combined_list =
-                g_slist_concat(g_slist_copy(existing_list), g_slist_copy(node_values_list));
-            g_hash_table_replace(key_nodes, (gpointer)json_key, combined_list);
-        }
+    if (has_value) {
+        write_json_proto_node(json_key, "", values, count, write_json_proto_node_value, pdata);
+    }
 
-        current_node = current_node->next;
+    if (has_children) {
+        const char *suffix = has_value ? "_tree" : "";
+        write_json_proto_node(json_key, suffix, values, count, write_json_proto_node_dynamic,
+                              pdata);
     }
 
-    // Second traversal: output merged nodes
-    GHashTableIter iter;
-    gpointer key, value;
-    g_hash_table_iter_init(&iter, key_nodes);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        GSList *node_values_list = (GSList *)value;
-        proto_node *first_value = (proto_node *)node_values_list->data;
+    if (!has_value && !has_children) {
+        write_json_proto_node(json_key, "", values, count, write_json_proto_node_no_value, pdata);
+    }
+}
 
-        field_info *fi = first_value->finfo;
-        char *value_string_repr =
-            fvalue_to_string_repr(NULL, fi->value, FTREPR_JSON, fi->hfinfo->display);
-        bool has_children = any_has_children(node_values_list);
+/**
+ * Writes the children of a node as a json object with one key:value pair per
+ * json key. Children sharing a json key are merged into one array, and keys
+ * come out in order of their first child, so the output is deterministic.
+ *
+ * The grouping lives in pdata->scope: an open-addressed table from json key to
+ * group, then a counting sort that makes each group contiguous. Nothing is
+ * freed here; the scope is emptied once the frame is written.
+ */
+static void write_json_proto_node_children(proto_node *node, write_json_data *pdata) {
+    wmem_allocator_t *scope = pdata->scope;
+    guint n = 0;
 
-        // descriptive values
-        gchar label_str[ITEM_LABEL_LENGTH];
-        gchar *label_ptr;
-        if (!fi->rep) {
-            label_ptr = label_str;
-            proto_item_fill_label(fi, label_str, NULL);
-            char *value_ptr = strstr(label_ptr, ": ");
-            if (value_ptr != NULL) {
-                value_string_repr = value_ptr + 2;
-            }
-        }
+    json_dumper_begin_object(pdata->dumper);
 
-        gboolean has_value = value_string_repr != NULL;
+    for (proto_node *child = node->first_child; child != NULL; child = child->next) {
+        n++;
+    }
+    if (n == 0) {
+        json_dumper_end_object(pdata->dumper);
+        return;
+    }
 
-        if (has_value) {
-            write_json_proto_node(node_values_list, "", write_json_proto_node_value, pdata);
+    // Power of two at least twice the number of children, keeping probes short.
+    guint mask = 1;
+    while (mask < 2 * n) {
+        mask <<= 1;
+    }
+    mask--;
+
+    guint *slots = wmem_alloc0_array(scope, guint, mask + 1);  // group + 1, 0 if empty
+    const char **keys = wmem_alloc_array(scope, const char *, n);
+    guint *group_of = wmem_alloc_array(scope, guint, n);
+    guint *start = wmem_alloc0_array(scope, guint, n + 1);
+    guint groups = 0;
+
+    guint i = 0;
+    for (proto_node *child = node->first_child; child != NULL; child = child->next, i++) {
+        const char *json_key = proto_node_to_json_key(child);
+        guint h = g_str_hash(json_key) & mask;
+        while (slots[h] != 0 && strcmp(keys[slots[h] - 1], json_key) != 0) {
+            h = (h + 1) & mask;
         }
-
-        if (has_children) {
-            char *suffix = has_value ? "_tree" : "";
-            write_json_proto_node(node_values_list, suffix, write_json_proto_node_dynamic, pdata);
+        if (slots[h] == 0) {
+            keys[groups] = json_key;
+            slots[h] = ++groups;
         }
+        group_of[i] = slots[h] - 1;
+        start[slots[h]]++;
+    }
 
-        if (!has_value && !has_children) {
-            write_json_proto_node(node_values_list, "", write_json_proto_node_no_value, pdata);
-        }
+    // Group sizes to offsets, then place every child after the earlier ones of
+    // its group.
+    for (guint g = 0; g < groups; g++) {
+        start[g + 1] += start[g];
+    }
+    proto_node **grouped = wmem_alloc_array(scope, proto_node *, n);
+    guint *fill = wmem_memdup(scope, start, groups * sizeof(guint));
+    i = 0;
+    for (proto_node *child = node->first_child; child != NULL; child = child->next, i++) {
+        grouped[fill[group_of[i]]++] = child;
     }
 
-    // clean
-    g_hash_table_destroy(key_nodes);
+    for (guint g = 0; g < groups; g++) {
+        write_json_proto_node_group(keys[g], grouped + start[g], start[g + 1] - start[g], pdata);
+    }
 
     json_dumper_end_object(pdata->dumper);
 }
 
-/**
- * Writes the children of a node. Calls get_json_proto_tree internally
- * which recursively writes children of nodes to the output.
- */
-static void write_json_proto_node_children(proto_node *node, write_json_data *data) {
-    GSList *grouped_children_list = data->node_children_grouper(node);
-    write_json_proto_node_list(grouped_children_list, data);
-    g_slist_free_full(grouped_children_list, (GDestroyNotify)g_slist_free);
-}
-
 /**
  * Get protocol tree dissect result in json format.
+ *
+ * Children are grouped by json key. Temporary data of the serializer goes to
+ * scope, which is emptied before returning; pass NULL to use a throwaway one.
  */
 void get_json_proto_tree(output_fields_t *fields, print_dissections_e print_dissections,
                          gboolean print_hex, gchar **protocolfilter, pf_flags protocolfilter_flags,
-                         epan_dissect_t *edt, column_info *cinfo,
-                         proto_node_children_grouper_func node_children_grouper,
-                         json_dumper *dumper) {
-    write_json_data data;
+                         epan_dissect_t *edt, column_info *cinfo, json_dumper *dumper,
+                         bool typed_values, wmem_allocator_t *scope) {
+    write_json_data data = {};
     data.dumper = dumper;
+    data.typed_values = typed_values;
+    data.scope = scope != NULL ? scope : wmem_allocator_new(WMEM_ALLOCATOR_BLOCK_FAST);
 
     json_dumper_begin_object(dumper);
     write_json_index(dumper, edt);
@@ -472,10 +653,49 @@ void get_json_proto_tree(output_fields_t *fields, print_dissections_e print_diss
     data.src_list = edt->pi.data_src;
     data.print_hex = print_hex;
     data.print_text = TRUE;
-    data.node_children_grouper = node_children_grouper;
     write_json_proto_node_children(edt->tree, &data);
 
     json_dumper_end_object(dumper);
+
+    if (scope != NULL) {
+        wmem_free_all(scope);
+    } else {
+        wmem_destroy_allocator(data.scope);
+    }
+}
+
+// json_buf is trimmed once its capacity exceeds this and four times the average
+// frame, so a single outsized frame does not pin its buffer for the whole pass.
+#define JSON_BUF_KEEP_MIN (64 * 1024)
+
+/**
+ * Render the proto tree of a dissected frame as JSON into ctx->json_buf.
+ *
+ *  @return true if the JSON is complete
+ */
+static bool render_frame_json(capture_ctx *ctx, epan_dissect_t *edt) {
+    json_dumper dumper = {};
+
+    g_string_truncate(ctx->json_buf, 0);
+    dumper.output_string = ctx->json_buf;
+    get_json_proto_tree(NULL, print_dissections_expanded, FALSE, NULL, PF_INCLUDE_CHILDREN, edt,
+                        &ctx->cf.cinfo, &dumper, ctx->typed_values, ctx->json_scope);
+
+    return json_dumper_finish(&dumper);
+}
+
+/**
+ * Fold the frame in ctx->json_buf into the running average and shrink the
+ * buffer back to twice the average if a larger frame left it oversized.
+ */
+static void json_buf_fit(capture_ctx *ctx) {
+    gsize len = ctx->json_buf->len;
+
+    ctx->json_avg_len = ctx->json_avg_len - ctx->json_avg_len / 16 + len / 16;
+    if (ctx->json_buf->allocated_len > MAX(JSON_BUF_KEEP_MIN, 4 * ctx->json_avg_len)) {
+        g_string_free(ctx->json_buf, TRUE);
+        ctx->json_buf = g_string_sized_new(2 * ctx->json_avg_len);
+    }
 }
 
 // --- Internal Processing Helpers ---
@@ -483,52 +703,44 @@ void get_json_proto_tree(output_fields_t *fields, print_dissections_e print_diss
 /**
  * Read each frame.
  *
- *  @param edt_r the epan_dissect_t struct of each frame
+ *  @param edt_r set to the reusable dissection context of ctx, which the caller
+ *  resets once done with the frame
  *  @return true if can dissect frame correctly, false if can not read frame
  */
-bool read_packet(epan_dissect_t **edt_r) {
+static bool read_packet(capture_ctx *ctx, epan_dissect_t **edt_r) {
     if (!edt_r) return false;
 
     epan_dissect_t *edt = NULL;
     int err;
     gchar *err_info = NULL;
-    guint32 cum_bytes = 0;
     int64_t data_offset = 0;
-    wtap_rec rec;
 
-    wtap_rec_init(&rec, 1514);
-
-    if (!wtap_read(cf.provider.wth, &rec, &err, &err_info, &data_offset)) {
-        wtap_rec_cleanup(&rec);
+    // The record buffer of the context stays valid until the next read, so the
+    // returned edt may still reference the frame data.
+    wtap_rec_reset(&ctx->rec);
+    if (!wtap_read(ctx->cf.provider.wth, &ctx->rec, &err, &err_info, &data_offset)) {
+        g_free(err_info);
         return false;
     }
 
-    cf.count++;
+    ctx->cf.count++;
 
     frame_data fd;
-    frame_data_init(&fd, cf.count, &rec, data_offset, cum_bytes);
-
-    // data_offset must be correctly set
-    data_offset = fd.pkt_len;
-    edt = epan_dissect_new(cf.epan, TRUE, TRUE);
-    if (!edt) {
-        frame_data_destroy(&fd);
-        wtap_rec_reset(&rec);
-        return false;
-    }
+    frame_data_init(&fd, ctx->cf.count, &ctx->rec, data_offset, ctx->cum_bytes);
 
-    frame_data_set_before_dissect(&fd, &cf.elapsed_time, &cf.provider.ref, cf.provider.prev_dis);
+    edt = &ctx->edt;
 
-    cf.provider.ref = &fd;
+    frame_data_set_before_dissect(&fd, &ctx->cf.elapsed_time, &ctx->cf.provider.ref,
+                                  ctx->cf.provider.prev_dis);
 
-    // core dissect process
-    epan_dissect_run_with_taps(edt, cf.cd_t, &rec, &fd, &cf.cinfo);
-    frame_data_set_after_dissect(&fd, &cum_bytes);
+    ctx->cf.provider.ref = &fd;
 
-    cf.provider.prev_cap = cf.provider.prev_dis = frame_data_sequence_add(cf.provider.frames, &fd);
+    // core dissect process
+    epan_dissect_run_with_taps(edt, ctx->cf.cd_t, &ctx->rec, &fd, &ctx->cf.cinfo);
+    frame_data_set_after_dissect(&fd, &ctx->cum_bytes);
 
-    // free space
-    wtap_rec_cleanup(&rec);
+    ctx->cf.provider.prev_cap = ctx->cf.provider.prev_dis =
+        frame_data_sequence_add(ctx->cf.provider.frames, &fd);
 
     *edt_r = edt;
     return true;
@@ -539,18 +751,25 @@ bool read_packet(epan_dissect_t **edt_r) {
  *
  *  @return none, just print dissect result
  */
-void print_all_frame() {
+void print_all_frame(capture_ctx *ctx) {
     epan_dissect_t *edt;
     print_stream_t *print_stream = print_stream_text_stdio_new(stdout);
     // start reading packets
-    while (read_packet(&edt)) {
+    while (read_packet(ctx, &edt)) {
         proto_tree_print(print_dissections_expanded, TRUE, edt, NULL, print_stream);
         // print hex data
         print_hex_data(print_stream, edt, hexdump_source_option | hexdump_ascii_option);
-        epan_dissect_free(edt);
-        edt = NULL;
+        epan_dissect_reset(edt);
     }
-    close_cf();
+}
+
+/**
+ * Render the hex dump of a dissected frame as {"offset":[],"hex":[],"ascii":[]}.
+ */
+static char *hex_data_to_json(epan_dissect_t *edt) {
+    GString *json = g_string_new(NULL);
+    get_hex_data(edt, json);
+    return g_string_free(json, FALSE);
 }
 
 /**
@@ -559,38 +778,21 @@ void print_all_frame() {
  *  @param num the index of frame which you want to dissect
  *  @return char of hex data dissect result, include hex data
  */
-char *get_specific_frame_hex_data(int num) {
+char *get_specific_frame_hex_data(capture_ctx *ctx, int num) {
     epan_dissect_t *edt;
     // start reading packets
-    while (read_packet(&edt)) {
-        if (num != cf.count) {
-            epan_dissect_free(edt);
-            edt = NULL;
+    while (read_packet(ctx, &edt)) {
+        if (num != ctx->cf.count) {
+            epan_dissect_reset(edt);
             continue;
         }
 
-        cJSON *cjson_hex_root = cJSON_CreateObject();
-
-        cJSON *cjson_offset = cJSON_CreateArray();
-        cJSON *cjson_hex = cJSON_CreateArray();
-        cJSON *cjson_ascii = cJSON_CreateArray();
+        char *res = hex_data_to_json(edt);
 
-        get_hex_data(edt, cjson_offset, cjson_hex, cjson_ascii);
+        epan_dissect_reset(edt);
 
-        cJSON_AddItemToObject(cjson_hex_root, "offset", cjson_offset);
-        cJSON_AddItemToObject(cjson_hex_root, "hex", cjson_hex);
-        cJSON_AddItemToObject(cjson_hex_root, "ascii", cjson_ascii);
-
-        epan_dissect_free(edt);
-        edt = NULL;
-
-        char *res = cJSON_PrintUnformatted(cjson_hex_root);
-        cJSON_Delete(cjson_hex_root);
-
-        close_cf();
         return res;
     }
-    close_cf();
 
     return strdup("");
 }
@@ -601,171 +803,892 @@ char *get_specific_frame_hex_data(int num) {
  *  @param num the index of frame which you want to dissect
  *  @return char of protocol tree dissect result
  */
-char *proto_tree_in_json(int num, int printCJson) {
+char *proto_tree_in_json(capture_ctx *ctx, int num, int printCJson) {
     epan_dissect_t *edt;
 
     // start reading packets
-    while (read_packet(&edt)) {
-        if (num != cf.count) {
-            epan_dissect_free(edt);
-            edt = NULL;
+    while (read_packet(ctx, &edt)) {
+        if (num != ctx->cf.count) {
+            epan_dissect_reset(edt);
             continue;
         }
 
-        json_dumper dumper = {};
-        dumper.output_string = g_string_new(NULL);
-
-        get_json_proto_tree(NULL, print_dissections_expanded, FALSE, NULL, PF_INCLUDE_CHILDREN, edt,
-                            &cf.cinfo, proto_node_group_children_by_unique, &dumper);
-
-        // Get JSON string from json_dumper
         char *json_str = NULL;
-        if (json_dumper_finish(&dumper)) {
-            json_str = g_strdup(dumper.output_string->str);
-        }
-
-        // cleanup
-        if (dumper.output_string) {
-            g_string_free(dumper.output_string, TRUE);
+        if (render_frame_json(ctx, edt)) {
+            json_str = g_strdup(ctx->json_buf->str);
         }
-        epan_dissect_free(edt);
+        epan_dissect_reset(edt);
 
         if (printCJson) {
             printf("%s\n", json_str);
         }
 
-        close_cf();
         return json_str ? json_str : g_strdup("");
     }
 
-    close_cf();
     return g_strdup("");
 }
 
-// --- Optimized Callbacks (Single Pass I/O) ---
-
-void get_all_frames_cb(int printCJson, char *filter_str, FrameCallback callback) {
+/**
+ * Serialize one frame to JSON over and over, to benchmark the serializer on a
+ * fixed proto tree. A first pass sizes the buffers and is not counted.
+ *
+ *  @param num the index of the frame
+ *  @param iterations number of counted passes
+ *  @param elapsed_ns set to the wall time of the counted passes
+ *  @param allocs set to the heap allocations of the counted passes, -1 if the
+ *  build does not count them
+ *  @return JSON length of the frame, -1 if the file has no such frame
+ */
+int bench_json_serialize(capture_ctx *ctx, int num, int iterations, int64_t *elapsed_ns,
+                         int64_t *allocs) {
     epan_dissect_t *edt;
-    cf.count = 0;
-    int err = 0;
-    gchar *err_info = NULL;
-    int64_t data_offset = 0;
-    guint32 cum_bytes = 0;
-    wtap_rec rec;
-    wtap_rec_init(&rec, 1514);
 
-    dfilter_t *dfcode = NULL;
-    if (filter_str != NULL && strlen(filter_str) > 0) {
-        if (!dfilter_compile(filter_str, &dfcode, NULL)) {
-            fprintf(stderr, "Filter compile failed: %s\n", filter_str);
+    while (read_packet(ctx, &edt)) {
+        if (num != ctx->cf.count) {
+            epan_dissect_reset(edt);
+            continue;
         }
-    }
-
-    while (wtap_read(cf.provider.wth, &rec, &err, &err_info, &data_offset)) {
-        cf.count++;
-        frame_data fd;
-        frame_data_init(&fd, cf.count, &rec, data_offset, 0);
 
-        edt = epan_dissect_new(cf.epan, TRUE, TRUE);
-
-        if (dfcode != NULL) {
-            epan_dissect_prime_with_dfilter(edt, dfcode);
+        render_frame_json(ctx, edt);
+        int64_t before = heap_alloc_count();
+        gint64 start = g_get_monotonic_time();
+        for (int i = 0; i < iterations; i++) {
+            render_frame_json(ctx, edt);
         }
+        *elapsed_ns = (g_get_monotonic_time() - start) * 1000;
+        *allocs = before < 0 ? -1 : heap_alloc_count() - before;
 
-        frame_data_set_before_dissect(&fd, &cf.elapsed_time, &cf.provider.ref, cf.provider.prev_dis);
-        cf.provider.ref = &fd;
-
-        epan_dissect_run_with_taps(edt, cf.cd_t, &rec, &fd, &cf.cinfo);
-
-        frame_data_set_after_dissect(&fd, &cum_bytes);
-        cf.provider.prev_cap = cf.provider.prev_dis = frame_data_sequence_add(cf.provider.frames, &fd);
+        int len = (int)ctx->json_buf->len;
+        epan_dissect_reset(edt);
+        return len;
+    }
 
-        if (dfcode != NULL) {
-            if (!dfilter_apply_edt(dfcode, edt)) {
-                epan_dissect_free(edt);
-                wtap_rec_reset(&rec);
-                continue;
-            }
-        }
+    return -1;
+}
 
-        json_dumper dumper = {};
-        dumper.output_string = g_string_new(NULL);
-        get_json_proto_tree(NULL, print_dissections_expanded, FALSE, NULL, PF_INCLUDE_CHILDREN, edt,
-                            &cf.cinfo, proto_node_group_children_by_unique, &dumper);
+// --- Frame Batching ---
 
-        if (json_dumper_finish(&dumper)) {
-            if (printCJson) printf("%s\n", dumper.output_string->str);
-            callback(dumper.output_string->str, dumper.output_string->len, 0);
-        }
+/**
+ * Deliver frames through cb in batches instead of one callback per frame. A
+ * batch is flushed once it holds max_frames frames or max_bytes bytes, and at
+ * the end of every call that emits frames. Once cb returns nonzero, further
+ * frames are dropped and the sequential loops stop reading.
+ *
+ *  @param cb batch callback, NULL to deliver frames one by one through the FrameCallback
+ *  @param max_frames frames per batch, <= 1 hands every frame over on its own
+ */
+void capture_ctx_set_batch(capture_ctx *ctx, FrameBatchCallback cb, int max_frames,
+                           int max_bytes) {
+    capture_ctx_flush_frames(ctx);
+    ctx->stop_requested = false;
+    ctx->batch_cb = cb;
+    ctx->batch_max_frames = max_frames;
+    ctx->batch_max_bytes = max_bytes > 0 ? (guint)max_bytes : G_MAXUINT;
+}
 
-        if (dumper.output_string) g_string_free(dumper.output_string, TRUE);
-        epan_dissect_free(edt);
-        wtap_rec_reset(&rec);
+/**
+ * Hand the pending batch of ctx to its batch callback, and the TCP segments the
+ * tcp_follow tap has buffered so far to theirs.
+ */
+void capture_ctx_flush_frames(capture_ctx *ctx) {
+    if (ctx->tcp_tap != NULL) {
+        tcp_follow_tap_flush(ctx->tcp_tap);
+    }
+    if (ctx->batch_offsets->len < 2) {
+        return;
     }
 
-    if (dfcode != NULL) dfilter_free(dfcode);
-    close_cf();
-    wtap_rec_cleanup(&rec);
+    if (ctx->batch_cb((char *)ctx->batch_buf->data, (uint32_t *)ctx->batch_offsets->data,
+                      (int)ctx->batch_offsets->len - 1, ctx->cb_ctx) != 0) {
+        ctx->stop_requested = true;
+    }
+    g_byte_array_set_size(ctx->batch_buf, 0);
+    g_array_set_size(ctx->batch_offsets, 0);
 }
 
-void get_frames_by_idxs_cb(int *idxs, int idx_count, int printCJson, FrameCallback callback) {
-    if (idx_count <= 0) {
-        close_cf();
+/**
+ * Deliver one emitted frame: straight to callback, or appended to the batch.
+ * Once either callback asks for no more frames, ctx->stop_requested is set and
+ * further frames are dropped.
+ */
+static void capture_ctx_deliver(capture_ctx *ctx, const char *data, guint len,
+                                FrameCallback callback) {
+    if (ctx->stop_requested) {
+        return;
+    }
+    if (ctx->batch_cb == NULL) {
+        if (callback((char *)data, (int)len, 0, ctx->cb_ctx) != 0) {
+            ctx->stop_requested = true;
+        }
         return;
     }
 
-    epan_dissect_t *edt;
-    cf.count = 0;
-    int err = 0;
+    if (ctx->batch_offsets->len == 0) {
+        uint32_t start = 0;
+        g_array_append_val(ctx->batch_offsets, start);
+    }
+    g_byte_array_append(ctx->batch_buf, (const guint8 *)data, len);
+    uint32_t end = ctx->batch_buf->len;
+    g_array_append_val(ctx->batch_offsets, end);
+
+    if (ctx->batch_offsets->len - 1 >= (guint)ctx->batch_max_frames ||
+        ctx->batch_buf->len >= ctx->batch_max_bytes) {
+        capture_ctx_flush_frames(ctx);
+    }
+}
+
+// --- Binary Frame Encoding ---
+
+static void frame_buf_put(GByteArray *buf, const void *data, guint len) {
+    g_byte_array_append(buf, (const guint8 *)data, len);
+}
+
+static void frame_buf_put_str(GByteArray *buf, const char *str, size_t max_len) {
+    size_t len = str != NULL ? strlen(str) : 0;
+    if (len > max_len) {
+        len = max_len;
+    }
+    if (max_len == UINT16_MAX) {
+        uint16_t len16 = (uint16_t)len;
+        frame_buf_put(buf, &len16, sizeof(len16));
+    } else {
+        uint32_t len32 = (uint32_t)len;
+        frame_buf_put(buf, &len32, sizeof(len32));
+    }
+    frame_buf_put(buf, str, (guint)len);
+}
+
+// Abbreviations of the fields registered by frame_keys_init, by hf id. Every
+// process of a build registers them alike, so binary frames leave them out.
+static const char **static_keys;
+static uint32_t static_key_count;
+
+void frame_keys_init(void) {
+    static_key_count = (uint32_t)proto_registrar_n();
+    static_keys = g_new0(const char *, static_key_count);
+    for (uint32_t id = 1; id < static_key_count; id++) {
+        header_field_info *hfinfo = proto_registrar_get_nth(id);
+        static_keys[id] = hfinfo != NULL ? hfinfo->abbrev : NULL;
+    }
+}
+
+uint32_t frame_static_key_count(void) { return static_key_count; }
+
+const char *frame_static_key(int32_t hfid) {
+    if (hfid < 0 || (uint32_t)hfid >= static_key_count) {
+        return NULL;
+    }
+    return static_keys[hfid];
+}
+
+/**
+ * Whether the json key group led by fi has a value, decided as in
+ * write_json_proto_node_group.
+ *
+ *  @param repr set to the JSON representation of fi if it had to be computed,
+ *  to be freed with wmem_free(NULL, ...)
+ */
+static bool frame_node_has_value(field_info *fi, char **repr) {
+    *repr = NULL;
+    if (!fi->rep) {
+        char label_str[ITEM_LABEL_LENGTH];
+        proto_item_fill_label(fi, label_str, NULL);
+        if (strstr(label_str, ": ") != NULL) {
+            return true;
+        }
+    }
+    *repr = fvalue_to_string_repr(NULL, fi->value, FTREPR_JSON, fi->hfinfo->display);
+    return *repr != NULL;
+}
+
+/**
+ * Append one proto tree item to a binary frame. The value string follows the
+ * JSON writer, so decoders can rebuild the same layers; numeric fields also
+ * carry their typed value, which stands in for the value string when it is
+ * just its decimal rendering. Keys of static fields are left out.
+ *
+ *  @param has_value whether the json key group of the node has a value
+ *  @param repr JSON representation of the node if already computed, or NULL;
+ *  freed here
+ */
+static void frame_buf_put_node(GByteArray *buf, proto_node *node, int32_t parent, bool has_value,
+                               char *repr) {
+    field_info *fi = node->finfo;
+    header_field_info *hfinfo = fi->hfinfo;
+    enum ftenum ftype = hfinfo->type;
+    char label_str[ITEM_LABEL_LENGTH];
+    const char *value = NULL;
+    uint8_t flags = 0;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+    } num = {0};
+
+    if (has_value) {
+        flags |= FRAME_NODE_HAS_VALUE;
+        if (repr == NULL) {
+            repr = fvalue_to_string_repr(NULL, fi->value, FTREPR_JSON, hfinfo->display);
+        }
+        value = repr;
+    } else if (ftype == FT_PROTOCOL && node->first_child == NULL) {
+        if (fi->rep) {
+            value = fi->rep->representation;
+        } else {
+            proto_item_fill_label(fi, label_str, NULL);
+            value = label_str;
+        }
+    }
+
+    if (fi->value != NULL) {
+        if (FT_IS_INT32(ftype)) {
+            num.i = fvalue_get_sinteger(fi->value);
+            flags |= FRAME_NODE_NUM_INT;
+        } else if (FT_IS_INT64(ftype)) {
+            num.i = fvalue_get_sinteger64(fi->value);
+            flags |= FRAME_NODE_NUM_INT;
+        } else if (FT_IS_UINT32(ftype)) {
+            num.u = fvalue_get_uinteger(fi->value);
+            flags |= FRAME_NODE_NUM_UINT;
+        } else if (FT_IS_UINT64(ftype) || ftype == FT_BOOLEAN) {
+            num.u = fvalue_get_uinteger64(fi->value);
+            flags |= FRAME_NODE_NUM_UINT;
+        } else if (ftype == FT_FLOAT || ftype == FT_DOUBLE) {
+            num.d = fvalue_get_floating(fi->value);
+            flags |= FRAME_NODE_NUM_DOUBLE;
+        }
+    }
+
+    // Most numbers are rendered in decimal, which the decoder can redo itself.
+    if (value != NULL && has_value && (flags & (FRAME_NODE_NUM_INT | FRAME_NODE_NUM_UINT))) {
+        char decimal[24];
+        if (flags & FRAME_NODE_NUM_INT) {
+            snprintf(decimal, sizeof(decimal), "%" PRId64, num.i);
+        } else {
+            snprintf(decimal, sizeof(decimal), "%" PRIu64, num.u);
+        }
+        if (strcmp(value, decimal) == 0) {
+            value = NULL;
+            flags |= FRAME_NODE_VALUE_NUM;
+        }
+    }
+    if (value != NULL) {
+        flags |= FRAME_NODE_VALUE;
+    }
+
+    const char *key = proto_node_to_json_key(node);
+    if (hfinfo->id == hf_text_only) {
+        flags |= FRAME_NODE_TEXT_ONLY | FRAME_NODE_KEY;
+    } else if (frame_static_key(hfinfo->id) != key) {
+        flags |= FRAME_NODE_KEY;
+    }
+
+    int32_t hfid = hfinfo->id;
+    int32_t start = fi->start;
+    int32_t length = fi->length;
+    uint8_t ftype8 = (uint8_t)ftype;
+
+    frame_buf_put(buf, &hfid, sizeof(hfid));
+    frame_buf_put(buf, &parent, sizeof(parent));
+    frame_buf_put(buf, &start, sizeof(start));
+    frame_buf_put(buf, &length, sizeof(length));
+    frame_buf_put(buf, &ftype8, sizeof(ftype8));
+    frame_buf_put(buf, &flags, sizeof(flags));
+    if (flags & (FRAME_NODE_NUM_INT | FRAME_NODE_NUM_UINT | FRAME_NODE_NUM_DOUBLE)) {
+        frame_buf_put(buf, &num, sizeof(num));
+    }
+    if (flags & FRAME_NODE_KEY) {
+        frame_buf_put_str(buf, key, UINT16_MAX);
+    }
+    if (flags & FRAME_NODE_VALUE) {
+        frame_buf_put_str(buf, value, UINT32_MAX);
+    }
+
+    wmem_free(NULL, repr);
+}
+
+/**
+ * Append the children of node in pre-order, so every node follows its parent.
+ * Children sharing a json key take the has-value decision of the first of
+ * them; the map of decisions lives in scope, which is emptied after the frame.
+ *
+ *  @param parent index of node in the frame, -1 for the tree root
+ *  @param count number of nodes written so far, updated
+ */
+static void frame_buf_put_children(GByteArray *buf, wmem_allocator_t *scope, proto_node *node,
+                                   int32_t parent, uint32_t *count) {
+    wmem_map_t *groups = NULL;
+    if (node->first_child != NULL && node->first_child->next != NULL) {
+        groups = wmem_map_new(scope, g_str_hash, g_str_equal);
+    }
+
+    for (proto_node *child = node->first_child; child != NULL; child = child->next) {
+        if (child->finfo == NULL) {
+            continue;
+        }
+        const char *key = proto_node_to_json_key(child);
+        char *repr = NULL;
+        gpointer decided;
+        bool has_value;
+        if (groups != NULL && wmem_map_lookup_extended(groups, key, NULL, &decided)) {
+            has_value = GPOINTER_TO_INT(decided) != 0;
+        } else {
+            has_value = frame_node_has_value(child->finfo, &repr);
+            if (groups != NULL) {
+                wmem_map_insert(groups, key, GINT_TO_POINTER(has_value));
+            }
+        }
+
+        int32_t index = (int32_t)(*count)++;
+        frame_buf_put_node(buf, child, parent, has_value, repr);
+        frame_buf_put_children(buf, scope, child, index, count);
+    }
+}
+
+/**
+ * Encode the proto tree of a dissected frame as a binary node array
+ * (FRAME_BINARY_MAGIC format, see offline.h) into ctx->frame_buf.
+ */
+static void encode_frame_binary(capture_ctx *ctx, epan_dissect_t *edt) {
+    GByteArray *buf = ctx->frame_buf;
+    uint32_t magic = FRAME_BINARY_MAGIC;
+    uint32_t count = 0;
+
+    g_byte_array_set_size(buf, 0);
+    frame_buf_put(buf, &magic, sizeof(magic));
+    frame_buf_put(buf, &count, sizeof(count));  // patched below
+    frame_buf_put(buf, &static_key_count, sizeof(static_key_count));
+
+    char *index = frame_index_name(edt);
+    frame_buf_put_str(buf, index, UINT16_MAX);
+    g_free(index);
+
+    if (edt->tree != NULL) {
+        frame_buf_put_children(buf, ctx->json_scope, edt->tree, -1, &count);
+        wmem_free_all(ctx->json_scope);
+    }
+    memcpy(buf->data + sizeof(magic), &count, sizeof(count));
+}
+
+// --- Field Projection ---
+
+/**
+ * Restrict the frames ctx emits to the given fields. Frames are then dissected
+ * with an invisible tree primed with just those fields and emitted as flat
+ * records. frame.number is always included, it orders the records.
+ *
+ *  @param fields comma-separated field names, NULL or empty for full trees;
+ *  unknown names are skipped
+ */
+void capture_ctx_set_fields(capture_ctx *ctx, const char *fields) {
+    if (ctx->fields != NULL) {
+        g_ptr_array_free(ctx->fields, TRUE);
+        ctx->fields = NULL;
+    }
+    if (fields == NULL || strlen(fields) == 0) {
+        return;
+    }
+
+    ctx->fields = g_ptr_array_new();
+    header_field_info *number = proto_registrar_get_byname("frame.number");
+    if (number != NULL) {
+        g_ptr_array_add(ctx->fields, number);
+    }
+
+    gchar **names = g_strsplit(fields, ",", -1);
+    for (gchar **name = names; *name != NULL; name++) {
+        header_field_info *hfinfo = proto_registrar_get_byname(g_strstrip(*name));
+        if (hfinfo != NULL && !g_ptr_array_find(ctx->fields, hfinfo, NULL)) {
+            g_ptr_array_add(ctx->fields, hfinfo);
+        }
+    }
+    g_strfreev(names);
+}
+
+/**
+ * Check that name is a registered field or protocol, like "ip.src".
+ */
+bool validate_field(const char *name) {
+    return name != NULL && proto_registrar_get_byname(name) != NULL;
+}
+
+/**
+ * Returns the dissection context for frames that are emitted: the full tree,
+ * or with field projection an invisible tree primed with the selected fields.
+ * Fields registered under one name by several dissectors are all primed.
+ */
+static epan_dissect_t *capture_ctx_frame_edt(capture_ctx *ctx) {
+    if (ctx->fields == NULL) {
+        return &ctx->edt;
+    }
+
+    epan_dissect_t *edt = &ctx->edt_fields;
+    for (guint i = 0; i < ctx->fields->len; i++) {
+        header_field_info *hfinfo = g_ptr_array_index(ctx->fields, i);
+        for (; hfinfo != NULL; hfinfo = hfinfo->same_name_next) {
+            epan_dissect_prime_with_hfid(edt, hfinfo->id);
+        }
+    }
+    return edt;
+}
+
+static void write_json_field_value(json_dumper *dumper, field_info *fi, bool typed_values) {
+    char label_str[ITEM_LABEL_LENGTH];
+    char *repr = NULL;
+
+    if (typed_values && write_json_typed_value(dumper, fi)) {
+        return;
+    }
+
+    if (fi->value != NULL) {
+        repr = fvalue_to_string_repr(NULL, fi->value, FTREPR_JSON, fi->hfinfo->display);
+    }
+    if (repr != NULL) {
+        json_dumper_value_string(dumper, repr);
+        wmem_free(NULL, repr);
+        return;
+    }
+
+    // Fields without a value (protocols, text items) are represented by their label.
+    proto_item_fill_label(fi, label_str, NULL);
+    char *value_ptr = strstr(label_str, ": ");
+    json_dumper_value_string(dumper, value_ptr != NULL ? value_ptr + 2 : label_str);
+}
+
+/**
+ * Render the selected fields of a frame as a flat record:
+ * {"_index": ..., "fields": {"ip.src": "10.0.0.1", "tcp.port": ["80", "5000"]}}.
+ * Fields absent from the frame are left out; repeated ones become arrays.
+ */
+static void emit_frame_fields(capture_ctx *ctx, epan_dissect_t *edt, int printCJson,
+                              FrameCallback callback) {
+    json_dumper dumper = {};
+    GPtrArray *values = g_ptr_array_new();
+
+    g_string_truncate(ctx->json_buf, 0);
+    dumper.output_string = ctx->json_buf;
+    json_dumper_begin_object(&dumper);
+    write_json_index(&dumper, edt);
+    json_dumper_set_member_name(&dumper, "fields");
+    json_dumper_begin_object(&dumper);
+
+    for (guint i = 0; i < ctx->fields->len; i++) {
+        header_field_info *first = g_ptr_array_index(ctx->fields, i);
+
+        g_ptr_array_set_size(values, 0);
+        for (header_field_info *hfinfo = first; hfinfo != NULL;
+             hfinfo = hfinfo->same_name_next) {
+            GPtrArray *finfos = proto_get_finfo_ptr_array(edt->tree, hfinfo->id);
+            for (guint j = 0; finfos != NULL && j < finfos->len; j++) {
+                g_ptr_array_add(values, g_ptr_array_index(finfos, j));
+            }
+        }
+        if (values->len == 0) {
+            continue;
+        }
+
+        json_dumper_set_member_name(&dumper, first->abbrev);
+        if (values->len == 1) {
+            write_json_field_value(&dumper, g_ptr_array_index(values, 0), ctx->typed_values);
+            continue;
+        }
+        json_dumper_begin_array(&dumper);
+        for (guint j = 0; j < values->len; j++) {
+            write_json_field_value(&dumper, g_ptr_array_index(values, j), ctx->typed_values);
+        }
+        json_dumper_end_array(&dumper);
+    }
+
+    json_dumper_end_object(&dumper);
+    json_dumper_end_object(&dumper);
+
+    if (json_dumper_finish(&dumper)) {
+        if (printCJson) printf("%s\n", dumper.output_string->str);
+        capture_ctx_deliver(ctx, dumper.output_string->str, dumper.output_string->len,
+                            callback);
+    }
+
+    json_buf_fit(ctx);
+    g_ptr_array_free(values, TRUE);
+}
+
+// --- Optimized Callbacks (Single Pass I/O) ---
+
+/**
+ * Render the proto tree of a dissected frame, as JSON or as a binary node
+ * array if ctx->binary_frames is set, and hand it to callback. With field
+ * projection the frame is emitted as a flat record instead.
+ */
+static void emit_frame(capture_ctx *ctx, epan_dissect_t *edt, int printCJson,
+                       FrameCallback callback) {
+    if (ctx->fields != NULL) {
+        emit_frame_fields(ctx, edt, printCJson, callback);
+        return;
+    }
+    if (ctx->binary_frames) {
+        encode_frame_binary(ctx, edt);
+        capture_ctx_deliver(ctx, (char *)ctx->frame_buf->data, ctx->frame_buf->len, callback);
+        return;
+    }
+
+    if (render_frame_json(ctx, edt)) {
+        if (printCJson) printf("%s\n", ctx->json_buf->str);
+        capture_ctx_deliver(ctx, ctx->json_buf->str, ctx->json_buf->len, callback);
+    }
+
+    json_buf_fit(ctx);
+}
+
+void get_all_frames_cb(capture_ctx *ctx, int printCJson, char *filter_str, FrameCallback callback) {
+    epan_dissect_t *edt;
+    ctx->cf.count = 0;
+    int err = 0;
+    gchar *err_info = NULL;
+    int64_t data_offset = 0;
+    guint32 cum_bytes = 0;
+    wtap_rec *rec = &ctx->rec;
+
+    dfilter_t *dfcode = NULL;
+    if (filter_str != NULL && strlen(filter_str) > 0) {
+        if (!dfilter_compile(filter_str, &dfcode, NULL)) {
+            fprintf(stderr, "Filter compile failed: %s\n", filter_str);
+        }
+    }
+
+    while (!ctx->stop_requested &&
+           wtap_read(ctx->cf.provider.wth, rec, &err, &err_info, &data_offset)) {
+        ctx->cf.count++;
+        frame_data fd;
+        frame_data_init(&fd, ctx->cf.count, rec, data_offset, 0);
+
+        edt = capture_ctx_frame_edt(ctx);
+
+        if (dfcode != NULL) {
+            epan_dissect_prime_with_dfilter(edt, dfcode);
+        }
+
+        frame_data_set_before_dissect(&fd, &ctx->cf.elapsed_time, &ctx->cf.provider.ref,
+                                      ctx->cf.provider.prev_dis);
+        ctx->cf.provider.ref = &fd;
+
+        epan_dissect_run_with_taps(edt, ctx->cf.cd_t, rec, &fd, &ctx->cf.cinfo);
+
+        frame_data_set_after_dissect(&fd, &cum_bytes);
+        ctx->cf.provider.prev_cap = ctx->cf.provider.prev_dis =
+            frame_data_sequence_add(ctx->cf.provider.frames, &fd);
+
+        if (dfcode != NULL) {
+            if (!dfilter_apply_edt(dfcode, edt)) {
+                epan_dissect_reset(edt);
+                wtap_rec_reset(rec);
+                continue;
+            }
+        }
+
+        emit_frame(ctx, edt, printCJson, callback);
+        epan_dissect_reset(edt);
+        wtap_rec_reset(rec);
+    }
+
+    if (dfcode != NULL) dfilter_free(dfcode);
+
+    capture_ctx_flush_frames(ctx);
+}
+
+void get_frames_by_idxs_cb(capture_ctx *ctx, int *idxs, int idx_count, int printCJson,
+                           FrameCallback callback) {
+    if (idx_count <= 0) {
+        return;
+    }
+
+    epan_dissect_t *edt;
+    ctx->cf.count = 0;
+    int err = 0;
     gchar *err_info = NULL;
     int64_t data_offset = 0;
-    wtap_rec rec;
-    wtap_rec_init(&rec, 1514);
+    wtap_rec *rec = &ctx->rec;
     int current_idx_ptr = 0;
 
-    while (wtap_read(cf.provider.wth, &rec, &err, &err_info, &data_offset)) {
-        cf.count++;
+    while (!ctx->stop_requested &&
+           wtap_read(ctx->cf.provider.wth, rec, &err, &err_info, &data_offset)) {
+        ctx->cf.count++;
 
         // Fast-forward idx pointer if current frame > target (shouldn't happen if
         // sorted, but safe)
-        while (current_idx_ptr < idx_count && cf.count > idxs[current_idx_ptr]) {
+        while (current_idx_ptr < idx_count && ctx->cf.count > idxs[current_idx_ptr]) {
             current_idx_ptr++;
         }
 
         // All targets processed
         if (current_idx_ptr >= idx_count) {
-            wtap_rec_reset(&rec);
+            wtap_rec_reset(rec);
             break;
         }
 
         // Match found
-        if (cf.count == idxs[current_idx_ptr]) {
+        if (ctx->cf.count == idxs[current_idx_ptr]) {
             frame_data fd;
-            frame_data_init(&fd, cf.count, &rec, data_offset, 0);
-
-            edt = epan_dissect_new(cf.epan, TRUE, TRUE);
-            epan_dissect_run_with_taps(edt, cf.cd_t, &rec, &fd, &cf.cinfo);
-
-            json_dumper dumper = {};
-            dumper.output_string = g_string_new(NULL);
-            get_json_proto_tree(NULL, print_dissections_expanded, FALSE, NULL, PF_INCLUDE_CHILDREN,
-                                edt, &cf.cinfo, proto_node_group_children_by_unique, &dumper);
+            frame_data_init(&fd, ctx->cf.count, rec, data_offset, 0);
 
-            if (json_dumper_finish(&dumper)) {
-                if (printCJson) printf("%s\n", dumper.output_string->str);
-                callback(dumper.output_string->str, dumper.output_string->len, 0);
-            }
+            edt = capture_ctx_frame_edt(ctx);
+            epan_dissect_run_with_taps(edt, ctx->cf.cd_t, rec, &fd, &ctx->cf.cinfo);
 
-            if (dumper.output_string) g_string_free(dumper.output_string, TRUE);
-            epan_dissect_free(edt);
+            emit_frame(ctx, edt, printCJson, callback);
+            epan_dissect_reset(edt);
 
             // Move to next target. Note: Handles duplicates in idxs implicitly.
             current_idx_ptr++;
         }
-        wtap_rec_reset(&rec);
+        wtap_rec_reset(rec);
+    }
+
+    capture_ctx_flush_frames(ctx);
+}
+
+// --- Indexed Random Access (wtap_seek_read) ---
+
+typedef struct {
+    capture_ctx *ctx;
+    const frame_index *idx;
+    frame_data ref;     // header-only stub of frame 1 (frame.time_relative)
+    frame_data prev;    // last dissected frame or a stub of the one before the target
+    uint32_t last_num;  // last frame run through the epan session, 0 if none
+    guint32 cum_bytes;
+} indexed_reader;
+
+/**
+ * Fill a header-only frame_data from an index entry, so timestamp lookups of
+ * the reference and previous frame resolve without a sequential pass.
+ */
+static void frame_data_from_index(const frame_index *idx, uint32_t num, frame_data *fd) {
+    const frame_index_entry *entry = frame_index_get(idx, num);
+
+    memset(fd, 0, sizeof(*fd));
+    fd->num = num;
+    if (entry != NULL) {
+        fd->file_off = entry->offset;
+        if (entry->flags & FRAME_INDEX_HAS_TS) {
+            fd->abs_ts.secs = (time_t)entry->secs;
+            fd->abs_ts.nsecs = entry->nsecs;
+            fd->has_ts = TRUE;
+        }
+    }
+}
+
+static void indexed_reader_init(indexed_reader *r, capture_ctx *ctx, const frame_index *idx) {
+    memset(r, 0, sizeof(*r));
+    r->ctx = ctx;
+    r->idx = idx;
+    frame_data_from_index(idx, 1, &r->ref);
+}
+
+static void indexed_reader_cleanup(indexed_reader *r) {
+    frame_data_destroy(&r->prev);
+    r->ctx->cf.provider.ref = NULL;
+    r->ctx->cf.provider.prev_dis = NULL;
+    r->ctx->cf.provider.prev_cap = NULL;
+}
+
+/**
+ * Seek to frame num and run it through the dissectors.
+ *
+ *  @return true if the frame was read and dissected
+ */
+static bool indexed_reader_dissect(indexed_reader *r, uint32_t num, epan_dissect_t *edt) {
+    const frame_index_entry *entry = frame_index_get(r->idx, num);
+    int err = 0;
+    gchar *err_info = NULL;
+    frame_data fd;
+
+    if (entry == NULL) {
+        return false;
+    }
+
+    wtap_rec *rec = &r->ctx->rec;
+    wtap_rec_reset(rec);
+    if (!wtap_seek_read(r->ctx->cf.provider.wth, entry->offset, rec, &err, &err_info)) {
+        g_free(err_info);
+        return false;
+    }
+
+    // Frames are not sequential here, so point prev at the real predecessor
+    // (or its stub) instead of whatever was dissected last.
+    if (r->prev.num + 1 != num) {
+        frame_data_destroy(&r->prev);
+        frame_data_from_index(r->idx, num - 1, &r->prev);
     }
-    close_cf();
-    wtap_rec_cleanup(&rec);
+    r->ctx->cf.provider.ref = &r->ref;
+    r->ctx->cf.provider.prev_dis = &r->prev;
+    r->ctx->cf.provider.prev_cap = &r->prev;
+
+    frame_data_init(&fd, num, rec, entry->offset, r->cum_bytes);
+    frame_data_set_before_dissect(&fd, &r->ctx->cf.elapsed_time, &r->ctx->cf.provider.ref,
+                                  r->ctx->cf.provider.prev_dis);
+    epan_dissect_run_with_taps(edt, r->ctx->cf.cd_t, rec, &fd, &r->ctx->cf.cinfo);
+    frame_data_set_after_dissect(&fd, &r->cum_bytes);
+
+    frame_data_destroy(&r->prev);
+    r->prev = fd;
+    r->last_num = num;
+
+    return true;
+}
+
+/**
+ * Dissect a target frame through the index. The context_frames frames before
+ * it are dissected first, without a tree, so reassembly-dependent layers see
+ * the state a sequential pass would have built. Frames already run through
+ * this epan session are not dissected twice.
+ *
+ *  @param dfcode display filter to prime the target's tree with, may be NULL
+ *  @return edt of the target frame (caller resets), NULL if num is not readable
+ */
+static epan_dissect_t *indexed_reader_dissect_target(indexed_reader *r, uint32_t num,
+                                                     int context_frames, dfilter_t *dfcode) {
+    uint32_t start = 1;
+
+    if (frame_index_get(r->idx, num) == NULL) {
+        return NULL;
+    }
+
+    if (context_frames > 0 && num > (uint32_t)context_frames) {
+        start = num - (uint32_t)context_frames;
+    } else if (context_frames <= 0) {
+        start = num;
+    }
+    if (r->last_num >= start && r->last_num < num) {
+        start = r->last_num + 1;
+    }
+
+    for (uint32_t n = start; n < num; n++) {
+        indexed_reader_dissect(r, n, &r->ctx->edt_bare);
+        epan_dissect_reset(&r->ctx->edt_bare);
+    }
+
+    epan_dissect_t *edt = capture_ctx_frame_edt(r->ctx);
+    if (dfcode != NULL) {
+        epan_dissect_prime_with_dfilter(edt, dfcode);
+    }
+    if (!indexed_reader_dissect(r, num, edt)) {
+        epan_dissect_reset(edt);
+        return NULL;
+    }
+
+    return edt;
+}
+
+/**
+ * Dissect specific frames by seeking straight to their offsets.
+ *
+ *  @param idx frame-offset index of the open capture
+ *  @param idxs sorted, de-duplicated frame numbers
+ *  @param context_frames frames to dissect before each target
+ */
+void get_frames_by_idxs_indexed_cb(capture_ctx *ctx, frame_index *idx, int *idxs, int idx_count,
+                                   int context_frames, int printCJson, FrameCallback callback) {
+    indexed_reader reader;
+
+    indexed_reader_init(&reader, ctx, idx);
+
+    for (int i = 0; i < idx_count && !ctx->stop_requested; i++) {
+        if (idxs[i] <= 0) {
+            continue;
+        }
+
+        epan_dissect_t *edt =
+            indexed_reader_dissect_target(&reader, (uint32_t)idxs[i], context_frames, NULL);
+        if (edt == NULL) {
+            continue;
+        }
+
+        emit_frame(ctx, edt, printCJson, callback);
+        epan_dissect_reset(edt);
+    }
+
+    indexed_reader_cleanup(&reader);
+
+    capture_ctx_flush_frames(ctx);
+}
+
+/**
+ * Dissect frames start..end as one shard of a sharded pass over a capture.
+ * The warmup frames before start are dissected first, without a tree, so
+ * reassembly state converges before the first frame of the shard is emitted.
+ *
+ *  @param idx frame-offset index of the open capture
+ *  @param start first frame of the shard
+ *  @param end last frame of the shard, clamped to the last frame of the capture
+ *  @param warmup frames to dissect before start
+ *  @param filter_str display filter, may be empty
+ */
+void get_frames_by_shard_indexed_cb(capture_ctx *ctx, frame_index *idx, int start, int end,
+                                    int warmup, int printCJson, const char *filter_str,
+                                    FrameCallback callback) {
+    indexed_reader reader;
+    dfilter_t *dfcode = NULL;
+
+    if (start <= 0 || end < start) {
+        return;
+    }
+    if ((uint32_t)end > idx->count) {
+        end = (int)idx->count;
+    }
+
+    if (filter_str != NULL && strlen(filter_str) > 0) {
+        if (!dfilter_compile(filter_str, &dfcode, NULL)) {
+            fprintf(stderr, "Filter compile failed: %s\n", filter_str);
+        }
+    }
+
+    indexed_reader_init(&reader, ctx, idx);
+
+    for (int num = start; num <= end && !ctx->stop_requested; num++) {
+        // Warm-up frames are only dissected for the first frame; the following
+        // ones continue from the previous frame.
+        epan_dissect_t *edt =
+            indexed_reader_dissect_target(&reader, (uint32_t)num, warmup, dfcode);
+        if (edt == NULL) {
+            continue;
+        }
+
+        if (dfcode == NULL || dfilter_apply_edt(dfcode, edt)) {
+            emit_frame(ctx, edt, printCJson, callback);
+        }
+        epan_dissect_reset(edt);
+    }
+
+    indexed_reader_cleanup(&reader);
+
+    if (dfcode != NULL) dfilter_free(dfcode);
+
+    capture_ctx_flush_frames(ctx);
+}
+
+/**
+ * Get hex data of a specific frame by seeking straight to its offset.
+ *
+ *  @return hex data JSON, empty string if the frame does not exist
+ */
+char *get_specific_frame_hex_data_indexed(capture_ctx *ctx, frame_index *idx, int num,
+                                          int context_frames) {
+    indexed_reader reader;
+    char *res = NULL;
+
+    indexed_reader_init(&reader, ctx, idx);
+
+    if (num > 0) {
+        epan_dissect_t *edt =
+            indexed_reader_dissect_target(&reader, (uint32_t)num, context_frames, NULL);
+        if (edt != NULL) {
+            res = hex_data_to_json(edt);
+            epan_dissect_reset(edt);
+        }
+    }
+
+    indexed_reader_cleanup(&reader);
+
+    return res ? res : strdup("");
 }
 
 /**
@@ -802,14 +1725,14 @@ char *validate_filter(const char *filter_str) {
     return NULL;
 }
 
-void get_frames_by_range(int start, int limit, int printCJson, const char *filter_str, FrameCallback callback) {
-    cf.count = 0;
+void get_frames_by_range(capture_ctx *ctx, int start, int limit, int printCJson,
+                         const char *filter_str, FrameCallback callback) {
+    ctx->cf.count = 0;
     int err = 0;
     gchar *err_info = NULL;
     int64_t data_offset = 0;
     guint32 cum_bytes = 0;
-    wtap_rec rec;
-    wtap_rec_init(&rec, 1514);
+    wtap_rec *rec = &ctx->rec;
     epan_dissect_t *edt = NULL;
 
     dfilter_t *dfcode = NULL;
@@ -822,30 +1745,33 @@ void get_frames_by_range(int start, int limit, int printCJson, const char *filte
     int matched_count = 0;
     int end = start + limit;
 
-    while (wtap_read(cf.provider.wth, &rec, &err, &err_info, &data_offset)) {
-        cf.count++;
+    while (!ctx->stop_requested &&
+           wtap_read(ctx->cf.provider.wth, rec, &err, &err_info, &data_offset)) {
+        ctx->cf.count++;
 
         frame_data fd;
-        frame_data_init(&fd, cf.count, &rec, data_offset, 0);
+        frame_data_init(&fd, ctx->cf.count, rec, data_offset, 0);
 
-        edt = epan_dissect_new(cf.epan, TRUE, TRUE);
+        edt = capture_ctx_frame_edt(ctx);
 
         if (dfcode != NULL) {
             epan_dissect_prime_with_dfilter(edt, dfcode);
         }
 
-        frame_data_set_before_dissect(&fd, &cf.elapsed_time, &cf.provider.ref, cf.provider.prev_dis);
-        cf.provider.ref = &fd;
+        frame_data_set_before_dissect(&fd, &ctx->cf.elapsed_time, &ctx->cf.provider.ref,
+                                      ctx->cf.provider.prev_dis);
+        ctx->cf.provider.ref = &fd;
 
-        epan_dissect_run_with_taps(edt, cf.cd_t, &rec, &fd, &cf.cinfo);
+        epan_dissect_run_with_taps(edt, ctx->cf.cd_t, rec, &fd, &ctx->cf.cinfo);
 
         frame_data_set_after_dissect(&fd, &cum_bytes);
-        cf.provider.prev_cap = cf.provider.prev_dis = frame_data_sequence_add(cf.provider.frames, &fd);
+        ctx->cf.provider.prev_cap = ctx->cf.provider.prev_dis =
+            frame_data_sequence_add(ctx->cf.provider.frames, &fd);
 
         if (dfcode != NULL) {
             if (!dfilter_apply_edt(dfcode, edt)) {
-                epan_dissect_free(edt);
-                wtap_rec_reset(&rec);
+                epan_dissect_reset(edt);
+                wtap_rec_reset(rec);
                 continue;
             }
         }
@@ -853,46 +1779,132 @@ void get_frames_by_range(int start, int limit, int printCJson, const char *filte
         matched_count++;
 
         if (matched_count < start) {
-            epan_dissect_free(edt);
-            wtap_rec_reset(&rec);
+            epan_dissect_reset(edt);
+            wtap_rec_reset(rec);
             continue;
         }
 
         if (matched_count >= end) {
-            epan_dissect_free(edt);
-            wtap_rec_reset(&rec);
+            epan_dissect_reset(edt);
+            wtap_rec_reset(rec);
             break;
         }
 
-        json_dumper dumper = {};
-        dumper.output_string = g_string_new(NULL);
-        get_json_proto_tree(NULL, print_dissections_expanded, FALSE, NULL, PF_INCLUDE_CHILDREN, edt,
-                            &cf.cinfo, proto_node_group_children_by_unique, &dumper);
+        emit_frame(ctx, edt, printCJson, callback);
+        epan_dissect_reset(edt);
+        wtap_rec_reset(rec);
+    }
+
+    if (dfcode != NULL) dfilter_free(dfcode);
+
+    capture_ctx_flush_frames(ctx);
+}
+
+/**
+ * Append a length-prefixed address to a raw payload record.
+ */
+static void payload_record_put_addr(GByteArray *buf, const address *addr) {
+    char str[WS_INET6_ADDRSTRLEN] = {0};
+    address_to_str_buf(addr, str, sizeof(str));
+    guint8 len = (guint8)MIN(strlen(str), UINT8_MAX);
+    frame_buf_put(buf, &len, sizeof(len));
+    frame_buf_put(buf, str, len);
+}
+
+/**
+ * Append the bytes of every payload field to a raw payload record, straight
+ * from the tvb.
+ */
+static void payload_record_put_bytes(GByteArray *buf, GPtrArray *finfo_array) {
+    if (finfo_array == NULL) {
+        return;
+    }
+    for (guint i = 0; i < finfo_array->len; i++) {
+        field_info *fi = (field_info *)g_ptr_array_index(finfo_array, i);
+        if (fi->ds_tvb != NULL && fi->length > 0) {
+            frame_buf_put(buf, tvb_get_ptr(fi->ds_tvb, fi->start, fi->length), fi->length);
+        }
+    }
+}
+
+/**
+ * Send the src/dst and payload of a dissected frame as a tiny JSON record with
+ * the payload in hex, or as a raw record (PAYLOAD_RECORD_MAGIC) if
+ * ctx->raw_payloads is set. Frames without payload are skipped.
+ */
+static void emit_stream_payload(capture_ctx *ctx, epan_dissect_t *edt, int payload_id,
+                                FrameCallback callback) {
+    if (payload_id == -1) {
+        return;
+    }
+    GPtrArray *finfo_array = proto_get_finfo_ptr_array(edt->tree, payload_id);
+    if (finfo_array == NULL) {
+        return;
+    }
 
-        if (json_dumper_finish(&dumper)) {
-            if (printCJson) printf("%s\n", dumper.output_string->str);
-            callback(dumper.output_string->str, dumper.output_string->len, 0);
+    gsize payload_len = 0;
+    for (guint i = 0; i < finfo_array->len; i++) {
+        field_info *fi = (field_info *)g_ptr_array_index(finfo_array, i);
+        if (fi->ds_tvb != NULL && fi->length > 0) {
+            payload_len += fi->length;
         }
+    }
+    if (payload_len == 0) {
+        return;
+    }
 
-        if (dumper.output_string) g_string_free(dumper.output_string, TRUE);
-        epan_dissect_free(edt);
-        wtap_rec_reset(&rec);
+    if (ctx->raw_payloads) {
+        GByteArray *buf = ctx->frame_buf;
+        uint32_t magic = PAYLOAD_RECORD_MAGIC;
+        uint32_t num = edt->pi.num;
+        uint16_t srcport = (uint16_t)edt->pi.srcport;
+        uint16_t destport = (uint16_t)edt->pi.destport;
+
+        g_byte_array_set_size(buf, 0);
+        frame_buf_put(buf, &magic, sizeof(magic));
+        frame_buf_put(buf, &num, sizeof(num));
+        frame_buf_put(buf, &srcport, sizeof(srcport));
+        frame_buf_put(buf, &destport, sizeof(destport));
+        payload_record_put_addr(buf, &edt->pi.src);
+        payload_record_put_addr(buf, &edt->pi.dst);
+        payload_record_put_bytes(buf, finfo_array);
+
+        capture_ctx_deliver(ctx, (char *)buf->data, buf->len, callback);
+        return;
     }
 
-    if (dfcode != NULL) dfilter_free(dfcode);
-    close_cf();
-    wtap_rec_cleanup(&rec);
+    char src_ip[WS_INET6_ADDRSTRLEN] = {0};
+    char dst_ip[WS_INET6_ADDRSTRLEN] = {0};
+    address_to_str_buf(&edt->pi.src, src_ip, sizeof(src_ip));
+    address_to_str_buf(&edt->pi.dst, dst_ip, sizeof(dst_ip));
+
+    // The payload bytes are hex-encoded straight into the record.
+    GString *json = g_string_sized_new(2 * payload_len + 128);
+    g_string_printf(json,
+                    "{\"src\":\"%s\",\"dst\":\"%s\",\"srcport\":%u,\"dstport\":%u,"
+                    "\"payload\":\"",
+                    src_ip, dst_ip, edt->pi.srcport, edt->pi.destport);
+    for (guint i = 0; i < finfo_array->len; i++) {
+        field_info *fi = (field_info *)g_ptr_array_index(finfo_array, i);
+        if (fi->ds_tvb != NULL && fi->length > 0) {
+            encode_hex_append(json, tvb_get_ptr(fi->ds_tvb, fi->start, fi->length), fi->length);
+        }
+    }
+    g_string_append(json, "\"}");
+
+    capture_ctx_deliver(ctx, json->str, json->len, callback);
+    g_string_free(json, TRUE);
 }
 
-void get_stream_payloads_cb(const char *filter_str, const char *proto, FrameCallback callback) {
+void get_stream_payloads_cb(capture_ctx *ctx, const char *filter_str, const char *proto,
+                            FrameCallback callback) {
     epan_dissect_t *edt;
-    cf.count = 0;
+    ctx->cf.count = 0;
     int err = 0;
     gchar *err_info = NULL;
     int64_t data_offset = 0;
     guint32 cum_bytes = 0;
-    wtap_rec rec;
-    wtap_rec_init(&rec, 1514);
+    wtap_rec *rec = &ctx->rec;
 
     dfilter_t *dfcode = NULL;
     df_error_t *df_err = NULL;
@@ -905,94 +1917,398 @@ void get_stream_payloads_cb(const char *filter_str, const char *proto, FrameCall
     int payload_id = proto_registrar_get_id_byname(strcmp(proto, "tcp") == 0 ? "tcp.payload" : "udp.payload");
     int matched_packets = 0;
 
-    while (wtap_read(cf.provider.wth, &rec, &err, &err_info, &data_offset)) {
-        cf.count++;
+    while (!ctx->stop_requested &&
+           wtap_read(ctx->cf.provider.wth, rec, &err, &err_info, &data_offset)) {
+        ctx->cf.count++;
         frame_data fd;
-        frame_data_init(&fd, cf.count, &rec, data_offset, 0);
+        frame_data_init(&fd, ctx->cf.count, rec, data_offset, 0);
 
-        edt = epan_dissect_new(cf.epan, TRUE, TRUE);
+        // Only the filter and payload fields are read: an invisible tree keeps just those.
+        edt = &ctx->edt_fields;
 
         if (dfcode != NULL) epan_dissect_prime_with_dfilter(edt, dfcode);
         if (payload_id != -1) epan_dissect_prime_with_hfid(edt, payload_id);
 
-        frame_data_set_before_dissect(&fd, &cf.elapsed_time, &cf.provider.ref, cf.provider.prev_dis);
-        cf.provider.ref = &fd;
+        frame_data_set_before_dissect(&fd, &ctx->cf.elapsed_time, &ctx->cf.provider.ref,
+                                      ctx->cf.provider.prev_dis);
+        ctx->cf.provider.ref = &fd;
 
-        epan_dissect_run_with_taps(edt, cf.cd_t, &rec, &fd, &cf.cinfo);
+        epan_dissect_run_with_taps(edt, ctx->cf.cd_t, rec, &fd, &ctx->cf.cinfo);
 
         frame_data_set_after_dissect(&fd, &cum_bytes);
-        cf.provider.prev_cap = cf.provider.prev_dis = frame_data_sequence_add(cf.provider.frames, &fd);
+        ctx->cf.provider.prev_cap = ctx->cf.provider.prev_dis =
+            frame_data_sequence_add(ctx->cf.provider.frames, &fd);
 
         if (dfcode != NULL) {
             if (!dfilter_apply_edt(dfcode, edt)) {
-                epan_dissect_free(edt);
-                wtap_rec_reset(&rec);
+                epan_dissect_reset(edt);
+                wtap_rec_reset(rec);
                 continue;
             }
         }
 
         matched_packets++;
+        emit_stream_payload(ctx, edt, payload_id, callback);
 
-        char src_ip[WS_INET6_ADDRSTRLEN] = {0};
-        char dst_ip[WS_INET6_ADDRSTRLEN] = {0};
-        address_to_str_buf(&edt->pi.src, src_ip, sizeof(src_ip));
-        address_to_str_buf(&edt->pi.dst, dst_ip, sizeof(dst_ip));
-        guint32 src_port = edt->pi.srcport;
-        guint32 dst_port = edt->pi.destport;
-
-        char *payload_hex = NULL;
-        if (payload_id != -1) {
-            GPtrArray *finfo_array = proto_get_finfo_ptr_array(edt->tree, payload_id);
-            if (finfo_array && finfo_array->len > 0) {
-                GString *hex_builder = g_string_new("");
-
-                for (guint i = 0; i < finfo_array->len; i++) {
-                    field_info *fi = (field_info *)g_ptr_array_index(finfo_array, i);
-                    if (fi && fi->value) {
-
-                        char *raw_repr = fvalue_to_string_repr(NULL, fi->value, FTREPR_JSON, fi->hfinfo->display);
-                        if (raw_repr) {
-                            char *r = raw_repr;
-                            char *w = raw_repr;
-                            while (*r) {
-                                if (*r != ':') {
-                                    *w++ = *r;
-                                }
-                                r++;
-                            }
-                            *w = '\0';
-
-                            g_string_append(hex_builder, raw_repr);
-                            wmem_free(NULL, raw_repr);
-                        }
-                    }
-                }
-                payload_hex = g_string_free(hex_builder, FALSE);
-            }
+        epan_dissect_reset(edt);
+        wtap_rec_reset(rec);
+    }
+
+    char *summary_json = g_strdup_printf("{\"_summary\":true,\"matched_count\":%d}", matched_packets);
+    capture_ctx_deliver(ctx, summary_json, strlen(summary_json), callback);
+    g_free(summary_json);
+    capture_ctx_flush_frames(ctx);
+
+    if (dfcode != NULL) dfilter_free(dfcode);
+}
+
+/**
+ * Send a frame that belongs to a conversation as a stream record
+ * (STREAM_RECORD_MAGIC), with or without payload, so the reader sees the
+ * conversation from its first frame on.
+ */
+static void emit_stream_record(capture_ctx *ctx, epan_dissect_t *edt, int stream_id,
+                               int payload_id, FrameCallback callback) {
+    GPtrArray *stream_array = proto_get_finfo_ptr_array(edt->tree, stream_id);
+    if (stream_array == NULL || stream_array->len == 0) {
+        return;
+    }
+    // Tunnelled frames carry several; the innermost conversation wins.
+    field_info *stream_fi =
+        (field_info *)g_ptr_array_index(stream_array, stream_array->len - 1);
+
+    GByteArray *buf = ctx->frame_buf;
+    uint32_t magic = STREAM_RECORD_MAGIC;
+    uint32_t stream = fvalue_get_uinteger(stream_fi->value);
+    uint32_t num = edt->pi.num;
+    int64_t ts_sec = (int64_t)edt->pi.abs_ts.secs;
+    int32_t ts_nsec = (int32_t)edt->pi.abs_ts.nsecs;
+    uint16_t srcport = (uint16_t)edt->pi.srcport;
+    uint16_t destport = (uint16_t)edt->pi.destport;
+
+    g_byte_array_set_size(buf, 0);
+    frame_buf_put(buf, &magic, sizeof(magic));
+    frame_buf_put(buf, &stream, sizeof(stream));
+    frame_buf_put(buf, &num, sizeof(num));
+    frame_buf_put(buf, &ts_sec, sizeof(ts_sec));
+    frame_buf_put(buf, &ts_nsec, sizeof(ts_nsec));
+    frame_buf_put(buf, &srcport, sizeof(srcport));
+    frame_buf_put(buf, &destport, sizeof(destport));
+    payload_record_put_addr(buf, &edt->pi.src);
+    payload_record_put_addr(buf, &edt->pi.dst);
+    if (payload_id != -1) {
+        payload_record_put_bytes(buf, proto_get_finfo_ptr_array(edt->tree, payload_id));
+    }
+
+    capture_ctx_deliver(ctx, (char *)buf->data, buf->len, callback);
+}
+
+void get_all_stream_records(capture_ctx *ctx, const char *proto, FrameCallback callback) {
+    // Only the stream and payload fields are read: an invisible tree keeps just those.
+    epan_dissect_t *edt = &ctx->edt_fields;
+    ctx->cf.count = 0;
+    int err = 0;
+    gchar *err_info = NULL;
+    int64_t data_offset = 0;
+    guint32 cum_bytes = 0;
+    wtap_rec *rec = &ctx->rec;
+
+    bool udp = strcmp(proto, "udp") == 0;
+    int stream_id = proto_registrar_get_id_byname(udp ? "udp.stream" : "tcp.stream");
+    int payload_id = proto_registrar_get_id_byname(udp ? "udp.payload" : "tcp.payload");
+    if (stream_id == -1) {
+        return;
+    }
+
+    while (!ctx->stop_requested &&
+           wtap_read(ctx->cf.provider.wth, rec, &err, &err_info, &data_offset)) {
+        ctx->cf.count++;
+        frame_data fd;
+        frame_data_init(&fd, ctx->cf.count, rec, data_offset, 0);
+
+        epan_dissect_prime_with_hfid(edt, stream_id);
+        if (payload_id != -1) epan_dissect_prime_with_hfid(edt, payload_id);
+
+        frame_data_set_before_dissect(&fd, &ctx->cf.elapsed_time, &ctx->cf.provider.ref,
+                                      ctx->cf.provider.prev_dis);
+        ctx->cf.provider.ref = &fd;
+
+        epan_dissect_run_with_taps(edt, ctx->cf.cd_t, rec, &fd, &ctx->cf.cinfo);
+
+        frame_data_set_after_dissect(&fd, &cum_bytes);
+        ctx->cf.provider.prev_cap = ctx->cf.provider.prev_dis =
+            frame_data_sequence_add(ctx->cf.provider.frames, &fd);
+
+        emit_stream_record(ctx, edt, stream_id, payload_id, callback);
+
+        epan_dissect_reset(edt);
+        wtap_rec_reset(rec);
+    }
+
+    capture_ctx_flush_frames(ctx);
+}
+
+// --- Capture Sessions (long-lived capture_ctx) ---
+
+/**
+ * Run the next unvisited frame through the first pass. Frames already in the
+ * frame_data sequence (from an earlier epan session) are re-read by offset,
+ * new ones are read sequentially and appended.
+ *
+ *  @return false at end of file
+ */
+static bool capture_ctx_first_pass(capture_ctx *ctx, epan_dissect_t *edt) {
+    uint32_t num = ctx->visited + 1;
+    int err = 0;
+    gchar *err_info = NULL;
+    int64_t data_offset = 0;
+    frame_data *fd;
+
+    wtap_rec_reset(&ctx->rec);
+    if (num <= ctx->cf.count) {
+        fd = frame_data_sequence_find(ctx->cf.provider.frames, num);
+        if (!wtap_seek_read(ctx->cf.provider.wth, fd->file_off, &ctx->rec, &err, &err_info)) {
+            g_free(err_info);
+            return false;
         }
+    } else {
+        frame_data fdlocal;
 
-        if (payload_hex != NULL && strlen(payload_hex) > 0) {
-            char *tiny_json = g_strdup_printf(
-                "{\"src\":\"%s\",\"dst\":\"%s\",\"srcport\":%u,\"dstport\":%u,\"payload\":\"%s\"}",
-                src_ip, dst_ip, src_port, dst_port, payload_hex
-            );
-            callback(tiny_json, strlen(tiny_json), 0);
-            g_free(tiny_json);
+        if (ctx->eof ||
+            !wtap_read(ctx->cf.provider.wth, &ctx->rec, &err, &err_info, &data_offset)) {
+            g_free(err_info);
+            ctx->eof = true;
+            return false;
         }
+        frame_data_init(&fdlocal, num, &ctx->rec, data_offset, ctx->cum_bytes);
+        fd = frame_data_sequence_add(ctx->cf.provider.frames, &fdlocal);
+        ctx->cf.count = num;
+    }
+
+    frame_data_set_before_dissect(fd, &ctx->cf.elapsed_time, &ctx->cf.provider.ref,
+                                  ctx->cf.provider.prev_dis);
+    epan_dissect_run_with_taps(edt, ctx->cf.cd_t, &ctx->rec, fd, &ctx->cf.cinfo);
+    frame_data_set_after_dissect(fd, &ctx->cum_bytes);
 
-        if (payload_hex != NULL) {
-            g_free(payload_hex);
+    ctx->cf.provider.prev_cap = ctx->cf.provider.prev_dis = fd;
+    ctx->visited = num;
+
+    return true;
+}
+
+/**
+ * Run the first pass (without a tree) up to and including frame num.
+ *
+ *  @return false if the file has fewer frames
+ */
+static bool capture_ctx_advance(capture_ctx *ctx, uint32_t num) {
+    while (ctx->visited < num) {
+        bool ok = capture_ctx_first_pass(ctx, &ctx->edt_bare);
+        epan_dissect_reset(&ctx->edt_bare);
+        if (!ok) {
+            return false;
         }
+    }
+    return true;
+}
+
+/**
+ * Dissect frame num into edt. Visited frames are re-read by offset and
+ * dissected again with the state the first pass built up; unvisited frames
+ * go through the first pass.
+ *
+ *  @return false if the frame does not exist
+ */
+static bool capture_ctx_dissect_frame(capture_ctx *ctx, uint32_t num, epan_dissect_t *edt) {
+    int err = 0;
+    gchar *err_info = NULL;
 
-        epan_dissect_free(edt);
-        wtap_rec_reset(&rec);
+    if (num == 0 || !capture_ctx_advance(ctx, num - 1)) {
+        return false;
+    }
+    if (num > ctx->visited) {
+        return capture_ctx_first_pass(ctx, edt);
     }
 
-    char *summary_json = g_strdup_printf("{\"_summary\":true,\"matched_count\":%d}", matched_packets);
-    callback(summary_json, strlen(summary_json), 0);
+    frame_data *fd = frame_data_sequence_find(ctx->cf.provider.frames, num);
+    wtap_rec_reset(&ctx->rec);
+    if (!wtap_seek_read(ctx->cf.provider.wth, fd->file_off, &ctx->rec, &err, &err_info)) {
+        g_free(err_info);
+        return false;
+    }
+    epan_dissect_run(edt, ctx->cf.cd_t, &ctx->rec, fd, &ctx->cf.cinfo);
+
+    return true;
+}
+
+/**
+ * Parse a page of (optionally filtered) frames of an open session. Without a
+ * filter, frames before the page that were already visited are skipped by
+ * offset instead of being dissected again.
+ *
+ *  @return false if the epan session cannot be taken back
+ */
+bool session_get_frames_by_range(capture_ctx *ctx, int start, int limit, int printCJson,
+                                 const char *filter_str, FrameCallback callback) {
+    dfilter_t *dfcode = NULL;
+
+    if (capture_ctx_acquire_epan(ctx, NULL) != 0) {
+        return false;
+    }
+
+    if (filter_str != NULL && strlen(filter_str) > 0) {
+        if (!dfilter_compile(filter_str, &dfcode, NULL)) {
+            fprintf(stderr, "Filter compile failed: %s\n", filter_str);
+        }
+    }
+
+    if (start < 1) start = 1;
+    int matched_count = 0;
+    int end = start + limit;
+    uint32_t num = 1;
+
+    bool more = true;
+    if (dfcode == NULL) {
+        // Without a filter the match count is the frame number.
+        more = capture_ctx_advance(ctx, (uint32_t)start - 1);
+        num = (uint32_t)start;
+        matched_count = start - 1;
+    }
+
+    for (; more && !ctx->stop_requested; num++) {
+        epan_dissect_t *edt = capture_ctx_frame_edt(ctx);
+        if (dfcode != NULL) {
+            epan_dissect_prime_with_dfilter(edt, dfcode);
+        }
+
+        if (!capture_ctx_dissect_frame(ctx, num, edt)) {
+            epan_dissect_reset(edt);
+            break;
+        }
+
+        if (dfcode != NULL && !dfilter_apply_edt(dfcode, edt)) {
+            epan_dissect_reset(edt);
+            continue;
+        }
+
+        matched_count++;
+        if (matched_count < start) {
+            epan_dissect_reset(edt);
+            continue;
+        }
+        if (matched_count >= end) {
+            epan_dissect_reset(edt);
+            break;
+        }
+
+        emit_frame(ctx, edt, printCJson, callback);
+        epan_dissect_reset(edt);
+    }
+
+    if (dfcode != NULL) dfilter_free(dfcode);
+
+    capture_ctx_flush_frames(ctx);
+    return true;
+}
+
+/**
+ * Parse specific frames of an open session.
+ *
+ *  @return false if the epan session cannot be taken back
+ */
+bool session_get_frames_by_idxs(capture_ctx *ctx, int *idxs, int idx_count, int printCJson,
+                                FrameCallback callback) {
+    if (capture_ctx_acquire_epan(ctx, NULL) != 0) {
+        return false;
+    }
+
+    for (int i = 0; i < idx_count && !ctx->stop_requested; i++) {
+        if (idxs[i] <= 0) {
+            continue;
+        }
+
+        epan_dissect_t *edt = capture_ctx_frame_edt(ctx);
+        if (capture_ctx_dissect_frame(ctx, (uint32_t)idxs[i], edt)) {
+            emit_frame(ctx, edt, printCJson, callback);
+        }
+        epan_dissect_reset(edt);
+    }
+
+    capture_ctx_flush_frames(ctx);
+    return true;
+}
+
+/**
+ * Get the hex data of a specific frame of an open session.
+ *
+ *  @return hex data JSON, empty string if the frame does not exist, NULL if the
+ *  epan session cannot be taken back
+ */
+char *session_get_hex_data(capture_ctx *ctx, int num) {
+    char *res = NULL;
+
+    if (capture_ctx_acquire_epan(ctx, NULL) != 0) {
+        return NULL;
+    }
+
+    if (num > 0) {
+        epan_dissect_t *edt = &ctx->edt;
+        if (capture_ctx_dissect_frame(ctx, (uint32_t)num, edt)) {
+            res = hex_data_to_json(edt);
+        }
+        epan_dissect_reset(edt);
+    }
+
+    return res ? res : strdup("");
+}
+
+/**
+ * Extract the payloads of the frames matching filter_str from an open session.
+ *
+ *  @return false if the epan session cannot be taken back
+ */
+bool session_get_stream_payloads(capture_ctx *ctx, const char *filter_str, const char *proto,
+                                 FrameCallback callback) {
+    dfilter_t *dfcode = NULL;
+    df_error_t *df_err = NULL;
+
+    if (capture_ctx_acquire_epan(ctx, NULL) != 0) {
+        return false;
+    }
+
+    if (filter_str != NULL && strlen(filter_str) > 0) {
+        if (!dfilter_compile(filter_str, &dfcode, &df_err)) {
+            if (df_err) df_error_free(&df_err);
+        }
+    }
+
+    int payload_id =
+        proto_registrar_get_id_byname(strcmp(proto, "tcp") == 0 ? "tcp.payload" : "udp.payload");
+    int matched_packets = 0;
+
+    for (uint32_t num = 1; !ctx->stop_requested; num++) {
+        epan_dissect_t *edt = &ctx->edt_fields;
+        if (dfcode != NULL) epan_dissect_prime_with_dfilter(edt, dfcode);
+        if (payload_id != -1) epan_dissect_prime_with_hfid(edt, payload_id);
+
+        if (!capture_ctx_dissect_frame(ctx, num, edt)) {
+            epan_dissect_reset(edt);
+            break;
+        }
+
+        if (dfcode == NULL || dfilter_apply_edt(dfcode, edt)) {
+            matched_packets++;
+            emit_stream_payload(ctx, edt, payload_id, callback);
+        }
+        epan_dissect_reset(edt);
+    }
+
+    char *summary_json =
+        g_strdup_printf("{\"_summary\":true,\"matched_count\":%d}", matched_packets);
+    capture_ctx_deliver(ctx, summary_json, strlen(summary_json), callback);
     g_free(summary_json);
+    capture_ctx_flush_frames(ctx);
 
     if (dfcode != NULL) dfilter_free(dfcode);
-    close_cf();
-    wtap_rec_cleanup(&rec);
-}
\ No newline at end of file
+    return true;
+}
@@ -6,28 +6,46 @@ package pkg
 #include "online.h"
 #include "offline.h"
 
-// Forward declaration of the Go exported callback
-extern void OnFrameCallback(char *json, int len, int err);
+// Forward declaration of the Go exported callbacks
+extern int OnFrameCallback(char *json, int len, int err, void *ctx);
+extern int OnFrameBatchCallback(char *data, uint32_t *offsets, int count, void *ctx);
+
+static void call_capture_ctx_set_batch(capture_ctx *ctx, int max_frames, int max_bytes) {
+    capture_ctx_set_batch(ctx, OnFrameBatchCallback, max_frames, max_bytes);
+}
 
 // Wrappers to pass the Go function pointer to C
-static void call_get_frames_by_range(int start, int limit, int printCJson, char *filter) {
-    get_frames_by_range(start, limit, printCJson, filter, OnFrameCallback);
+static void call_get_frames_by_range(capture_ctx *ctx, int start, int limit, int printCJson,
+                                     char *filter) {
+    get_frames_by_range(ctx, start, limit, printCJson, filter, OnFrameCallback);
+}
+
+static void call_get_all_frames_cb(capture_ctx *ctx, int printCJson, char *filter) {
+    get_all_frames_cb(ctx, printCJson, filter, OnFrameCallback);
 }
 
-static void call_get_all_frames_cb(int printCJson, char *filter) {
-    get_all_frames_cb(printCJson, filter, OnFrameCallback);
+static void call_get_frames_by_idxs_cb(capture_ctx *ctx, int *idxs, int count, int printCJson) {
+    get_frames_by_idxs_cb(ctx, idxs, count, printCJson, OnFrameCallback);
 }
 
-static void call_get_frames_by_idxs_cb(int *idxs, int count, int printCJson) {
-    get_frames_by_idxs_cb(idxs, count, printCJson, OnFrameCallback);
+static void call_get_frames_by_idxs_indexed_cb(capture_ctx *ctx, frame_index *idx, int *idxs,
+                                               int count, int context_frames, int printCJson) {
+    get_frames_by_idxs_indexed_cb(ctx, idx, idxs, count, context_frames, printCJson,
+                                  OnFrameCallback);
 }
 
-static void call_get_stream_payloads_cb(char *filter, char *proto) {
-    get_stream_payloads_cb(filter, proto, OnFrameCallback);
+static void call_get_stream_payloads_cb(capture_ctx *ctx, char *filter, char *proto) {
+    get_stream_payloads_cb(ctx, filter, proto, OnFrameCallback);
+}
+
+static char *call_capture_ctx_set_tcp_tap(capture_ctx *ctx, uintptr_t handle, char *filter) {
+    return capture_ctx_set_tcp_tap(ctx, (TcpTapBatchCallback)GetTcpTapBatchCallback,
+                                   (void *)handle, filter);
 }
 */
 import "C"
 import (
+	"encoding/json"
 	"fmt"
 	"log/slog"
 	"os"
@@ -36,21 +54,44 @@ import (
 	"strconv"
 	"strings"
 	"sync"
+	"time"
 	"unsafe"
 
 	"github.com/bytedance/sonic"
 	"github.com/pkg/errors"
 )
 
-// Global channel for bridging C callbacks to Go consumers.
-// Protected by EpanMutex implicitly as only one dissection task runs at a time.
-var globalFrameChan chan []byte
+// frameSinks routes the frames C reports through OnFrameCallback to the consumer
+// of the capture context that produced them, keyed by the handle stored in
+// capture_ctx.cb_ctx.
+var (
+	frameSinks    = make(map[uintptr]func([][]byte) bool)
+	muFrameSinks  sync.RWMutex
+	nextFrameSink uintptr = 1
+)
+
+func registerFrameSink(emit func([][]byte) bool) uintptr {
+	muFrameSinks.Lock()
+	id := nextFrameSink
+	nextFrameSink++
+	frameSinks[id] = emit
+	muFrameSinks.Unlock()
+	return id
+}
+
+func unregisterFrameSink(handle uintptr) {
+	muFrameSinks.Lock()
+	delete(frameSinks, handle)
+	muFrameSinks.Unlock()
+}
 
 // OnFrameCallback
-// This function is called from C. It copies the JSON string to Go memory and pushes it to the channel.
+// This function is called from C. It copies the JSON string to Go memory and hands it to the
+// sink registered for the calling capture context.
+// It returns 1 when the sink wants no more frames, which stops the dissection loop.
 //
 //export OnFrameCallback
-func OnFrameCallback(jsonStr *C.char, length C.int, errCode C.int) {
+func OnFrameCallback(jsonStr *C.char, length C.int, errCode C.int, ctx unsafe.Pointer) C.int {
 	defer func() {
 		if r := recover(); r != nil {
 			slog.Error("Panic in OnFrameCallback", "err", r)
@@ -58,15 +99,75 @@ func OnFrameCallback(jsonStr *C.char, length C.int, errCode C.int) {
 	}()
 
 	if errCode != 0 {
-		return
+		return 0
 	}
 	if jsonStr == nil || length <= 0 {
-		return
+		return 0
+	}
+
+	muFrameSinks.RLock()
+	emit, exists := frameSinks[uintptr(ctx)]
+	muFrameSinks.RUnlock()
+	if !exists {
+		return 0
+	}
+
+	if !emit([][]byte{C.GoBytes(unsafe.Pointer(jsonStr), length)}) {
+		return 1
+	}
+	return 0
+}
+
+// OnFrameBatchCallback
+// This function is called from C with count frames packed back to back in data.
+// The batch is copied to Go memory at once and handed to the sink as one slice of
+// frames sharing that copy.
+// It returns 1 when the sink wants no more frames, which stops the dissection loop.
+//
+//export OnFrameBatchCallback
+func OnFrameBatchCallback(data *C.char, offsets *C.uint32_t, count C.int, ctx unsafe.Pointer) C.int {
+	defer func() {
+		if r := recover(); r != nil {
+			slog.Error("Panic in OnFrameBatchCallback", "err", r)
+		}
+	}()
+
+	if data == nil || offsets == nil || count <= 0 {
+		return 0
+	}
+
+	muFrameSinks.RLock()
+	emit, exists := frameSinks[uintptr(ctx)]
+	muFrameSinks.RUnlock()
+	if !exists {
+		return 0
+	}
+
+	offs := unsafe.Slice(offsets, int(count)+1)
+	buf := C.GoBytes(unsafe.Pointer(data), C.int(offs[count]))
+	batch := make([][]byte, count)
+	for i := range batch {
+		batch[i] = buf[offs[i]:offs[i+1]:offs[i+1]]
+	}
+	if !emit(batch) {
+		return 1
 	}
+	return 0
+}
 
-	goBytes := C.GoBytes(unsafe.Pointer(jsonStr), length)
-	if globalFrameChan != nil {
-		globalFrameChan <- goBytes
+// frameSource produces raw frames (JSON or binary), handing them to emit in
+// order, in batches. Once emit returns false the source stops producing as
+// soon as it can and returns. Frames come either from C in this process
+// (cFrameSource) or from a worker process (WorkerPool).
+type frameSource func(emit func(batch [][]byte) bool) error
+
+// cFrameSource adapts a C dissection call to a frameSource. run receives the
+// routing handle to store in capture_ctx.cb_ctx.
+func cFrameSource(run func(cbCtx unsafe.Pointer) error) frameSource {
+	return func(emit func([][]byte) bool) error {
+		handle := registerFrameSink(emit)
+		defer unregisterFrameSink(handle)
+		return run(unsafe.Pointer(handle))
 	}
 }
 
@@ -76,6 +177,7 @@ var (
 	ErrFromCLogic      = errors.New("run c logic occur error")
 	ErrParseDissectRes = errors.New("fail to parse DissectRes")
 	ErrFrameIsBlank    = errors.New("frame data is blank")
+	ErrUnknownField    = errors.New("unknown field")
 )
 
 func getOptimalWorkerNum(taskSize int) int {
@@ -89,14 +191,26 @@ func getOptimalWorkerNum(taskSize int) int {
 	return cpuNum
 }
 
-// EpanMutex ensures thread safety for libwireshark's global state.
+// EpanMutex guards libwireshark's process-wide state: the epan session, the
+// preferences and the tap registrations. withCapFile and the Session methods
+// hold it for a whole C call, from opening the capture context to closing it,
+// so it covers the entire dissection of a capture: one dissection runs at a
+// time per process. Option handling and filter validation run before it is
+// taken, and frame-index building runs without it. JSON parsing and
+// reordering run concurrently on other goroutines while the lock is held.
+// Parallel dissection needs separate processes (WorkerPool).
 var EpanMutex = &sync.Mutex{}
 
-// init initializes the Wireshark environment once on startup.
+// init initializes the Wireshark environment once on startup. Processes started
+// by a WorkerPool then serve dissection jobs and exit instead of running main.
 func init() {
 	if !C.init_env() {
 		panic("failed to initialize wireshark env")
 	}
+	C.frame_keys_init()
+	if isWorkerProcess() {
+		os.Exit(serveWorker())
+	}
 }
 
 // IsFileExist check if a file path exists.
@@ -120,40 +234,80 @@ func EpanPluginsSupported() int {
 	return int(C.epan_plugins_supported())
 }
 
-// initCapFile initializes the capture file structure in C.
-func initCapFile(path string, opts ...Option) (conf *Conf, err error) {
+// withCapFile opens path into a fresh capture context, runs fn on it and closes
+// it again. EpanMutex is held for exactly this C section.
+func withCapFile(path string, conf *Conf, fn func(ctx *C.capture_ctx)) error {
 	if !IsFileExist(path) {
-		err = errors.Wrap(ErrFileNotFound, path)
-		return
+		return errors.Wrap(ErrFileNotFound, path)
 	}
 
-	conf = NewConfig(opts...)
-
 	cPath := C.CString(path)
 	cOptions := C.CString(HandleConf(conf))
 	defer C.free(unsafe.Pointer(cPath))
 	defer C.free(unsafe.Pointer(cOptions))
 
-	errNo := C.init_cf(cPath, cOptions)
-	if errNo != 0 {
-		err = errors.Wrap(ErrReadFile, strconv.Itoa(int(errNo)))
-		return
+	EpanMutex.Lock()
+	defer EpanMutex.Unlock()
+
+	var cErr C.int
+	ctx := C.capture_ctx_open(cPath, cOptions, &cErr)
+	if ctx == nil {
+		return errors.Wrap(ErrReadFile, strconv.Itoa(int(cErr)))
 	}
+	release, err := bindReassembler(ctx, conf)
+	if err != nil {
+		C.capture_ctx_close(ctx)
+		return err
+	}
+	defer release()
+	defer C.capture_ctx_close(ctx)
 
-	return
+	fn(ctx)
+	return nil
 }
 
-// PrintAllFrames dissects and prints all frames to stdout.
-func PrintAllFrames(path string) (err error) {
-	EpanMutex.Lock()
-	defer EpanMutex.Unlock()
+// bindReassembler gives ctx its own tcp_follow listener feeding conf.Reassembler,
+// if one is set. The returned release drops the routing handle of the listener;
+// call it once ctx is closed.
+func bindReassembler(ctx *C.capture_ctx, conf *Conf) (release func(), err error) {
+	r := conf.Reassembler
+	if r == nil {
+		return func() {}, nil
+	}
 
-	_, err = initCapFile(path)
-	if err != nil {
-		return
+	cFilter := C.CString(conf.ReassemblyFilter)
+	defer C.free(unsafe.Pointer(cFilter))
+
+	handle := r.register()
+	if cErrMsg := C.call_capture_ctx_set_tcp_tap(ctx, C.uintptr_t(handle), cFilter); cErrMsg != nil {
+		defer C.free_c_string(cErrMsg)
+		r.UnregisterCallback(handle)
+		return nil, fmt.Errorf("Syntax error in reassembly filter: %s", CChar2GoStr(cErrMsg))
 	}
-	C.print_all_frame()
-	return
+	return func() { r.UnregisterCallback(handle) }, nil
+}
+
+// bindFrameSink points the frames ctx reports at the sink cbCtx, in the frame
+// encoding, field projection and batching selected by conf.
+func bindFrameSink(ctx *C.capture_ctx, cbCtx unsafe.Pointer, conf *Conf) {
+	ctx.cb_ctx = cbCtx
+	ctx.binary_frames = C.bool(conf.BinaryFrames)
+	ctx.typed_values = C.bool(conf.TypedValues)
+	C.call_capture_ctx_set_batch(ctx, C.int(conf.BatchFrames), C.int(conf.BatchBytes))
+
+	var cFields *C.char
+	if len(conf.Fields) > 0 {
+		cFields = C.CString(strings.Join(conf.Fields, ","))
+		defer C.free(unsafe.Pointer(cFields))
+	}
+	C.capture_ctx_set_fields(ctx, cFields)
+}
+
+// PrintAllFrames dissects and prints all frames to stdout.
+func PrintAllFrames(path string) (err error) {
+	return withCapFile(path, NewConfig(), func(ctx *C.capture_ctx) {
+		C.print_all_frame(ctx)
+	})
 }
 
 // HexData represents the hex dump format.
@@ -171,15 +325,23 @@ func ParseHexData(src string) (hexData *HexData, err error) {
 
 // GetHexDataByIdx retrieves hex dump for a specific frame index.
 func GetHexDataByIdx(path string, frameIdx int, opts ...Option) (hexData *HexData, err error) {
-	EpanMutex.Lock()
-	defer EpanMutex.Unlock()
+	conf := NewConfig(opts...)
+
+	idx := frameIndexFor(path, conf)
+	defer idx.release()
 
-	_, err = initCapFile(path, opts...)
+	var srcHex *C.char
+	err = withCapFile(path, conf, func(ctx *C.capture_ctx) {
+		if idx != nil {
+			srcHex = C.get_specific_frame_hex_data_indexed(ctx, idx.idx, C.int(frameIdx), C.int(conf.ContextFrames))
+		} else {
+			srcHex = C.get_specific_frame_hex_data(ctx, C.int(frameIdx))
+		}
+	})
 	if err != nil {
 		return
 	}
 
-	srcHex := C.get_specific_frame_hex_data(C.int(frameIdx))
 	if srcHex != nil {
 		defer C.free(unsafe.Pointer(srcHex))
 		if C.strlen(srcHex) > 0 {
@@ -191,15 +353,47 @@ func GetHexDataByIdx(path string, frameIdx int, opts ...Option) (hexData *HexDat
 
 // ParseFrameData parses the JSON representation of a dissected frame.
 func ParseFrameData(src []byte) (frame *FrameData, err error) {
+	return parseFrameData(src, true)
+}
+
+// parseFrameData parses a dissected frame in one pass over src. Layers are kept
+// as raw JSON and only the BaseLayers are decoded; with keepLayers unset, Layers
+// is dropped once they are.
+func parseFrameData(src []byte, keepLayers bool) (frame *FrameData, err error) {
 	if len(src) == 0 {
 		return nil, errors.New("empty input data")
 	}
+	if isBinaryFrame(src) {
+		return decodeBinaryFrame(src, keepLayers)
+	}
 
-	err = sonic.Unmarshal(src, &frame)
-	if err != nil {
+	var raw struct {
+		Index  string                     `json:"_index"`
+		Layers map[string]json.RawMessage `json:"layers"`
+		Fields map[string]any             `json:"fields"`
+	}
+	if err = sonic.Unmarshal(src, &raw); err != nil {
 		return nil, ErrParseDissectRes
 	}
+	frame = &FrameData{Index: raw.Index, Fields: raw.Fields}
+
+	// Field projection records (WithFields) carry no layers.
+	if frame.Fields != nil {
+		var num int
+		switch n := frame.Fields["frame.number"].(type) {
+		case float64: // WithTypedValues
+			num = int(n)
+		default:
+			num, _ = strconv.Atoi(fmt.Sprint(n))
+		}
+		frame.BaseLayers.Frame = &Frame{Number: num}
+		return frame, nil
+	}
 
+	frame.Layers = make(Layers, len(raw.Layers))
+	for name, layer := range raw.Layers {
+		frame.Layers[name] = layer
+	}
 	var layerErrors []error
 	parseLayer := func(layerFunc func() (any, error), setLayerFunc func(any)) {
 		val, err := layerFunc()
@@ -220,6 +414,10 @@ func ParseFrameData(src []byte) (frame *FrameData, err error) {
 	parseLayer(frame.Layers.Http, func(v any) { frame.BaseLayers.Http = v.([]*Http) })
 	parseLayer(frame.Layers.Dns, func(v any) { frame.BaseLayers.Dns = v.(*Dns) })
 
+	if !keepLayers {
+		frame.Layers = nil
+	}
+
 	if len(layerErrors) > 0 {
 		return frame, errors.Errorf("frame:%d errors:%v", frame.BaseLayers.Frame.Number, layerErrors)
 	}
@@ -229,12 +427,10 @@ func ParseFrameData(src []byte) (frame *FrameData, err error) {
 
 // GetFrameByIdx gets a single frame.
 func GetFrameByIdx(path string, frameIdx int, opts ...Option) (frameData *FrameData, err error) {
-	EpanMutex.Lock()
-	defer EpanMutex.Unlock()
+	conf := NewConfig(opts...)
 
-	conf, err := initCapFile(path, opts...)
-	if err != nil {
-		return
+	if err := validateFrameConf(conf); err != nil {
+		return nil, err
 	}
 
 	printCJson := 0
@@ -242,30 +438,57 @@ func GetFrameByIdx(path string, frameIdx int, opts ...Option) (frameData *FrameD
 		printCJson = 1
 	}
 
-	counter := 0
-	for {
-		counter++
-		if counter < frameIdx && frameIdx != counter {
-			continue
-		}
+	idx := frameIndexFor(path, conf)
+	defer idx.release()
 
-		srcFrame := C.proto_tree_in_json(C.int(counter), C.int(printCJson))
-		if srcFrame != nil {
-			defer C.free_c_string(srcFrame)
-			if C.strlen(srcFrame) == 0 {
-				return frameData, ErrFrameIsBlank
+	// Both paths report through the frame sink, so Fields and BinaryFrames
+	// shape the result the same whether or not the index is available.
+	var src []byte
+	cIdxs := []C.int{C.int(frameIdx)}
+	err = cFrameSource(func(cbCtx unsafe.Pointer) error {
+		return withCapFile(path, conf, func(ctx *C.capture_ctx) {
+			bindFrameSink(ctx, cbCtx, conf)
+			if idx != nil {
+				C.call_get_frames_by_idxs_indexed_cb(ctx, idx.idx, &cIdxs[0], 1, C.int(conf.ContextFrames), C.int(printCJson))
+			} else {
+				C.call_get_frames_by_idxs_cb(ctx, &cIdxs[0], 1, C.int(printCJson))
 			}
-		}
+		})
+	})(func(batch [][]byte) bool {
+		src = batch[len(batch)-1]
+		return true
+	})
+	if err != nil {
+		return nil, err
+	}
+	if len(src) == 0 {
+		return nil, ErrFrameIsBlank
+	}
 
-		// unmarshal dissect result
-		frameData, err = ParseFrameData([]byte(CChar2GoStr(srcFrame)))
-		if err != nil {
-			slog.Warn("GetFrameByIdx:", "ParseFrameData", err)
-			return
-		}
+	frameData, err = parseFrameData(src, conf.KeepLayers)
+	if err != nil {
+		slog.Warn("GetFrameByIdx:", "ParseFrameData", err)
+	}
+	return frameData, err
+}
 
-		return
+// serializeFrameJSON dissects frame frameIdx once and serializes its proto tree
+// to JSON iterations times, for benchmarking the serializer on a fixed tree. It
+// returns the JSON length, the time spent serializing and the C heap
+// allocations made meanwhile, -1 unless built with the alloccount tag.
+func serializeFrameJSON(path string, frameIdx, iterations int, opts ...Option) (size int, elapsed time.Duration, allocs int64, err error) {
+	conf := NewConfig(opts...)
+
+	err = withCapFile(path, conf, func(ctx *C.capture_ctx) {
+		ctx.typed_values = C.bool(conf.TypedValues)
+		var cElapsed, cAllocs C.int64_t
+		size = int(C.bench_json_serialize(ctx, C.int(frameIdx), C.int(iterations), &cElapsed, &cAllocs))
+		elapsed, allocs = time.Duration(cElapsed), int64(cAllocs)
+	})
+	if err == nil && size < 0 {
+		err = errors.Wrapf(ErrFrameIsBlank, "frame %d", frameIdx)
 	}
+	return
 }
 
 func removeNegativeAndZero(nums []int) []int {
@@ -278,18 +501,17 @@ func removeNegativeAndZero(nums []int) []int {
 	return result
 }
 
-// GetFramesByIdxs fetches specific frames efficiently using a single pass.
+// GetFramesByIdxs fetches specific frames, seeking straight to them through the
+// frame index when it is enabled, otherwise using a single sequential pass.
 func GetFramesByIdxs(path string, frameIdxs []int, opts ...Option) (frames []*FrameData, err error) {
 	if len(frameIdxs) == 0 {
 		return []*FrameData{}, nil
 	}
 
-	EpanMutex.Lock()
-	defer EpanMutex.Unlock()
+	conf := NewConfig(opts...)
 
-	conf, err := initCapFile(path, opts...)
-	if err != nil {
-		return nil, err
+	if err := ValidateFields(conf.Fields); err != nil {
+		return []*FrameData{}, err
 	}
 
 	printCJson := 0
@@ -306,69 +528,73 @@ func GetFramesByIdxs(path string, frameIdxs []int, opts ...Option) (frames []*Fr
 		return []*FrameData{}, nil
 	}
 
-	// 2. Setup channel
-	globalFrameChan = make(chan []byte, len(frameIdxs))
-
-	// 3. Start parsing consumer
-	var parseWg sync.WaitGroup
-	var parseErr error
-	var errMutex sync.Mutex
-	resultChan := make(chan *FrameData, len(frameIdxs))
-
-	workerNum := getOptimalWorkerNum(len(frameIdxs))
-
-	parseWg.Add(workerNum)
-	for i := 0; i < workerNum; i++ {
-		go func() {
-			defer parseWg.Done()
-			for jsonStr := range globalFrameChan {
-				frame, e := ParseFrameData(jsonStr)
-				if e != nil {
-					if !conf.IgnoreError {
-						errMutex.Lock()
-						parseErr = e
-						errMutex.Unlock()
-					} else {
-						slog.Warn("GetFramesByIdxs Parse Error", "err", e)
-					}
-					continue
-				}
-				resultChan <- frame
-			}
-		}()
-	}
-
-	// 4. Convert Go slice to C array (Safe handling for int sizes)
+	// 2. Convert Go slice to C array (Safe handling for int sizes)
 	cIdxsSlice := make([]C.int, len(frameIdxs))
 	for i, v := range frameIdxs {
 		cIdxsSlice[i] = C.int(v)
 	}
-
-	// 5. Call C function
 	cIdxs := (*C.int)(unsafe.Pointer(&cIdxsSlice[0]))
 	cCount := C.int(len(cIdxsSlice))
-	C.call_get_frames_by_idxs_cb(cIdxs, cCount, C.int(printCJson))
 
-	// 6. Cleanup
-	close(globalFrameChan)
-	globalFrameChan = nil
+	idx := frameIndexFor(path, conf)
+	defer idx.release()
 
-	parseWg.Wait()
-	close(resultChan)
-
-	for f := range resultChan {
-		frames = append(frames, f)
-	}
+	// 3. Call C function, parsing concurrently
+	return collectFrames(conf, len(frameIdxs), cFrameSource(func(cbCtx unsafe.Pointer) error {
+		return withCapFile(path, conf, func(ctx *C.capture_ctx) {
+			bindFrameSink(ctx, cbCtx, conf)
+			if idx != nil {
+				C.call_get_frames_by_idxs_indexed_cb(ctx, idx.idx, cIdxs, cCount, C.int(conf.ContextFrames), C.int(printCJson))
+			} else {
+				C.call_get_frames_by_idxs_cb(ctx, cIdxs, cCount, C.int(printCJson))
+			}
+		})
+	}))
+}
 
-	slices.SortFunc(frames, func(a, b *FrameData) int {
-		return a.BaseLayers.Frame.Number - b.BaseLayers.Frame.Number
+// collectFrames drains a frame source through iterFrames and returns its frames
+// in the order the source emitted them, which for a single C dissection is frame
+// order. capacity is a hint for the number of frames. A parse error is returned
+// with the frames when IgnoreError is off; an error of the source wins over it.
+func collectFrames(conf *Conf, capacity int, src frameSource) (frames []*FrameData, err error) {
+	frames = make([]*FrameData, 0, capacity)
+
+	iterFrames(conf, src, func(frame *FrameData, e error) bool {
+		if e != nil {
+			err = e
+			return true
+		}
+		frames = append(frames, frame)
+		return true
 	})
 
-	if parseErr != nil {
-		return frames, parseErr
+	return frames, err
+}
+
+// ValidateFields checks that every name is a registered field or protocol, like "ip.src".
+func ValidateFields(fields []string) error {
+	for _, field := range fields {
+		cField := C.CString(field)
+		EpanMutex.Lock()
+		ok := C.validate_field(cField)
+		EpanMutex.Unlock()
+		C.free(unsafe.Pointer(cField))
+
+		if !ok {
+			return errors.Wrap(ErrUnknownField, field)
+		}
 	}
+	return nil
+}
 
-	return frames, nil
+// validateFrameConf checks the display filter and the projected fields of conf.
+func validateFrameConf(conf *Conf) error {
+	if conf.BpfFilter != "" {
+		if err := ValidateFilter(conf.BpfFilter); err != nil {
+			return err
+		}
+	}
+	return ValidateFields(conf.Fields)
 }
 
 // ValidateFilter checks if the given display filter syntax is valid.
@@ -379,7 +605,9 @@ func ValidateFilter(filter string) error {
 	cFilter := C.CString(filter)
 	defer C.free(unsafe.Pointer(cFilter))
 
+	EpanMutex.Lock()
 	cErrMsg := C.validate_filter(cFilter)
+	EpanMutex.Unlock()
 	if cErrMsg != nil {
 		defer C.free_c_string(cErrMsg)
 		return fmt.Errorf("Syntax error in display filter: %s", CChar2GoStr(cErrMsg))
@@ -389,203 +617,89 @@ func ValidateFilter(filter string) error {
 
 // GetAllFrames fetches all frames efficiently.
 func GetAllFrames(path string, opts ...Option) (frames []*FrameData, err error) {
-	frames = make([]*FrameData, 0)
-
-	EpanMutex.Lock()
-	defer EpanMutex.Unlock()
-
-	conf, err := initCapFile(path, opts...)
-	if err != nil {
-		return nil, err
-	}
-
-	if conf.BpfFilter != "" {
-		if err := ValidateFilter(conf.BpfFilter); err != nil {
-			return frames, err
-		}
-	}
-
-	printCJson := 0
-	if conf.PrintCJson {
-		printCJson = 1
-	}
+	conf := NewConfig(opts...)
 
-	// 1. Setup channel
-	globalFrameChan = make(chan []byte, 1000)
-
-	// 2. Start concurrent parsers
-	var parseWg sync.WaitGroup
-	var parseErr error
-	var errMutex sync.Mutex
-	resultChan := make(chan *FrameData, 1000)
-
-	workerNum := runtime.NumCPU()
-	if workerNum < 1 {
-		workerNum = 1
-	}
-
-	parseWg.Add(workerNum)
-	for i := 0; i < workerNum; i++ {
-		go func() {
-			defer parseWg.Done()
-			for jsonStr := range globalFrameChan {
-				frame, e := ParseFrameData(jsonStr)
-				if e != nil {
-					if !conf.IgnoreError {
-						errMutex.Lock()
-						parseErr = e
-						errMutex.Unlock()
-					}
-					continue
-				}
-				resultChan <- frame
-			}
-		}()
+	if err := validateFrameConf(conf); err != nil {
+		return []*FrameData{}, err
 	}
 
-	// 3. Collector
-	doneChan := make(chan struct{})
-	go func() {
-		for f := range resultChan {
-			frames = append(frames, f)
-		}
-		close(doneChan)
-	}()
-
-	cFilter := C.CString(conf.BpfFilter)
-	defer C.free(unsafe.Pointer(cFilter))
-
-	// 4. Call C function
-	C.call_get_all_frames_cb(C.int(printCJson), cFilter)
-
-	// 5. Cleanup
-	close(globalFrameChan)
-	globalFrameChan = nil
-
-	// 6. Wait for workers
-	parseWg.Wait()
-	close(resultChan)
-	<-doneChan
-
-	// 7. Sort results
-	slices.SortFunc(frames, func(a, b *FrameData) int {
-		return a.BaseLayers.Frame.Number - b.BaseLayers.Frame.Number
-	})
+	frames, err = collectFrames(conf, 1000, cFrameSource(runAllFrames(path, conf)))
 
 	if conf.Debug {
 		slog.Info("GetAllFrames Dissect end", "PCAP_FILE", path, "COUNT", len(frames))
 	}
 
-	if parseErr != nil {
-		return frames, parseErr
-	}
+	return frames, err
+}
+
+// runAllFrames returns the C call behind GetAllFrames.
+func runAllFrames(path string, conf *Conf) func(cbCtx unsafe.Pointer) error {
+	return func(cbCtx unsafe.Pointer) error {
+		cFilter := C.CString(conf.BpfFilter)
+		defer C.free(unsafe.Pointer(cFilter))
 
-	return frames, nil
+		return withCapFile(path, conf, func(ctx *C.capture_ctx) {
+			bindFrameSink(ctx, cbCtx, conf)
+			C.call_get_all_frames_cb(ctx, C.int(boolToInt(conf.PrintCJson)), cFilter)
+		})
+	}
 }
 
 // GetFramesByPage fetches a specific page of frames using pagination.
 func GetFramesByPage(path string, page, size int, opts ...Option) (frames []*FrameData, hasMore bool, err error) {
-	frames = make([]*FrameData, 0)
+	page, size, startFrameIdx, fetchSize := pageBounds(page, size)
 
-	if page < 1 {
-		page = 1
-	}
-	if size < 1 {
-		size = 10
-	}
-
-	fetchSize := size + 1
-	startFrameIdx := (page-1)*size + 1
+	conf := NewConfig(opts...)
 
-	// Global Lock & Init
-	EpanMutex.Lock()
-	defer EpanMutex.Unlock()
+	// 1. Validate BPF filter and fields
+	if err := validateFrameConf(conf); err != nil {
+		return []*FrameData{}, false, err
+	}
 
-	conf, err := initCapFile(path, opts...)
+	frames, err = collectFrames(conf, fetchSize, cFrameSource(runFramesByRange(path, conf, startFrameIdx, fetchSize)))
 	if err != nil {
 		return frames, false, err
 	}
 
-	// 1. Validate BPF filter
-	if conf.BpfFilter != "" {
-		if err := ValidateFilter(conf.BpfFilter); err != nil {
-			return frames, false, err
-		}
-	}
-
-	printCJson := 0
-	if conf.PrintCJson {
-		printCJson = 1
-	}
-
-	// Setup Pipeline
-	globalFrameChan = make(chan []byte, fetchSize)
-
-	// Consumer
-	var parseWg sync.WaitGroup
-	var parseErr error
-	var errMutex sync.Mutex
-	resultChan := make(chan *FrameData, fetchSize)
-
-	// Dynamic worker count
-	workerNum := getOptimalWorkerNum(fetchSize)
-
-	parseWg.Add(workerNum)
-	for i := 0; i < workerNum; i++ {
-		go func() {
-			defer parseWg.Done()
-			for jsonStr := range globalFrameChan {
-				f, e := ParseFrameData(jsonStr)
-				if e != nil {
-					if !conf.IgnoreError {
-						errMutex.Lock()
-						parseErr = e
-						errMutex.Unlock()
-					}
-					continue
-				}
-				resultChan <- f
-			}
-		}()
+	if conf.Debug {
+		slog.Info("Paged parsing completed", "fetched_count", len(frames), "page", page)
 	}
 
-	cFilter := C.CString(conf.BpfFilter)
-	defer C.free(unsafe.Pointer(cFilter))
-
-	// Call C (Blocking I/O)
-	C.call_get_frames_by_range(C.int(startFrameIdx), C.int(fetchSize), C.int(printCJson), cFilter)
-
-	// Cleanup
-	close(globalFrameChan)
-	globalFrameChan = nil
+	frames, hasMore = trimPage(frames, size)
+	return frames, hasMore, nil
+}
 
-	parseWg.Wait()
-	close(resultChan)
+// runFramesByRange returns the C call behind GetFramesByPage.
+func runFramesByRange(path string, conf *Conf, start, limit int) func(cbCtx unsafe.Pointer) error {
+	return func(cbCtx unsafe.Pointer) error {
+		cFilter := C.CString(conf.BpfFilter)
+		defer C.free(unsafe.Pointer(cFilter))
 
-	for f := range resultChan {
-		frames = append(frames, f)
+		return withCapFile(path, conf, func(ctx *C.capture_ctx) {
+			bindFrameSink(ctx, cbCtx, conf)
+			C.call_get_frames_by_range(ctx, C.int(start), C.int(limit), C.int(boolToInt(conf.PrintCJson)), cFilter)
+		})
 	}
+}
 
-	if parseErr != nil {
-		return frames, hasMore, parseErr
+// pageBounds normalises page and size and returns the first frame to fetch and
+// how many frames to fetch; one extra frame tells whether there is a next page.
+func pageBounds(page, size int) (int, int, int, int) {
+	if page < 1 {
+		page = 1
 	}
-
-	slices.SortFunc(frames, func(a, b *FrameData) int {
-		return a.BaseLayers.Frame.Number - b.BaseLayers.Frame.Number
-	})
-
-	if conf.Debug {
-		slog.Info("Paged parsing completed", "fetched_count", len(frames), "page", page)
+	if size < 1 {
+		size = 10
 	}
+	return page, size, (page-1)*size + 1, size + 1
+}
 
+// trimPage cuts the extra frame fetched by pageBounds off a page.
+func trimPage(frames []*FrameData, size int) ([]*FrameData, bool) {
 	if len(frames) > size {
-		hasMore = true
-		frames = frames[:size]
-	} else {
-		hasMore = false
+		return frames[:size], true
 	}
-
-	return frames, hasMore, nil
+	return frames, false
 }
 
 // =======================
@@ -618,13 +732,7 @@ type FastStreamPayload struct {
 
 // GetStreamData With streaming read, the frame object is dropped immediately after the Payload is extracted
 func GetStreamData(path string, filter string, proto string, opts ...Option) (*StreamResult, error) {
-	EpanMutex.Lock()
-	defer EpanMutex.Unlock()
-
-	_, err := initCapFile(path, opts...)
-	if err != nil {
-		return nil, err
-	}
+	conf := NewConfig(opts...)
 
 	if filter != "" {
 		if err := ValidateFilter(filter); err != nil {
@@ -632,20 +740,36 @@ func GetStreamData(path string, filter string, proto string, opts ...Option) (*S
 		}
 	}
 
-	globalFrameChan = make(chan []byte, 1000)
-	resChan := make(chan *StreamResult, 1)
+	return collectStreamPayloads(cFrameSource(runStreamPayloads(path, conf, filter, proto, false)))
+}
 
-	go func() {
-		result := &StreamResult{
-			ClientNode: "Client",
-			ServerNode: "Server",
-		}
-		clientPort := -1
-		currentDir := ""
+// runStreamPayloads returns the C call behind GetStreamData, or behind
+// WriteStreamData if raw is set.
+func runStreamPayloads(path string, conf *Conf, filter, proto string, raw bool) func(cbCtx unsafe.Pointer) error {
+	return func(cbCtx unsafe.Pointer) error {
+		cFilter := C.CString(filter)
+		cProto := C.CString(proto)
+		defer C.free(unsafe.Pointer(cFilter))
+		defer C.free(unsafe.Pointer(cProto))
+
+		return withCapFile(path, conf, func(ctx *C.capture_ctx) {
+			bindFrameSink(ctx, cbCtx, conf)
+			ctx.raw_payloads = C.bool(raw)
+			C.call_get_stream_payloads_cb(ctx, cFilter, cProto)
+		})
+	}
+}
 
-		var currentBuilder strings.Builder
+// collectStreamPayloads drains a source of payload records and merges
+// consecutive payloads of the same direction.
+func collectStreamPayloads(src frameSource) (*StreamResult, error) {
+	result := &StreamResult{}
+	ends := newStreamEnds()
+	currentDir := ""
+	var currentBuilder strings.Builder
 
-		for jsonStr := range globalFrameChan {
+	err := src(func(batch [][]byte) bool {
+		for _, jsonStr := range batch {
 			var fastFrame FastStreamPayload
 
 			if err := sonic.Unmarshal(jsonStr, &fastFrame); err != nil {
@@ -661,57 +785,34 @@ func GetStreamData(path string, filter string, proto string, opts ...Option) (*S
 				continue
 			}
 
-			if clientPort == -1 && fastFrame.SrcPort != 0 {
-				clientPort = fastFrame.SrcPort
-				result.ClientNode = fmt.Sprintf("%s:%d", fastFrame.Src, fastFrame.SrcPort)
-				result.ServerNode = fmt.Sprintf("%s:%d", fastFrame.Dst, fastFrame.DstPort)
-			}
-
-			dir := "server"
-			if fastFrame.SrcPort == clientPort {
-				dir = "client"
-			}
+			dir := ends.dir(fastFrame.Src, fastFrame.SrcPort, fastFrame.Dst, fastFrame.DstPort)
 
 			bytesLen := len(fastFrame.Payload) / 2
-			if dir == "client" {
+			if dir == PayloadDirClient {
 				result.ClientBytes += bytesLen
 			} else {
 				result.ServerBytes += bytesLen
 			}
 
-			if currentDir == "" {
-				currentDir = dir
-				currentBuilder.WriteString(fastFrame.Payload)
-			} else if currentDir == dir {
-				currentBuilder.WriteString(fastFrame.Payload)
-			} else {
+			if currentDir != "" && currentDir != dir {
 				result.Payloads = append(result.Payloads, StreamPayload{Dir: currentDir, HexData: currentBuilder.String()})
-				currentDir = dir
 				currentBuilder.Reset()
-				currentBuilder.WriteString(fastFrame.Payload)
 			}
+			currentDir = dir
+			currentBuilder.WriteString(fastFrame.Payload)
 		}
+		return true
+	})
+	if err != nil {
+		return nil, err
+	}
 
-		if currentDir != "" {
-			result.Payloads = append(result.Payloads, StreamPayload{Dir: currentDir, HexData: currentBuilder.String()})
-		}
-		if len(result.Payloads) == 0 {
-			result.Payloads = append(result.Payloads, StreamPayload{Dir: "client", HexData: ""})
-		}
-
-		resChan <- result
-	}()
-
-	cFilter := C.CString(filter)
-	cProto := C.CString(proto)
-	defer C.free(unsafe.Pointer(cFilter))
-	defer C.free(unsafe.Pointer(cProto))
-
-	C.call_get_stream_payloads_cb(cFilter, cProto)
-
-	close(globalFrameChan)
-	globalFrameChan = nil
-
-	res := <-resChan
-	return res, nil
+	if currentDir != "" {
+		result.Payloads = append(result.Payloads, StreamPayload{Dir: currentDir, HexData: currentBuilder.String()})
+	}
+	if len(result.Payloads) == 0 {
+		result.Payloads = append(result.Payloads, StreamPayload{Dir: PayloadDirClient, HexData: ""})
+	}
+	result.ClientNode, result.ServerNode = ends.clientNode, ends.serverNode
+	return result, nil
 }
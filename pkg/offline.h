@@ -1,43 +1,238 @@
 #ifndef OFFLINE_H
 #define OFFLINE_H
 
+#include "frame_index.h"
 #include "lib.h"
+#include "reassembly.h"
 
-// Initialize the capture file structure and open the PCAP file.
-// Returns 0 on success, error code otherwise.
-int init_cf(char *filename, char *options);
+// --- Capture Contexts ---
 
-// Clean up capture file resources and close the file.
-void close_cf();
+// An open capture file with its own capture_file, record buffer and callback
+// routing handle. The functions below take the context explicitly instead of
+// sharing one global capture file.
+//
+// libwireshark supports a single live epan session per process; contexts hand
+// it over on demand, so calls on different contexts must still be serialised
+// by the caller.
+typedef struct {
+    capture_file cf;
+    char *options;       // JSON options, re-applied when the epan is re-acquired
+    void *cb_ctx;        // passed to every FrameCallback, identifies the consumer
+    uint32_t visited;    // frames 1..visited went through the first pass of the current epan
+    bool eof;            // the whole file has been read into the frame_data sequence
+    guint32 cum_bytes;
+    wtap_rec rec;                 // record buffer reused for every frame read
+    epan_dissect_t edt;           // reused for frames dissected with a tree; live while cf.epan is
+    epan_dissect_t edt_bare;      // reused for first-pass and warm-up frames, without a tree
+    epan_dissect_t edt_fields;    // invisible tree, for field projection and the payload loops
+    GPtrArray *fields;            // header_field_info of the projected fields, NULL for full trees
+    bool binary_frames;           // emit frames as binary node arrays instead of JSON
+    bool typed_values;            // emit numeric and boolean JSON values natively, not as strings
+    GByteArray *frame_buf;        // reused buffer of the binary encoder
+    GString *json_buf;            // reused buffer of the JSON serializer
+    gsize json_avg_len;           // running average JSON length, json_buf is trimmed to fit it
+    wmem_allocator_t *json_scope; // per-frame arena of the JSON serializer
+    FrameBatchCallback batch_cb;  // receives batched frames, NULL to deliver them one by one
+    int batch_max_frames;         // flush a batch once it holds this many frames
+    guint batch_max_bytes;        // ... or this many bytes
+    GByteArray *batch_buf;        // frames of the pending batch, back to back
+    GArray *batch_offsets;        // uint32 start of each pending frame, plus the end of the last
+    bool stop_requested;          // the frame or batch callback asked for no more frames
+    bool raw_payloads;            // emit stream payloads as raw records instead of hex JSON
+    tcp_follow_tap *tcp_tap;      // tcp_follow listener, attached while the ctx owns the epan
+} capture_ctx;
+
+// --- Binary Frames ---
+
+// With binary_frames set, frames are handed to the FrameCallback as a node array
+// instead of JSON, in host byte order:
+//
+//   uint32 magic (FRAME_BINARY_MAGIC), uint32 node count,
+//   uint32 number of static keys of the encoding process (frame_static_key_count),
+//   uint16 length + "_index" value,
+//   then per node, in pre-order (a node always follows its parent):
+//     int32 hf id, int32 parent node (-1 for top-level protocols),
+//     int32 byte offset, int32 byte length, uint8 ftenum, uint8 FRAME_NODE_* flags,
+//     [8 byte int64/uint64/double if a FRAME_NODE_NUM_* flag is set],
+//     [uint16 length + key if FRAME_NODE_KEY is set],
+//     [uint32 length + value if FRAME_NODE_VALUE is set]
+//
+// Without FRAME_NODE_KEY the key is the abbreviation of the hf id, see
+// frame_static_key. Without FRAME_NODE_VALUE the value is the decimal rendering
+// of the typed value with FRAME_NODE_VALUE_NUM, and empty otherwise (null in the
+// JSON output if FRAME_NODE_HAS_VALUE is set). FRAME_NODE_HAS_VALUE is decided
+// per json key group by its first node, as in the JSON output; the value of
+// every node in such a group is its own JSON representation.
+#define FRAME_BINARY_MAGIC 0x32425747u /* "GWB2" */
+
+#define FRAME_NODE_HAS_VALUE 0x01    // value is the field value, else the no-value text
+#define FRAME_NODE_NUM_INT 0x02      // typed value is an int64
+#define FRAME_NODE_NUM_UINT 0x04     // typed value is an uint64
+#define FRAME_NODE_NUM_DOUBLE 0x08   // typed value is a double
+#define FRAME_NODE_TEXT_ONLY 0x10    // text-only item without a field abbreviation
+#define FRAME_NODE_KEY 0x20          // the key is carried in the node
+#define FRAME_NODE_VALUE 0x40        // the value is carried in the node
+#define FRAME_NODE_VALUE_NUM 0x80    // the value is the decimal typed value
+
+/**
+ * Snapshot the fields registered so far as static keys. Called once after
+ * init_env; fields registered later (e.g. by a changed preference) carry their
+ * key in binary frames.
+ */
+void frame_keys_init(void);
+
+/** Number of static keys, which a decoder must match. */
+uint32_t frame_static_key_count(void);
+
+/**
+ * Abbreviation of a field registered by frame_keys_init.
+ *
+ *  @param hfid header field id
+ *  @return the abbreviation, or NULL if hfid is not a static key
+ */
+const char *frame_static_key(int32_t hfid);
+
+// --- Raw Stream Payloads ---
+
+// With raw_payloads set, the stream payload calls hand every payload to the
+// FrameCallback as a record of the raw bytes instead of hex JSON, in host byte
+// order:
+//
+//   uint32 magic (PAYLOAD_RECORD_MAGIC), uint32 frame number,
+//   uint16 source port, uint16 destination port,
+//   uint8 length + source address, uint8 length + destination address,
+//   then the payload bytes up to the end of the record.
+//
+// The closing {"_summary":true,...} record stays JSON.
+#define PAYLOAD_RECORD_MAGIC 0x31505747u /* "GWP1" */
+
+// get_all_stream_records reports every frame of a conversation as a stream
+// record, in host byte order:
+//
+//   uint32 magic (STREAM_RECORD_MAGIC), uint32 stream index, uint32 frame number,
+//   int64 seconds + int32 nanoseconds of the frame timestamp,
+//   uint16 source port, uint16 destination port,
+//   uint8 length + source address, uint8 length + destination address,
+//   then the payload bytes, if any, up to the end of the record.
+#define STREAM_RECORD_MAGIC 0x31535747u /* "GWS1" */
+
+// Open a capture file into a new context. Returns NULL (and sets *err) on failure.
+capture_ctx *capture_ctx_open(const char *filepath, const char *options, int *err);
+
+// Close a context and free everything it holds.
+void capture_ctx_close(capture_ctx *ctx);
+
+// Free the epan session held by whichever context currently owns it, if any.
+void capture_ctx_release_epan_owner();
+
+// Deliver emitted frames through cb in batches of up to max_frames frames / max_bytes bytes.
+void capture_ctx_set_batch(capture_ctx *ctx, FrameBatchCallback cb, int max_frames,
+                           int max_bytes);
+
+// Hand the pending batch, if any, to the batch callback.
+void capture_ctx_flush_frames(capture_ctx *ctx);
+
+// Give ctx its own tcp_follow listener reporting to callback, restricted to the
+// segments matching the display filter (NULL or "" for all), replacing any
+// previous one. Returns NULL, or an error (free with g_free) if the filter does
+// not compile.
+char *capture_ctx_set_tcp_tap(capture_ctx *ctx, TcpTapBatchCallback callback, void *cb_ctx,
+                              const char *filter);
+
+// Emit only the given comma-separated fields, as flat records, instead of full trees.
+// NULL or "" restores full trees.
+void capture_ctx_set_fields(capture_ctx *ctx, const char *fields);
+
+// Check that name is a registered field or protocol.
+bool validate_field(const char *name);
+
+// --- Single Pass Operations ---
+// These read the file once from the start and leave the context exhausted:
+// close it afterwards.
 
 // Dissect a specific frame and return its JSON representation.
-char *proto_tree_in_json(int num, int printCJson);
+char *proto_tree_in_json(capture_ctx *ctx, int num, int printCJson);
 
 // Dissect a specific frame and return its Hex Data JSON.
-char *get_specific_frame_hex_data(int num);
+char *get_specific_frame_hex_data(capture_ctx *ctx, int num);
 
+// Write the proto tree of a dissected frame as JSON. scope holds the temporary
+// data of the serializer and is emptied before returning, NULL uses a throwaway one.
 void get_json_proto_tree(output_fields_t *fields, print_dissections_e print_dissections,
                          gboolean print_hex, gchar **protocolfilter, pf_flags protocolfilter_flags,
-                         epan_dissect_t *edt, column_info *cinfo,
-                         proto_node_children_grouper_func node_children_grouper,
-                         json_dumper *dumper);
+                         epan_dissect_t *edt, column_info *cinfo, json_dumper *dumper,
+                         bool typed_values, wmem_allocator_t *scope);
+
+// Serialize frame num to JSON iterations times, for benchmarking the serializer.
+int bench_json_serialize(capture_ctx *ctx, int num, int iterations, int64_t *elapsed_ns,
+                         int64_t *allocs);
+
+// Heap allocations made so far by the calling thread, -1 unless the package is
+// built with the alloccount tag (alloc_count.c).
+int64_t heap_alloc_count(void);
 
 // Print all frames to stdout (Mainly for debugging C logic).
-void print_all_frame();
+void print_all_frame(capture_ctx *ctx);
 
 // Parse all frames in the file and trigger the callback for each.
-void get_all_frames_cb(int printCJson, char *filter, FrameCallback callback);
+void get_all_frames_cb(capture_ctx *ctx, int printCJson, char *filter, FrameCallback callback);
 
 // Parse specific frames based on a sorted list of indices.
-void get_frames_by_idxs_cb(int *idxs, int idx_count, int printCJson, FrameCallback callback);
+void get_frames_by_idxs_cb(capture_ctx *ctx, int *idxs, int idx_count, int printCJson,
+                           FrameCallback callback);
+
+// Parse specific frames by seeking through a frame-offset index, dissecting
+// context_frames frames before each target.
+void get_frames_by_idxs_indexed_cb(capture_ctx *ctx, frame_index *idx, int *idxs, int idx_count,
+                                   int context_frames, int printCJson, FrameCallback callback);
+
+// Parse frames start..end through a frame-offset index as one shard of a sharded
+// pass, after dissecting warmup frames before start without emitting them.
+void get_frames_by_shard_indexed_cb(capture_ctx *ctx, frame_index *idx, int start, int end,
+                                    int warmup, int printCJson, const char *filter_str,
+                                    FrameCallback callback);
+
+// Dissect a specific frame through a frame-offset index and return its Hex Data JSON.
+char *get_specific_frame_hex_data_indexed(capture_ctx *ctx, frame_index *idx, int num,
+                                          int context_frames);
 
 // Parse a range of frames
-void get_frames_by_range(int start, int limit, int printCJson, const char *filter, FrameCallback callback);
+void get_frames_by_range(capture_ctx *ctx, int start, int limit, int printCJson,
+                         const char *filter, FrameCallback callback);
 
 // Validate Wireshark display filter syntax.
 // Returns NULL if valid, or an error string (must be freed by caller) if invalid.
 char *validate_filter(const char *filter_str);
 
-void get_stream_payloads_cb(const char *filter_str, const char *proto, FrameCallback callback);
+// Report the tcp.payload or udp.payload of every frame matching filter_str,
+// as hex JSON or raw records (raw_payloads), then a summary record.
+void get_stream_payloads_cb(capture_ctx *ctx, const char *filter_str, const char *proto,
+                            FrameCallback callback);
+
+// Report every frame carrying a tcp.stream (proto "tcp") or udp.stream (proto "udp")
+// index as a stream record, in a single pass over the file.
+void get_all_stream_records(capture_ctx *ctx, const char *proto, FrameCallback callback);
+
+// --- Capture Sessions ---
+// These keep the frame_data sequence built by the first pass, so later calls
+// re-dissect frames by offset instead of re-reading the file from the start.
+// Each call takes the epan session back first; they fail (false, NULL) if the
+// session's options no longer apply.
+
+// Parse a range of frames of a session.
+bool session_get_frames_by_range(capture_ctx *ctx, int start, int limit, int printCJson,
+                                 const char *filter, FrameCallback callback);
+
+// Parse specific frames of a session.
+bool session_get_frames_by_idxs(capture_ctx *ctx, int *idxs, int idx_count, int printCJson,
+                                FrameCallback callback);
+
+// Dissect a specific frame of a session and return its Hex Data JSON, "" if the
+// frame does not exist.
+char *session_get_hex_data(capture_ctx *ctx, int num);
+
+// Extract the payloads of the frames of a session matching filter.
+bool session_get_stream_payloads(capture_ctx *ctx, const char *filter_str, const char *proto,
+                                 FrameCallback callback);
 
-#endif  // OFFLINE_H
\ No newline at end of file
+#endif  // OFFLINE_H
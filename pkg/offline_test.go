@@ -1,9 +1,15 @@
 package pkg
 
 import (
+	"fmt"
 	"os"
+	"reflect"
+	"runtime"
+	"sync"
 	"testing"
 	"time"
+
+	"github.com/pkg/errors"
 )
 
 const inputFilepath = "../pcaps/mysql.pcapng"
@@ -99,6 +105,32 @@ func TestGetFrameByIdx(t *testing.T) {
 	}
 }
 
+// TestGetFrameByIdx_SameShapeWithoutIndex checks that a frame fetched without
+// the frame index honours field projection like an indexed fetch does.
+func TestGetFrameByIdx_SameShapeWithoutIndex(t *testing.T) {
+	if _, err := os.Stat(testPcapFile); os.IsNotExist(err) {
+		t.Skip("skipping test; pcap file not found")
+	}
+
+	fields := []string{"frame.len", "ip.src"}
+	for _, indexed := range []bool{true, false} {
+		frame, err := GetFrameByIdx(testPcapFile, 3, WithFrameIndex(indexed), WithFields(fields))
+		if err != nil {
+			t.Fatalf("indexed=%v: %v", indexed, err)
+		}
+		if frame.Layers != nil || frame.Fields == nil {
+			t.Errorf("indexed=%v: expected a field projection, got layers", indexed)
+		}
+		if frame.BaseLayers.Frame.Number != 3 {
+			t.Errorf("indexed=%v: got frame %d, want 3", indexed, frame.BaseLayers.Frame.Number)
+		}
+	}
+
+	if _, err := GetFrameByIdx(testPcapFile, 1<<30, WithFrameIndex(false)); !errors.Is(err, ErrFrameIsBlank) {
+		t.Errorf("expected ErrFrameIsBlank past the last frame, got %v", err)
+	}
+}
+
 // TestGetAllFrames_Correctness verifies data integrity of GetAllFrames.
 // It checks if the frame count matches CountFrames and if frame numbers are sequential.
 func TestGetAllFrames_Correctness(t *testing.T) {
@@ -129,6 +161,88 @@ func TestGetAllFrames_Correctness(t *testing.T) {
 
 // TestGetFramesByIdxs_Random tests random access capabilities.
 // It verifies that requested frames (including boundary values) are correctly retrieved.
+// TestReorderRing checks that results put out of order come back in sequence
+// order and that reserve waits while the ring is full.
+func TestReorderRing(t *testing.T) {
+	ring := newReorderRing[int](4)
+
+	var seqs []uint64
+	for i := 0; i < 4; i++ {
+		seq, ok := ring.reserve()
+		if !ok {
+			t.Fatal("reserve failed on an open ring")
+		}
+		seqs = append(seqs, seq)
+	}
+
+	reserved := make(chan uint64)
+	go func() {
+		seq, _ := ring.reserve()
+		reserved <- seq
+	}()
+
+	for _, i := range []int{3, 1, 2, 0} {
+		ring.put(seqs[i], int(seqs[i]))
+	}
+	for want := 0; want < 4; want++ {
+		if got, ok := ring.next(); !ok || got != want {
+			t.Fatalf("next: got %d (ok=%v), want %d", got, ok, want)
+		}
+		if want == 0 {
+			if seq := <-reserved; seq != 4 {
+				t.Fatalf("reserve after release: got %d, want 4", seq)
+			}
+		}
+	}
+
+	ring.put(4, 4)
+	ring.finish()
+	if got, ok := ring.next(); !ok || got != 4 {
+		t.Fatalf("next: got %d (ok=%v), want 4", got, ok)
+	}
+	if _, ok := ring.next(); ok {
+		t.Fatal("next returned a result from a drained ring")
+	}
+}
+
+// TestIterFrames checks that IterFrames yields every frame in order, with a tiny
+// in-flight bound, and that breaking out early releases the dissection.
+func TestIterFrames(t *testing.T) {
+	if _, err := os.Stat(inputFilepath); os.IsNotExist(err) {
+		t.Skip("skipping test; pcap file not found")
+	}
+
+	want, err := GetAllFrames(inputFilepath)
+	if err != nil {
+		t.Fatalf("GetAllFrames failed: %v", err)
+	}
+
+	n := 0
+	for frame, err := range IterFrames(inputFilepath, WithBatch(4, 0), WithMaxInFlight(8)) {
+		if err != nil {
+			t.Fatalf("IterFrames failed: %v", err)
+		}
+		if n >= len(want) || frame.BaseLayers.Frame.Number != want[n].BaseLayers.Frame.Number {
+			t.Fatalf("[%d]: got frame %d, out of order", n, frame.BaseLayers.Frame.Number)
+		}
+		n++
+	}
+	if n != len(want) {
+		t.Fatalf("got %d frames, want %d", n, len(want))
+	}
+
+	n = 0
+	for range IterFrames(inputFilepath, WithBatch(2, 0), WithMaxInFlight(2)) {
+		if n++; n == 3 {
+			break
+		}
+	}
+	// EpanMutex must be free again once the loop is left.
+	if _, err := GetFrameByIdx(inputFilepath, 1); err != nil {
+		t.Fatalf("GetFrameByIdx after break failed: %v", err)
+	}
+}
+
 func TestGetFramesByIdxs_Random(t *testing.T) {
 	if _, err := os.Stat(testPcapFile); os.IsNotExist(err) {
 		t.Skip("skipping test; pcap file not found")
@@ -164,6 +278,91 @@ func TestGetFramesByIdxs_Random(t *testing.T) {
 	}
 }
 
+// TestGetFramesByIdxs_IndexMatchesSequential checks that seeking through the frame index
+// returns the same frames as a sequential pass.
+func TestGetFramesByIdxs_IndexMatchesSequential(t *testing.T) {
+	if _, err := os.Stat(testPcapFile); os.IsNotExist(err) {
+		t.Skip("skipping test; pcap file not found")
+	}
+
+	targets := []int{1, 5, 10, 50}
+
+	indexed, err := GetFramesByIdxs(testPcapFile, targets, WithFrameIndex(true), WithContextFrames(2))
+	if err != nil {
+		t.Fatalf("indexed GetFramesByIdxs failed: %v", err)
+	}
+	sequential, err := GetFramesByIdxs(testPcapFile, targets, WithFrameIndex(false))
+	if err != nil {
+		t.Fatalf("sequential GetFramesByIdxs failed: %v", err)
+	}
+
+	if len(indexed) != len(sequential) {
+		t.Fatalf("frame count mismatch: indexed %d, sequential %d", len(indexed), len(sequential))
+	}
+	for i := range indexed {
+		if indexed[i].BaseLayers.Frame.Number != sequential[i].BaseLayers.Frame.Number {
+			t.Errorf("frame number mismatch at %d: %d != %d", i,
+				indexed[i].BaseLayers.Frame.Number, sequential[i].BaseLayers.Frame.Number)
+		}
+		if indexed[i].BaseLayers.WsCol.Protocol != sequential[i].BaseLayers.WsCol.Protocol {
+			t.Errorf("protocol mismatch at frame %d: %s != %s", indexed[i].BaseLayers.Frame.Number,
+				indexed[i].BaseLayers.WsCol.Protocol, sequential[i].BaseLayers.WsCol.Protocol)
+		}
+	}
+
+	if !IsFileExist(FrameIndexPath(testPcapFile)) {
+		t.Log("frame index sidecar was not persisted (read-only directory?)")
+	}
+}
+
+// TestGetFramesByPage_Concurrent runs paged requests on two files from many goroutines
+// and checks that every caller gets its own frames back.
+func TestGetFramesByPage_Concurrent(t *testing.T) {
+	for _, f := range []string{testPcapFile, inputFilepath} {
+		if _, err := os.Stat(f); os.IsNotExist(err) {
+			t.Skip("skipping test; pcap file not found")
+		}
+	}
+
+	want := make(map[string][]int)
+	for _, f := range []string{testPcapFile, inputFilepath} {
+		frames, _, err := GetFramesByPage(f, 2, 5)
+		if err != nil {
+			t.Fatalf("GetFramesByPage(%s) failed: %v", f, err)
+		}
+		for _, frame := range frames {
+			want[f] = append(want[f], frame.BaseLayers.Frame.Number)
+		}
+	}
+
+	var wg sync.WaitGroup
+	for i := 0; i < 16; i++ {
+		f := testPcapFile
+		if i%2 == 1 {
+			f = inputFilepath
+		}
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			frames, _, err := GetFramesByPage(f, 2, 5)
+			if err != nil {
+				t.Errorf("GetFramesByPage(%s) failed: %v", f, err)
+				return
+			}
+			if len(frames) != len(want[f]) {
+				t.Errorf("%s: got %d frames, want %d", f, len(frames), len(want[f]))
+				return
+			}
+			for j, frame := range frames {
+				if frame.BaseLayers.Frame.Number != want[f][j] {
+					t.Errorf("%s[%d]: got frame %d, want %d", f, j, frame.BaseLayers.Frame.Number, want[f][j])
+				}
+			}
+		}()
+	}
+	wg.Wait()
+}
+
 // TestGetFramesByPage validates the pagination logic.
 func TestGetFramesByPage(t *testing.T) {
 	if _, err := os.Stat(testPcapFile); os.IsNotExist(err) {
@@ -265,6 +464,157 @@ func BenchmarkGetAllFrames(b *testing.B) {
 	}
 }
 
+// BenchmarkSerializeFrameJSON measures the C JSON serializer alone on the fixed
+// proto tree of one frame, in ns/frame and, when built with -tags alloccount,
+// heap allocations per frame.
+func BenchmarkSerializeFrameJSON(b *testing.B) {
+	if _, err := os.Stat(inputFilepath); os.IsNotExist(err) {
+		b.Skip("skipping benchmark; pcap file not found")
+	}
+
+	for _, typed := range []bool{false, true} {
+		b.Run(fmt.Sprintf("typed=%v", typed), func(b *testing.B) {
+			size, elapsed, allocs, err := serializeFrameJSON(inputFilepath, 65, b.N, WithTypedValues(typed))
+			if err != nil {
+				b.Fatal(err)
+			}
+			b.SetBytes(int64(size))
+			b.ReportMetric(float64(elapsed.Nanoseconds())/float64(b.N), "ns/frame")
+			if allocs >= 0 {
+				b.ReportMetric(float64(allocs)/float64(b.N), "allocs/frame")
+			}
+		})
+	}
+}
+
+// TestGetFramesByPage_BinaryMatchesJson checks that binary frames decode to the
+// same layers and base layers as the JSON output, down to the has-value decision
+// of repeated keys and the values left out of the encoding.
+func TestGetFramesByPage_BinaryMatchesJson(t *testing.T) {
+	if _, err := os.Stat(testPcapFile); os.IsNotExist(err) {
+		t.Skip("skipping test; pcap file not found")
+	}
+
+	want, _, err := GetFramesByPage(testPcapFile, 1, 50)
+	if err != nil {
+		t.Fatalf("GetFramesByPage failed: %v", err)
+	}
+	got, _, err := GetFramesByPage(testPcapFile, 1, 50, WithBinaryFrames(true))
+	if err != nil {
+		t.Fatalf("GetFramesByPage (binary) failed: %v", err)
+	}
+	if len(got) != len(want) {
+		t.Fatalf("got %d frames, want %d", len(got), len(want))
+	}
+
+	for i := range want {
+		w, g := want[i], got[i]
+		if g.Index != w.Index {
+			t.Errorf("[%d]: got index %q, want %q", i, g.Index, w.Index)
+		}
+		if !reflect.DeepEqual(g.Layers, w.Layers) {
+			t.Errorf("[%d]: layers differ from the JSON output", i)
+		}
+		if *g.BaseLayers.Frame != *w.BaseLayers.Frame {
+			t.Errorf("[%d]: got frame %+v, want %+v", i, *g.BaseLayers.Frame, *w.BaseLayers.Frame)
+		}
+		if *g.BaseLayers.WsCol != *w.BaseLayers.WsCol {
+			t.Errorf("[%d]: got _ws.col %+v, want %+v", i, *g.BaseLayers.WsCol, *w.BaseLayers.WsCol)
+		}
+		if (g.BaseLayers.Ip == nil) != (w.BaseLayers.Ip == nil) ||
+			g.BaseLayers.Ip != nil && g.BaseLayers.Ip.Src != w.BaseLayers.Ip.Src {
+			t.Errorf("[%d]: ip layer differs", i)
+		}
+	}
+}
+
+// TestGetFramesByPage_Fields checks that field projection returns flat records
+// holding just the requested fields.
+func TestGetFramesByPage_Fields(t *testing.T) {
+	if _, err := os.Stat(testPcapFile); os.IsNotExist(err) {
+		t.Skip("skipping test; pcap file not found")
+	}
+
+	fields := []string{"frame.len", "ip.src", "ip.dst", "tcp.stream"}
+	frames, _, err := GetFramesByPage(testPcapFile, 1, 20, WithFields(fields))
+	if err != nil {
+		t.Fatalf("GetFramesByPage failed: %v", err)
+	}
+	if len(frames) == 0 {
+		t.Fatal("expected frames")
+	}
+
+	allowed := map[string]bool{"frame.number": true}
+	for _, f := range fields {
+		allowed[f] = true
+	}
+	for i, frame := range frames {
+		if frame.Layers != nil {
+			t.Errorf("[%d]: expected no layers with field projection", i)
+		}
+		if frame.BaseLayers.Frame.Number != i+1 {
+			t.Errorf("[%d]: got frame %d, want %d", i, frame.BaseLayers.Frame.Number, i+1)
+		}
+		if _, ok := frame.Fields["frame.len"]; !ok {
+			t.Errorf("[%d]: frame.len missing from %v", i, frame.Fields)
+		}
+		for name := range frame.Fields {
+			if !allowed[name] {
+				t.Errorf("[%d]: unexpected field %s", i, name)
+			}
+		}
+	}
+
+	if _, _, err := GetFramesByPage(testPcapFile, 1, 20, WithFields([]string{"no.such.field"})); err == nil {
+		t.Error("expected an error for an unknown field")
+	}
+}
+
+// BenchmarkDissectAllFrames measures the C dissection loop alone: frames are
+// counted but not parsed. It reports frames/s and Go allocations per frame,
+// with frames handed over one by one and in batches; run it against a large
+// capture with BENCH_PCAP=/path/to/capture.pcap.
+func BenchmarkDissectAllFrames(b *testing.B) {
+	path := os.Getenv("BENCH_PCAP")
+	if path == "" {
+		path = testPcapFile
+	}
+	if _, err := os.Stat(path); os.IsNotExist(err) {
+		b.Skip("skipping benchmark; pcap file not found")
+	}
+
+	for _, batch := range []int{1, 64} {
+		b.Run(fmt.Sprintf("batch=%d", batch), func(b *testing.B) {
+			conf := NewConfig(WithBatch(batch, 1<<20))
+			src := cFrameSource(runAllFrames(path, conf))
+
+			var ms runtime.MemStats
+			runtime.ReadMemStats(&ms)
+			mallocs := ms.Mallocs
+
+			b.ReportAllocs()
+			b.ResetTimer()
+			frames := 0
+			for i := 0; i < b.N; i++ {
+				if err := src(func(batch [][]byte) bool {
+					frames += len(batch)
+					return true
+				}); err != nil {
+					b.Fatal(err)
+				}
+			}
+			b.StopTimer()
+
+			if frames == 0 {
+				b.Fatal("Got 0 frames")
+			}
+			runtime.ReadMemStats(&ms)
+			b.ReportMetric(float64(frames)/b.Elapsed().Seconds(), "frames/s")
+			b.ReportMetric(float64(ms.Mallocs-mallocs)/float64(frames), "allocs/frame")
+		})
+	}
+}
+
 // BenchmarkGetFramesByPage measures pagination performance.
 func BenchmarkGetFramesByPage(b *testing.B) {
 	if _, err := os.Stat(testPcapFile); os.IsNotExist(err) {
@@ -318,6 +668,25 @@ func BenchmarkGetFramesByIdxs_Sparse(b *testing.B) {
 	}
 }
 
+// BenchmarkGetFrameByIdx_Deep measures random access to a frame far into the file.
+func BenchmarkGetFrameByIdx_Deep(b *testing.B) {
+	if _, err := os.Stat(testPcapFile); os.IsNotExist(err) {
+		b.Skip("skipping benchmark; pcap file not found")
+	}
+
+	count, err := BuildFrameIndex(testPcapFile)
+	if err != nil || count == 0 {
+		b.Skipf("skipping benchmark; cannot index pcap: %v", err)
+	}
+
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if _, err := GetFrameByIdx(testPcapFile, count); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
 // BenchmarkGetFramesByIdxs_Batch100 measures batch random access performance.
 func BenchmarkGetFramesByIdxs_Batch100(b *testing.B) {
 	if _, err := os.Stat(testPcapFile); os.IsNotExist(err) {
@@ -1,5 +1,9 @@
 #include "online.h"
 
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
 #define LOG_DEBUG(fmt, ...) \
     fprintf(stderr, "[C-DEBUG] %s:%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
 
@@ -13,10 +17,24 @@ typedef struct device_content {
 
     capture_file *cf_live;
     pcap_t *handle;
+    bool nano_ts;  // the handle delivers nanosecond timestamps
+    int printCJson;
+    packet_ring *ring;         // packets handed from the capture to the dissection thread
+    pthread_t dissect_thread;  // drains ring
+    packet_ring **fanout;      // per-worker rings of a fan-out capture, owned by the caller
+    int fanout_count;
+    int linktype;
+
+    rollover_opts rollover;
+    rollover_stats rollover_stats;
+    int64_t session_start_ns;  // when the current epan session began
+    int64_t rollover_due_ns;   // when a rollover became due, 0 if none is
+    int64_t rss_checked_ns;
     frame_data prev_dis_frame;
     frame_data prev_cap_frame;
     wtap_rec rec;
     epan_dissect_t edt;
+    wmem_allocator_t *json_scope;  // per-frame arena of the JSON serializer
 } device_content;
 
 struct device_map {
@@ -27,26 +45,25 @@ struct device_map {
 
 // global map to restore device info
 struct device_map *devices = NULL;
+// Guards devices. Only the thread that added a device removes it, but any
+// thread may look one up, so lookups that go on to read a device hold it until
+// they are done; remove_device unlinks under it before freeing.
+static pthread_mutex_t devices_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-char *add_device(char *device_name, char *bpf_expr, int num, int promisc, int to_ms, char *options);
+char *add_device(char *device_name, char *bpf_expr, int num, int promisc, int to_ms, char *options,
+                 bool dissect);
 struct device_map *find_device(char *device_name);
 
 void cap_file_init(capture_file *cf);
 char *init_cf_live(capture_file *cf_live, char *options);
 void close_cf_live(capture_file *cf_live);
 
-static bool prepare_data(wtap_rec *rec, const struct pcap_pkthdr *pkthdr);
+static bool prepare_data(wtap_rec *rec, const struct pcap_pkthdr *pkthdr, bool nano_ts);
 static bool send_data_to_wrap(struct device_map *device, int printCJson);
 static bool process_packet(struct device_map *device, gint64 offset,
                            const struct pcap_pkthdr *pkthdr, const u_char *packet, int printCJson);
 void before_callback_init(struct device_map *device);
 
-// pcap_loop callback function arg type
-typedef struct {
-    char device_name[100];
-    int printCJson;
-} callback_arg_t;
-
 void process_packet_callback(u_char *arg, const struct pcap_pkthdr *pkthdr, const u_char *packet);
 char *stop_dissect_capture_pkg(char *device_name);
 // Set up callback function for send packet to Go
@@ -59,47 +76,65 @@ void setDataCallback(DataCallback callback) {
 PART1. Use uthash to implement the logic related to the map of the device
 */
 
+/**
+ * Add a device to the global map. A device that only captures (dissect false)
+ * gets no capture_file and no epan session.
+ */
 char *add_device(char *device_name, char *bpf_expr, int num, int promisc, int to_ms,
-                 char *options) {
+                 char *options, bool dissect) {
     char *err_msg;
     struct device_map *s;
     capture_file *cf_tmp;
 
+    pthread_mutex_lock(&devices_mutex);
     HASH_FIND_STR(devices, device_name, s);
     if (s == NULL) {
         s = (struct device_map *)malloc(sizeof *s);
         memset(s, 0, sizeof(struct device_map));
 
-        cf_tmp = (capture_file *)malloc(sizeof *cf_tmp);
-        cap_file_init(cf_tmp);
-
         s->device_name = device_name;
         s->content.bpf_expr = bpf_expr;
         s->content.num = num;
         s->content.promisc = promisc;
         s->content.to_ms = to_ms;
-        s->content.cf_live = cf_tmp;
-
-        // init capture_file
-        err_msg = init_cf_live(cf_tmp, options);
-        if (err_msg != NULL) {
-            if (strlen(err_msg) != 0) {
-                // close cf file
-                close_cf_live(cf_tmp);
-                return "Add device failed: fail to init cf_live";
+
+        if (dissect) {
+            cf_tmp = (capture_file *)malloc(sizeof *cf_tmp);
+            cap_file_init(cf_tmp);
+            s->content.cf_live = cf_tmp;
+
+            // init capture_file
+            err_msg = init_cf_live(cf_tmp, options);
+            if (err_msg != NULL) {
+                if (strlen(err_msg) != 0) {
+                    // close cf file
+                    close_cf_live(cf_tmp);
+                    free(cf_tmp);
+                    free(s);
+                    pthread_mutex_unlock(&devices_mutex);
+                    return "Add device failed: fail to init cf_live";
+                }
             }
         }
         HASH_ADD_KEYPTR(hh, devices, s->device_name, strlen(s->device_name), s);
+        pthread_mutex_unlock(&devices_mutex);
         return "";
     } else {
+        pthread_mutex_unlock(&devices_mutex);
         return "The device is in use";
     }
 }
 
+/**
+ * Look a device up. The pointer stays valid only for the thread that added the
+ * device; other threads must hold devices_mutex while they use it.
+ */
 struct device_map *find_device(char *device_name) {
     struct device_map *s;
 
+    pthread_mutex_lock(&devices_mutex);
     HASH_FIND_STR(devices, device_name, s);
+    pthread_mutex_unlock(&devices_mutex);
     return s;
 }
 
@@ -108,6 +143,7 @@ PART2. libpcap
 */
 
 #define SNAP_LEN 65535
+#define PACKET_RING_WAIT_US 100000
 #define MAX_BUFFER_SIZE 65536
 
 void process_sockaddr(const struct sockaddr *sockaddr, char *buffer, size_t buffer_size) {
@@ -469,12 +505,13 @@ void close_cf_live(capture_file *cf_live) {
  *
  *  @param rec: wtap_rec for each packet
  *  @param pkthdr: package header
+ *  @param nano_ts: pkthdr->ts.tv_usec holds nanoseconds
  *  @return bool: true or false
  */
-static bool prepare_data(wtap_rec *rec, const struct pcap_pkthdr *pkthdr) {
+static bool prepare_data(wtap_rec *rec, const struct pcap_pkthdr *pkthdr, bool nano_ts) {
     rec->rec_type = REC_TYPE_PACKET;
     rec->presence_flags = WTAP_HAS_TS | WTAP_HAS_CAP_LEN;
-    rec->ts.nsecs = (gint32)pkthdr->ts.tv_usec * 1000;
+    rec->ts.nsecs = nano_ts ? (gint32)pkthdr->ts.tv_usec : (gint32)pkthdr->ts.tv_usec * 1000;
     rec->ts.secs = pkthdr->ts.tv_sec;
     rec->rec_header.packet_header.caplen = pkthdr->caplen;
     rec->rec_header.packet_header.len = pkthdr->len;
@@ -507,8 +544,8 @@ static bool send_data_to_wrap(struct device_map *device, int printCJson) {
     dumper.output_string = g_string_new(NULL);
 
     get_json_proto_tree(NULL, print_dissections_expanded, TRUE, NULL, PF_INCLUDE_CHILDREN,
-                        &device->content.edt, &device->content.cf_live->cinfo,
-                        proto_node_group_children_by_json_key, &dumper);
+                        &device->content.edt, &device->content.cf_live->cinfo, &dumper, false,
+                        device->content.json_scope);
 
     // Get JSON string from json_dumper
     if (json_dumper_finish(&dumper)) {
@@ -555,6 +592,7 @@ static bool process_packet(struct device_map *device, gint64 offset,
     guint32 cum_bytes = 0;
 
     device->content.cf_live->count++;
+    device->content.rollover_stats.session_packets++;
 
     frame_data_init(&fd, device->content.cf_live->count, &device->content.rec, offset, cum_bytes);
 
@@ -590,45 +628,417 @@ static bool process_packet(struct device_map *device, gint64 offset,
     return true;
 }
 
+// --- Session Rollover ---
+
+#define ROLLOVER_DEFAULT_GRACE_MS 1000
+#define ROLLOVER_RSS_CHECK_NS 1000000000LL
+
+static int64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Resident memory of this process in bytes, 0 if unknown.
+ */
+static int64_t process_rss(void) {
+    long pages = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f == NULL) {
+        return 0;
+    }
+    if (fscanf(f, "%*ld %ld", &pages) != 1) {
+        pages = 0;
+    }
+    fclose(f);
+    return (int64_t)pages * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * Replace the epan session of a device with a fresh one. Everything the old
+ * session accumulated goes with it: conversations, reassembly tables and the
+ * file-scoped allocations of the dissectors. Frame numbers keep counting.
+ */
+static void rollover_session(struct device_map *device) {
+    capture_file *cf = device->content.cf_live;
+    int64_t start = monotonic_ns();
+
+    epan_dissect_cleanup(&device->content.edt);
+    free_frame_data_sequence(cf->provider.frames);
+    cf->provider.frames = new_frame_data_sequence();
+    cf->provider.ref = NULL;
+    cf->provider.prev_dis = NULL;
+    cf->provider.prev_cap = NULL;
+    nstime_set_zero(&cf->elapsed_time);
+
+    epan_free(cf->epan);
+    cf->epan = raw_epan_new(cf);
+    epan_dissect_init(&device->content.edt, cf->epan, TRUE, TRUE);
+    wmem_free_all(device->content.json_scope);
+
+    int64_t end = monotonic_ns();
+    rollover_stats *st = &device->content.rollover_stats;
+    st->rollovers++;
+    st->session_packets = 0;
+    st->last_pause_ns = end - start;
+    st->total_pause_ns += st->last_pause_ns;
+    if (st->last_pause_ns > st->max_pause_ns) {
+        st->max_pause_ns = st->last_pause_ns;
+    }
+    device->content.session_start_ns = end;
+    device->content.rollover_due_ns = 0;
+}
+
+/**
+ * Roll the session over once the policy of the device asks for it. A due
+ * rollover waits for a lull, when no packets are waiting, so that few
+ * conversations are cut off in the middle of a reassembly; after the grace
+ * period it happens regardless.
+ *
+ *  @param idle: no packets are waiting to be dissected
+ */
+static void maybe_rollover(struct device_map *device, bool idle) {
+    const rollover_opts *opts = &device->content.rollover;
+    if (opts->packets <= 0 && opts->interval_ms <= 0 && opts->max_rss <= 0) {
+        return;
+    }
+
+    int64_t now = monotonic_ns();
+    if (device->content.rollover_due_ns == 0) {
+        bool due =
+            (opts->packets > 0 &&
+             device->content.rollover_stats.session_packets >= (uint64_t)opts->packets) ||
+            (opts->interval_ms > 0 &&
+             now - device->content.session_start_ns >= opts->interval_ms * 1000000LL);
+        if (!due && opts->max_rss > 0 &&
+            now - device->content.rss_checked_ns >= ROLLOVER_RSS_CHECK_NS) {
+            device->content.rss_checked_ns = now;
+            due = process_rss() > opts->max_rss;
+        }
+        if (!due) {
+            return;
+        }
+        device->content.rollover_due_ns = now;
+    }
+
+    int64_t grace_ms = opts->grace_ms > 0 ? opts->grace_ms : ROLLOVER_DEFAULT_GRACE_MS;
+    if (idle || now - device->content.rollover_due_ns >= grace_ms * 1000000LL) {
+        rollover_session(device);
+    }
+}
+
 void before_callback_init(struct device_map *device) {
     epan_dissect_init(&device->content.edt, device->content.cf_live->epan, TRUE, TRUE);
+    device->content.session_start_ns = monotonic_ns();
     wtap_rec_init(&device->content.rec, 1514);
+    if (device->content.json_scope == NULL) {
+        device->content.json_scope = wmem_allocator_new(WMEM_ALLOCATOR_BLOCK_FAST);
+    }
 
     return;
 }
 
 /**
- * Dissect each package in real time.
+ * Copy each captured packet into the device's ring. This runs on the capture
+ * thread, so it does nothing else: a stall here leaves packets in the kernel
+ * buffer until it overflows.
  *
- *  @param arg: user argument
+ *  @param arg: the device's packet_ring
  *  @param pkthdr: package header
  *  @param packet: package content
  */
 void process_packet_callback(u_char *arg, const struct pcap_pkthdr *pkthdr, const u_char *packet) {
-    LOG_DEBUG("Callback triggered. Len: %d", pkthdr->len);
+    packet_ring_push((packet_ring *)arg, pkthdr, packet);
+}
 
-    callback_arg_t *args = (callback_arg_t *)arg;
-    int printCJson = (int)args->printCJson;
-    char *device_name = (char *)args->device_name;
+/**
+ * Dissect the packets of a device's ring in capture order, until the ring is
+ * closed and drained.
+ *
+ *  @param arg: a device in global device map
+ */
+static void *dissect_thread_main(void *arg) {
+    struct device_map *device = (struct device_map *)arg;
+    packet_ring *ring = device->content.ring;
+    struct pcap_pkthdr pkthdr;
+    const u_char *packet;
+
+    while (packet_ring_wait(ring, PACKET_RING_WAIT_US)) {
+        while ((packet = packet_ring_claim(ring, &pkthdr)) != NULL) {
+            if (!prepare_data(&device->content.rec, &pkthdr, device->content.nano_ts)) {
+                LOG_DEBUG("prepare_data failed");
+                wtap_rec_cleanup(&device->content.rec);
+            } else if (!process_packet(device, 0, &pkthdr, packet, device->content.printCJson)) {
+                LOG_DEBUG("process_packet returned false");
+            }
+            packet_ring_release(ring);
+            maybe_rollover(device, false);
+        }
+        maybe_rollover(device, true);
+    }
+    return NULL;
+}
 
-    struct device_map *device = find_device(device_name);
-    if (!device) {
-        LOG_DEBUG("ERROR: Device not found in callback: %s", device_name);
-        return;
+// --- Flow Fan-out ---
+
+#define FLOW_ETHERTYPE_IPV4 0x0800
+#define FLOW_ETHERTYPE_IPV6 0x86dd
+#define FLOW_IPPROTO_TCP 6
+
+static inline uint16_t flow_u16(const u_char *p) { return (uint16_t)(p[0] << 8 | p[1]); }
+
+static uint64_t flow_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb3fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t flow_endpoint(const u_char *addr, int addr_len, uint16_t port) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < addr_len; i++) {
+        h = (h ^ addr[i]) * 0x100000001b3ULL;
     }
+    return flow_mix(h ^ port);
+}
 
-    gchar *err_info = NULL;
-    gint64 data_offset = 0;
-    if (!prepare_data(&device->content.rec, pkthdr)) {
-        LOG_DEBUG("prepare_data failed");
-        wtap_rec_cleanup(&device->content.rec);
+/**
+ * Hash the conversation of a packet the same way for both of its directions.
+ * TCP packets hash their addresses and ports; everything else only the
+ * addresses, so that the fragments of a datagram, which carry no ports after
+ * the first, stay together. Packets that are not IP hash to 0.
+ *
+ *  @param linktype: DLT_* of the capture
+ */
+static uint32_t flow_hash(const u_char *data, uint32_t caplen, int linktype) {
+    uint32_t off;
+    uint16_t ethertype;
+
+    switch (linktype) {
+        case DLT_EN10MB:
+            if (caplen < 14) {
+                return 0;
+            }
+            ethertype = flow_u16(data + 12);
+            off = 14;
+            // 802.1Q and 802.1ad tags
+            while ((ethertype == 0x8100 || ethertype == 0x88a8 || ethertype == 0x9100) &&
+                   caplen >= off + 4) {
+                ethertype = flow_u16(data + off + 2);
+                off += 4;
+            }
+            break;
+        case DLT_LINUX_SLL:
+            if (caplen < 16) {
+                return 0;
+            }
+            ethertype = flow_u16(data + 14);
+            off = 16;
+            break;
+        case DLT_RAW:
+            if (caplen < 1) {
+                return 0;
+            }
+            ethertype = (data[0] >> 4) == 6 ? FLOW_ETHERTYPE_IPV6 : FLOW_ETHERTYPE_IPV4;
+            off = 0;
+            break;
+        default:
+            return 0;
+    }
+
+    const u_char *src, *dst;
+    int addr_len;
+    uint32_t l4;
+    uint8_t proto;
+    bool whole;  // the packet is not a fragment
+
+    if (ethertype == FLOW_ETHERTYPE_IPV4 && caplen >= off + 20) {
+        const u_char *ip = data + off;
+        proto = ip[9];
+        src = ip + 12;
+        dst = ip + 16;
+        addr_len = 4;
+        l4 = off + (ip[0] & 0x0f) * 4;
+        whole = (flow_u16(ip + 6) & 0x3fff) == 0;
+    } else if (ethertype == FLOW_ETHERTYPE_IPV6 && caplen >= off + 40) {
+        const u_char *ip = data + off;
+        proto = ip[6];
+        src = ip + 8;
+        dst = ip + 24;
+        addr_len = 16;
+        l4 = off + 40;
+        whole = true;
+    } else {
+        return 0;
+    }
+
+    uint16_t sport = 0, dport = 0;
+    if (proto == FLOW_IPPROTO_TCP && whole && caplen >= l4 + 4) {
+        sport = flow_u16(data + l4);
+        dport = flow_u16(data + l4 + 2);
+    }
+
+    uint64_t a = flow_endpoint(src, addr_len, sport);
+    uint64_t b = flow_endpoint(dst, addr_len, dport);
+    return (uint32_t)flow_mix(a < b ? a * 31 + b : b * 31 + a);
+}
+
+/**
+ * Route each captured packet of a fan-out capture to the ring of the worker
+ * that owns its conversation. Timestamps go in as nanoseconds.
+ *
+ *  @param arg: the device
+ */
+static void fanout_packet_callback(u_char *arg, const struct pcap_pkthdr *pkthdr,
+                                   const u_char *packet) {
+    struct device_map *device = (struct device_map *)arg;
+    struct pcap_pkthdr hdr = *pkthdr;
+
+    if (!device->content.nano_ts) {
+        hdr.ts.tv_usec *= 1000;
+    }
+    uint32_t h = flow_hash(packet, pkthdr->caplen, device->content.linktype);
+    packet_ring_push(device->content.fanout[h % (uint32_t)device->content.fanout_count], &hdr,
+                     packet);
+}
+
+/**
+ * Counters of the ring of a device, summed over the rings of a fan-out
+ * capture (the high-water mark is the highest of them).
+ */
+static void device_ring_stats(struct device_map *device, packet_ring_stats *stats) {
+    if (device->content.fanout_count == 0) {
+        packet_ring_get_stats(device->content.ring, stats);
         return;
     }
 
-    bool ret = process_packet(device, data_offset, pkthdr, packet, printCJson);
-    if (!ret) {
-        LOG_DEBUG("process_packet returned false");
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < device->content.fanout_count; i++) {
+        packet_ring_stats rs;
+        packet_ring_get_stats(device->content.fanout[i], &rs);
+        stats->capacity += rs.capacity;
+        stats->used += rs.used;
+        stats->queued += rs.queued;
+        stats->pushed += rs.pushed;
+        stats->consumed += rs.consumed;
+        stats->dropped += rs.dropped;
+        stats->evicted += rs.evicted;
+        if (rs.high_water > stats->high_water) {
+            stats->high_water = rs.high_water;
+        }
+    }
+}
+
+/**
+ * Create and activate a capture handle tuned by opts, through pcap_create so
+ * that the buffer size, immediate mode and timestamp precision can be set
+ * before activation.
+ *
+ *  @param opts: capture tuning, NULL for the defaults
+ *  @param err_buf: receives the error message on failure
+ *  @return pcap_t: the handle, NULL on failure
+ */
+static pcap_t *open_capture_handle(const char *device_name, int promisc, int to_ms,
+                                   const capture_opts *opts, char *err_buf) {
+    pcap_t *handle = pcap_create(device_name, err_buf);
+    if (!handle) {
+        return NULL;
+    }
+
+    pcap_set_snaplen(handle, opts != NULL && opts->snaplen > 0 ? opts->snaplen : SNAP_LEN);
+    pcap_set_promisc(handle, promisc);
+    pcap_set_timeout(handle, to_ms);
+    if (opts != NULL) {
+        if (opts->buffer_size > 0) {
+            pcap_set_buffer_size(handle, opts->buffer_size);
+        }
+        if (opts->immediate) {
+            pcap_set_immediate_mode(handle, 1);
+        }
+        // Devices without support keep microseconds; capture_stats.nano_timestamps tells.
+        if (opts->nano_timestamps) {
+            pcap_set_tstamp_precision(handle, PCAP_TSTAMP_PRECISION_NANO);
+        }
+    }
+
+    int status = pcap_activate(handle);
+    if (status < 0) {
+        const char *msg = pcap_geterr(handle);
+        snprintf(err_buf, PCAP_ERRBUF_SIZE, "%s",
+                 msg != NULL && msg[0] != '\0' ? msg : pcap_statustostr(status));
+        pcap_close(handle);
+        return NULL;
+    }
+    return handle;
+}
+
+/**
+ * Close the capture state of a device and remove it from the global map.
+ */
+static void remove_device(struct device_map *device) {
+    // Unlink first: a reader still using the device holds devices_mutex, and no
+    // one finds it afterwards.
+    pthread_mutex_lock(&devices_mutex);
+    HASH_DEL(devices, device);
+    pthread_mutex_unlock(&devices_mutex);
+
+    if (device->content.handle) {
+        pcap_close(device->content.handle);
+        device->content.handle = NULL;
+    }
+    packet_ring_free(device->content.ring);
+    if (device->content.cf_live != NULL) {
+        close_cf_live(device->content.cf_live);
+        free(device->content.cf_live);
     }
+    if (device->content.json_scope != NULL) {
+        wmem_destroy_allocator(device->content.json_scope);
+    }
+    free(device);
+}
+
+/**
+ * Capture on the calling thread into the device's ring while a second thread
+ * dissects, until pcap_loop returns and the ring is drained.
+ *
+ *  @return char: NULL, or an error message after removing the device
+ */
+static char *capture_and_dissect(struct device_map *device, const capture_opts *opts,
+                                 int printCJson) {
+    int64_t ring_size = PACKET_RING_DEFAULT_SIZE;
+    packet_ring_policy ring_policy = PACKET_RING_DROP_NEWEST;
+    if (opts != NULL) {
+        if (opts->ring_size > 0) {
+            ring_size = opts->ring_size;
+        }
+        ring_policy = (packet_ring_policy)opts->ring_policy;
+    }
+    device->content.ring = packet_ring_new((uint64_t)ring_size, ring_policy);
+    if (!device->content.ring) {
+        remove_device(device);
+        return "Could not allocate the packet ring";
+    }
+    device->content.printCJson = printCJson;
+    if (opts != NULL) {
+        device->content.rollover = opts->rollover;
+    }
+    before_callback_init(device);
+    if (pthread_create(&device->content.dissect_thread, NULL, dissect_thread_main, device) != 0) {
+        remove_device(device);
+        return "Could not start the dissection thread";
+    }
+
+    pcap_loop(device->content.handle, device->content.num, process_packet_callback,
+              (u_char *)device->content.ring);
+
+    // Let the dissection thread drain what was captured.
+    packet_ring_close(device->content.ring);
+    pthread_join(device->content.dissect_thread, NULL);
+
+    return NULL;
 }
 
 /**
@@ -641,16 +1051,21 @@ void process_packet_callback(u_char *arg, const struct pcap_pkthdr *pkthdr, cons
  * indicates a promiscuous mode
  *  @param to_ms: The timeout period for libpcap to capture packets from the
  * device
+ *  @param opts: capture handle and ring tuning, NULL for the defaults
+ *  @param final_stats: receives the counters at the end, may be NULL
  *  @return char: error message
  */
 char *handle_packet(char *device_name, char *bpf_expr, int num, int promisc, int to_ms,
-                    int printCJson, char *options) {
+                    int printCJson, char *options, const capture_opts *opts,
+                    capture_stats *final_stats) {
     LOG_DEBUG("Starting handle_packet for device: %s", device_name);
     char *err_msg;
     char err_buf[PCAP_ERRBUF_SIZE];
 
+    bool fanout = opts != NULL && opts->fanout_count > 0;
+
     // add a device to global device map
-    err_msg = add_device(device_name, bpf_expr, num, promisc, to_ms, options);
+    err_msg = add_device(device_name, bpf_expr, num, promisc, to_ms, options, !fanout);
     if (err_msg != NULL) {
         if (strlen(err_msg) != 0) {
             LOG_DEBUG("add_device failed: %s", err_msg);
@@ -666,14 +1081,17 @@ char *handle_packet(char *device_name, char *bpf_expr, int num, int promisc, int
     }
 
     // open device && gen a libpcap handle
-    device->content.handle = pcap_open_live(device->device_name, SNAP_LEN, device->content.promisc,
-                                            device->content.to_ms, err_buf);
+    device->content.handle = open_capture_handle(device->device_name, device->content.promisc,
+                                                 device->content.to_ms, opts, err_buf);
     if (!device->content.handle) {
-        LOG_DEBUG("pcap_open_live failed: %s", err_buf);
-        close_cf_live(device->content.cf_live);
-        return "pcap_open_live() couldn't open device";
+        LOG_DEBUG("pcap_activate failed: %s", err_buf);
+        remove_device(device);
+        return "pcap_activate() couldn't open device";
     }
-    LOG_DEBUG("pcap_open_live success. Handle: %p", device->content.handle);
+    device->content.nano_ts =
+        pcap_get_tstamp_precision(device->content.handle) == PCAP_TSTAMP_PRECISION_NANO;
+    device->content.linktype = pcap_datalink(device->content.handle);
+    LOG_DEBUG("pcap_activate success. Handle: %p", device->content.handle);
 
     // bpf filter
     struct bpf_program fp;
@@ -689,48 +1107,176 @@ char *handle_packet(char *device_name, char *bpf_expr, int num, int promisc, int
     if (pcap_compile(device->content.handle, &fp, device->content.bpf_expr, 0, net) != 0) {
         fprintf(stderr, "Could not parse bpf filter %s: %s\n", device->content.bpf_expr,
                 pcap_geterr(device->content.handle));
+        remove_device(device);
         return "Could not parse bpf filter";
     }
 
     if (pcap_setfilter(device->content.handle, &fp) != 0) {
         fprintf(stderr, "Could not set filter %s: %s\n", device->content.bpf_expr,
                 pcap_geterr(device->content.handle));
+        pcap_freecode(&fp);
+        remove_device(device);
         return "Could not set bpf filter";
     }
+    pcap_freecode(&fp);
 
     printf("Start capture packet on device:%s bpf: %s \n", device->device_name,
            device->content.bpf_expr);
 
-    // handle pcap_loop callback function args
-    callback_arg_t args;
-    strncpy(args.device_name, device_name, sizeof(args.device_name) - 1);
-    args.device_name[sizeof(args.device_name) - 1] = '\0';
-    args.printCJson = printCJson;
-
-    // loop and dissect pkg
-    before_callback_init(device);
-    LOG_DEBUG("Entering pcap_loop...");
-    int loop_ret = pcap_loop(device->content.handle, device->content.num, process_packet_callback,
-                             (u_char *)&args);
-    LOG_DEBUG("pcap_loop returned with code: %d", loop_ret);
+    if (fanout) {
+        // Capture only: the owners of the rings dissect.
+        device->content.fanout = opts->fanout;
+        device->content.fanout_count = opts->fanout_count;
+        int loop_ret = pcap_loop(device->content.handle, device->content.num,
+                                 fanout_packet_callback, (u_char *)device);
+        LOG_DEBUG("pcap_loop returned with code: %d", loop_ret);
+        for (int i = 0; i < device->content.fanout_count; i++) {
+            packet_ring_close(device->content.fanout[i]);
+        }
+    } else {
+        char *err = capture_and_dissect(device, opts, printCJson);
+        if (err != NULL) {
+            return err;
+        }
+    }
 
     LOG_DEBUG("Starting cleanup...");
 
-    if (device->content.handle) {
-        pcap_close(device->content.handle);
-        device->content.handle = NULL;
+    if (final_stats != NULL) {
+        if (pcap_stats(device->content.handle, &final_stats->pcap) != 0) {
+            memset(&final_stats->pcap, 0, sizeof(final_stats->pcap));
+        }
+        device_ring_stats(device, &final_stats->ring);
+        final_stats->rollover = device->content.rollover_stats;
+        final_stats->nano_timestamps = device->content.nano_ts;
     }
-    close_cf_live(device->content.cf_live);
 
     /* 从 map 中移除设备 */
-    HASH_DEL(devices, device);
-    free(device->content.cf_live);
-    free(device);
+    remove_device(device);
 
     LOG_DEBUG("Cleanup finished. handle_packet returning.");
     return "";
 }
 
+/**
+ * Read the counters of a running capture: packets received, dropped for lack
+ * of buffer space and dropped by the interface according to libpcap, and the
+ * occupancy and drops of the packet ring.
+ *
+ * It runs on any thread, so it holds devices_mutex across the lookup and the
+ * reads, which keeps the capture thread from freeing the device meanwhile.
+ *
+ *  @return int: 0, or -1 if the device is not capturing
+ */
+int get_capture_stats(char *device_name, capture_stats *stats) {
+    struct device_map *device;
+    int ret = -1;
+
+    pthread_mutex_lock(&devices_mutex);
+    HASH_FIND_STR(devices, device_name, device);
+    if (device && device->content.handle &&
+        (device->content.ring || device->content.fanout_count > 0) &&
+        pcap_stats(device->content.handle, &stats->pcap) == 0) {
+        device_ring_stats(device, &stats->ring);
+        stats->rollover = device->content.rollover_stats;
+        stats->nano_timestamps = device->content.nano_ts;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&devices_mutex);
+    return ret;
+}
+
+// --- Live Feeds ---
+
+/**
+ * Open a feed: a device without a capture handle, dissecting packets handed to
+ * it by live_feed_dissect.
+ *
+ *  @param name: key of the feed in the device map, passed to the DataCallback
+ *  @return char: error message, "" on success
+ */
+char *live_feed_open(char *name, char *options, const capture_opts *opts) {
+    char *err_msg = add_device(name, "", 0, 0, 0, options, true);
+    if (strlen(err_msg) != 0) {
+        return err_msg;
+    }
+    struct device_map *device = find_device(name);
+    device->content.nano_ts = true;
+    if (opts != NULL) {
+        device->content.rollover = opts->rollover;
+    }
+    before_callback_init(device);
+    return "";
+}
+
+/**
+ * Dissect packet records (PACKET_RING_RECORD_HDR, with nanosecond timestamps)
+ * in order and hand every frame to the DataCallback. The sender drains its ring
+ * into each call, so the end of the records counts as a lull for the rollover.
+ * A truncated last record, which packet_ring_read never produces, is ignored.
+ */
+void live_feed_dissect(char *name, const uint8_t *records, int len, int printCJson) {
+    struct device_map *device = find_device(name);
+    if (!device) {
+        return;
+    }
+
+    int off = 0;
+    while (off + PACKET_RING_RECORD_HDR <= len) {
+        struct pcap_pkthdr hdr;
+        int64_t sec;
+        int32_t nsec;
+        memcpy(&sec, records + off, 8);
+        memcpy(&nsec, records + off + 8, 4);
+        memcpy(&hdr.caplen, records + off + 12, 4);
+        memcpy(&hdr.len, records + off + 16, 4);
+        hdr.ts.tv_sec = (time_t)sec;
+        hdr.ts.tv_usec = nsec;
+        if (hdr.caplen > (uint32_t)(len - off - PACKET_RING_RECORD_HDR)) {
+            return;
+        }
+
+        const u_char *packet = records + off + PACKET_RING_RECORD_HDR;
+        if (!prepare_data(&device->content.rec, &hdr, true)) {
+            wtap_rec_cleanup(&device->content.rec);
+        } else {
+            process_packet(device, 0, &hdr, packet, printCJson);
+        }
+        off += PACKET_RING_RECORD_HDR + (int)hdr.caplen;
+        maybe_rollover(device, false);
+    }
+    maybe_rollover(device, true);
+}
+
+/**
+ * Read the rollover counters of a feed.
+ *
+ *  @return int: 0, or -1 if no feed of that name is open
+ */
+int live_feed_stats(char *name, rollover_stats *stats) {
+    struct device_map *device;
+    int ret = -1;
+
+    pthread_mutex_lock(&devices_mutex);
+    HASH_FIND_STR(devices, name, device);
+    if (device && !device->content.handle) {
+        *stats = device->content.rollover_stats;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&devices_mutex);
+    return ret;
+}
+
+/**
+ * Close a feed and free its dissection state.
+ */
+void live_feed_close(char *name) {
+    struct device_map *device = find_device(name);
+    if (device) {
+        remove_device(device);
+    }
+}
+
 /**
  * Stop capture packet live、 free all memory allocated.
  *
@@ -740,19 +1286,26 @@ char *handle_packet(char *device_name, char *bpf_expr, int num, int promisc, int
 char *stop_dissect_capture_pkg(char *device_name) {
     LOG_DEBUG("stop_dissect_capture_pkg called for: %s", device_name);
 
-    struct device_map *device = find_device(device_name);
+    // Called from another thread than the capture: keep the device alive
+    // until the loop is broken.
+    struct device_map *device;
+    pthread_mutex_lock(&devices_mutex);
+    HASH_FIND_STR(devices, device_name, device);
     if (!device) {
+        pthread_mutex_unlock(&devices_mutex);
         LOG_DEBUG("Device not found in map (maybe already stopped?)");
         return "The device is not in the global map";
     }
 
-    if (!device || !device->content.handle) {
+    if (!device->content.handle) {
+        pthread_mutex_unlock(&devices_mutex);
         LOG_DEBUG("Device handle is NULL");
         return "This device has no pcap_handle, no need to close";
     }
 
     LOG_DEBUG("Calling pcap_breakloop on handle: %p", device->content.handle);
     pcap_breakloop(device->content.handle);
+    pthread_mutex_unlock(&devices_mutex);
     LOG_DEBUG("pcap_breakloop called");
 
     return "";
@@ -8,20 +8,29 @@ package pkg
 */
 import "C"
 import (
+	"bufio"
 	"log/slog"
+	"os"
+	"strconv"
 	"sync"
+	"time"
 	"unsafe"
 
 	"github.com/bytedance/sonic"
 	"github.com/pkg/errors"
 )
 
-// frameDataChanMap stores channels for live capture results, keyed by interface name.
+// liveQueues decode the frames of the live captures into their channels, keyed
+// by interface name.
 var (
-	frameDataChanMap = make(map[string]chan FrameData)
-	mapMutex         sync.RWMutex
+	liveQueues = make(map[string]*liveQueue)
+	mapMutex   sync.RWMutex
 )
 
+// liveFeedSinks receive the raw frames of the live feeds of this process, keyed
+// by feed name, instead of an interface channel. Guarded by mapMutex.
+var liveFeedSinks = make(map[string]func(frame []byte))
+
 // FrameDataChan is the public map for accessing capture channels
 var FrameDataChan = make(map[string]chan FrameData)
 
@@ -41,11 +50,115 @@ type IFace struct {
 	Addresses   []PcapAddr `json:"addresses"`             // List of addresses associated with the interface
 }
 
+// CaptureStats are the counters of a live capture: libpcap's, for the kernel;
+// those of the ring that hands packets from the capture thread to the
+// dissection thread; and those of the queue that hands the dissected frames to
+// the interface channel.
+type CaptureStats struct {
+	Received  uint32 `json:"received"`  // Packets that passed the BPF filter
+	Dropped   uint32 `json:"dropped"`   // Packets dropped because the buffer was full
+	IfDropped uint32 `json:"ifDropped"` // Packets dropped by the interface or its driver
+
+	RingSize      uint64 `json:"ringSize"`      // Ring capacity in bytes
+	RingUsed      uint64 `json:"ringUsed"`      // Bytes waiting for dissection
+	RingHighWater uint64 `json:"ringHighWater"` // Most bytes ever waiting
+	RingQueued    uint64 `json:"ringQueued"`    // Packets waiting for dissection
+	RingDissected uint64 `json:"ringDissected"` // Packets taken from the ring for dissection
+	RingDropped   uint64 `json:"ringDropped"`   // Captured packets discarded because the ring was full
+	RingEvicted   uint64 `json:"ringEvicted"`   // Queued packets discarded by RingDropOldest
+
+	Rollovers          uint64        `json:"rollovers"`          // Epan sessions replaced by WithRollover
+	SessionPackets     uint64        `json:"sessionPackets"`     // Packets dissected in the current session
+	RolloverPauseLast  time.Duration `json:"rolloverPauseLast"`  // Dissection pause of the last rollover
+	RolloverPauseMax   time.Duration `json:"rolloverPauseMax"`   // Longest rollover pause
+	RolloverPauseTotal time.Duration `json:"rolloverPauseTotal"` // Sum of all rollover pauses
+
+	QueueDropped uint64 `json:"queueDropped"` // Frames discarded because the parse queue was full
+	QueueSampled uint64 `json:"queueSampled"` // Frames skipped by LiveSample
+	ChanDropped  uint64 `json:"chanDropped"`  // Decoded frames discarded because the channel was full
+	ParseErrors  uint64 `json:"parseErrors"`  // Frames that could not be decoded
+
+	NanoTimestamps bool `json:"nanoTimestamps"` // Timestamps carry nanoseconds, not microseconds
+}
+
+// finalCaptureStats keeps the counters of the last finished capture per
+// interface, guarded by mapMutex.
+var finalCaptureStats = make(map[string]CaptureStats)
+
+func captureStatsFromC(st *C.capture_stats) CaptureStats {
+	return CaptureStats{
+		Received:      uint32(st.pcap.ps_recv),
+		Dropped:       uint32(st.pcap.ps_drop),
+		IfDropped:     uint32(st.pcap.ps_ifdrop),
+		RingSize:      uint64(st.ring.capacity),
+		RingUsed:      uint64(st.ring.used),
+		RingHighWater: uint64(st.ring.high_water),
+		RingQueued:    uint64(st.ring.queued),
+		RingDissected: uint64(st.ring.consumed),
+		RingDropped:   uint64(st.ring.dropped),
+		RingEvicted:   uint64(st.ring.evicted),
+
+		Rollovers:          uint64(st.rollover.rollovers),
+		SessionPackets:     uint64(st.rollover.session_packets),
+		RolloverPauseLast:  time.Duration(st.rollover.last_pause_ns),
+		RolloverPauseMax:   time.Duration(st.rollover.max_pause_ns),
+		RolloverPauseTotal: time.Duration(st.rollover.total_pause_ns),
+
+		NanoTimestamps: bool(st.nano_timestamps),
+	}
+}
+
+// captureOpts translates the live capture settings of conf for C.
+func captureOpts(conf *Conf) C.capture_opts {
+	return C.capture_opts{
+		snaplen:         C.int(conf.Snaplen),
+		buffer_size:     C.int(conf.BufferSize),
+		immediate:       C.bool(conf.ImmediateMode),
+		nano_timestamps: C.bool(conf.NanoTimestamps),
+		ring_size:       C.int64_t(conf.RingSize),
+		ring_policy:     C.int(conf.RingPolicy),
+		rollover: C.rollover_opts{
+			packets:     C.int64_t(conf.Rollover.Packets),
+			interval_ms: C.int64_t(conf.Rollover.Interval.Milliseconds()),
+			max_rss:     C.int64_t(conf.Rollover.MaxRSS),
+			grace_ms:    C.int64_t(conf.Rollover.Grace.Milliseconds()),
+		},
+	}
+}
+
+// GetLiveCaptureStats returns the counters of the capture running on an
+// interface, or those of the last capture there once it has finished.
+func GetLiveCaptureStats(interfaceName string) (CaptureStats, error) {
+	cIfName := C.CString(interfaceName)
+	defer C.free(unsafe.Pointer(cIfName))
+
+	var st C.capture_stats
+	running := C.get_capture_stats(cIfName, &st) == 0
+
+	mapMutex.RLock()
+	defer mapMutex.RUnlock()
+	stats, ok := finalCaptureStats[interfaceName]
+	if running {
+		stats, ok = captureStatsFromC(&st), true
+	}
+	if !ok {
+		return CaptureStats{}, errors.Errorf("no capture on %s", interfaceName)
+	}
+	// The frames of a finished capture may still be on their way to the channel.
+	if q, ok := liveQueues[interfaceName]; ok {
+		q.fillStats(&stats)
+	}
+	return stats, nil
+}
+
 // GetIfaceChannel safely retrieves the channel for a specific interface.
 func GetIfaceChannel(ifaceName string) <-chan FrameData {
 	mapMutex.RLock()
 	defer mapMutex.RUnlock()
-	return frameDataChanMap[ifaceName]
+	if q, ok := liveQueues[ifaceName]; ok {
+		return q.out
+	}
+	return nil
 }
 
 // ParseIFace parses the JSON representation of interface lists.
@@ -126,23 +239,28 @@ func GetDataCallback(data *C.char, length C.int, interfaceName *C.char) {
 		interfaceNameStr = C.GoString(interfaceName)
 	}
 
-	frame, err := ParseFrameData(goPacket)
-	if err != nil {
-		slog.Warn("Error parsing frame data", "err", err)
+	mapMutex.RLock()
+	sink := liveFeedSinks[interfaceNameStr]
+	mapMutex.RUnlock()
+	if sink != nil {
+		sink(goPacket)
 		return
 	}
 
-	// Use safe map access
+	deliverLiveFrame(interfaceNameStr, goPacket)
+}
+
+// deliverLiveFrame queues a frame of a live capture for decoding, dropping it
+// if the capture is gone. Decoding happens on the parsers of the queue, not on
+// the dissection thread that calls this. A push that waits under LiveBlock only
+// holds up its own capture: mapMutex is not held across it.
+func deliverLiveFrame(interfaceName string, data []byte) {
 	mapMutex.RLock()
-	ch, ok := frameDataChanMap[interfaceNameStr]
+	q := liveQueues[interfaceName]
 	mapMutex.RUnlock()
 
-	if ok {
-		select {
-		case ch <- *frame:
-		default:
-			slog.Warn("Channel full, dropping packet", "interface", interfaceNameStr)
-		}
+	if q != nil {
+		q.push(data)
 	}
 }
 
@@ -154,21 +272,70 @@ func GetDataCallback(data *C.char, length C.int, interfaceName *C.char) {
 // packetCount: Number of packets to capture (-1 for infinite).
 // promisc: 1 for promiscuous mode, 0 otherwise.
 // timeout: Read timeout in milliseconds.
+//
+// WithSnaplen, WithBufferSize, WithImmediateMode and WithNanoTimestamps tune the
+// capture handle. The calling thread only captures; packets are copied into a
+// ring, sized by WithRingSize, and dissected on a separate thread, so a slow
+// dissection does not keep the kernel buffer from being drained. The drop
+// counters are available from GetLiveCaptureStats, during the capture and after
+// it returns.
+//
+// WithRollover bounds the memory of captures that run indefinitely, by replacing
+// the dissection session at intervals.
+//
+// The dissected frames are decoded into FrameData by WithLiveParsers goroutines
+// and delivered in order. WithLiveQueue and WithLivePolicy decide what happens
+// when they or the channel's consumer fall behind. The channel is closed once
+// the capture ends, after the frames already on it.
 func StartLivePacketCapture(interfaceName, bpfFilter string, packetCount, promisc, timeout int, opts ...Option) (err error) {
 	if interfaceName == "" {
 		return errors.New("device name is blank")
 	}
 
-	// Initialize channel for this interface
+	conf := NewConfig(opts...)
+	if err := openLiveChannel(interfaceName, conf); err != nil {
+		return err
+	}
+	return captureLive(interfaceName, bpfFilter, packetCount, promisc, timeout, conf, nil)
+}
+
+// openLiveChannel creates the frame channel of a capture on interfaceName,
+// with the queue that decodes into it.
+func openLiveChannel(interfaceName string, conf *Conf) error {
 	mapMutex.Lock()
-	if _, ok := frameDataChanMap[interfaceName]; ok {
-		mapMutex.Unlock()
+	defer mapMutex.Unlock()
+	if _, ok := liveQueues[interfaceName]; ok {
 		return errors.Errorf("capture already running on %s", interfaceName)
 	}
-	frameDataChanMap[interfaceName] = make(chan FrameData, 1000)
+	liveQueues[interfaceName] = newLiveQueue(conf)
+	return nil
+}
+
+// closeLiveChannel stops the queue of interfaceName once the frames already
+// pushed are delivered or dropped, closes its channel and keeps its counters.
+func closeLiveChannel(interfaceName string) {
+	mapMutex.Lock()
+	q, ok := liveQueues[interfaceName]
+	delete(liveQueues, interfaceName)
+	mapMutex.Unlock()
+	if !ok {
+		return
+	}
+
+	q.stop()
+
+	mapMutex.Lock()
+	if stats, ok := finalCaptureStats[interfaceName]; ok {
+		q.fillStats(&stats)
+		finalCaptureStats[interfaceName] = stats
+	}
 	mapMutex.Unlock()
+}
 
-	conf := NewConfig(opts...)
+// captureLive runs a live capture until it finishes or is stopped. With fanout
+// rings it only captures, spreading the packets over the rings by conversation;
+// otherwise it also dissects into the interface channel.
+func captureLive(interfaceName, bpfFilter string, packetCount, promisc, timeout int, conf *Conf, fanout fanoutRings) error {
 	printCJson := 0
 	if conf.PrintCJson {
 		printCJson = 1
@@ -183,18 +350,55 @@ func StartLivePacketCapture(interfaceName, bpfFilter string, packetCount, promis
 		C.free(unsafe.Pointer(cConf))
 	}()
 
+	C.setDataCallback((C.DataCallback)(C.GetDataCallback))
+
+	// Kept for its counters, which StopLivePacketCapture may race us to.
+	mapMutex.RLock()
+	q := liveQueues[interfaceName]
+	mapMutex.RUnlock()
+
+	cOpts := captureOpts(conf)
+	if len(fanout) > 0 {
+		// capture_opts lives in Go memory, so the ring array must not.
+		rings := (**C.packet_ring)(C.malloc(C.size_t(len(fanout)) * C.size_t(unsafe.Sizeof(fanout[0]))))
+		defer C.free(unsafe.Pointer(rings))
+		copy(unsafe.Slice(rings, len(fanout)), fanout)
+		cOpts.fanout = rings
+		cOpts.fanout_count = C.int(len(fanout))
+	}
+	var st C.capture_stats
+
 	// This call blocks
 	errMsg := C.handle_packet(cIfName, cBpf, C.int(packetCount),
-		C.int(promisc), C.int(timeout), C.int(printCJson), cConf)
+		C.int(promisc), C.int(timeout), C.int(printCJson), cConf, &cOpts, &st)
 
 	if C.strlen(errMsg) != 0 {
 		// Cleanup on failure
-		mapMutex.Lock()
-		delete(frameDataChanMap, interfaceName)
-		mapMutex.Unlock()
+		closeLiveChannel(interfaceName)
 		return errors.Errorf("fail to capture packet live: %s", CChar2GoStr(errMsg))
 	}
 
+	stats := captureStatsFromC(&st)
+	if q != nil {
+		q.fillStats(&stats)
+	}
+	mapMutex.Lock()
+	finalCaptureStats[interfaceName] = stats
+	mapMutex.Unlock()
+	if stats.Dropped > 0 || stats.IfDropped > 0 || stats.RingDropped > 0 || stats.RingEvicted > 0 ||
+		stats.QueueDropped > 0 || stats.ChanDropped > 0 {
+		slog.Warn("Live capture dropped packets", "interface", interfaceName,
+			"received", stats.Received, "dropped", stats.Dropped, "ifDropped", stats.IfDropped,
+			"ringDropped", stats.RingDropped, "ringEvicted", stats.RingEvicted,
+			"ringHighWater", stats.RingHighWater, "queueDropped", stats.QueueDropped,
+			"queueSampled", stats.QueueSampled, "chanDropped", stats.ChanDropped)
+	}
+
+	// Fan-out workers may still be delivering: the pool closes the channel
+	// once they are done.
+	if len(fanout) == 0 {
+		closeLiveChannel(interfaceName)
+	}
 	return nil
 }
 
@@ -212,13 +416,164 @@ func StopLivePacketCapture(interfaceName string) (err error) {
 		return errors.Errorf("fail to stop capture packet live: %s", CChar2GoStr(errMsg))
 	}
 
-	// Cleanup channel safely
-	mapMutex.Lock()
-	if ch, ok := frameDataChanMap[interfaceName]; ok {
-		close(ch)
-		delete(frameDataChanMap, interfaceName)
+	closeLiveChannel(interfaceName)
+	return nil
+}
+
+// liveFeedChunk is the most packet bytes a fan-out worker is sent at a time.
+const liveFeedChunk = 1 << 20
+
+// fanoutRings are the per-worker rings of a fan-out capture.
+type fanoutRings []*C.packet_ring
+
+// newFanoutRings allocates one ring per fan-out worker, sharing the ring size of
+// conf between them.
+func newFanoutRings(n int, conf *Conf) (fanoutRings, error) {
+	size := conf.RingSize
+	if size <= 0 {
+		size = C.PACKET_RING_DEFAULT_SIZE
 	}
-	mapMutex.Unlock()
+	size = max(size/n, 4*liveFeedChunk)
+
+	rings := make(fanoutRings, n)
+	for i := range rings {
+		rings[i] = C.packet_ring_new(C.uint64_t(size), C.packet_ring_policy(conf.RingPolicy))
+		if rings[i] == nil {
+			rings.free()
+			return nil, errors.New("could not allocate the packet rings")
+		}
+	}
+	return rings, nil
+}
 
-	return nil
+// close stops the rings from taking packets; their feeds drain them and end.
+func (rings fanoutRings) close() {
+	for _, ring := range rings {
+		C.packet_ring_close(ring)
+	}
+}
+
+// closeOne closes ring i alone, once nothing drains it anymore, so pushes to it
+// fail instead of waiting.
+func (rings fanoutRings) closeOne(i int) {
+	C.packet_ring_close(rings[i])
+}
+
+// free releases the rings once nothing reads them anymore.
+func (rings fanoutRings) free() {
+	for _, ring := range rings {
+		C.packet_ring_free(ring)
+	}
+}
+
+// feed sends the packets of ring i to a fan-out worker as recPackets records
+// until the ring is closed and drained, then ends the input with recInputEnd.
+// It returns errFeedStopped once stop is closed, within 100ms.
+func (rings fanoutRings) feed(i int, w *bufio.Writer, stop <-chan struct{}) error {
+	ring := rings[i]
+	buf := make([]byte, liveFeedChunk)
+	for {
+		select {
+		case <-stop:
+			return errFeedStopped
+		default:
+		}
+		n := C.packet_ring_read(ring, (*C.uint8_t)(unsafe.Pointer(&buf[0])), C.int(len(buf)))
+		if n > 0 {
+			if err := writeRecord(w, recPackets, buf[:n]); err != nil {
+				return err
+			}
+			if err := w.Flush(); err != nil {
+				return err
+			}
+			continue
+		}
+		if !C.packet_ring_wait(ring, 100*1000) {
+			break
+		}
+	}
+	if err := writeRecord(w, recInputEnd, nil); err != nil {
+		return err
+	}
+	return w.Flush()
+}
+
+// liveFeedName is the device name of the live feed of this process.
+func liveFeedName() string {
+	return "feed-" + strconv.Itoa(os.Getpid())
+}
+
+// liveFeedStats returns the rollover counters of an open live feed; the capture
+// counters are those of the parent and stay zero.
+func liveFeedStats(name string) (CaptureStats, error) {
+	cName := C.CString(name)
+	defer C.free(unsafe.Pointer(cName))
+
+	var st C.capture_stats
+	if C.live_feed_stats(cName, &st.rollover) != 0 {
+		return CaptureStats{}, errors.Errorf("no live feed %s", name)
+	}
+	return captureStatsFromC(&st), nil
+}
+
+// liveFeedSource dissects, in a worker process, the packets its parent streams
+// for a live job, and reports their frames in batches as they come.
+func liveFeedSource(conf *Conf, in *bufio.Reader) frameSource {
+	return func(emit func([][]byte) bool) error {
+		name := liveFeedName()
+		cName := C.CString(name)
+		cOptions := C.CString(HandleConf(conf))
+		defer C.free(unsafe.Pointer(cName))
+		defer C.free(unsafe.Pointer(cOptions))
+
+		printCJson := 0
+		if conf.PrintCJson {
+			printCJson = 1
+		}
+
+		var batch [][]byte
+		mapMutex.Lock()
+		liveFeedSinks[name] = func(frame []byte) { batch = append(batch, frame) }
+		mapMutex.Unlock()
+		defer func() {
+			mapMutex.Lock()
+			delete(liveFeedSinks, name)
+			mapMutex.Unlock()
+		}()
+
+		EpanMutex.Lock()
+		defer EpanMutex.Unlock()
+
+		// The feed brings its own epan session.
+		C.capture_ctx_release_epan_owner()
+		C.setDataCallback((C.DataCallback)(C.GetDataCallback))
+		cOpts := captureOpts(conf)
+		if errMsg := C.live_feed_open(cName, cOptions, &cOpts); C.strlen(errMsg) != 0 {
+			return errors.Errorf("fail to open live feed: %s", CChar2GoStr(errMsg))
+		}
+		defer C.live_feed_close(cName)
+
+		emitting := true
+		for {
+			typ, body, err := readRecord(in)
+			if err != nil {
+				return err
+			}
+			switch typ {
+			case recPackets:
+				if !emitting || len(body) == 0 {
+					continue
+				}
+				C.live_feed_dissect(cName, (*C.uint8_t)(unsafe.Pointer(&body[0])), C.int(len(body)), C.int(printCJson))
+				if len(batch) > 0 {
+					emitting = emit(batch)
+					batch = nil
+				}
+			case recInputEnd:
+				return nil
+			default:
+				return errors.Errorf("unexpected live feed record %q", typ)
+			}
+		}
+	}
 }
@@ -6,6 +6,7 @@
 
 #include "lib.h"
 #include "offline.h"
+#include "packet_ring.h"
 #ifdef __linux__
 #include <linux/if_packet.h>  // Linux
 #include <net/if.h>
@@ -23,9 +24,66 @@ int get_first_device(char *device);
 int get_if_nonblock_status(char *device_name);
 // Set interface nonblock status
 int set_if_nonblock_status(char *device_name, int nonblock);
-// Capture and dissect packet in real time
+// When a live capture swaps its epan session for a fresh one, dropping the
+// conversation, reassembly and file-scoped state that otherwise grows for as long
+// as the capture runs. A due rollover waits for a lull, up to grace_ms. Zero
+// fields are off.
+typedef struct {
+    int64_t packets;      // roll over after this many packets in a session
+    int64_t interval_ms;  // ... or once a session is this old
+    int64_t max_rss;      // ... or once the process holds this many resident bytes
+    int64_t grace_ms;     // longest wait for a lull once due, 0 for 1 second
+} rollover_opts;
+
+typedef struct {
+    uint64_t rollovers;       // sessions replaced so far
+    uint64_t session_packets; // packets dissected in the current session
+    int64_t last_pause_ns;    // time dissection stood still for the last rollover
+    int64_t max_pause_ns;
+    int64_t total_pause_ns;
+} rollover_stats;
+
+// Tuning of a live capture handle. Zero values keep the libpcap defaults.
+typedef struct {
+    int snaplen;           // bytes kept per packet, 0 for 65535
+    int buffer_size;       // kernel buffer (the mmap ring on Linux) in bytes
+    bool immediate;        // hand packets over as they arrive instead of per filled block
+    bool nano_timestamps;  // request nanosecond timestamps, if the device supports them
+    int64_t ring_size;     // bytes of the ring between capture and dissection, 0 for 64 MiB
+    int ring_policy;       // packet_ring_policy applied when the ring is full
+    packet_ring **fanout;  // if fanout_count > 0, only capture and spread packets over these
+    int fanout_count;      // rings by conversation, for other threads or processes to dissect
+    rollover_opts rollover;
+} capture_opts;
+
+#define PACKET_RING_DEFAULT_SIZE (64 << 20)
+
+// Counters of a live capture: libpcap's and those of its packet ring.
+typedef struct {
+    struct pcap_stat pcap;
+    packet_ring_stats ring;
+    rollover_stats rollover;
+    bool nano_timestamps;  // timestamps carry nanoseconds, false if the device lacks support
+} capture_stats;
+
+// Capture and dissect packet in real time. Packets are captured on the calling
+// thread and dissected on a second one, through a packet_ring. final_stats, if
+// not NULL, receives the counters at the end of the capture.
 char *handle_packet(char *device_name, char *bpf_expr, int num, int promisc, int to_ms,
-                    int printCJson, char *options);
+                    int printCJson, char *options, const capture_opts *opts,
+                    capture_stats *final_stats);
+// Read the counters of a running capture. Returns 0, or -1 if the device is not
+// capturing.
+int get_capture_stats(char *device_name, capture_stats *stats);
+// A live feed dissects packets captured elsewhere, like a fan-out worker's share
+// of a capture. Frames go to the DataCallback under the feed's name. Only the
+// rollover of opts applies.
+char *live_feed_open(char *name, char *options, const capture_opts *opts);
+// Dissect packet records in the packet_ring_read format, with nanosecond timestamps.
+void live_feed_dissect(char *name, const uint8_t *records, int len, int printCJson);
+// Read the rollover counters of a feed. Returns 0, or -1 if the feed is not open.
+int live_feed_stats(char *name, rollover_stats *stats);
+void live_feed_close(char *name);
 // Stop capture packet live、 free all memory allocated
 char *stop_dissect_capture_pkg(char *device_name);
 
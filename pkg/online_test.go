@@ -1,6 +1,10 @@
 package pkg
 
 import (
+	"bufio"
+	"bytes"
+	"encoding/binary"
+	"strconv"
 	"sync"
 	"sync/atomic"
 	"testing"
@@ -243,3 +247,192 @@ func TestBPF(t *testing.T) {
 		t.Logf("Success: Verified BPF filter with %d packets.", count)
 	}
 }
+
+// TestWorkerPoolLivePacketCapture captures a fixed number of packets with the
+// dissection fanned out over two worker processes.
+func TestWorkerPoolLivePacketCapture(t *testing.T) {
+	ifName := getValidInterface(t)
+	pktNum := 5
+
+	p, err := NewWorkerPool(WithWorkers(2))
+	if err != nil {
+		t.Fatalf("NewWorkerPool failed: %v", err)
+	}
+	defer p.Close()
+
+	done := make(chan error, 1)
+	go func() {
+		done <- p.StartLivePacketCapture(ifName, "", pktNum, 1, 100, WithLiveWorkers(2))
+	}()
+
+	time.Sleep(100 * time.Millisecond)
+	ch := GetIfaceChannel(ifName)
+	if ch == nil {
+		t.Fatal("Channel not initialized")
+	}
+
+	select {
+	case err := <-done:
+		if err != nil {
+			t.Fatalf("StartLivePacketCapture failed: %v", err)
+		}
+	case <-time.After(10 * time.Second):
+		t.Log("No traffic, stopping the capture")
+		StopLivePacketCapture(ifName)
+		<-done
+		return
+	}
+
+	// The capture closed the channel once the workers were done, after the
+	// frames already on it.
+	for i := 0; i < pktNum; i++ {
+		select {
+		case _, ok := <-ch:
+			if !ok {
+				t.Fatalf("Expected %d frames on the channel, got %d", pktNum, i)
+			}
+		case <-time.After(5 * time.Second):
+			t.Fatalf("Expected %d frames on the channel, got %d", pktNum, i)
+		}
+	}
+	stats, err := GetLiveCaptureStats(ifName)
+	if err != nil {
+		t.Fatalf("GetLiveCaptureStats failed: %v", err)
+	}
+	if stats.RingDissected != uint64(pktNum) {
+		t.Errorf("Expected the workers to get %d packets, got %d", pktNum, stats.RingDissected)
+	}
+}
+
+// feedRecord appends an Ethernet/IPv4/UDP packet numbered seq to records, as a
+// packet record of the live feed (PACKET_RING_RECORD_HDR).
+func feedRecord(records []byte, seq int) []byte {
+	pkt := []byte{
+		0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0x08, 0x00,
+		0x45, 0x00, 0x00, 0x20, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11, 0x00, 0x00,
+		10, 0, 0, 1, 10, 0, 0, 2,
+		0x30, 0x39, 0x00, 0x35, 0x00, 0x0c, 0x00, 0x00,
+		0, 0, 0, 0,
+	}
+	binary.BigEndian.PutUint32(pkt[len(pkt)-4:], uint32(seq))
+
+	var hdr [20]byte
+	binary.NativeEndian.PutUint64(hdr[0:], uint64(1700000000+seq))
+	binary.NativeEndian.PutUint32(hdr[8:], uint32(seq*1000))
+	binary.NativeEndian.PutUint32(hdr[12:], uint32(len(pkt)))
+	binary.NativeEndian.PutUint32(hdr[16:], uint32(len(pkt)))
+	return append(append(records, hdr[:]...), pkt...)
+}
+
+// TestLiveFeedRollover feeds packets to a live feed that rolls its session over
+// every few packets: each call to live_feed_dissect ends in a lull, so every
+// batch rolls the session over, and frame numbers keep counting across sessions.
+func TestLiveFeedRollover(t *testing.T) {
+	const batches, perBatch = 5, 10
+
+	var in bytes.Buffer
+	w := bufio.NewWriter(&in)
+	for b := 0; b < batches; b++ {
+		var records []byte
+		for i := 0; i < perBatch; i++ {
+			records = feedRecord(records, b*perBatch+i)
+		}
+		if err := writeRecord(w, recPackets, records); err != nil {
+			t.Fatal(err)
+		}
+	}
+	if err := writeRecord(w, recInputEnd, nil); err != nil {
+		t.Fatal(err)
+	}
+	if err := w.Flush(); err != nil {
+		t.Fatal(err)
+	}
+
+	conf := NewConfig(WithRollover(RolloverPolicy{Packets: perBatch}))
+	var frames, emitted int
+	err := liveFeedSource(conf, bufio.NewReader(&in))(func(batch [][]byte) bool {
+		for _, raw := range batch {
+			frame, err := parseFrameData(raw, false)
+			if err != nil {
+				t.Fatalf("parse frame %d: %v", frames+1, err)
+			}
+			frames++
+			if frame.BaseLayers.Frame.Number != frames {
+				t.Fatalf("frame %d numbered %d", frames, frame.BaseLayers.Frame.Number)
+			}
+		}
+		emitted++
+		stats, err := liveFeedStats(liveFeedName())
+		if err != nil {
+			t.Fatalf("liveFeedStats: %v", err)
+		}
+		if stats.Rollovers != uint64(emitted) || stats.SessionPackets != 0 {
+			t.Fatalf("after batch %d: %d rollovers, %d packets in the session",
+				emitted, stats.Rollovers, stats.SessionPackets)
+		}
+		if stats.RolloverPauseMax < stats.RolloverPauseLast ||
+			stats.RolloverPauseTotal < stats.RolloverPauseMax {
+			t.Errorf("inconsistent rollover pauses: %+v", stats)
+		}
+		return true
+	})
+	if err != nil {
+		t.Fatalf("live feed failed: %v", err)
+	}
+	if frames != batches*perBatch {
+		t.Fatalf("got %d frames, want %d", frames, batches*perBatch)
+	}
+	if _, err := liveFeedStats(liveFeedName()); err == nil {
+		t.Error("the live feed is still open after its input ended")
+	}
+}
+
+// TestLiveQueue decodes frames with several parsers and checks that they come
+// out in push order, and that every frame is either delivered or counted.
+func TestLiveQueue(t *testing.T) {
+	frame := func(i int) []byte {
+		return []byte(`{"_index":"` + strconv.Itoa(i) + `","layers":{"frame":{"frame.number":"` +
+			strconv.Itoa(i) + `"}}}`)
+	}
+
+	for _, policy := range []LivePolicy{LiveDrop, LiveBlock, LiveSample} {
+		q := newLiveQueue(NewConfig(WithLiveParsers(4), WithLiveQueue(64), WithLivePolicy(policy, 4)))
+		const pushed = 5000
+
+		var delivered int
+		done := make(chan struct{})
+		go func() {
+			defer close(done)
+			last := -1
+			for f := range q.out {
+				n, _ := strconv.Atoi(f.Index)
+				if n <= last {
+					t.Errorf("policy %d: frame %d after %d", policy, n, last)
+				}
+				last = n
+				delivered++
+			}
+		}()
+
+		// Into the empty queue, where no policy discards it.
+		q.push([]byte("not json"))
+		for i := 0; i < pushed; i++ {
+			q.push(frame(i))
+		}
+		q.stop()
+		<-done
+
+		var st CaptureStats
+		q.fillStats(&st)
+		if st.ParseErrors != 1 {
+			t.Errorf("policy %d: expected 1 parse error, got %d", policy, st.ParseErrors)
+		}
+		got := uint64(delivered) + st.QueueDropped + st.QueueSampled + st.ChanDropped + st.ParseErrors
+		if got != pushed+1 {
+			t.Errorf("policy %d: %d frames accounted for, pushed %d (%+v)", policy, got, pushed+1, st)
+		}
+		if policy == LiveBlock && delivered != pushed {
+			t.Errorf("LiveBlock delivered %d of %d frames", delivered, pushed)
+		}
+	}
+}
@@ -0,0 +1,304 @@
+#include "packet_ring.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Record header, followed by caplen bytes and padding to a multiple of 8. A
+// record with caplen PACKET_RING_WRAP only fills the rest of the buffer; so
+// does any tail too short to hold a header.
+typedef struct {
+    uint32_t size;  // bytes of the record, header and padding included
+    uint32_t caplen;
+    uint32_t len;
+    uint32_t reserved;
+    int64_t sec;
+    int64_t usec;
+} packet_ring_rec;
+
+#define PACKET_RING_WRAP UINT32_MAX
+#define PACKET_RING_NONE UINT64_MAX
+#define PACKET_RING_ALIGN(n) (((n) + 7) & ~(uint64_t)7)
+
+// head, tail and held are byte offsets that only grow; the position in the
+// buffer is the offset modulo size.
+//
+// The producer writes at head and publishes with a release store. The consumer
+// claims the record at tail by moving tail past it; under DROP_OLDEST the
+// producer moves tail too, so both use compare-and-swap. held is the offset of
+// the record the consumer is reading, which the producer must not overwrite
+// even though tail is already past it.
+struct packet_ring {
+    uint8_t *buf;
+    uint64_t size;
+    packet_ring_policy policy;
+
+    _Alignas(64) _Atomic uint64_t head;
+    _Atomic uint64_t pushed;
+    _Atomic uint64_t dropped;
+    _Atomic uint64_t evicted;
+    _Atomic uint64_t high_water;
+    _Atomic bool closed;
+
+    _Alignas(64) _Atomic uint64_t tail;
+    _Atomic uint64_t held;
+    _Atomic uint64_t consumed;
+};
+
+packet_ring *packet_ring_new(uint64_t size, packet_ring_policy policy) {
+    size = PACKET_RING_ALIGN(size);
+    if (size < 2 * sizeof(packet_ring_rec)) {
+        return NULL;
+    }
+
+    packet_ring *ring = aligned_alloc(64, sizeof(packet_ring));
+    if (ring == NULL) {
+        return NULL;
+    }
+    memset(ring, 0, sizeof(*ring));
+    ring->buf = malloc(size);
+    if (ring->buf == NULL) {
+        free(ring);
+        return NULL;
+    }
+    ring->size = size;
+    ring->policy = policy;
+    atomic_init(&ring->held, PACKET_RING_NONE);
+    return ring;
+}
+
+void packet_ring_free(packet_ring *ring) {
+    if (ring == NULL) {
+        return;
+    }
+    free(ring->buf);
+    free(ring);
+}
+
+static void backoff(unsigned *spins) {
+    if (*spins < 64) {
+        (*spins)++;
+        sched_yield();
+        return;
+    }
+    struct timespec ts = {0, 50 * 1000};
+    nanosleep(&ts, NULL);
+}
+
+/**
+ * Size of the record at offset off, which must be queued and not being
+ * overwritten. Wrap records and short tails span to the end of the buffer.
+ */
+static uint64_t record_span(const packet_ring *ring, uint64_t off, const packet_ring_rec **out) {
+    uint64_t pos = off % ring->size;
+    *out = NULL;
+    if (ring->size - pos < sizeof(packet_ring_rec)) {
+        return ring->size - pos;
+    }
+    const packet_ring_rec *rec = (const packet_ring_rec *)(ring->buf + pos);
+    if (rec->caplen == PACKET_RING_WRAP) {
+        return ring->size - pos;
+    }
+    *out = rec;
+    return rec->size;
+}
+
+/**
+ * Lowest offset still in use: tail, or the record the consumer is reading.
+ * tail is loaded first: a consumer that claims in between publishes held
+ * before it moves tail, so one of the two loads sees the claim.
+ */
+static uint64_t in_use_from(packet_ring *ring) {
+    uint64_t tail = atomic_load(&ring->tail);
+    uint64_t held = atomic_load(&ring->held);
+    return held < tail ? held : tail;
+}
+
+/**
+ * Make room for need bytes at head by discarding the oldest unclaimed record.
+ *
+ *  @return bool: false if there is nothing left to discard
+ */
+static bool evict_oldest(packet_ring *ring, uint64_t head) {
+    uint64_t tail = atomic_load(&ring->tail);
+    if (tail == head) {
+        // Only the record the consumer is reading is left.
+        return false;
+    }
+    const packet_ring_rec *rec;
+    uint64_t span = record_span(ring, tail, &rec);
+    if (atomic_compare_exchange_strong(&ring->tail, &tail, tail + span) && rec != NULL) {
+        atomic_fetch_add_explicit(&ring->evicted, 1, memory_order_relaxed);
+    }
+    return true;
+}
+
+bool packet_ring_push(packet_ring *ring, const struct pcap_pkthdr *hdr, const u_char *data) {
+    uint64_t need = PACKET_RING_ALIGN(sizeof(packet_ring_rec) + hdr->caplen);
+    if (need > ring->size / 2 || atomic_load_explicit(&ring->closed, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t pos = head % ring->size;
+    uint64_t pad = ring->size - pos < need ? ring->size - pos : 0;
+    unsigned spins = 0;
+
+    for (;;) {
+        uint64_t from = in_use_from(ring);
+        if (head + pad + need - from <= ring->size) {
+            break;
+        }
+        if (ring->policy == PACKET_RING_DROP_OLDEST && evict_oldest(ring, head)) {
+            continue;
+        }
+        if (ring->policy == PACKET_RING_BLOCK &&
+            !atomic_load_explicit(&ring->closed, memory_order_relaxed)) {
+            backoff(&spins);
+            continue;
+        }
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    if (pad >= sizeof(packet_ring_rec)) {
+        packet_ring_rec *wrap = (packet_ring_rec *)(ring->buf + pos);
+        wrap->size = (uint32_t)pad;
+        wrap->caplen = PACKET_RING_WRAP;
+    }
+
+    packet_ring_rec *rec = (packet_ring_rec *)(ring->buf + (head + pad) % ring->size);
+    rec->size = (uint32_t)need;
+    rec->caplen = hdr->caplen;
+    rec->len = hdr->len;
+    rec->sec = hdr->ts.tv_sec;
+    rec->usec = hdr->ts.tv_usec;
+    memcpy(rec + 1, data, hdr->caplen);
+
+    uint64_t new_head = head + pad + need;
+    atomic_store_explicit(&ring->head, new_head, memory_order_release);
+    atomic_fetch_add_explicit(&ring->pushed, 1, memory_order_relaxed);
+
+    uint64_t used = new_head - atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (used > atomic_load_explicit(&ring->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->high_water, used, memory_order_relaxed);
+    }
+    return true;
+}
+
+/**
+ * Claim the oldest packet if its captured length is at most max_caplen.
+ *
+ *  @return the packet bytes, NULL if the ring is empty or the packet too large
+ */
+static const u_char *claim(packet_ring *ring, struct pcap_pkthdr *hdr, int64_t max_caplen) {
+    for (;;) {
+        uint64_t tail = atomic_load(&ring->tail);
+        if (tail == atomic_load_explicit(&ring->head, memory_order_acquire)) {
+            return NULL;
+        }
+
+        // Pin the record before reading it, then make sure it was not evicted
+        // before the pin became visible.
+        atomic_store(&ring->held, tail);
+        if (atomic_load(&ring->tail) != tail) {
+            continue;
+        }
+
+        const packet_ring_rec *rec;
+        uint64_t span = record_span(ring, tail, &rec);
+        if (rec != NULL && (int64_t)rec->caplen > max_caplen) {
+            atomic_store(&ring->held, PACKET_RING_NONE);
+            return NULL;
+        }
+        if (!atomic_compare_exchange_strong(&ring->tail, &tail, tail + span)) {
+            continue;
+        }
+        if (rec == NULL) {
+            atomic_store(&ring->held, PACKET_RING_NONE);
+            continue;
+        }
+
+        hdr->caplen = rec->caplen;
+        hdr->len = rec->len;
+        hdr->ts.tv_sec = rec->sec;
+        hdr->ts.tv_usec = rec->usec;
+        atomic_fetch_add_explicit(&ring->consumed, 1, memory_order_relaxed);
+        return (const u_char *)(rec + 1);
+    }
+}
+
+const u_char *packet_ring_claim(packet_ring *ring, struct pcap_pkthdr *hdr) {
+    return claim(ring, hdr, INT64_MAX);
+}
+
+int packet_ring_read(packet_ring *ring, uint8_t *buf, int cap) {
+    struct pcap_pkthdr hdr;
+    const u_char *data;
+    int n = 0;
+
+    while ((data = claim(ring, &hdr, (int64_t)cap - n - PACKET_RING_RECORD_HDR)) != NULL) {
+        int64_t sec = hdr.ts.tv_sec;
+        int32_t subsec = (int32_t)hdr.ts.tv_usec;
+        memcpy(buf + n, &sec, 8);
+        memcpy(buf + n + 8, &subsec, 4);
+        memcpy(buf + n + 12, &hdr.caplen, 4);
+        memcpy(buf + n + 16, &hdr.len, 4);
+        memcpy(buf + n + PACKET_RING_RECORD_HDR, data, hdr.caplen);
+        n += PACKET_RING_RECORD_HDR + (int)hdr.caplen;
+        packet_ring_release(ring);
+    }
+    return n;
+}
+
+void packet_ring_release(packet_ring *ring) {
+    atomic_store_explicit(&ring->held, PACKET_RING_NONE, memory_order_release);
+}
+
+bool packet_ring_wait(packet_ring *ring, int64_t timeout_us) {
+    struct timespec start, now;
+    unsigned spins = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (;;) {
+        // Read closed first: packets pushed before the close are then visible.
+        bool closed = atomic_load_explicit(&ring->closed, memory_order_acquire);
+        if (atomic_load(&ring->tail) != atomic_load_explicit(&ring->head, memory_order_acquire)) {
+            return true;
+        }
+        if (closed) {
+            return false;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t waited =
+            (now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000;
+        if (waited >= timeout_us) {
+            return true;
+        }
+        backoff(&spins);
+    }
+}
+
+void packet_ring_close(packet_ring *ring) {
+    atomic_store_explicit(&ring->closed, true, memory_order_release);
+}
+
+void packet_ring_get_stats(packet_ring *ring, packet_ring_stats *stats) {
+    uint64_t tail = atomic_load(&ring->tail);
+    uint64_t head = atomic_load(&ring->head);
+    uint64_t pushed = atomic_load_explicit(&ring->pushed, memory_order_relaxed);
+    uint64_t consumed = atomic_load_explicit(&ring->consumed, memory_order_relaxed);
+    uint64_t evicted = atomic_load_explicit(&ring->evicted, memory_order_relaxed);
+
+    stats->capacity = ring->size;
+    stats->used = head > tail ? head - tail : 0;
+    stats->high_water = atomic_load_explicit(&ring->high_water, memory_order_relaxed);
+    stats->queued = pushed > consumed + evicted ? pushed - consumed - evicted : 0;
+    stats->pushed = pushed;
+    stats->consumed = consumed;
+    stats->dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    stats->evicted = evicted;
+}
@@ -0,0 +1,132 @@
+package pkg
+
+/*
+#cgo pkg-config: glib-2.0
+#include <string.h>
+#include "packet_ring.h"
+
+static bool packet_ring_push_bytes(packet_ring *ring, const u_char *data, uint32_t caplen,
+                                   uint32_t len, int64_t sec, int64_t usec) {
+    struct pcap_pkthdr hdr;
+    hdr.caplen = caplen;
+    hdr.len = len;
+    hdr.ts.tv_sec = (time_t)sec;
+    hdr.ts.tv_usec = usec;
+    return packet_ring_push(ring, &hdr, data);
+}
+
+// Copy the oldest packet into buf and release it. Returns its captured length,
+// -1 if the ring is empty.
+static int packet_ring_claim_copy(packet_ring *ring, u_char *buf, int cap, uint32_t *len,
+                                  int64_t *sec, int64_t *usec) {
+    struct pcap_pkthdr hdr;
+    const u_char *data = packet_ring_claim(ring, &hdr);
+    if (data == NULL) {
+        return -1;
+    }
+    memcpy(buf, data, hdr.caplen < (uint32_t)cap ? hdr.caplen : (uint32_t)cap);
+    *len = hdr.len;
+    *sec = hdr.ts.tv_sec;
+    *usec = hdr.ts.tv_usec;
+    packet_ring_release(ring);
+    return (int)hdr.caplen;
+}
+*/
+import "C"
+import "unsafe"
+
+// Go entry points to the C packet ring, used by the tests to drive its producer
+// and consumer sides from goroutines.
+
+type ringPolicy int
+
+const (
+	ringDropNewest = ringPolicy(C.PACKET_RING_DROP_NEWEST)
+	ringDropOldest = ringPolicy(C.PACKET_RING_DROP_OLDEST)
+	ringBlock      = ringPolicy(C.PACKET_RING_BLOCK)
+)
+
+// ringPacket is a packet as pushed to and claimed from a packetRing.
+type ringPacket struct {
+	data []byte
+	len  uint32 // original length
+	sec  int64
+	usec int64
+}
+
+// packetRing wraps a C packet_ring. Like the ring itself, push must be called
+// from one goroutine and claim, read and wait from one other.
+type packetRing struct {
+	ring *C.packet_ring
+	buf  []byte // claim copies packets through it
+}
+
+func newPacketRing(size int, policy ringPolicy) *packetRing {
+	ring := C.packet_ring_new(C.uint64_t(size), C.packet_ring_policy(policy))
+	if ring == nil {
+		return nil
+	}
+	return &packetRing{ring: ring, buf: make([]byte, 65536)}
+}
+
+func (r *packetRing) push(p ringPacket) bool {
+	var data *C.u_char
+	if len(p.data) > 0 {
+		data = (*C.u_char)(unsafe.Pointer(&p.data[0]))
+	}
+	return bool(C.packet_ring_push_bytes(r.ring, data, C.uint32_t(len(p.data)), C.uint32_t(p.len),
+		C.int64_t(p.sec), C.int64_t(p.usec)))
+}
+
+// claim returns a copy of the oldest packet, ok false if the ring is empty.
+func (r *packetRing) claim() (p ringPacket, ok bool) {
+	var plen C.uint32_t
+	var sec, usec C.int64_t
+	n := C.packet_ring_claim_copy(r.ring, (*C.u_char)(unsafe.Pointer(&r.buf[0])),
+		C.int(len(r.buf)), &plen, &sec, &usec)
+	if n < 0 {
+		return p, false
+	}
+	data := append([]byte(nil), r.buf[:n]...)
+	return ringPacket{data: data, len: uint32(plen), sec: int64(sec), usec: int64(usec)}, true
+}
+
+// read copies packets out as records (PACKET_RING_RECORD_HDR) into buf and
+// returns the bytes written.
+func (r *packetRing) read(buf []byte) int {
+	return int(C.packet_ring_read(r.ring, (*C.uint8_t)(unsafe.Pointer(&buf[0])), C.int(len(buf))))
+}
+
+// wait returns false once the ring is closed and drained.
+func (r *packetRing) wait(timeoutUs int64) bool {
+	return bool(C.packet_ring_wait(r.ring, C.int64_t(timeoutUs)))
+}
+
+func (r *packetRing) close() {
+	C.packet_ring_close(r.ring)
+}
+
+// ringStats are the counters of packet_ring_stats.
+type ringStats struct {
+	used, highWater, queued            uint64
+	pushed, consumed, dropped, evicted uint64
+}
+
+func (r *packetRing) stats() ringStats {
+	var st C.packet_ring_stats
+	C.packet_ring_get_stats(r.ring, &st)
+	return ringStats{
+		used:      uint64(st.used),
+		highWater: uint64(st.high_water),
+		queued:    uint64(st.queued),
+		pushed:    uint64(st.pushed),
+		consumed:  uint64(st.consumed),
+		dropped:   uint64(st.dropped),
+		evicted:   uint64(st.evicted),
+	}
+}
+
+func (r *packetRing) free() {
+	C.packet_ring_free(r.ring)
+	r.ring = nil
+}
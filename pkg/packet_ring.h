@@ -0,0 +1,72 @@
+#ifndef PACKET_RING_H
+#define PACKET_RING_H
+
+#include <pcap/pcap.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// A lock-free single-producer/single-consumer ring of captured packets. The
+// capture thread copies each packet and its header in with packet_ring_push;
+// the dissection thread claims them in order with packet_ring_claim and hands
+// them back with packet_ring_release. Records are variable-sized and packed
+// into one preallocated byte buffer, so the ring holds many small packets
+// without reserving snaplen bytes for each.
+
+typedef enum {
+    PACKET_RING_DROP_NEWEST = 0,  // discard the incoming packet when full
+    PACKET_RING_DROP_OLDEST = 1,  // discard the oldest unclaimed packets to make room
+    PACKET_RING_BLOCK = 2,        // wait for the consumer, leaving drops to the kernel
+} packet_ring_policy;
+
+typedef struct {
+    uint64_t capacity;    // ring size in bytes
+    uint64_t used;        // bytes queued right now
+    uint64_t high_water;  // most bytes ever queued
+    uint64_t queued;      // packets queued right now
+    uint64_t pushed;      // packets accepted by the ring
+    uint64_t consumed;    // packets claimed by the consumer
+    uint64_t dropped;     // incoming packets discarded because the ring was full
+    uint64_t evicted;     // queued packets discarded by PACKET_RING_DROP_OLDEST
+} packet_ring_stats;
+
+typedef struct packet_ring packet_ring;
+
+// Allocate a ring of size bytes, rounded up to a multiple of 8. NULL if it
+// cannot be allocated.
+packet_ring *packet_ring_new(uint64_t size, packet_ring_policy policy);
+
+// Copy a packet in. Returns false if it was dropped, or if the ring is closed.
+// Producer side only.
+bool packet_ring_push(packet_ring *ring, const struct pcap_pkthdr *hdr, const u_char *data);
+
+// Claim the oldest packet, NULL if the ring is empty. The header and data stay
+// valid until packet_ring_release. Consumer side only.
+const u_char *packet_ring_claim(packet_ring *ring, struct pcap_pkthdr *hdr);
+
+// Hand the claimed packet's space back to the producer.
+void packet_ring_release(packet_ring *ring);
+
+// packet_ring_read copies packets out as records, back to back in host byte
+// order:
+//
+//   int64 seconds, int32 sub-second part (as pushed), uint32 captured length,
+//   uint32 original length, then the captured bytes.
+#define PACKET_RING_RECORD_HDR 20
+
+// Claim as many packets as fit into buf, copy them out as records and release
+// them. Returns the bytes written, 0 if the ring is empty. Consumer side only.
+int packet_ring_read(packet_ring *ring, uint8_t *buf, int cap);
+
+// Wait for packets, up to timeout_us. Returns false once the ring is closed and
+// drained.
+bool packet_ring_wait(packet_ring *ring, int64_t timeout_us);
+
+// Stop accepting packets and wake a blocked producer. The consumer still drains
+// what is queued.
+void packet_ring_close(packet_ring *ring);
+
+void packet_ring_get_stats(packet_ring *ring, packet_ring_stats *stats);
+
+void packet_ring_free(packet_ring *ring);
+
+#endif  // PACKET_RING_H
@@ -0,0 +1,237 @@
+package pkg
+
+import (
+	"bytes"
+	"encoding/binary"
+	"math/rand"
+	"sync"
+	"testing"
+	"time"
+)
+
+// ringRecordOverhead is the header of a record in the ring buffer, see
+// packet_ring_rec; records are padded to a multiple of 8.
+const ringRecordOverhead = 32
+
+// seqPacket builds a packet of caplen bytes carrying seq, whose content can be
+// checked by checkSeqPacket.
+func seqPacket(seq uint64, caplen int) ringPacket {
+	data := make([]byte, max(caplen, 8))
+	binary.NativeEndian.PutUint64(data, seq)
+	for i := 8; i < len(data); i++ {
+		data[i] = byte(seq + uint64(i))
+	}
+	return ringPacket{data: data[:caplen], len: uint32(caplen + 1), sec: int64(seq),
+		usec: int64(seq % 1000000)}
+}
+
+// checkSeqPacket returns the seq of p, or ok false if p is not intact.
+func checkSeqPacket(p ringPacket) (seq uint64, ok bool) {
+	if len(p.data) < 8 {
+		return 0, false
+	}
+	seq = binary.NativeEndian.Uint64(p.data)
+	want := seqPacket(seq, len(p.data))
+	return seq, bytes.Equal(p.data, want.data) && p.len == want.len && p.sec == want.sec &&
+		p.usec == want.usec
+}
+
+// TestPacketRing_Wraparound pushes bursts of random sizes through a small ring,
+// so records wrap at every offset, including tails too short for a header.
+func TestPacketRing_Wraparound(t *testing.T) {
+	ring := newPacketRing(4096, ringDropNewest)
+	defer ring.free()
+
+	rng := rand.New(rand.NewSource(1))
+	var next, want uint64
+	for round := 0; round < 2000; round++ {
+		for burst := rng.Intn(8); burst >= 0; burst-- {
+			if ring.push(seqPacket(next, 8+rng.Intn(600))) {
+				next++
+			}
+		}
+		for ring.stats().queued > uint64(rng.Intn(3)) {
+			p, ok := ring.claim()
+			if !ok {
+				t.Fatal("claim failed on a ring with queued packets")
+			}
+			seq, intact := checkSeqPacket(p)
+			if !intact || seq != want {
+				t.Fatalf("got seq %d (intact %v), want %d", seq, intact, want)
+			}
+			want++
+		}
+	}
+	if st := ring.stats(); st.pushed != next || st.evicted != 0 {
+		t.Fatalf("stats %+v after %d accepted pushes", st, next)
+	}
+}
+
+// TestPacketRing_HalfSize checks the largest record: up to half the ring is
+// accepted at any offset of an empty ring, anything larger is dropped.
+func TestPacketRing_HalfSize(t *testing.T) {
+	const size = 4096
+	maxCaplen := size/2 - ringRecordOverhead
+	ring := newPacketRing(size, ringDropNewest)
+	defer ring.free()
+
+	if ring.push(seqPacket(0, maxCaplen+1)) {
+		t.Fatal("a record over half the ring was accepted")
+	}
+	if !ring.push(seqPacket(1, maxCaplen)) || !ring.push(seqPacket(2, maxCaplen)) {
+		t.Fatal("two records of half the ring each do not fill an empty ring")
+	}
+	if ring.push(seqPacket(3, 8)) {
+		t.Fatal("a full ring accepted another record")
+	}
+	for want := uint64(1); want <= 2; want++ {
+		if p, ok := ring.claim(); !ok || binary.NativeEndian.Uint64(p.data) != want {
+			t.Fatalf("claim %d failed", want)
+		}
+	}
+
+	// A small record moves the offset of the empty ring on every round, so the
+	// large record needs padding at every position.
+	for shift := 1; shift < size/8; shift++ {
+		for _, caplen := range []int{8 + 8*(shift%5), maxCaplen} {
+			if !ring.push(seqPacket(uint64(shift), caplen)) {
+				t.Fatalf("shift %d: record of %d bytes dropped by an empty ring", shift, caplen)
+			}
+			p, ok := ring.claim()
+			if seq, intact := checkSeqPacket(p); !ok || !intact || seq != uint64(shift) {
+				t.Fatalf("shift %d: record of %d bytes corrupt", shift, caplen)
+			}
+		}
+	}
+	if st := ring.stats(); st.dropped != 2 || st.queued != 0 {
+		t.Fatalf("stats %+v, want 2 drops and an empty ring", st)
+	}
+}
+
+// TestPacketRing_Policies runs a producer and a consumer concurrently under
+// every policy: packets come out intact and in order, and the counters add up.
+func TestPacketRing_Policies(t *testing.T) {
+	const packets = 50000
+
+	for _, tc := range []struct {
+		name   string
+		policy ringPolicy
+	}{
+		{"DropNewest", ringDropNewest},
+		{"DropOldest", ringDropOldest},
+		{"Block", ringBlock},
+	} {
+		t.Run(tc.name, func(t *testing.T) {
+			ring := newPacketRing(1<<16, tc.policy)
+			defer ring.free()
+
+			var consumed uint64
+			var consumeErr string
+			var wg sync.WaitGroup
+			wg.Add(1)
+			go func() {
+				defer wg.Done()
+				var last uint64
+				for ring.wait(1000) {
+					for {
+						p, ok := ring.claim()
+						if !ok {
+							break
+						}
+						seq, intact := checkSeqPacket(p)
+						if !intact || (consumed > 0 && seq <= last) {
+							consumeErr = "packet out of order or corrupt"
+							return
+						}
+						last = seq
+						consumed++
+						// Fall behind now and then, so the ring fills up.
+						if consumed%1000 == 0 {
+							time.Sleep(100 * time.Microsecond)
+						}
+					}
+				}
+			}()
+
+			rng := rand.New(rand.NewSource(2))
+			for seq := uint64(1); seq <= packets; seq++ {
+				ring.push(seqPacket(seq, 8+rng.Intn(1500)))
+			}
+			ring.close()
+			wg.Wait()
+			if consumeErr != "" {
+				t.Fatal(consumeErr)
+			}
+
+			st := ring.stats()
+			if st.pushed+st.dropped != packets {
+				t.Errorf("pushed %d + dropped %d != %d", st.pushed, st.dropped, packets)
+			}
+			if st.consumed != consumed || st.pushed != st.consumed+st.evicted || st.queued != 0 {
+				t.Errorf("stats %+v, consumer saw %d", st, consumed)
+			}
+			switch tc.policy {
+			case ringBlock:
+				if st.dropped != 0 || consumed != packets {
+					t.Errorf("block: %d dropped, %d consumed", st.dropped, consumed)
+				}
+			case ringDropNewest:
+				if st.evicted != 0 {
+					t.Errorf("drop newest evicted %d", st.evicted)
+				}
+			}
+			t.Logf("%+v", st)
+		})
+	}
+}
+
+// TestPacketRing_CloseThenDrain checks that a closed ring refuses packets and
+// releases a blocked producer, while the consumer still drains what is queued.
+func TestPacketRing_CloseThenDrain(t *testing.T) {
+	ring := newPacketRing(4096, ringBlock)
+	defer ring.free()
+
+	var queued int
+	for ring.stats().used+1024+ringRecordOverhead <= 4096 {
+		if !ring.push(seqPacket(uint64(queued), 1024)) {
+			t.Fatal("push failed on a ring with room")
+		}
+		queued++
+	}
+
+	// The ring is full: this push blocks until the close.
+	pushed := make(chan bool)
+	go func() { pushed <- ring.push(seqPacket(99, 1024)) }()
+	select {
+	case ok := <-pushed:
+		t.Fatalf("push on a full blocking ring returned %v", ok)
+	case <-time.After(50 * time.Millisecond):
+	}
+	ring.close()
+	select {
+	case ok := <-pushed:
+		if ok {
+			t.Fatal("blocked push succeeded after close")
+		}
+	case <-time.After(5 * time.Second):
+		t.Fatal("close did not release the blocked producer")
+	}
+	if ring.push(seqPacket(100, 8)) {
+		t.Fatal("closed ring accepted a packet")
+	}
+
+	buf := make([]byte, 1<<16)
+	var drained int
+	for ring.wait(1000) {
+		for off, n := 0, ring.read(buf); off < n; drained++ {
+			caplen := int(binary.NativeEndian.Uint32(buf[off+12:]))
+			if seq := binary.NativeEndian.Uint64(buf[off+20:]); seq != uint64(drained) {
+				t.Fatalf("record %d: got seq %d", drained, seq)
+			}
+			off += 20 + caplen
+		}
+	}
+	if drained != queued {
+		t.Fatalf("drained %d packets, %d were queued before the close", drained, queued)
+	}
+}
@@ -1,12 +1,27 @@
 #include "reassembly.h"
 
-static TcpTapDataCallback tcpTapDataCallback;
-static void *tcpTapCtx = NULL;
+#include <string.h>
+
+// Callback of taps created without one.
+static TcpTapBatchCallback defaultTapCallback;
+static void *defaultTapCtx = NULL;
+
+struct tcp_follow_tap {
+    TcpTapBatchCallback callback;
+    void *ctx;
+    char *filter;
+    bool attached;
+    guint32 last_num;      // highest frame reported so far
+    guint32 replay_until;  // frames up to here were reported before the last attach
+    char *data;            // records not yet handed over, see reassembly.h
+    gsize len;
+    int count;
+};
 
 // Set up callback function for send packet to Go
-void setTcpTapDataCallbackWithCtx(TcpTapDataCallback callback, void *ctx) {
-    tcpTapDataCallback = callback;
-    tcpTapCtx = ctx;
+void setTcpTapDataCallbackWithCtx(TcpTapBatchCallback callback, void *ctx) {
+    defaultTapCallback = callback;
+    defaultTapCtx = ctx;
 }
 
 typedef struct tcp_follow_tap_data {
@@ -15,46 +30,45 @@ typedef struct tcp_follow_tap_data {
     struct tcp_analysis *tcpd;
 } tcp_follow_tap_data_t;
 
-typedef struct {
-    guint32 packet_id;
-    guint32 peer;
-    guint32 index;
-    double timestamp;
-    gchar *data;
-} tcp_packet;
-
-typedef struct {
-    guint32 stream_id;
-    guint32 peer_count;
-    address src;
-    guint16 srcport;
-    address dst;
-    guint16 destport;
-    GList *packets;
-} tcp_stream_context;
-
-// helper func：Base64 encode
-static gchar *encode_data_to_base64(const guint8 *data, guint32 data_len) {
-    if (data == NULL || data_len == 0) {
-        return g_strdup("");
+/**
+ * Hand count records to the callback of tap.
+ */
+static void tcp_follow_tap_deliver(tcp_follow_tap *tap, const char *data, gsize len, int count) {
+    if (tap->callback != NULL) {
+        tap->callback(data, (int)len, count, tap->ctx);
+    } else if (defaultTapCallback != NULL) {
+        defaultTapCallback(data, (int)len, count, defaultTapCtx);
     }
-    return g_base64_encode(data, data_len);
 }
 
-double nstime_to_double(const nstime_t *nstime) {
-    if (!nstime) {
-        return 0.0;
+void tcp_follow_tap_flush(tcp_follow_tap *tap) {
+    if (tap->count > 0) {
+        tcp_follow_tap_deliver(tap, tap->data, tap->len, tap->count);
     }
-    return (double)nstime->secs + (double)nstime->nsecs / 1e9;
+    tap->len = 0;
+    tap->count = 0;
+}
+
+static char *tap_record_put(char *dst, const void *src, gsize len) {
+    memcpy(dst, src, len);
+    return dst + len;
 }
 
 static tap_packet_status follow_tcp_tap_packet(void *tapdata, packet_info *pinfo,
                                                epan_dissect_t *edt _U_, const void *data,
                                                tap_flags_t flags _U_) {
+    tcp_follow_tap *tap = (tcp_follow_tap *)tapdata;
     const tcp_follow_tap_data_t *follow_data = (const tcp_follow_tap_data_t *)data;
     const uint8_t *tcp_data = NULL;
     guint32 tcp_data_len = 0;
 
+    // A session that got the epan back replays its first pass; skip what the
+    // callback already has.
+    if (pinfo->num <= tap->replay_until) {
+        return TAP_PACKET_DONT_REDRAW;
+    }
+    tap->last_num = MAX(tap->last_num, pinfo->num);
+
     if (follow_data) {
         tcp_data_len = follow_data->tcph->th_seglen;
         if (tcp_data_len > 0) {
@@ -69,38 +83,106 @@ static tap_packet_status follow_tcp_tap_packet(void *tapdata, packet_info *pinfo
     char src_addr[128], dst_addr[128];
     address_to_str_buf(&pinfo->src, src_addr, sizeof(src_addr));
     address_to_str_buf(&pinfo->dst, dst_addr, sizeof(dst_addr));
+    guint8 src_len = (guint8)strlen(src_addr);
+    guint8 dst_len = (guint8)strlen(dst_addr);
+
+    guint32 stream_id = pinfo->stream_id;
+    guint32 packet_id = pinfo->num;
+    int64_t ts_sec = (int64_t)pinfo->abs_ts.secs;
+    int32_t ts_nsec = (int32_t)pinfo->abs_ts.nsecs;
+    guint16 srcport = (guint16)pinfo->srcport;
+    guint16 destport = (guint16)pinfo->destport;
+    guint16 tcp_flags = follow_data->tcph->th_flags;
+
+    gsize size = sizeof(stream_id) + sizeof(packet_id) + sizeof(ts_sec) + sizeof(ts_nsec) +
+                 sizeof(srcport) + sizeof(destport) + sizeof(tcp_flags) + sizeof(tcp_data_len) +
+                 2 + src_len + dst_len + tcp_data_len;
+
+    // A record larger than the whole buffer goes out on its own.
+    bool alone = size > TCP_TAP_BUF_SIZE;
+    char *record;
+    if (alone) {
+        tcp_follow_tap_flush(tap);
+        record = g_malloc(size);
+    } else {
+        if (tap->len + size > TCP_TAP_BUF_SIZE) {
+            tcp_follow_tap_flush(tap);
+        }
+        record = tap->data + tap->len;
+    }
 
-    gchar *data_base64 = encode_data_to_base64(tcp_data, tcp_data_len);
-
-    GString *json_str = g_string_new(NULL);
-    g_string_printf(json_str,
-                    "{\"stream_id\":%u,\"packet_id\":%u,\"src\":\"%s:%u\",\"dst\":\"%s:%u\","
-                    "\"timestamp\":%.6f,\"data\":\"%s\"}",
-                    pinfo->stream_id, pinfo->num, src_addr, pinfo->srcport, dst_addr,
-                    pinfo->destport, nstime_to_double(&pinfo->abs_ts), data_base64);
-
-    if (tcpTapDataCallback != NULL) {
-        tcpTapDataCallback(json_str->str, json_str->len, tcpTapCtx);
+    char *p = record;
+    p = tap_record_put(p, &stream_id, sizeof(stream_id));
+    p = tap_record_put(p, &packet_id, sizeof(packet_id));
+    p = tap_record_put(p, &ts_sec, sizeof(ts_sec));
+    p = tap_record_put(p, &ts_nsec, sizeof(ts_nsec));
+    p = tap_record_put(p, &srcport, sizeof(srcport));
+    p = tap_record_put(p, &destport, sizeof(destport));
+    p = tap_record_put(p, &tcp_flags, sizeof(tcp_flags));
+    p = tap_record_put(p, &tcp_data_len, sizeof(tcp_data_len));
+    p = tap_record_put(p, &src_len, 1);
+    p = tap_record_put(p, src_addr, src_len);
+    p = tap_record_put(p, &dst_len, 1);
+    p = tap_record_put(p, dst_addr, dst_len);
+    if (tcp_data != NULL) {
+        tap_record_put(p, tcp_data, tcp_data_len);
     }
 
-    g_string_free(json_str, TRUE);
-    g_free(data_base64);
+    if (alone) {
+        tcp_follow_tap_deliver(tap, record, size, 1);
+        g_free(record);
+    } else {
+        tap->len += size;
+        tap->count++;
+    }
 
     return TAP_PACKET_DONT_REDRAW;
 }
 
-void setup_tcp_follow_tap() {
-    int tap_id = register_tap("tcp_follow");
-    if (tap_id == 0) {
-        fprintf(stderr, "Error: Failed to register tcp_follow TAP.\n");
-        return;
-    }
+tcp_follow_tap *tcp_follow_tap_new(TcpTapBatchCallback callback, void *ctx, const char *filter) {
+    tcp_follow_tap *tap = g_new0(tcp_follow_tap, 1);
+    tap->callback = callback;
+    tap->ctx = ctx;
+    tap->filter = filter != NULL && filter[0] != '\0' ? g_strdup(filter) : NULL;
+    return tap;
+}
 
-    GString *error = register_tap_listener("tcp_follow", NULL, NULL, TL_REQUIRES_NOTHING, NULL,
-                                           follow_tcp_tap_packet, NULL, NULL);
+char *tcp_follow_tap_attach(tcp_follow_tap *tap) {
+    if (tap->attached) {
+        return NULL;
+    }
+    if (register_tap("tcp_follow") == 0) {
+        return g_strdup("failed to register the tcp_follow tap");
+    }
 
+    GString *error = register_tap_listener("tcp_follow", tap, tap->filter, TL_REQUIRES_NOTHING,
+                                           NULL, follow_tcp_tap_packet, NULL, NULL);
     if (error) {
-        fprintf(stderr, "Error registering listener: %s\n", error->str);
-        g_string_free(error, TRUE);
+        return g_string_free(error, FALSE);
+    }
+    if (tap->data == NULL) {
+        tap->data = g_malloc(TCP_TAP_BUF_SIZE);
     }
-}
\ No newline at end of file
+    tap->attached = true;
+    tap->replay_until = tap->last_num;
+    return NULL;
+}
+
+void tcp_follow_tap_detach(tcp_follow_tap *tap) {
+    if (!tap->attached) {
+        return;
+    }
+    tcp_follow_tap_flush(tap);
+    remove_tap_listener(tap);
+    tap->attached = false;
+}
+
+void tcp_follow_tap_free(tcp_follow_tap *tap) {
+    if (tap == NULL) {
+        return;
+    }
+    tcp_follow_tap_detach(tap);
+    g_free(tap->filter);
+    g_free(tap->data);
+    g_free(tap);
+}
@@ -26,13 +26,14 @@ type Packet struct {
 	Src       string  `json:"src"`
 	Dst       string  `json:"dst"`
 	Timestamp float64 `json:"timestamp"`
-	Data      string  `json:"data"`
+	Flags     uint16  `json:"flags"` // TCP flags of the segment
+	Data      string  `json:"data"`  // Base64 segment, only set by ParseTcpStream
 	RawData   []byte
 }
 
 var (
 	handles     = make(map[uintptr]*TCPReassembler)
-	muTcpStream sync.Mutex
+	muTcpStream sync.RWMutex
 	nextID      uintptr = 1
 )
 
@@ -40,21 +41,36 @@ type TCPReassembler struct {
 	streamStore *TCPStreamStore
 }
 
-func NewTCPReassembler() *TCPReassembler {
+// NewTCPReassembler returns a reassembler collecting the segments of the
+// tcp_follow tap into a TCPStreamStore configured by opts.
+func NewTCPReassembler(opts ...StoreOption) *TCPReassembler {
 	return &TCPReassembler{
-		streamStore: NewTCPStreamStore(),
+		streamStore: NewTCPStreamStore(opts...),
 	}
 }
 
-func (r *TCPReassembler) RegisterCallback() uintptr {
+// Store returns the stream store of r.
+func (r *TCPReassembler) Store() *TCPStreamStore {
+	return r.streamStore
+}
+
+// register returns a handle routing segment batches from C to r.
+func (r *TCPReassembler) register() uintptr {
 	muTcpStream.Lock()
+	defer muTcpStream.Unlock()
 	id := nextID
 	nextID++
 	handles[id] = r
-	muTcpStream.Unlock()
+	return id
+}
 
+// RegisterCallback makes r the receiver of the captures opened with
+// PrintTcpStreams(true). Prefer WithReassembler, which binds a reassembler to
+// one capture.
+func (r *TCPReassembler) RegisterCallback() uintptr {
+	id := r.register()
 	C.setTcpTapDataCallbackWithCtx(
-		(C.TcpTapDataCallback)(C.GetTcpTapDataCallback),
+		(C.TcpTapBatchCallback)(C.GetTcpTapBatchCallback),
 		unsafe.Pointer(id),
 	)
 	return id
@@ -66,53 +82,62 @@ func (r *TCPReassembler) UnregisterCallback(handle uintptr) {
 	muTcpStream.Unlock()
 }
 
-type TCPStreamStore struct {
-	sync.Mutex
-	streams map[uint32][]Packet
-}
-
-func NewTCPStreamStore() *TCPStreamStore {
-	return &TCPStreamStore{
-		streams: make(map[uint32][]Packet),
-	}
-}
-
-func (s *TCPStreamStore) AddPacket(packet Packet) {
-	s.Lock()
-	defer s.Unlock()
-	s.streams[packet.StreamID] = append(s.streams[packet.StreamID], packet)
-}
-
-//export GetTcpTapDataCallback
-func GetTcpTapDataCallback(data *C.char, length C.int, ctx unsafe.Pointer) {
-	if data == nil || length <= 0 || ctx == nil {
+// GetTcpTapBatchCallback
+// This function is called from C with count binary segment records (see
+// reassembly.h) back to back in data. The batch is copied once; the RawData of
+// its packets share that copy.
+//
+//export GetTcpTapBatchCallback
+func GetTcpTapBatchCallback(data *C.char, length C.int, count C.int, ctx unsafe.Pointer) {
+	if data == nil || length <= 0 || count <= 0 || ctx == nil {
 		return
 	}
 
-	muTcpStream.Lock()
+	muTcpStream.RLock()
 	handle := uintptr(ctx)
 	reassembler, exists := handles[handle]
-	muTcpStream.Unlock()
+	muTcpStream.RUnlock()
 
 	if !exists || reassembler == nil {
 		slog.Info("invalid reassembler handle", "handle", handle)
 		return
 	}
 
-	goStr := C.GoStringN(data, length)
-
-	if err := reassembler.handleTcpData(goStr); err != nil {
+	packets, err := parseTcpTapRecords(C.GoBytes(unsafe.Pointer(data), length), int(count))
+	if err != nil {
 		slog.Info("TCP data handling failed", "err", err)
 	}
+	reassembler.streamStore.AddPackets(packets)
 }
 
-func (r *TCPReassembler) handleTcpData(jsonStr string) error {
-	packet, err := ParseTcpStream(jsonStr)
-	if err != nil {
-		return fmt.Errorf("parse tcp stream: %w", err)
+// parseTcpTapRecords decodes count segment records from buf. On a malformed
+// record it returns the packets decoded before it.
+func parseTcpTapRecords(buf []byte, count int) ([]Packet, error) {
+	packets := make([]Packet, 0, count)
+	r := binaryFrameReader{src: buf}
+	for range count {
+		var p Packet
+		p.StreamID = r.u32()
+		p.PacketID = r.u32()
+		sec := int64(r.u64())
+		nsec := int32(r.u32())
+		p.Timestamp = float64(sec) + float64(nsec)/1e9
+		srcPort := r.u16()
+		dstPort := r.u16()
+		p.Flags = r.u16()
+		n := int(r.u32())
+		p.Src = fmt.Sprintf("%s:%d", r.str(int(r.u8())), srcPort)
+		p.Dst = fmt.Sprintf("%s:%d", r.str(int(r.u8())), dstPort)
+		if n > 0 {
+			b := r.next(n)
+			p.RawData = b[:n:n]
+		}
+		if r.err != nil {
+			return packets, ErrParseTcpStream
+		}
+		packets = append(packets, p)
 	}
-	r.streamStore.AddPacket(*packet)
-	return nil
+	return packets, nil
 }
 
 func ParseTcpStream(src string) (packet *Packet, err error) {
@@ -9,10 +9,44 @@
 #include <sys/un.h>
 #include <unistd.h>
 
-void setup_tcp_follow_tap();
+// A tcp_follow tap listener with its own callback, filter and record buffer.
+// Capture contexts attach theirs while they own the epan session, so the segments
+// of different captures never reach the same callback.
+typedef struct tcp_follow_tap tcp_follow_tap;
 
-typedef void (*TcpTapDataCallback)(const char *json, int length, void *ctx);
-void setTcpTapDataCallbackWithCtx(TcpTapDataCallback callback, void *ctx);
-void GetTcpTapDataCallback(char *json, int length, void *ctx);
+// The tcp_follow tap packs every TCP segment into a preallocated buffer as a
+// binary record, in host byte order:
+//
+//   uint32 stream id, uint32 packet id, int64 seconds + int32 nanoseconds,
+//   uint16 source port, uint16 destination port, uint16 TCP flags, uint32 data length,
+//   uint8 length + source address, uint8 length + destination address,
+//   then the segment bytes.
+//
+// The records are handed over back to back, count at a time, once the buffer is
+// full and whenever tcp_follow_tap_flush is called.
+#define TCP_TAP_BUF_SIZE (1 << 20)
+
+typedef void (*TcpTapBatchCallback)(const char *data, int length, int count, void *ctx);
+void GetTcpTapBatchCallback(char *data, int length, int count, void *ctx);
+
+// Set the callback of taps created without one (the printTcpStreams option).
+void setTcpTapDataCallbackWithCtx(TcpTapBatchCallback callback, void *ctx);
+
+// Create a detached listener. filter is a display filter, NULL or "" for every
+// segment; callback NULL uses the one of setTcpTapDataCallbackWithCtx.
+tcp_follow_tap *tcp_follow_tap_new(TcpTapBatchCallback callback, void *ctx, const char *filter);
+
+// Register the listener with the tcp_follow tap. Returns NULL, or an error that
+// the caller must g_free if the filter does not compile.
+char *tcp_follow_tap_attach(tcp_follow_tap *tap);
+
+// Hand the buffered segments to the callback and unregister the listener.
+void tcp_follow_tap_detach(tcp_follow_tap *tap);
+
+// Hand the buffered segments to the callback.
+void tcp_follow_tap_flush(tcp_follow_tap *tap);
+
+// Detach and free a listener.
+void tcp_follow_tap_free(tcp_follow_tap *tap);
 
 #endif  // FOLLOW_STREAM_H
\ No newline at end of file
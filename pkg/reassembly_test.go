@@ -1,8 +1,13 @@
 package pkg
 
 import (
+	"bytes"
+	"encoding/binary"
+	"fmt"
+	"os"
 	"sync"
 	"testing"
+	"time"
 )
 
 func TestFollowTcpStream(t *testing.T) {
@@ -28,17 +33,62 @@ func TestFollowTcpStream(t *testing.T) {
 
 	wg.Wait()
 
-	if len(reassembler.streamStore.streams) == 0 {
+	store := reassembler.Store()
+	if len(store.StreamIDs()) == 0 {
 		t.Error("No TCP streams captured")
 		return
 	}
 
-	for streamID, packets := range reassembler.streamStore.streams {
+	for _, streamID := range store.StreamIDs() {
+		packets, err := store.Packets(streamID)
+		if err != nil {
+			t.Fatalf("Packets(%d) failed: %v", streamID, err)
+		}
 		t.Logf("Stream %d: %d packets, total size: %d bytes",
 			streamID, len(packets), calculateTotalSize(packets))
 	}
 }
 
+// TestWithReassembler checks that captures with their own reassemblers do not
+// mix their streams, also while a session holds a listener of its own.
+func TestWithReassembler(t *testing.T) {
+	const path = "../pcaps/https.pcapng"
+	if _, err := os.Stat(path); os.IsNotExist(err) {
+		t.Skip("skipping test; pcap file not found")
+	}
+
+	all := NewTCPReassembler()
+	session, err := OpenCapture(path, WithReassembler(all, ""))
+	if err != nil {
+		t.Fatalf("OpenCapture failed: %v", err)
+	}
+	defer session.Close()
+	if _, _, err := session.GetPage(1, 1000); err != nil {
+		t.Fatalf("GetPage failed: %v", err)
+	}
+
+	first := NewTCPReassembler()
+	if _, err := GetAllFrames(path, WithReassembler(first, "tcp.stream == 0")); err != nil {
+		t.Fatalf("GetAllFrames failed: %v", err)
+	}
+
+	if ids := first.Store().StreamIDs(); len(ids) != 1 || ids[0] != 0 {
+		t.Fatalf("filtered reassembler got streams %v, want [0]", ids)
+	}
+	if len(all.Store().StreamIDs()) == 0 {
+		t.Fatal("session reassembler got no streams")
+	}
+	want, _ := all.Store().Packets(0)
+	got, _ := first.Store().Packets(0)
+	if len(got) != len(want) {
+		t.Fatalf("stream 0: %d packets, session saw %d", len(got), len(want))
+	}
+
+	if _, err := GetAllFrames(path, WithReassembler(NewTCPReassembler(), "tcp.stream ==")); err == nil {
+		t.Fatal("expected an error for a bad reassembly filter")
+	}
+}
+
 func calculateTotalSize(packets []Packet) int {
 	total := 0
 	for _, p := range packets {
@@ -46,3 +96,192 @@ func calculateTotalSize(packets []Packet) int {
 	}
 	return total
 }
+
+// appendTcpTapRecord encodes a segment record the way the tcp_follow tap does.
+func appendTcpTapRecord(buf []byte, stream, packet uint32, sec int64, nsec int32,
+	src string, srcPort uint16, dst string, dstPort uint16, data []byte) []byte {
+	buf = binary.NativeEndian.AppendUint32(buf, stream)
+	buf = binary.NativeEndian.AppendUint32(buf, packet)
+	buf = binary.NativeEndian.AppendUint64(buf, uint64(sec))
+	buf = binary.NativeEndian.AppendUint32(buf, uint32(nsec))
+	buf = binary.NativeEndian.AppendUint16(buf, srcPort)
+	buf = binary.NativeEndian.AppendUint16(buf, dstPort)
+	buf = binary.NativeEndian.AppendUint16(buf, 0x18) // PSH, ACK
+	buf = binary.NativeEndian.AppendUint32(buf, uint32(len(data)))
+	buf = append(buf, byte(len(src)))
+	buf = append(buf, src...)
+	buf = append(buf, byte(len(dst)))
+	buf = append(buf, dst...)
+	return append(buf, data...)
+}
+
+func TestParseTcpTapRecords(t *testing.T) {
+	var buf []byte
+	buf = appendTcpTapRecord(buf, 3, 10, 1700000000, 500000000, "10.0.0.1", 51000, "10.0.0.2", 443, []byte("hello"))
+	buf = appendTcpTapRecord(buf, 3, 11, 1700000001, 0, "10.0.0.2", 443, "10.0.0.1", 51000, nil)
+
+	packets, err := parseTcpTapRecords(buf, 2)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if len(packets) != 2 {
+		t.Fatalf("got %d packets, want 2", len(packets))
+	}
+	p := packets[0]
+	if p.StreamID != 3 || p.PacketID != 10 || p.Src != "10.0.0.1:51000" || p.Dst != "10.0.0.2:443" ||
+		p.Timestamp != 1700000000.5 || !bytes.Equal(p.RawData, []byte("hello")) {
+		t.Errorf("unexpected first packet: %+v", p)
+	}
+	if packets[1].RawData != nil || packets[1].Src != "10.0.0.2:443" {
+		t.Errorf("unexpected second packet: %+v", packets[1])
+	}
+
+	if _, err := parseTcpTapRecords(buf[:len(buf)-3], 2); err == nil {
+		t.Error("expected an error for a truncated batch")
+	}
+}
+
+func testSegment(stream, packet uint32, ts float64, src string, flags uint16, size int) Packet {
+	return Packet{StreamID: stream, PacketID: packet, Src: src, Dst: "peer", Timestamp: ts,
+		Flags: flags, RawData: bytes.Repeat([]byte{byte(packet)}, size)}
+}
+
+func TestTCPStreamStore_CloseAndIdle(t *testing.T) {
+	done := make(map[uint32]StreamEndReason)
+	store := NewTCPStreamStore(
+		WithStoreIdleTimeout(30*time.Second),
+		WithStreamDone(func(id uint32, packets []Packet, reason StreamEndReason) {
+			done[id] = reason
+		}),
+	)
+	defer store.Close()
+
+	store.AddPackets([]Packet{
+		testSegment(1, 1, 0, "a", 0, 10),
+		testSegment(1, 2, 1, "a", tcpFlagFin, 0),
+		testSegment(2, 3, 1, "c", 0, 10),
+		testSegment(1, 4, 2, "b", tcpFlagFin, 0),
+	})
+	if done[1] != StreamClosed {
+		t.Fatalf("stream 1: got %v, want closed", done)
+	}
+
+	// The trailing ACK of a closed stream does not bring it back.
+	store.AddPackets([]Packet{testSegment(1, 5, 2, "a", 0, 0), testSegment(3, 6, 100, "d", 0, 1)})
+	if done[2] != StreamIdle {
+		t.Fatalf("stream 2: got %v, want idle", done)
+	}
+	if ids := store.StreamIDs(); len(ids) != 1 || ids[0] != 3 {
+		t.Fatalf("streams left: %v, want [3]", ids)
+	}
+
+	store.Flush()
+	if done[3] != StreamFlushed {
+		t.Fatalf("stream 3: got %v, want flushed", done)
+	}
+}
+
+func TestTCPStreamStore_Spill(t *testing.T) {
+	const budget = 16 * 1024
+	store := NewTCPStreamStore(WithStoreMemoryBudget(budget), WithStoreSpillDir(t.TempDir()))
+	defer store.Close()
+
+	for i := uint32(0); i < 200; i++ {
+		store.AddPackets([]Packet{testSegment(i%4, i, float64(i), fmt.Sprint(i%2), 0, 1000)})
+		if used := store.MemoryUsage(); used > budget {
+			t.Fatalf("memory %d over budget %d", used, budget)
+		}
+	}
+
+	for stream := uint32(0); stream < 4; stream++ {
+		packets, err := store.Packets(stream)
+		if err != nil {
+			t.Fatal(err)
+		}
+		if len(packets) != 50 {
+			t.Fatalf("stream %d: %d packets, want 50", stream, len(packets))
+		}
+		for i, p := range packets {
+			want := stream + uint32(4*i)
+			if p.PacketID != want || len(p.RawData) != 1000 || p.RawData[0] != byte(want) {
+				t.Fatalf("stream %d packet %d: got id %d, want %d", stream, i, p.PacketID, want)
+			}
+		}
+	}
+}
+
+func TestTCPStreamStore_SpillTruncatedWhenUnused(t *testing.T) {
+	var got []int
+	store := NewTCPStreamStore(WithStoreMemoryBudget(4096), WithStoreSpillDir(t.TempDir()),
+		WithStreamDone(func(id uint32, packets []Packet, reason StreamEndReason) {
+			got = append(got, len(packets))
+		}))
+	defer store.Close()
+
+	for i := uint32(0); i < 20; i++ {
+		store.AddPackets([]Packet{testSegment(i%2, i, float64(i), "a", 0, 1000)})
+	}
+	store.AddPackets([]Packet{testSegment(0, 20, 20, "a", tcpFlagRst, 0)})
+	if info, err := os.Stat(store.spill.Name()); err != nil || info.Size() == 0 {
+		t.Fatalf("spill log emptied while stream 1 still uses it: %v", err)
+	}
+
+	store.AddPackets([]Packet{testSegment(1, 21, 21, "a", tcpFlagRst, 0)})
+	if len(got) != 2 || got[0] != 11 || got[1] != 11 {
+		t.Fatalf("handed over %v packets, want [11 11]", got)
+	}
+	info, err := os.Stat(store.spill.Name())
+	if err != nil {
+		t.Fatal(err)
+	}
+	if info.Size() != 0 {
+		t.Fatalf("spill log holds %d bytes with no stream spilled", info.Size())
+	}
+
+	// The log is reused from the start.
+	for i := uint32(22); i < 30; i++ {
+		store.AddPackets([]Packet{testSegment(2, i, float64(i), "a", 0, 1000)})
+	}
+	if packets, err := store.Packets(2); err != nil || len(packets) != 8 || packets[0].PacketID != 22 {
+		t.Fatalf("stream 2 after truncation: %d packets, err %v", len(packets), err)
+	}
+}
+
+func TestTCPStreamStore_FinishedForgotten(t *testing.T) {
+	store := NewTCPStreamStore(WithStoreIdleTimeout(30*time.Second),
+		WithStreamDone(func(uint32, []Packet, StreamEndReason) {}))
+	defer store.Close()
+
+	for i := uint32(0); i < 100; i++ {
+		store.AddPackets([]Packet{testSegment(i, i, 0, "a", tcpFlagRst, 10)})
+	}
+	if n := len(store.finished); n != 100 {
+		t.Fatalf("%d finished streams remembered, want 100", n)
+	}
+
+	// Past the idle timeout the trailing ACKs are over; the ids are forgotten.
+	store.AddPackets([]Packet{testSegment(1000, 1000, 31, "a", 0, 10)})
+	if n, q := len(store.finished), store.finishedQ.Len(); n != 0 || q != 0 {
+		t.Fatalf("%d finished streams (%d queued) remembered past the idle timeout", n, q)
+	}
+}
+
+func TestTCPStreamStore_EvictWithoutSpill(t *testing.T) {
+	var evicted []uint32
+	store := NewTCPStreamStore(WithStoreMemoryBudget(4096),
+		WithStreamDone(func(id uint32, packets []Packet, reason StreamEndReason) {
+			if reason == StreamEvicted {
+				evicted = append(evicted, id)
+			}
+		}))
+
+	for i := uint32(0); i < 10; i++ {
+		store.AddPackets([]Packet{testSegment(i, i, float64(i), "a", 0, 1000)})
+	}
+	if len(evicted) == 0 || evicted[0] != 0 {
+		t.Fatalf("evicted %v, want the oldest streams first", evicted)
+	}
+	if used := store.MemoryUsage(); used > 4096 {
+		t.Fatalf("memory %d over budget", used)
+	}
+}
@@ -0,0 +1,353 @@
+package pkg
+
+/*
+#cgo pkg-config: glib-2.0
+#include <stdlib.h>
+#include "offline.h"
+
+extern int OnFrameCallback(char *json, int len, int err, void *ctx);
+
+static bool call_session_get_frames_by_range(capture_ctx *ctx, int start, int limit,
+                                             int printCJson, char *filter) {
+    return session_get_frames_by_range(ctx, start, limit, printCJson, filter, OnFrameCallback);
+}
+
+static bool call_session_get_frames_by_idxs(capture_ctx *ctx, int *idxs, int count,
+                                            int printCJson) {
+    return session_get_frames_by_idxs(ctx, idxs, count, printCJson, OnFrameCallback);
+}
+
+static bool call_session_get_stream_payloads(capture_ctx *ctx, char *filter, char *proto) {
+    return session_get_stream_payloads(ctx, filter, proto, OnFrameCallback);
+}
+*/
+import "C"
+import (
+	"log/slog"
+	"os"
+	"slices"
+	"strconv"
+	"sync"
+	"time"
+	"unsafe"
+
+	"github.com/pkg/errors"
+)
+
+var (
+	ErrSessionClosed = errors.New("capture session is closed")
+	ErrSessionEpan   = errors.New("capture session cannot take the epan session back")
+	ErrSessionOption = errors.New("option is bound to the capture session at OpenCapture")
+)
+
+// Session keeps a capture file open across calls. The first pass over the file
+// is done once and its frame state kept, so paging, random access and stream
+// extraction on the same file no longer reopen and re-read it from frame 1.
+//
+// libwireshark supports a single live dissection session per process; sessions
+// hand it over between each other, and a session that lost it replays its first
+// pass (by offset, without re-reading the frames before) on its next call. Any
+// one-shot call (GetAllFrames, GetFrameByIdx, ...) takes it too. Sessions thus
+// only save that pass while calls on one file follow each other.
+//
+// A session closes itself, and its calls return ErrSessionClosed, once the file
+// changes on disk.
+//
+// Lock order: Session.mu, then EpanMutex.
+type Session struct {
+	mu       sync.Mutex
+	path     string
+	conf     *Conf
+	ctx      *C.capture_ctx
+	size     int64     // size of the file when it was opened
+	modTime  time.Time // mtime of the file when it was opened
+	lastUsed time.Time
+	idle     *time.Timer
+
+	releaseTap func() // drops the routing handle of the Reassembler listener
+}
+
+// OpenCapture opens a capture file into a long-lived session. TLS options,
+// PrintTcpStreams and the Reassembler configure its epan session, so they are
+// bound to it: a call that sets them differently fails with ErrSessionOption.
+// IgnoreError, Debug, PrintCJson and the other options are defaults that each
+// call may override.
+func OpenCapture(path string, opts ...Option) (*Session, error) {
+	info, err := os.Stat(path)
+	if err != nil {
+		return nil, errors.Wrap(ErrFileNotFound, path)
+	}
+
+	conf := NewConfig(opts...)
+
+	cPath := C.CString(path)
+	cOptions := C.CString(HandleConf(conf))
+	defer C.free(unsafe.Pointer(cPath))
+	defer C.free(unsafe.Pointer(cOptions))
+
+	var cErr C.int
+	EpanMutex.Lock()
+	ctx := C.capture_ctx_open(cPath, cOptions, &cErr)
+	if ctx == nil {
+		EpanMutex.Unlock()
+		return nil, errors.Wrap(ErrReadFile, strconv.Itoa(int(cErr)))
+	}
+	release, err := bindReassembler(ctx, conf)
+	if err != nil {
+		C.capture_ctx_close(ctx)
+		EpanMutex.Unlock()
+		return nil, err
+	}
+	EpanMutex.Unlock()
+
+	s := &Session{
+		path:       path,
+		conf:       conf,
+		ctx:        ctx,
+		size:       info.Size(),
+		modTime:    info.ModTime(),
+		lastUsed:   time.Now(),
+		releaseTap: release,
+	}
+	if conf.IdleTimeout > 0 {
+		s.idle = time.AfterFunc(conf.IdleTimeout, s.expire)
+	}
+
+	return s, nil
+}
+
+// Path returns the capture file path of the session.
+func (s *Session) Path() string {
+	return s.path
+}
+
+// Close releases the file handle and the frame state of the session.
+// Calls after Close return ErrSessionClosed.
+func (s *Session) Close() error {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	s.closeLocked()
+	return nil
+}
+
+func (s *Session) closeLocked() {
+	if s.ctx == nil {
+		return
+	}
+	if s.idle != nil {
+		s.idle.Stop()
+	}
+
+	EpanMutex.Lock()
+	C.capture_ctx_close(s.ctx)
+	EpanMutex.Unlock()
+	s.ctx = nil
+	s.releaseTap()
+}
+
+// expire closes the session once it has been idle for IdleTimeout.
+func (s *Session) expire() {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	if s.ctx == nil {
+		return
+	}
+	if idle := time.Since(s.lastUsed); idle < s.conf.IdleTimeout {
+		s.idle.Reset(s.conf.IdleTimeout - idle)
+		return
+	}
+
+	if s.conf.Debug {
+		slog.Info("Closing idle capture session", "path", s.path)
+	}
+	s.closeLocked()
+}
+
+// begin locks the session for one call and returns the configuration of that call.
+// The caller must unlock s.mu when done.
+func (s *Session) begin(opts []Option) (*Conf, error) {
+	s.mu.Lock()
+	if s.ctx == nil {
+		s.mu.Unlock()
+		return nil, ErrSessionClosed
+	}
+	// The frame state describes the file as it was; a rewritten file needs a
+	// new session.
+	if info, err := os.Stat(s.path); err != nil || info.Size() != s.size || !info.ModTime().Equal(s.modTime) {
+		s.closeLocked()
+		s.mu.Unlock()
+		return nil, errors.Wrap(ErrSessionClosed, "capture changed on disk")
+	}
+	s.lastUsed = time.Now()
+
+	conf := *s.conf
+	for _, opt := range opts {
+		opt(&conf)
+	}
+	if HandleConf(&conf) != HandleConf(s.conf) || conf.Reassembler != s.conf.Reassembler ||
+		conf.ReassemblyFilter != s.conf.ReassemblyFilter {
+		s.mu.Unlock()
+		return nil, ErrSessionOption
+	}
+	return &conf, nil
+}
+
+// GetPage fetches a page of frames, filtered by the display filter set with
+// WithBpfFilter if any.
+func (s *Session) GetPage(page, size int, opts ...Option) (frames []*FrameData, hasMore bool, err error) {
+	conf, err := s.begin(opts)
+	if err != nil {
+		return nil, false, err
+	}
+	defer s.mu.Unlock()
+
+	_, size, startFrameIdx, fetchSize := pageBounds(page, size)
+
+	if err := validateFrameConf(conf); err != nil {
+		return []*FrameData{}, false, err
+	}
+
+	cFilter := C.CString(conf.BpfFilter)
+	defer C.free(unsafe.Pointer(cFilter))
+
+	frames, err = collectFrames(conf, fetchSize, cFrameSource(func(cbCtx unsafe.Pointer) error {
+		EpanMutex.Lock()
+		defer EpanMutex.Unlock()
+
+		bindFrameSink(s.ctx, cbCtx, conf)
+		if !C.call_session_get_frames_by_range(s.ctx, C.int(startFrameIdx), C.int(fetchSize),
+			C.int(boolToInt(conf.PrintCJson)), cFilter) {
+			return ErrSessionEpan
+		}
+		return nil
+	}))
+	if err != nil {
+		return frames, false, err
+	}
+
+	frames, hasMore = trimPage(frames, size)
+	return frames, hasMore, nil
+}
+
+// GetByIdxs fetches specific frames by their frame numbers.
+func (s *Session) GetByIdxs(frameIdxs []int, opts ...Option) ([]*FrameData, error) {
+	conf, err := s.begin(opts)
+	if err != nil {
+		return nil, err
+	}
+	defer s.mu.Unlock()
+
+	if err := ValidateFields(conf.Fields); err != nil {
+		return []*FrameData{}, err
+	}
+
+	frameIdxs = removeNegativeAndZero(frameIdxs)
+	slices.Sort(frameIdxs)
+	frameIdxs = slices.Compact(frameIdxs)
+
+	if len(frameIdxs) == 0 {
+		return []*FrameData{}, nil
+	}
+
+	cIdxs := make([]C.int, len(frameIdxs))
+	for i, v := range frameIdxs {
+		cIdxs[i] = C.int(v)
+	}
+
+	return collectFrames(conf, len(frameIdxs), cFrameSource(func(cbCtx unsafe.Pointer) error {
+		EpanMutex.Lock()
+		defer EpanMutex.Unlock()
+
+		bindFrameSink(s.ctx, cbCtx, conf)
+		if !C.call_session_get_frames_by_idxs(s.ctx, &cIdxs[0], C.int(len(cIdxs)), C.int(boolToInt(conf.PrintCJson))) {
+			return ErrSessionEpan
+		}
+		return nil
+	}))
+}
+
+// GetHex retrieves the hex dump of a specific frame.
+func (s *Session) GetHex(frameIdx int, opts ...Option) (*HexData, error) {
+	if _, err := s.begin(opts); err != nil {
+		return nil, err
+	}
+	defer s.mu.Unlock()
+
+	EpanMutex.Lock()
+	srcHex := C.session_get_hex_data(s.ctx, C.int(frameIdx))
+	EpanMutex.Unlock()
+
+	if srcHex == nil {
+		return nil, ErrSessionEpan
+	}
+	defer C.free(unsafe.Pointer(srcHex))
+	if C.strlen(srcHex) == 0 {
+		return nil, nil
+	}
+	return ParseHexData(CChar2GoStr(srcHex))
+}
+
+// GetStream extracts the payloads of the frames matching filter, like GetStreamData.
+func (s *Session) GetStream(filter string, proto string, opts ...Option) (*StreamResult, error) {
+	conf, err := s.begin(opts)
+	if err != nil {
+		return nil, err
+	}
+	defer s.mu.Unlock()
+
+	if filter != "" {
+		if err := ValidateFilter(filter); err != nil {
+			return nil, err
+		}
+	}
+
+	return collectStreamPayloads(s.streamPayloads(conf, filter, proto, false))
+}
+
+// WriteStream writes the raw payloads of the frames matching filter to sink,
+// like WriteStreamData.
+func (s *Session) WriteStream(filter string, proto string, sink StreamSink, opts ...Option) (*StreamSummary, error) {
+	conf, err := s.begin(opts)
+	if err != nil {
+		return nil, err
+	}
+	defer s.mu.Unlock()
+
+	if filter != "" {
+		if err := ValidateFilter(filter); err != nil {
+			return nil, err
+		}
+	}
+
+	return writeStreamPayloads(s.streamPayloads(conf, filter, proto, true), sink)
+}
+
+// streamPayloads returns the source of the payload records of the session,
+// hex JSON or raw records if raw is set. Caller must hold s.mu.
+func (s *Session) streamPayloads(conf *Conf, filter, proto string, raw bool) frameSource {
+	return cFrameSource(func(cbCtx unsafe.Pointer) error {
+		cFilter := C.CString(filter)
+		cProto := C.CString(proto)
+		defer C.free(unsafe.Pointer(cFilter))
+		defer C.free(unsafe.Pointer(cProto))
+
+		EpanMutex.Lock()
+		defer EpanMutex.Unlock()
+
+		bindFrameSink(s.ctx, cbCtx, conf)
+		s.ctx.raw_payloads = C.bool(raw)
+		if !C.call_session_get_stream_payloads(s.ctx, cFilter, cProto) {
+			return ErrSessionEpan
+		}
+		return nil
+	})
+}
+
+func boolToInt(b bool) int {
+	if b {
+		return 1
+	}
+	return 0
+}
@@ -0,0 +1,159 @@
+package pkg
+
+import (
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+
+	"github.com/pkg/errors"
+)
+
+// TestSession_MatchesOneShot checks that pages, idxs and hex served by a session
+// match the one-shot API, including after another session took over the epan.
+func TestSession_MatchesOneShot(t *testing.T) {
+	if _, err := os.Stat(testPcapFile); os.IsNotExist(err) {
+		t.Skip("skipping test; pcap file not found")
+	}
+
+	s, err := OpenCapture(testPcapFile)
+	if err != nil {
+		t.Fatalf("OpenCapture failed: %v", err)
+	}
+	defer s.Close()
+
+	for _, page := range []int{3, 1, 5} {
+		want, wantMore, err := GetFramesByPage(testPcapFile, page, 20)
+		if err != nil {
+			t.Fatalf("GetFramesByPage(%d) failed: %v", page, err)
+		}
+		got, gotMore, err := s.GetPage(page, 20)
+		if err != nil {
+			t.Fatalf("Session.GetPage(%d) failed: %v", page, err)
+		}
+		if len(got) != len(want) || gotMore != wantMore {
+			t.Fatalf("page %d: got %d frames (more=%v), want %d (more=%v)", page, len(got), gotMore, len(want), wantMore)
+		}
+		for i := range want {
+			if got[i].BaseLayers.Frame.Number != want[i].BaseLayers.Frame.Number {
+				t.Errorf("page %d[%d]: got frame %d, want %d", page, i, got[i].BaseLayers.Frame.Number, want[i].BaseLayers.Frame.Number)
+			}
+		}
+	}
+
+	// A second session takes the epan over; the first one must still answer correctly.
+	other, err := OpenCapture(testPcapFile)
+	if err != nil {
+		t.Fatalf("OpenCapture failed: %v", err)
+	}
+	if _, err := other.GetByIdxs([]int{7}); err != nil {
+		t.Fatalf("Session.GetByIdxs failed: %v", err)
+	}
+	other.Close()
+
+	frames, err := s.GetByIdxs([]int{42, 10, 42})
+	if err != nil {
+		t.Fatalf("Session.GetByIdxs failed: %v", err)
+	}
+	if len(frames) != 2 || frames[0].BaseLayers.Frame.Number != 10 || frames[1].BaseLayers.Frame.Number != 42 {
+		t.Fatalf("unexpected frames: %d", len(frames))
+	}
+
+	hex, err := s.GetHex(10)
+	if err != nil || hex == nil || len(hex.Hex) == 0 {
+		t.Fatalf("Session.GetHex failed: %v", err)
+	}
+}
+
+func TestSession_CloseAndIdle(t *testing.T) {
+	if _, err := os.Stat(testPcapFile); os.IsNotExist(err) {
+		t.Skip("skipping test; pcap file not found")
+	}
+
+	s, err := OpenCapture(testPcapFile, WithIdleTimeout(50*time.Millisecond))
+	if err != nil {
+		t.Fatalf("OpenCapture failed: %v", err)
+	}
+	if _, _, err := s.GetPage(1, 5); err != nil {
+		t.Fatalf("Session.GetPage failed: %v", err)
+	}
+
+	time.Sleep(200 * time.Millisecond)
+	if _, _, err := s.GetPage(1, 5); !errors.Is(err, ErrSessionClosed) {
+		t.Fatalf("expected ErrSessionClosed after idle timeout, got %v", err)
+	}
+	if err := s.Close(); err != nil {
+		t.Fatalf("Close after eviction failed: %v", err)
+	}
+}
+
+// TestSession_BoundOptions checks that a call cannot change the options the
+// epan session was opened with, while per-call options still apply.
+func TestSession_BoundOptions(t *testing.T) {
+	if _, err := os.Stat(testPcapFile); os.IsNotExist(err) {
+		t.Skip("skipping test; pcap file not found")
+	}
+
+	tls := TlsConf{DesegmentSslRecords: true}
+	s, err := OpenCapture(testPcapFile, WithTls(tls))
+	if err != nil {
+		t.Fatalf("OpenCapture failed: %v", err)
+	}
+	defer s.Close()
+
+	if _, _, err := s.GetPage(1, 5, WithTls(TlsConf{})); !errors.Is(err, ErrSessionOption) {
+		t.Errorf("expected ErrSessionOption for other TLS options, got %v", err)
+	}
+	if _, _, err := s.GetPage(1, 5, WithTls(tls), IgnoreError(false)); err != nil {
+		t.Errorf("Session.GetPage with the session's own TLS options failed: %v", err)
+	}
+}
+
+// TestSession_FileChanged checks that a session stops serving a file that was
+// rewritten after it was opened.
+func TestSession_FileChanged(t *testing.T) {
+	data, err := os.ReadFile(testPcapFile)
+	if err != nil {
+		t.Skip("skipping test; pcap file not found")
+	}
+	path := filepath.Join(t.TempDir(), "capture.pcap")
+	if err := os.WriteFile(path, data, 0o644); err != nil {
+		t.Fatal(err)
+	}
+
+	s, err := OpenCapture(path)
+	if err != nil {
+		t.Fatalf("OpenCapture failed: %v", err)
+	}
+	defer s.Close()
+	if _, _, err := s.GetPage(1, 5); err != nil {
+		t.Fatalf("Session.GetPage failed: %v", err)
+	}
+
+	later := time.Now().Add(time.Minute)
+	if err := os.Chtimes(path, later, later); err != nil {
+		t.Fatal(err)
+	}
+	if _, _, err := s.GetPage(1, 5); !errors.Is(err, ErrSessionClosed) {
+		t.Fatalf("expected ErrSessionClosed after the file changed, got %v", err)
+	}
+}
+
+func BenchmarkSession_GetPageDeep(b *testing.B) {
+	if _, err := os.Stat(testPcapFile); os.IsNotExist(err) {
+		b.Skip("skipping benchmark; pcap file not found")
+	}
+
+	s, err := OpenCapture(testPcapFile)
+	if err != nil {
+		b.Fatalf("OpenCapture failed: %v", err)
+	}
+	defer s.Close()
+
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if _, _, err := s.GetPage(50, 20); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
@@ -0,0 +1,178 @@
+package pkg
+
+/*
+#cgo pkg-config: glib-2.0
+#include <stdlib.h>
+#include "offline.h"
+
+extern int OnFrameCallback(char *json, int len, int err, void *ctx);
+
+static void call_get_frames_by_shard_indexed_cb(capture_ctx *ctx, frame_index *idx, int start,
+                                                int end, int warmup, int printCJson,
+                                                char *filter) {
+    get_frames_by_shard_indexed_cb(ctx, idx, start, end, warmup, printCJson, filter,
+                                   OnFrameCallback);
+}
+*/
+import "C"
+import (
+	"log/slog"
+	"slices"
+	"sort"
+	"sync"
+	"unsafe"
+)
+
+// Shard is a range of frames dissected by one worker in a sharded pass.
+type Shard struct {
+	First int `json:"first"`
+	Last  int `json:"last"`
+}
+
+// ShardEdge is a range of frames right after a shard boundary. Their shard was
+// warmed up with only ShardOverlap frames, so layers that depend on reassembly
+// begun before the warm-up window may differ from a sequential pass.
+type ShardEdge struct {
+	First int `json:"first"`
+	Last  int `json:"last"`
+}
+
+// ShardedFrames is the merged result of a sharded pass.
+type ShardedFrames struct {
+	Frames []*FrameData `json:"frames"` // In frame order
+	Shards []Shard      `json:"shards"`
+	Edges  []ShardEdge  `json:"edges"`
+}
+
+// IsEdgeFrame reports whether frame num falls in one of the shard edges.
+func (r *ShardedFrames) IsEdgeFrame(num int) bool {
+	for _, e := range r.Edges {
+		if num >= e.First && num <= e.Last {
+			return true
+		}
+	}
+	return false
+}
+
+// shardStarts splits the indexed capture into up to n byte ranges of similar
+// size, cut at frame boundaries, and returns the first frame of each.
+func (c *cachedFrameIndex) shardStarts(n int) []int {
+	count := int(c.idx.count)
+	if count == 0 {
+		return nil
+	}
+	n = min(n, count)
+
+	entries := unsafe.Slice(c.idx.entries, count)
+	size := int64(c.idx.file_size)
+
+	starts := []int{1}
+	for k := 1; k < n; k++ {
+		target := size * int64(k) / int64(n)
+		i := sort.Search(count, func(i int) bool { return int64(entries[i].offset) >= target })
+		if i < count && i+1 > starts[len(starts)-1] {
+			starts = append(starts, i+1)
+		}
+	}
+	return starts
+}
+
+// planShards splits frames 1..count at starts and lists the edges of the
+// shards whose warm-up does not reach back to frame 1.
+func planShards(starts []int, count, overlap int) ([]Shard, []ShardEdge) {
+	var shards []Shard
+	var edges []ShardEdge
+	for i, first := range starts {
+		last := count
+		if i+1 < len(starts) {
+			last = starts[i+1] - 1
+		}
+		shards = append(shards, Shard{First: first, Last: last})
+
+		if first-1 > overlap {
+			edges = append(edges, ShardEdge{First: first, Last: min(first+max(overlap, 1)-1, last)})
+		}
+	}
+	return shards, edges
+}
+
+// runShard returns the C call that dissects one shard.
+func runShard(path string, conf *Conf, first, last int) func(cbCtx unsafe.Pointer) error {
+	return func(cbCtx unsafe.Pointer) error {
+		idx, err := loadFrameIndex(path)
+		if err != nil {
+			return err
+		}
+		defer idx.release()
+
+		cFilter := C.CString(conf.BpfFilter)
+		defer C.free(unsafe.Pointer(cFilter))
+
+		return withCapFile(path, conf, func(ctx *C.capture_ctx) {
+			bindFrameSink(ctx, cbCtx, conf)
+			C.call_get_frames_by_shard_indexed_cb(ctx, idx.idx, C.int(first), C.int(last),
+				C.int(conf.ShardOverlap), C.int(boolToInt(conf.PrintCJson)), cFilter)
+		})
+	}
+}
+
+// GetAllFramesSharded dissects a whole capture in shards spread over the
+// workers and merges them back in frame order. The capture is split into byte
+// ranges of similar size at the frame boundaries of its frame index; each
+// shard first dissects the ShardOverlap frames before it (WithShardOverlap) so
+// TCP and IP reassembly converge. Results near shard starts may still differ
+// from GetAllFrames; those frames are listed in Edges.
+//
+// shards defaults to the number of workers.
+func (p *WorkerPool) GetAllFramesSharded(path string, shards int, opts ...Option) (*ShardedFrames, error) {
+	conf := NewConfig(opts...)
+
+	if err := validateFrameConf(conf); err != nil {
+		return nil, err
+	}
+	if shards < 1 {
+		shards = len(p.workers)
+	}
+
+	// Building the index here persists the sidecar once, so the workers load it
+	// instead of each scanning the capture.
+	idx, err := loadFrameIndex(path)
+	if err != nil {
+		return nil, err
+	}
+	starts := idx.shardStarts(shards)
+	count := int(idx.idx.count)
+	idx.release()
+
+	res := &ShardedFrames{}
+	res.Shards, res.Edges = planShards(starts, count, conf.ShardOverlap)
+
+	// Each shard comes back in frame order and the shards are in order, so the
+	// merge is a concatenation.
+	var wg sync.WaitGroup
+	frames := make([][]*FrameData, len(res.Shards))
+	errs := make([]error, len(res.Shards))
+	for i, s := range res.Shards {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			frames[i], errs[i] = collectFrames(conf, s.Last-s.First+1,
+				p.source(&workerJob{Op: jobShard, Path: path, Start: s.First, Limit: s.Last, Conf: conf}))
+		}()
+	}
+	wg.Wait()
+
+	res.Frames = slices.Concat(frames...)
+	for _, e := range errs {
+		if e != nil {
+			err = e
+			break
+		}
+	}
+
+	if conf.Debug {
+		slog.Info("Sharded dissect end", "PCAP_FILE", path, "SHARDS", len(res.Shards), "COUNT", len(res.Frames))
+	}
+
+	return res, err
+}
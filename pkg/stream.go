@@ -0,0 +1,554 @@
+package pkg
+
+/*
+#cgo pkg-config: glib-2.0
+#include <stdlib.h>
+#include "offline.h"
+
+extern int OnFrameCallback(char *json, int len, int err, void *ctx);
+
+static void call_get_all_stream_records(capture_ctx *ctx, char *proto) {
+    get_all_stream_records(ctx, proto, OnFrameCallback);
+}
+*/
+import "C"
+import (
+	"bufio"
+	"cmp"
+	"container/list"
+	"encoding/binary"
+	"fmt"
+	"io"
+	"os"
+	"path/filepath"
+	"slices"
+	"time"
+	"unsafe"
+
+	"github.com/bytedance/sonic"
+	"github.com/pkg/errors"
+)
+
+// Directions of a stream payload. The sender of the first payload is the client.
+const (
+	PayloadDirClient = "client"
+	PayloadDirServer = "server"
+)
+
+var (
+	ErrParsePayloadRecord = errors.New("malformed payload record")
+	ErrPayloadFile        = errors.New("not a payload file")
+)
+
+const (
+	payloadRecordMagic = uint32(C.PAYLOAD_RECORD_MAGIC)
+	streamRecordMagic  = uint32(C.STREAM_RECORD_MAGIC)
+)
+
+// PayloadRecord is one payload of a stream, copied raw from its frame.
+type PayloadRecord struct {
+	Dir   string // PayloadDirClient or PayloadDirServer
+	Frame int    // Frame number
+	Data  []byte // Payload bytes, valid only until WritePayload returns
+}
+
+// StreamSink receives the payloads of WriteStreamData in frame order. An error
+// stops the extraction and is returned by WriteStreamData.
+type StreamSink interface {
+	WritePayload(rec *PayloadRecord) error
+}
+
+// StreamSummary is what WriteStreamData keeps in memory of a stream: its ends
+// and byte counts, not the payloads.
+type StreamSummary struct {
+	ClientNode  string `json:"clientNode"`
+	ServerNode  string `json:"serverNode"`
+	ClientBytes int    `json:"clientBytes"`
+	ServerBytes int    `json:"serverBytes"`
+	PacketCount int    `json:"packetCount"` // Frames matching the filter
+	Payloads    int    `json:"payloads"`    // Payload records written to the sink
+}
+
+// WriteStreamData extracts the payloads of the frames matching filter like
+// GetStreamData, but hands the raw bytes of each payload to sink as it is
+// dissected instead of collecting hex strings. Memory stays flat however large
+// the stream is. See DirWriters and NewPayloadFileWriter for ready-made sinks.
+func WriteStreamData(path string, filter string, proto string, sink StreamSink, opts ...Option) (*StreamSummary, error) {
+	conf := NewConfig(opts...)
+
+	if filter != "" {
+		if err := ValidateFilter(filter); err != nil {
+			return nil, err
+		}
+	}
+
+	return writeStreamPayloads(cFrameSource(runStreamPayloads(path, conf, filter, proto, true)), sink)
+}
+
+// writeStreamPayloads drains a source of raw payload records into sink.
+func writeStreamPayloads(src frameSource, sink StreamSink) (*StreamSummary, error) {
+	sum := &StreamSummary{}
+	ends := newStreamEnds()
+	var sinkErr error
+
+	err := src(func(batch [][]byte) bool {
+		for _, raw := range batch {
+			if sinkErr != nil {
+				return false
+			}
+			if !isPayloadRecord(raw) {
+				var summary FastStreamPayload
+				if sonic.Unmarshal(raw, &summary) == nil && summary.Summary {
+					sum.PacketCount = summary.MatchedCount
+				}
+				continue
+			}
+
+			p, err := parsePayloadRecord(raw)
+			if err != nil {
+				sinkErr = err
+				return false
+			}
+			rec := PayloadRecord{
+				Dir:   ends.dir(p.src, p.srcPort, p.dst, p.dstPort),
+				Frame: p.frame,
+				Data:  p.data,
+			}
+			if rec.Dir == PayloadDirClient {
+				sum.ClientBytes += len(rec.Data)
+			} else {
+				sum.ServerBytes += len(rec.Data)
+			}
+			if sinkErr = sink.WritePayload(&rec); sinkErr != nil {
+				return false
+			}
+			sum.Payloads++
+		}
+		return true
+	})
+	if sinkErr != nil {
+		err = sinkErr
+	}
+	sum.ClientNode, sum.ServerNode = ends.clientNode, ends.serverNode
+	return sum, err
+}
+
+// streamEnds tells the two directions of a stream apart by the port of the
+// first payload's sender.
+type streamEnds struct {
+	clientPort int
+	clientNode string
+	serverNode string
+}
+
+func newStreamEnds() streamEnds {
+	return streamEnds{clientPort: -1, clientNode: "Client", serverNode: "Server"}
+}
+
+// dir returns the direction of a payload sent from src to dst.
+func (e *streamEnds) dir(src string, srcPort int, dst string, dstPort int) string {
+	if e.clientPort == -1 && srcPort != 0 {
+		e.clientPort = srcPort
+		e.clientNode = fmt.Sprintf("%s:%d", src, srcPort)
+		e.serverNode = fmt.Sprintf("%s:%d", dst, dstPort)
+	}
+	if srcPort == e.clientPort {
+		return PayloadDirClient
+	}
+	return PayloadDirServer
+}
+
+// rawPayload is a decoded raw payload record (PAYLOAD_RECORD_MAGIC) or stream
+// record (STREAM_RECORD_MAGIC), see offline.h.
+type rawPayload struct {
+	stream  int
+	ts      time.Time
+	frame   int
+	srcPort int
+	dstPort int
+	src     string
+	dst     string
+	data    []byte
+}
+
+func isPayloadRecord(src []byte) bool {
+	return len(src) >= 4 && binary.NativeEndian.Uint32(src) == payloadRecordMagic
+}
+
+func parsePayloadRecord(src []byte) (p rawPayload, err error) {
+	r := binaryFrameReader{src: src}
+	r.next(4) // magic
+	p.frame = int(r.u32())
+	p.srcPort = int(r.u16())
+	p.dstPort = int(r.u16())
+	p.src = r.str(int(r.u8()))
+	p.dst = r.str(int(r.u8()))
+	if r.err != nil {
+		return p, ErrParsePayloadRecord
+	}
+	p.data = r.src
+	return p, nil
+}
+
+func parseStreamRecord(src []byte) (p rawPayload, err error) {
+	r := binaryFrameReader{src: src}
+	r.next(4) // magic
+	p.stream = int(r.u32())
+	p.frame = int(r.u32())
+	sec := int64(r.u64())
+	nsec := int64(int32(r.u32()))
+	p.ts = time.Unix(sec, nsec)
+	p.srcPort = int(r.u16())
+	p.dstPort = int(r.u16())
+	p.src = r.str(int(r.u8()))
+	p.dst = r.str(int(r.u8()))
+	if r.err != nil {
+		return p, ErrParsePayloadRecord
+	}
+	p.data = r.src
+	return p, nil
+}
+
+// dirWriters is the StreamSink of DirWriters.
+type dirWriters struct {
+	client io.Writer
+	server io.Writer
+}
+
+// DirWriters returns a sink that writes client payloads to client and server
+// payloads to server, back to back. A nil writer drops its direction.
+func DirWriters(client, server io.Writer) StreamSink {
+	return &dirWriters{client: client, server: server}
+}
+
+func (d *dirWriters) WritePayload(rec *PayloadRecord) error {
+	w := d.server
+	if rec.Dir == PayloadDirClient {
+		w = d.client
+	}
+	if w == nil {
+		return nil
+	}
+	_, err := w.Write(rec.Data)
+	return err
+}
+
+// Payload files, in the spirit of pcap: a file header, then one header per
+// record followed by the payload, all little-endian.
+//
+//	file header:   "GWPL", uint16 version (1), uint16 reserved
+//	record header: uint8 direction (0 client, 1 server), 3 bytes reserved,
+//	               uint32 frame number, uint32 payload length
+const (
+	payloadFileMagic     = "GWPL"
+	payloadFileVersion   = 1
+	payloadRecHeaderSize = 12
+)
+
+// PayloadFileWriter is a StreamSink that writes a payload file. Call Flush once
+// the extraction is done.
+type PayloadFileWriter struct {
+	w           *bufio.Writer
+	wroteHeader bool
+}
+
+// NewPayloadFileWriter returns a sink writing a payload file to w.
+func NewPayloadFileWriter(w io.Writer) *PayloadFileWriter {
+	return &PayloadFileWriter{w: bufio.NewWriterSize(w, 64*1024)}
+}
+
+func (f *PayloadFileWriter) writeHeader() error {
+	var hdr [8]byte
+	copy(hdr[:], payloadFileMagic)
+	binary.LittleEndian.PutUint16(hdr[4:], payloadFileVersion)
+	f.wroteHeader = true
+	_, err := f.w.Write(hdr[:])
+	return err
+}
+
+func (f *PayloadFileWriter) WritePayload(rec *PayloadRecord) error {
+	if !f.wroteHeader {
+		if err := f.writeHeader(); err != nil {
+			return err
+		}
+	}
+	var hdr [payloadRecHeaderSize]byte
+	if rec.Dir != PayloadDirClient {
+		hdr[0] = 1
+	}
+	binary.LittleEndian.PutUint32(hdr[4:], uint32(rec.Frame))
+	binary.LittleEndian.PutUint32(hdr[8:], uint32(len(rec.Data)))
+	if _, err := f.w.Write(hdr[:]); err != nil {
+		return err
+	}
+	_, err := f.w.Write(rec.Data)
+	return err
+}
+
+// Flush writes the file header if no payload was written, and any buffered data.
+func (f *PayloadFileWriter) Flush() error {
+	if !f.wroteHeader {
+		if err := f.writeHeader(); err != nil {
+			return err
+		}
+	}
+	return f.w.Flush()
+}
+
+// ReadPayloadFile reads a payload file written by PayloadFileWriter and calls
+// fn for every record, in order. rec.Data is reused between calls.
+func ReadPayloadFile(r io.Reader, fn func(rec *PayloadRecord) error) error {
+	br := bufio.NewReader(r)
+
+	var hdr [payloadRecHeaderSize]byte
+	if _, err := io.ReadFull(br, hdr[:8]); err != nil {
+		return errors.Wrap(ErrPayloadFile, err.Error())
+	}
+	if string(hdr[:4]) != payloadFileMagic || binary.LittleEndian.Uint16(hdr[4:]) != payloadFileVersion {
+		return ErrPayloadFile
+	}
+
+	var rec PayloadRecord
+	for {
+		if _, err := io.ReadFull(br, hdr[:]); err != nil {
+			if err == io.EOF {
+				return nil
+			}
+			return errors.Wrap(ErrPayloadFile, err.Error())
+		}
+		rec.Dir = PayloadDirClient
+		if hdr[0] != 0 {
+			rec.Dir = PayloadDirServer
+		}
+		rec.Frame = int(binary.LittleEndian.Uint32(hdr[4:]))
+		n := int(binary.LittleEndian.Uint32(hdr[8:]))
+		if cap(rec.Data) < n {
+			rec.Data = make([]byte, n)
+		}
+		rec.Data = rec.Data[:n]
+		if _, err := io.ReadFull(br, rec.Data); err != nil {
+			return errors.Wrap(ErrPayloadFile, err.Error())
+		}
+		if err := fn(&rec); err != nil {
+			return err
+		}
+	}
+}
+
+// StreamIndexFile is the name of the index ExtractAllStreams writes to outDir.
+const StreamIndexFile = "index.json"
+
+// StreamIndexEntry describes one conversation extracted by ExtractAllStreams.
+// The client is the sender of its first frame.
+type StreamIndexEntry struct {
+	Stream      int       `json:"stream"` // tcp.stream or udp.stream index
+	Proto       string    `json:"proto"`
+	ClientAddr  string    `json:"clientAddr"`
+	ClientPort  int       `json:"clientPort"`
+	ServerAddr  string    `json:"serverAddr"`
+	ServerPort  int       `json:"serverPort"`
+	ClientBytes int64     `json:"clientBytes"`
+	ServerBytes int64     `json:"serverBytes"`
+	Packets     int       `json:"packets"`
+	FirstTime   time.Time `json:"firstTime"`
+	LastTime    time.Time `json:"lastTime"`
+	Path        string    `json:"path,omitempty"` // Payload file, empty if the stream carried no payload
+}
+
+// ExtractAllStreams writes the payloads of every TCP (proto "tcp") or UDP (proto
+// "udp") conversation in path to its own payload file in outDir, in a single pass
+// over the file, and writes an index of the conversations to outDir/index.json.
+// At most MaxOpenStreams (WithMaxOpenStreams) files are open at a time. The
+// returned entries are ordered by stream index. Read the files back with
+// ReadPayloadFile.
+func ExtractAllStreams(path string, outDir string, proto string, opts ...Option) ([]StreamIndexEntry, error) {
+	conf := NewConfig(opts...)
+	if proto != "tcp" && proto != "udp" {
+		return nil, errors.Errorf("unsupported stream protocol %q", proto)
+	}
+	if err := os.MkdirAll(outDir, 0o755); err != nil {
+		return nil, errors.Wrap(err, "create stream directory")
+	}
+
+	src := cFrameSource(func(cbCtx unsafe.Pointer) error {
+		cProto := C.CString(proto)
+		defer C.free(unsafe.Pointer(cProto))
+
+		return withCapFile(path, conf, func(ctx *C.capture_ctx) {
+			bindFrameSink(ctx, cbCtx, conf)
+			C.call_get_all_stream_records(ctx, cProto)
+		})
+	})
+
+	files := newStreamFiles(outDir, proto, conf.MaxOpenStreams)
+	var writeErr error
+	err := src(func(batch [][]byte) bool {
+		for _, raw := range batch {
+			if len(raw) < 4 || binary.NativeEndian.Uint32(raw) != streamRecordMagic {
+				continue
+			}
+			p, err := parseStreamRecord(raw)
+			if err == nil {
+				err = files.add(&p)
+			}
+			if err != nil {
+				writeErr = err
+				return false
+			}
+		}
+		return true
+	})
+	if closeErr := files.close(); writeErr == nil {
+		writeErr = closeErr
+	}
+	if err == nil {
+		err = writeErr
+	}
+	if err != nil {
+		return nil, err
+	}
+
+	entries := files.entries()
+	data, err := sonic.Marshal(entries)
+	if err != nil {
+		return nil, errors.Wrap(err, "marshal stream index")
+	}
+	if err := os.WriteFile(filepath.Join(outDir, StreamIndexFile), data, 0o644); err != nil {
+		return nil, errors.Wrap(err, "write stream index")
+	}
+	return entries, nil
+}
+
+// streamFile is the index entry and, while it is in the LRU, the open payload
+// file of one conversation.
+type streamFile struct {
+	entry StreamIndexEntry
+	f     *os.File
+	w     *PayloadFileWriter
+	elem  *list.Element
+}
+
+// streamFiles routes stream records to per-stream payload files, keeping at most
+// max of them open. lru holds the open ones, most recently written first.
+type streamFiles struct {
+	dir     string
+	proto   string
+	max     int
+	streams map[int]*streamFile
+	lru     *list.List
+}
+
+// Buffer of each open stream file. Small, since many are open at once.
+const streamFileBufSize = 16 * 1024
+
+func newStreamFiles(dir, proto string, max int) *streamFiles {
+	return &streamFiles{
+		dir:     dir,
+		proto:   proto,
+		max:     max,
+		streams: make(map[int]*streamFile),
+		lru:     list.New(),
+	}
+}
+
+// add accounts a stream record to its conversation and appends its payload.
+func (s *streamFiles) add(p *rawPayload) error {
+	sf := s.streams[p.stream]
+	if sf == nil {
+		sf = &streamFile{entry: StreamIndexEntry{
+			Stream:     p.stream,
+			Proto:      s.proto,
+			ClientAddr: p.src,
+			ClientPort: p.srcPort,
+			ServerAddr: p.dst,
+			ServerPort: p.dstPort,
+			FirstTime:  p.ts,
+		}}
+		s.streams[p.stream] = sf
+	}
+	e := &sf.entry
+	e.Packets++
+	e.LastTime = p.ts
+	if len(p.data) == 0 {
+		return nil
+	}
+
+	rec := PayloadRecord{Dir: PayloadDirServer, Frame: p.frame, Data: p.data}
+	if p.srcPort == e.ClientPort && p.src == e.ClientAddr {
+		rec.Dir = PayloadDirClient
+		e.ClientBytes += int64(len(p.data))
+	} else {
+		e.ServerBytes += int64(len(p.data))
+	}
+
+	if err := s.open(sf); err != nil {
+		return err
+	}
+	return sf.w.WritePayload(&rec)
+}
+
+// open makes sure the file of sf is open and at the front of the LRU, closing
+// the least recently written file if the LRU is full.
+func (s *streamFiles) open(sf *streamFile) error {
+	if sf.f != nil {
+		s.lru.MoveToFront(sf.elem)
+		return nil
+	}
+	if s.lru.Len() >= s.max {
+		if err := s.evict(s.lru.Back().Value.(*streamFile)); err != nil {
+			return err
+		}
+	}
+
+	// A file written before already has its header.
+	reopen := sf.entry.Path != ""
+	if !reopen {
+		sf.entry.Path = filepath.Join(s.dir, fmt.Sprintf("%s-%d.gwpl", s.proto, sf.entry.Stream))
+	}
+	f, err := os.OpenFile(sf.entry.Path, os.O_WRONLY|os.O_CREATE|os.O_APPEND, 0o644)
+	if err != nil {
+		return errors.Wrap(err, "open stream file")
+	}
+	if !reopen {
+		if err := f.Truncate(0); err != nil {
+			f.Close()
+			return errors.Wrap(err, "open stream file")
+		}
+	}
+	sf.f = f
+	sf.w = &PayloadFileWriter{w: bufio.NewWriterSize(f, streamFileBufSize), wroteHeader: reopen}
+	sf.elem = s.lru.PushFront(sf)
+	return nil
+}
+
+// evict flushes and closes the file of sf and drops it from the LRU.
+func (s *streamFiles) evict(sf *streamFile) error {
+	s.lru.Remove(sf.elem)
+	err := sf.w.Flush()
+	if closeErr := sf.f.Close(); err == nil {
+		err = closeErr
+	}
+	sf.f, sf.w, sf.elem = nil, nil, nil
+	return errors.Wrap(err, "close stream file")
+}
+
+// close flushes and closes every open file, returning the first error.
+func (s *streamFiles) close() error {
+	var first error
+	for s.lru.Len() > 0 {
+		if err := s.evict(s.lru.Front().Value.(*streamFile)); err != nil && first == nil {
+			first = err
+		}
+	}
+	return first
+}
+
+// entries returns the index entries ordered by stream index.
+func (s *streamFiles) entries() []StreamIndexEntry {
+	entries := make([]StreamIndexEntry, 0, len(s.streams))
+	for _, sf := range s.streams {
+		entries = append(entries, sf.entry)
+	}
+	slices.SortFunc(entries, func(a, b StreamIndexEntry) int { return cmp.Compare(a.Stream, b.Stream) })
+	return entries
+}
@@ -0,0 +1,524 @@
+package pkg
+
+import (
+	"bufio"
+	"bytes"
+	"container/list"
+	"encoding/binary"
+	"io"
+	"log/slog"
+	"math"
+	"os"
+	"slices"
+	"sync"
+	"time"
+	"unsafe"
+
+	"github.com/pkg/errors"
+)
+
+var ErrUnknownStream = errors.New("unknown tcp stream")
+
+// StreamEndReason tells why a TCPStreamStore finished a stream.
+type StreamEndReason int
+
+const (
+	StreamClosed  StreamEndReason = iota // FIN from both ends, or RST
+	StreamIdle                           // No segment for the idle timeout, in capture time
+	StreamEvicted                        // Dropped to stay within the memory budget
+	StreamFlushed                        // Still open at Flush or Close
+)
+
+func (r StreamEndReason) String() string {
+	switch r {
+	case StreamClosed:
+		return "closed"
+	case StreamIdle:
+		return "idle"
+	case StreamEvicted:
+		return "evicted"
+	case StreamFlushed:
+		return "flushed"
+	}
+	return "unknown"
+}
+
+// TCP flags of Packet.Flags.
+const (
+	tcpFlagFin = 0x01
+	tcpFlagRst = 0x04
+)
+
+// StreamDoneFunc receives a finished stream with all of its packets, including
+// those read back from the spill log. It runs on the dissection goroutine,
+// outside the store lock.
+type StreamDoneFunc func(id uint32, packets []Packet, reason StreamEndReason)
+
+// StoreOption configures a TCPStreamStore.
+type StoreOption func(*TCPStreamStore)
+
+// WithStoreMemoryBudget bounds the bytes of packets a TCPStreamStore keeps in
+// memory. Over budget, the least recently active streams are spilled to disk if
+// a spill directory is set, and evicted otherwise. 0 means unbounded.
+func WithStoreMemoryBudget(bytes int64) StoreOption {
+	return func(s *TCPStreamStore) {
+		s.budget = max(bytes, 0)
+	}
+}
+
+// WithStoreIdleTimeout finishes streams that saw no segment for d, measured in
+// capture time. 0 keeps streams until they close.
+func WithStoreIdleTimeout(d time.Duration) StoreOption {
+	return func(s *TCPStreamStore) {
+		s.idle = max(d, 0).Seconds()
+	}
+}
+
+// WithStoreSpillDir sets the directory of the append log that streams over the
+// memory budget are spilled to. The log is truncated whenever no stream in the
+// store has packets in it anymore, and removed by Close.
+func WithStoreSpillDir(dir string) StoreOption {
+	return func(s *TCPStreamStore) {
+		s.spillDir = dir
+	}
+}
+
+// WithStreamDone sets the callback that receives finished streams. Handed over
+// streams are dropped from the store. Without a callback, closed and idle
+// streams stay in the store, and evicted ones are lost.
+func WithStreamDone(fn StreamDoneFunc) StoreOption {
+	return func(s *TCPStreamStore) {
+		s.onDone = fn
+	}
+}
+
+// TCPStreamStore collects the packets of the tcp_follow tap by stream, within
+// an optional memory budget.
+type TCPStreamStore struct {
+	sync.Mutex
+	budget   int64
+	idle     float64
+	spillDir string
+	onDone   StreamDoneFunc
+
+	streams   map[uint32]*storedStream
+	finished  map[uint32]*list.Element // handed over or evicted, to drop their trailing ACKs
+	finishedQ *list.List               // finishedStream entries of finished, oldest first
+	active    *list.List               // open streams, most recently active first
+	resident  *list.List               // streams with packets in memory, most recently active first
+	memBytes  int64
+	now       float64 // newest capture time seen
+	swept     float64 // capture time of the last idle sweep
+
+	spill        *os.File
+	spillW       *bufio.Writer
+	spillOff     int64
+	spillStreams int // streams with packets in the spill log
+}
+
+// A finished stream is remembered for the idle timeout, or finishedTTL without
+// one, which is ample for its trailing ACKs, and at most maxFinished of them.
+const (
+	finishedTTL = 60.0 // seconds of capture time
+	maxFinished = 1 << 16
+)
+
+// finishedStream is an entry of TCPStreamStore.finishedQ.
+type finishedStream struct {
+	id uint32
+	at float64 // capture time the stream finished
+}
+
+// storedStream is a stream of a TCPStreamStore. Its oldest packets may be in
+// the spill log, the newer ones in packets.
+type storedStream struct {
+	id        uint32
+	packets   []Packet
+	memBytes  int64
+	spilled   []spillRun
+	lastSeen  float64
+	finSrc    string // source of the first FIN
+	done      bool   // closed or idle, kept for lack of a callback
+	activeEl  *list.Element
+	residentE *list.Element
+}
+
+// spillRun is a run of count packets of one stream at off in the spill log.
+type spillRun struct {
+	off   int64
+	size  int64
+	count int
+}
+
+// doneStream is a finished stream waiting to be handed to the callback.
+type doneStream struct {
+	id      uint32
+	packets []Packet
+	reason  StreamEndReason
+}
+
+func NewTCPStreamStore(opts ...StoreOption) *TCPStreamStore {
+	s := &TCPStreamStore{
+		streams:   make(map[uint32]*storedStream),
+		finished:  make(map[uint32]*list.Element),
+		finishedQ: list.New(),
+		active:    list.New(),
+		resident:  list.New(),
+	}
+	for _, opt := range opts {
+		opt(s)
+	}
+	return s
+}
+
+func (s *TCPStreamStore) AddPacket(packet Packet) {
+	s.AddPackets([]Packet{packet})
+}
+
+// AddPackets adds a batch of packets under one lock, then finishes the streams
+// that closed, went idle or had to be evicted.
+func (s *TCPStreamStore) AddPackets(packets []Packet) {
+	var done []doneStream
+
+	s.Lock()
+	for i := range packets {
+		done = s.add(&packets[i], done)
+	}
+	done = s.sweepIdle(done)
+	done = s.enforceBudget(done)
+	s.pruneFinished()
+	s.Unlock()
+
+	s.handOver(done)
+}
+
+func (s *TCPStreamStore) add(p *Packet, done []doneStream) []doneStream {
+	s.now = max(s.now, p.Timestamp)
+
+	st := s.streams[p.StreamID]
+	if st == nil {
+		if _, ok := s.finished[p.StreamID]; ok && len(p.RawData) == 0 {
+			return done
+		}
+		st = &storedStream{id: p.StreamID}
+		st.activeEl = s.active.PushFront(st)
+		s.streams[p.StreamID] = st
+	} else if st.activeEl != nil {
+		s.active.MoveToFront(st.activeEl)
+	}
+
+	// Within a budget, packets must not pin the batch their bytes came in.
+	if s.budget > 0 {
+		p.RawData = bytes.Clone(p.RawData)
+	}
+	size := packetMemSize(p)
+	st.packets = append(st.packets, *p)
+	st.memBytes += size
+	s.memBytes += size
+	st.lastSeen = p.Timestamp
+	if st.residentE == nil {
+		st.residentE = s.resident.PushFront(st)
+	} else {
+		s.resident.MoveToFront(st.residentE)
+	}
+
+	if st.done {
+		return done
+	}
+	if p.Flags&tcpFlagRst != 0 {
+		return s.finish(st, StreamClosed, done)
+	}
+	if p.Flags&tcpFlagFin != 0 {
+		if st.finSrc != "" && st.finSrc != p.Src {
+			return s.finish(st, StreamClosed, done)
+		}
+		st.finSrc = p.Src
+	}
+	return done
+}
+
+// sweepIdle finishes the streams idle for longer than the idle timeout, at most
+// once per second of capture time.
+func (s *TCPStreamStore) sweepIdle(done []doneStream) []doneStream {
+	if s.idle <= 0 || s.now-s.swept < 1 {
+		return done
+	}
+	s.swept = s.now
+
+	for e := s.active.Back(); e != nil; {
+		st := e.Value.(*storedStream)
+		if s.now-st.lastSeen <= s.idle {
+			break
+		}
+		e = e.Prev()
+		done = s.finish(st, StreamIdle, done)
+	}
+	return done
+}
+
+// enforceBudget spills or evicts the least recently active resident streams
+// until the packets in memory fit the budget.
+func (s *TCPStreamStore) enforceBudget(done []doneStream) []doneStream {
+	for s.budget > 0 && s.memBytes > s.budget && s.resident.Len() > 0 {
+		st := s.resident.Back().Value.(*storedStream)
+		if s.spillDir == "" {
+			done = s.finish(st, StreamEvicted, done)
+			continue
+		}
+		if err := s.spillStream(st); err != nil {
+			slog.Warn("TCP stream spill failed, evicting", "stream", st.id, "err", err)
+			s.spillDir = ""
+		}
+	}
+	return done
+}
+
+// finish ends st: hands it to the callback, or keeps it as done without one.
+func (s *TCPStreamStore) finish(st *storedStream, reason StreamEndReason, done []doneStream) []doneStream {
+	if s.onDone == nil && reason != StreamEvicted {
+		st.done = true
+		if st.activeEl != nil {
+			s.active.Remove(st.activeEl)
+			st.activeEl = nil
+		}
+		return done
+	}
+
+	var packets []Packet
+	if s.onDone != nil {
+		var err error
+		if packets, err = s.readStream(st); err != nil {
+			slog.Warn("TCP stream read back failed", "stream", st.id, "err", err)
+		}
+	}
+	s.drop(st)
+	return append(done, doneStream{id: st.id, packets: packets, reason: reason})
+}
+
+// drop removes st from the store.
+func (s *TCPStreamStore) drop(st *storedStream) {
+	if st.activeEl != nil {
+		s.active.Remove(st.activeEl)
+	}
+	if st.residentE != nil {
+		s.resident.Remove(st.residentE)
+	}
+	s.memBytes -= st.memBytes
+	delete(s.streams, st.id)
+
+	if el := s.finished[st.id]; el != nil {
+		s.finishedQ.Remove(el)
+	}
+	s.finished[st.id] = s.finishedQ.PushBack(finishedStream{id: st.id, at: s.now})
+
+	if len(st.spilled) > 0 {
+		s.spillStreams--
+		if s.spillStreams == 0 {
+			s.truncateSpill()
+		}
+	}
+}
+
+// pruneFinished forgets the finished streams past finishedTTL or maxFinished.
+func (s *TCPStreamStore) pruneFinished() {
+	ttl := s.idle
+	if ttl <= 0 {
+		ttl = finishedTTL
+	}
+	for e := s.finishedQ.Front(); e != nil; e = s.finishedQ.Front() {
+		f := e.Value.(finishedStream)
+		if s.now-f.at <= ttl && s.finishedQ.Len() <= maxFinished {
+			break
+		}
+		s.finishedQ.Remove(e)
+		delete(s.finished, f.id)
+	}
+}
+
+func (s *TCPStreamStore) handOver(done []doneStream) {
+	if s.onDone == nil {
+		return
+	}
+	for _, d := range done {
+		s.onDone(d.id, d.packets, d.reason)
+	}
+}
+
+// packetMemSize estimates the bytes a stored packet holds.
+func packetMemSize(p *Packet) int64 {
+	return int64(unsafe.Sizeof(*p)) + int64(len(p.Src)+len(p.Dst)+len(p.Data)+len(p.RawData))
+}
+
+// --- Spill Log ---
+
+// Spilled packets are appended to one log per store, in native byte order:
+//
+//	uint32 packet id, float64 timestamp, uint16 flags, uint32 data length,
+//	uint8 length + source, uint8 length + destination, data
+
+// spillStream appends the packets in memory of st to the spill log.
+func (s *TCPStreamStore) spillStream(st *storedStream) error {
+	if s.spill == nil {
+		f, err := os.CreateTemp(s.spillDir, "tcpstreams-*.log")
+		if err != nil {
+			return errors.Wrap(err, "create spill log")
+		}
+		s.spill = f
+		s.spillW = bufio.NewWriterSize(f, 256*1024)
+	}
+
+	run := spillRun{off: s.spillOff, count: len(st.packets)}
+	var hdr [19]byte
+	for i := range st.packets {
+		p := &st.packets[i]
+		binary.NativeEndian.PutUint32(hdr[0:], p.PacketID)
+		binary.NativeEndian.PutUint64(hdr[4:], math.Float64bits(p.Timestamp))
+		binary.NativeEndian.PutUint16(hdr[12:], p.Flags)
+		binary.NativeEndian.PutUint32(hdr[14:], uint32(len(p.RawData)))
+		hdr[18] = byte(len(p.Src))
+		s.spillW.Write(hdr[:])
+		s.spillW.WriteString(p.Src)
+		s.spillW.WriteByte(byte(len(p.Dst)))
+		s.spillW.WriteString(p.Dst)
+		if _, err := s.spillW.Write(p.RawData); err != nil {
+			return errors.Wrap(err, "write spill log")
+		}
+		run.size += int64(len(hdr) + len(p.Src) + 1 + len(p.Dst) + len(p.RawData))
+	}
+	s.spillOff += run.size
+	if len(st.spilled) == 0 {
+		s.spillStreams++
+	}
+	st.spilled = append(st.spilled, run)
+
+	s.memBytes -= st.memBytes
+	st.packets, st.memBytes = nil, 0
+	s.resident.Remove(st.residentE)
+	st.residentE = nil
+	return nil
+}
+
+// truncateSpill empties the spill log once no stream has packets in it, so the
+// log only grows with the streams spilled at the same time. On failure the log
+// keeps growing.
+func (s *TCPStreamStore) truncateSpill() {
+	err := s.spillW.Flush()
+	if err == nil {
+		err = s.spill.Truncate(0)
+	}
+	if err == nil {
+		_, err = s.spill.Seek(0, io.SeekStart)
+	}
+	if err != nil {
+		slog.Warn("TCP stream spill log truncate failed", "err", err)
+		return
+	}
+	s.spillOff = 0
+}
+
+// readStream returns all packets of st, those in the spill log first.
+func (s *TCPStreamStore) readStream(st *storedStream) ([]Packet, error) {
+	if len(st.spilled) == 0 {
+		return st.packets, nil
+	}
+	if err := s.spillW.Flush(); err != nil {
+		return st.packets, errors.Wrap(err, "flush spill log")
+	}
+
+	total := len(st.packets)
+	for _, run := range st.spilled {
+		total += run.count
+	}
+	packets := make([]Packet, 0, total)
+	for _, run := range st.spilled {
+		buf := make([]byte, run.size)
+		if _, err := s.spill.ReadAt(buf, run.off); err != nil {
+			return append(packets, st.packets...), errors.Wrap(err, "read spill log")
+		}
+		r := binaryFrameReader{src: buf}
+		for range run.count {
+			p := Packet{StreamID: st.id}
+			p.PacketID = r.u32()
+			p.Timestamp = math.Float64frombits(r.u64())
+			p.Flags = r.u16()
+			n := int(r.u32())
+			p.Src = r.str(int(r.u8()))
+			p.Dst = r.str(int(r.u8()))
+			if n > 0 {
+				p.RawData = r.next(n)
+			}
+			if r.err != nil {
+				return append(packets, st.packets...), errors.Wrap(r.err, "read spill log")
+			}
+			packets = append(packets, p)
+		}
+	}
+	return append(packets, st.packets...), nil
+}
+
+// --- Access ---
+
+// StreamIDs returns the ids of the streams in the store, in ascending order.
+func (s *TCPStreamStore) StreamIDs() []uint32 {
+	s.Lock()
+	defer s.Unlock()
+	ids := make([]uint32, 0, len(s.streams))
+	for id := range s.streams {
+		ids = append(ids, id)
+	}
+	slices.Sort(ids)
+	return ids
+}
+
+// Packets returns the packets of stream id, reading spilled ones back.
+func (s *TCPStreamStore) Packets(id uint32) ([]Packet, error) {
+	s.Lock()
+	defer s.Unlock()
+	st := s.streams[id]
+	if st == nil {
+		return nil, ErrUnknownStream
+	}
+	packets, err := s.readStream(st)
+	return slices.Clip(packets), err
+}
+
+// MemoryUsage returns the estimated bytes of packets held in memory.
+func (s *TCPStreamStore) MemoryUsage() int64 {
+	s.Lock()
+	defer s.Unlock()
+	return s.memBytes
+}
+
+// Flush hands every stream still open to the callback as StreamFlushed. Without
+// a callback it does nothing.
+func (s *TCPStreamStore) Flush() {
+	if s.onDone == nil {
+		return
+	}
+	var done []doneStream
+	s.Lock()
+	for s.active.Len() > 0 {
+		done = s.finish(s.active.Front().Value.(*storedStream), StreamFlushed, done)
+	}
+	s.Unlock()
+	s.handOver(done)
+}
+
+// Close flushes the store and removes its spill log. Spilled packets of streams
+// kept in the store are gone afterwards.
+func (s *TCPStreamStore) Close() error {
+	s.Flush()
+
+	s.Lock()
+	defer s.Unlock()
+	if s.spill == nil {
+		return nil
+	}
+	name := s.spill.Name()
+	err := s.spill.Close()
+	if rmErr := os.Remove(name); err == nil {
+		err = rmErr
+	}
+	s.spill, s.spillW = nil, nil
+	return errors.Wrap(err, "remove spill log")
+}
@@ -0,0 +1,189 @@
+package pkg
+
+import (
+	"bytes"
+	"fmt"
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+func TestPayloadFile_RoundTrip(t *testing.T) {
+	recs := []PayloadRecord{
+		{Dir: PayloadDirClient, Frame: 4, Data: []byte("GET / HTTP/1.1\r\n")},
+		{Dir: PayloadDirServer, Frame: 6, Data: []byte{0, 1, 2, 0xff}},
+		{Dir: PayloadDirClient, Frame: 9, Data: nil},
+	}
+
+	var buf bytes.Buffer
+	w := NewPayloadFileWriter(&buf)
+	for i := range recs {
+		if err := w.WritePayload(&recs[i]); err != nil {
+			t.Fatal(err)
+		}
+	}
+	if err := w.Flush(); err != nil {
+		t.Fatal(err)
+	}
+
+	i := 0
+	err := ReadPayloadFile(&buf, func(rec *PayloadRecord) error {
+		want := recs[i]
+		if rec.Dir != want.Dir || rec.Frame != want.Frame || !bytes.Equal(rec.Data, want.Data) {
+			t.Errorf("record %d: got %+v, want %+v", i, *rec, want)
+		}
+		i++
+		return nil
+	})
+	if err != nil {
+		t.Fatal(err)
+	}
+	if i != len(recs) {
+		t.Fatalf("read %d records, want %d", i, len(recs))
+	}
+
+	if err := ReadPayloadFile(bytes.NewReader([]byte("pcap")), func(*PayloadRecord) error { return nil }); err == nil {
+		t.Fatal("expected an error for a foreign file")
+	}
+}
+
+// TestCollectStreamPayloads checks that GetStreamData merges consecutive
+// payloads of one direction, counts bytes per side and takes the packet count
+// from the summary record.
+func TestCollectStreamPayloads(t *testing.T) {
+	rec := func(src string, srcPort int, dst string, dstPort int, payload string) []byte {
+		return []byte(fmt.Sprintf(`{"src":%q,"srcport":%d,"dst":%q,"dstport":%d,"payload":%q}`,
+			src, srcPort, dst, dstPort, payload))
+	}
+	src := func(emit func([][]byte) bool) error {
+		emit([][]byte{
+			rec("10.0.0.1", 5000, "10.0.0.2", 80, "0102"),
+			rec("10.0.0.1", 5000, "10.0.0.2", 80, "03"),
+		})
+		emit([][]byte{
+			rec("10.0.0.2", 80, "10.0.0.1", 5000, "aabbcc"),
+			rec("10.0.0.2", 80, "10.0.0.1", 5000, ""),
+			rec("10.0.0.1", 5000, "10.0.0.2", 80, "04"),
+			[]byte(`{"_summary":true,"matched_count":6}`),
+		})
+		return nil
+	}
+
+	res, err := collectStreamPayloads(src)
+	if err != nil {
+		t.Fatal(err)
+	}
+	want := []StreamPayload{
+		{Dir: PayloadDirClient, HexData: "010203"},
+		{Dir: PayloadDirServer, HexData: "aabbcc"},
+		{Dir: PayloadDirClient, HexData: "04"},
+	}
+	if fmt.Sprint(res.Payloads) != fmt.Sprint(want) {
+		t.Errorf("payloads: got %v, want %v", res.Payloads, want)
+	}
+	if res.ClientNode != "10.0.0.1:5000" || res.ServerNode != "10.0.0.2:80" {
+		t.Errorf("nodes: got %s -> %s", res.ClientNode, res.ServerNode)
+	}
+	if res.ClientBytes != 4 || res.ServerBytes != 3 || res.PacketCount != 6 {
+		t.Errorf("counts: got client %d, server %d, packets %d", res.ClientBytes, res.ServerBytes, res.PacketCount)
+	}
+
+	empty, err := collectStreamPayloads(func(func([][]byte) bool) error { return nil })
+	if err != nil {
+		t.Fatal(err)
+	}
+	if len(empty.Payloads) != 1 || empty.Payloads[0].Dir != PayloadDirClient || empty.Payloads[0].HexData != "" {
+		t.Errorf("empty stream: got %v", empty.Payloads)
+	}
+}
+
+// TestWriteStreamData_MatchesGetStreamData checks that the raw payloads carry the
+// same bytes per direction as the hex payloads of GetStreamData.
+func TestWriteStreamData_MatchesGetStreamData(t *testing.T) {
+	if _, err := os.Stat(inputFilepath); os.IsNotExist(err) {
+		t.Skip("skipping test; pcap file not found")
+	}
+	const filter = "tcp.stream eq 0"
+
+	want, err := GetStreamData(inputFilepath, filter, "tcp")
+	if err != nil {
+		t.Fatalf("GetStreamData failed: %v", err)
+	}
+
+	var client, server bytes.Buffer
+	sum, err := WriteStreamData(inputFilepath, filter, "tcp", DirWriters(&client, &server))
+	if err != nil {
+		t.Fatalf("WriteStreamData failed: %v", err)
+	}
+
+	if sum.ClientBytes != want.ClientBytes || sum.ServerBytes != want.ServerBytes {
+		t.Errorf("bytes: got %d/%d, want %d/%d",
+			sum.ClientBytes, sum.ServerBytes, want.ClientBytes, want.ServerBytes)
+	}
+	if client.Len() != sum.ClientBytes || server.Len() != sum.ServerBytes {
+		t.Errorf("writers got %d/%d bytes, summary says %d/%d",
+			client.Len(), server.Len(), sum.ClientBytes, sum.ServerBytes)
+	}
+	if sum.ClientNode != want.ClientNode || sum.ServerNode != want.ServerNode {
+		t.Errorf("nodes: got %s/%s, want %s/%s", sum.ClientNode, sum.ServerNode, want.ClientNode, want.ServerNode)
+	}
+}
+
+// TestExtractAllStreams checks that the one-pass extraction writes the same
+// payload bytes per stream as GetStreamData, also when the file LRU has to
+// close and reopen stream files.
+func TestExtractAllStreams(t *testing.T) {
+	if _, err := os.Stat(inputFilepath); os.IsNotExist(err) {
+		t.Skip("skipping test; pcap file not found")
+	}
+	outDir := t.TempDir()
+
+	entries, err := ExtractAllStreams(inputFilepath, outDir, "tcp", WithMaxOpenStreams(1))
+	if err != nil {
+		t.Fatalf("ExtractAllStreams failed: %v", err)
+	}
+	if len(entries) == 0 {
+		t.Fatal("no streams extracted")
+	}
+	if _, err := os.Stat(filepath.Join(outDir, StreamIndexFile)); err != nil {
+		t.Fatalf("index not written: %v", err)
+	}
+
+	for _, e := range entries[:min(len(entries), 5)] {
+		want, err := GetStreamData(inputFilepath, fmt.Sprintf("tcp.stream eq %d", e.Stream), "tcp")
+		if err != nil {
+			t.Fatalf("GetStreamData failed: %v", err)
+		}
+		if got := e.ClientBytes + e.ServerBytes; got != int64(want.ClientBytes+want.ServerBytes) {
+			t.Errorf("stream %d: %d bytes, want %d", e.Stream, got, want.ClientBytes+want.ServerBytes)
+		}
+		if e.Packets != want.PacketCount {
+			t.Errorf("stream %d: %d packets, want %d", e.Stream, e.Packets, want.PacketCount)
+		}
+		if e.Path == "" {
+			continue
+		}
+
+		f, err := os.Open(e.Path)
+		if err != nil {
+			t.Fatal(err)
+		}
+		var client, server int64
+		err = ReadPayloadFile(f, func(rec *PayloadRecord) error {
+			if rec.Dir == PayloadDirClient {
+				client += int64(len(rec.Data))
+			} else {
+				server += int64(len(rec.Data))
+			}
+			return nil
+		})
+		f.Close()
+		if err != nil {
+			t.Fatalf("stream %d: %v", e.Stream, err)
+		}
+		if client != e.ClientBytes || server != e.ServerBytes {
+			t.Errorf("stream %d: file holds %d/%d bytes, index says %d/%d",
+				e.Stream, client, server, e.ClientBytes, e.ServerBytes)
+		}
+	}
+}
@@ -0,0 +1,912 @@
+package pkg
+
+import (
+	"bufio"
+	"encoding/binary"
+	"io"
+	"iter"
+	"log/slog"
+	"os"
+	"os/exec"
+	"strconv"
+	"strings"
+	"sync"
+	"syscall"
+	"time"
+
+	"github.com/bytedance/sonic"
+	"github.com/pkg/errors"
+)
+
+// libwireshark keeps one dissection session per process, so EpanMutex
+// serialises every dissection of a process. A WorkerPool gets real multi-core
+// throughput by running dissections in worker processes: re-executions of the
+// current binary that initialise the environment once (package init) and then
+// serve jobs over a Unix socket pair until they are stopped.
+
+// workerEnv marks a process started by a WorkerPool.
+const workerEnv = "GOWIRESHARK_WORKER"
+
+// workerFd is the socket of a worker process: the first entry of ExtraFiles.
+const workerFd = 3
+
+// Record types of the worker protocol. Each record is a type byte, a
+// little-endian uint32 length and the body.
+const (
+	recJob   byte = 'J' // parent -> worker: workerJob
+	recBatch byte = 'B' // worker -> parent: a batch of frames (or payloads), as reported by C
+	recEnd   byte = 'E' // worker -> parent: workerEnd, closes a job
+
+	recPackets  byte = 'P' // parent -> worker: packet records of a live job
+	recInputEnd byte = 'D' // parent -> worker: no more packets for the live job
+)
+
+const (
+	jobAllFrames      = "all"
+	jobFramesByRange  = "range"
+	jobStreamPayloads = "stream"
+	jobRawPayloads    = "rawstream"
+	jobShard          = "shard"
+	jobLive           = "live"
+)
+
+var (
+	ErrPoolClosed    = errors.New("worker pool is closed")
+	ErrPoolBusy      = errors.New("not enough idle workers in the pool")
+	ErrWorkerCrashed = errors.New("dissection worker exited")
+	errFeedStopped   = errors.New("worker stopped reading its input")
+)
+
+type workerJob struct {
+	Op     string
+	Path   string
+	Start  int
+	Limit  int // Frame count for range jobs, last frame for shard jobs
+	Filter string
+	Proto  string
+	Conf   *Conf
+}
+
+type workerEnd struct {
+	Err string
+}
+
+// isWorkerProcess reports whether this process was started by a WorkerPool.
+func isWorkerProcess() bool {
+	return os.Getenv(workerEnv) == "1"
+}
+
+func writeRecord(w *bufio.Writer, typ byte, body []byte) error {
+	var hdr [5]byte
+	hdr[0] = typ
+	binary.LittleEndian.PutUint32(hdr[1:], uint32(len(body)))
+	if _, err := w.Write(hdr[:]); err != nil {
+		return err
+	}
+	_, err := w.Write(body)
+	return err
+}
+
+// writeBatchRecord writes a batch of frames as one record: a uint32 count,
+// count+1 uint32 offsets into the frame data and the frames back to back.
+func writeBatchRecord(w *bufio.Writer, batch [][]byte) error {
+	size := 4 + 4*(len(batch)+1)
+	for _, frame := range batch {
+		size += len(frame)
+	}
+
+	var hdr [5]byte
+	hdr[0] = recBatch
+	binary.LittleEndian.PutUint32(hdr[1:], uint32(size))
+	if _, err := w.Write(hdr[:]); err != nil {
+		return err
+	}
+
+	var u32 [4]byte
+	binary.LittleEndian.PutUint32(u32[:], uint32(len(batch)))
+	if _, err := w.Write(u32[:]); err != nil {
+		return err
+	}
+	offset := 0
+	for i := 0; i <= len(batch); i++ {
+		binary.LittleEndian.PutUint32(u32[:], uint32(offset))
+		if _, err := w.Write(u32[:]); err != nil {
+			return err
+		}
+		if i < len(batch) {
+			offset += len(batch[i])
+		}
+	}
+	for _, frame := range batch {
+		if _, err := w.Write(frame); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// parseBatchRecord splits the body of a batch record into its frames, which
+// share body.
+func parseBatchRecord(body []byte) ([][]byte, error) {
+	if len(body) < 4 {
+		return nil, errors.New("short batch record")
+	}
+	count := int(binary.LittleEndian.Uint32(body))
+	data := 4 + 4*(count+1)
+	if count < 0 || data > len(body) {
+		return nil, errors.New("short batch record")
+	}
+
+	offsets := body[4:data]
+	frames := body[data:]
+	batch := make([][]byte, count)
+	for i := range batch {
+		start := binary.LittleEndian.Uint32(offsets[4*i:])
+		end := binary.LittleEndian.Uint32(offsets[4*i+4:])
+		if start > end || int(end) > len(frames) {
+			return nil, errors.New("bad batch record offsets")
+		}
+		batch[i] = frames[start:end:end]
+	}
+	return batch, nil
+}
+
+func readRecord(r *bufio.Reader) (byte, []byte, error) {
+	var hdr [5]byte
+	if _, err := io.ReadFull(r, hdr[:]); err != nil {
+		return 0, nil, err
+	}
+	body := make([]byte, binary.LittleEndian.Uint32(hdr[1:]))
+	if _, err := io.ReadFull(r, body); err != nil {
+		return 0, nil, err
+	}
+	return hdr[0], body, nil
+}
+
+// source returns the in-process frame source that runs job. Live jobs read
+// their packets from in.
+func (job *workerJob) source(in *bufio.Reader) (frameSource, error) {
+	switch job.Op {
+	case jobAllFrames:
+		return cFrameSource(runAllFrames(job.Path, job.Conf)), nil
+	case jobFramesByRange:
+		return cFrameSource(runFramesByRange(job.Path, job.Conf, job.Start, job.Limit)), nil
+	case jobStreamPayloads:
+		return cFrameSource(runStreamPayloads(job.Path, job.Conf, job.Filter, job.Proto, false)), nil
+	case jobRawPayloads:
+		return cFrameSource(runStreamPayloads(job.Path, job.Conf, job.Filter, job.Proto, true)), nil
+	case jobShard:
+		return cFrameSource(runShard(job.Path, job.Conf, job.Start, job.Limit)), nil
+	case jobLive:
+		return liveFeedSource(job.Conf, in), nil
+	}
+	return nil, errors.Errorf("unknown worker job %q", job.Op)
+}
+
+// serveWorker runs the job loop of a worker process and returns its exit code.
+// It returns once the parent closes the socket.
+func serveWorker() int {
+	conn := os.NewFile(workerFd, "gowireshark-worker")
+	r := bufio.NewReader(conn)
+	w := bufio.NewWriterSize(conn, 64*1024)
+
+	for {
+		typ, body, err := readRecord(r)
+		if err == io.EOF {
+			return 0
+		}
+		if err != nil || typ != recJob {
+			slog.Error("worker: bad job record", "err", err)
+			return 1
+		}
+
+		var job workerJob
+		var jobErr error
+		var writeErr error
+		if jobErr = sonic.Unmarshal(body, &job); jobErr == nil {
+			var src frameSource
+			if src, jobErr = job.source(r); jobErr == nil {
+				jobErr = src(func(batch [][]byte) bool {
+					writeErr = writeBatchRecord(w, batch)
+					if writeErr == nil && job.Op == jobLive {
+						writeErr = w.Flush()
+					}
+					return writeErr == nil
+				})
+			}
+		}
+		if writeErr != nil {
+			slog.Error("worker: write frame", "err", writeErr)
+			return 1
+		}
+
+		var end workerEnd
+		if jobErr != nil {
+			end.Err = jobErr.Error()
+		}
+		endBody, _ := sonic.Marshal(&end)
+		if err := writeRecord(w, recEnd, endBody); err != nil {
+			return 1
+		}
+		if err := w.Flush(); err != nil {
+			return 1
+		}
+	}
+}
+
+// PoolConf configures a WorkerPool.
+type PoolConf struct {
+	Workers    int    // Number of worker processes (default: runtime.NumCPU())
+	MaxRSS     int64  // Resident memory in bytes above which a worker is restarted after its job (default: 1 GiB, 0 disables)
+	MaxJobs    int    // Jobs after which a worker is restarted (default: 0, unlimited)
+	Executable string // Binary started as worker (default: os.Executable())
+}
+
+type PoolOption func(*PoolConf)
+
+// WithWorkers sets the number of worker processes.
+func WithWorkers(n int) PoolOption {
+	return func(c *PoolConf) {
+		c.Workers = n
+	}
+}
+
+// WithMaxWorkerRSS sets the resident memory above which a worker is recycled.
+func WithMaxWorkerRSS(bytes int64) PoolOption {
+	return func(c *PoolConf) {
+		c.MaxRSS = bytes
+	}
+}
+
+// WithMaxWorkerJobs sets the number of jobs after which a worker is recycled.
+func WithMaxWorkerJobs(n int) PoolOption {
+	return func(c *PoolConf) {
+		c.MaxJobs = n
+	}
+}
+
+// WithWorkerExecutable sets the binary started as worker. It must import this
+// package, which turns it into a worker at init.
+func WithWorkerExecutable(path string) PoolOption {
+	return func(c *PoolConf) {
+		c.Executable = path
+	}
+}
+
+// WorkerStats reports the state and load of one worker slot.
+type WorkerStats struct {
+	ID          int           `json:"id"`
+	PID         int           `json:"pid"`
+	Busy        bool          `json:"busy"`
+	Jobs        int           `json:"jobs"`
+	Failures    int           `json:"failures"`
+	Restarts    int           `json:"restarts"`
+	RSS         int64         `json:"rss"`
+	Uptime      time.Duration `json:"uptime"`      // Since the current process started
+	BusyTime    time.Duration `json:"busyTime"`    // Since the pool started
+	Utilisation float64       `json:"utilisation"` // BusyTime over the lifetime of the pool
+}
+
+// workerProc is one running worker process.
+type workerProc struct {
+	cmd     *exec.Cmd
+	conn    *os.File
+	r       *bufio.Reader
+	w       *bufio.Writer
+	started time.Time
+	jobs    int
+}
+
+// poolWorker is a worker slot; its process is replaced on crash or recycling.
+type poolWorker struct {
+	id   int
+	proc *workerProc // owned by whoever took the slot from the idle channel
+
+	mu        sync.Mutex // guards the stats below, read by Stats
+	pid       int
+	procStart time.Time
+	busySince time.Time
+	busyTime  time.Duration
+	jobs      int
+	failures  int
+	restarts  int
+}
+
+// WorkerPool load-balances dissection jobs over worker processes.
+type WorkerPool struct {
+	conf    PoolConf
+	workers []*poolWorker
+	idle    chan *poolWorker
+	done    chan struct{}
+	started time.Time
+
+	mu     sync.Mutex // orders returning workers against Close
+	closed bool
+}
+
+// NewWorkerPool starts the worker processes of a pool.
+func NewWorkerPool(opts ...PoolOption) (*WorkerPool, error) {
+	conf := PoolConf{
+		Workers: getOptimalWorkerNum(0),
+		MaxRSS:  1 << 30,
+	}
+	for _, opt := range opts {
+		opt(&conf)
+	}
+	if conf.Workers < 1 {
+		conf.Workers = 1
+	}
+	if conf.Executable == "" {
+		exe, err := os.Executable()
+		if err != nil {
+			return nil, errors.Wrap(err, "locate worker executable")
+		}
+		conf.Executable = exe
+	}
+
+	p := &WorkerPool{
+		conf:    conf,
+		idle:    make(chan *poolWorker, conf.Workers),
+		done:    make(chan struct{}),
+		started: time.Now(),
+	}
+	for i := 0; i < conf.Workers; i++ {
+		w := &poolWorker{id: i}
+		if err := p.spawn(w); err != nil {
+			p.Close()
+			return nil, err
+		}
+		p.workers = append(p.workers, w)
+		p.idle <- w
+	}
+
+	return p, nil
+}
+
+// spawn starts the process of a worker slot.
+func (p *WorkerPool) spawn(w *poolWorker) error {
+	fds, err := syscall.Socketpair(syscall.AF_UNIX, syscall.SOCK_STREAM|syscall.SOCK_CLOEXEC, 0)
+	if err != nil {
+		return errors.Wrap(err, "worker socketpair")
+	}
+	conn := os.NewFile(uintptr(fds[0]), "gowireshark-pool")
+	child := os.NewFile(uintptr(fds[1]), "gowireshark-worker")
+	defer child.Close()
+
+	cmd := exec.Command(p.conf.Executable)
+	cmd.Env = append(os.Environ(), workerEnv+"=1")
+	cmd.ExtraFiles = []*os.File{child}
+	cmd.Stdout = os.Stdout
+	cmd.Stderr = os.Stderr
+	if err := cmd.Start(); err != nil {
+		conn.Close()
+		return errors.Wrap(err, "start worker")
+	}
+
+	w.proc = &workerProc{
+		cmd:     cmd,
+		conn:    conn,
+		r:       bufio.NewReaderSize(conn, 64*1024),
+		w:       bufio.NewWriter(conn),
+		started: time.Now(),
+	}
+	w.mu.Lock()
+	w.pid = cmd.Process.Pid
+	w.procStart = w.proc.started
+	w.mu.Unlock()
+
+	return nil
+}
+
+// stop ends the process of a worker slot. Closing the socket makes an idle
+// worker exit by itself; a busy or hung one is killed.
+func (proc *workerProc) stop(kill bool) {
+	proc.conn.Close()
+	if kill {
+		_ = proc.cmd.Process.Kill()
+	}
+	_ = proc.cmd.Wait()
+}
+
+// restart replaces the process of a worker slot.
+func (p *WorkerPool) restart(w *poolWorker, kill bool) error {
+	if w.proc != nil {
+		w.proc.stop(kill)
+		w.proc = nil
+	}
+	w.mu.Lock()
+	w.restarts++
+	w.pid = 0
+	w.mu.Unlock()
+	return p.spawn(w)
+}
+
+// overLimits reports whether a worker should be recycled after its last job.
+func (p *WorkerPool) overLimits(proc *workerProc) bool {
+	if p.conf.MaxJobs > 0 && proc.jobs >= p.conf.MaxJobs {
+		return true
+	}
+	return p.conf.MaxRSS > 0 && processRSS(proc.cmd.Process.Pid) > p.conf.MaxRSS
+}
+
+// processRSS returns the resident memory of a process in bytes, 0 if unknown.
+func processRSS(pid int) int64 {
+	data, err := os.ReadFile("/proc/" + strconv.Itoa(pid) + "/statm")
+	if err != nil {
+		return 0
+	}
+	fields := strings.Fields(string(data))
+	if len(fields) < 2 {
+		return 0
+	}
+	pages, err := strconv.ParseInt(fields[1], 10, 64)
+	if err != nil {
+		return 0
+	}
+	return pages * int64(os.Getpagesize())
+}
+
+// acquire takes an idle worker, waiting for one if all are busy.
+func (p *WorkerPool) acquire() (*poolWorker, error) {
+	select {
+	case w := <-p.idle:
+		return w, nil
+	case <-p.done:
+		return nil, ErrPoolClosed
+	}
+}
+
+// acquireN takes n workers for a long job, waiting at most d for them to become
+// idle. It takes none unless all n are idle in time, so two long jobs cannot
+// each hold part of the pool while waiting for the rest.
+func (p *WorkerPool) acquireN(n int, d time.Duration) ([]*poolWorker, error) {
+	timer := time.NewTimer(d)
+	defer timer.Stop()
+
+	ws := make([]*poolWorker, 0, n)
+	for len(ws) < n {
+		var err error
+		select {
+		case w := <-p.idle:
+			ws = append(ws, w)
+			continue
+		case <-p.done:
+			err = ErrPoolClosed
+		case <-timer.C:
+			err = ErrPoolBusy
+		}
+		for _, w := range ws {
+			p.release(w)
+		}
+		return nil, err
+	}
+	return ws, nil
+}
+
+// release returns a worker to the pool, or stops it if the pool was closed
+// while it was busy.
+func (p *WorkerPool) release(w *poolWorker) {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+
+	if !p.closed {
+		p.idle <- w
+		return
+	}
+	if w.proc != nil {
+		w.proc.stop(true)
+		w.proc = nil
+	}
+}
+
+// run sends a job to a worker and streams its frames to emit. Once emit asks
+// to stop, the rest of the job's frames are read and dropped, so the worker
+// stays in step with the socket. feed, if set, writes the input of the job
+// concurrently; stop is closed once the worker no longer reads it, as it ended
+// the job or died, and feed must then return. jobErr is the error of the
+// dissection itself; ioErr means the worker is unusable.
+func (proc *workerProc) run(body []byte, feed jobFeed, emit func([][]byte) bool) (jobErr, ioErr error) {
+	if err := writeRecord(proc.w, recJob, body); err != nil {
+		return nil, err
+	}
+	if err := proc.w.Flush(); err != nil {
+		return nil, err
+	}
+	if feed == nil {
+		return proc.read(emit)
+	}
+
+	fed := make(chan error, 1)
+	stop := make(chan struct{})
+	go func() { fed <- feed(proc.w, stop) }()
+	jobErr, ioErr = proc.read(emit)
+	close(stop)
+	if ioErr != nil {
+		// Unblock a feed still writing to the dead worker.
+		proc.conn.Close()
+	}
+	if err := <-fed; err != nil && ioErr == nil {
+		ioErr = err
+	}
+	return jobErr, ioErr
+}
+
+// read streams the frames of the running job to emit until its end record.
+func (proc *workerProc) read(emit func([][]byte) bool) (jobErr, ioErr error) {
+	emitting := true
+	for {
+		typ, rec, err := readRecord(proc.r)
+		if err != nil {
+			return nil, err
+		}
+		switch typ {
+		case recBatch:
+			if !emitting {
+				continue
+			}
+			batch, err := parseBatchRecord(rec)
+			if err != nil {
+				return nil, err
+			}
+			emitting = emit(batch)
+		case recEnd:
+			var end workerEnd
+			if err := sonic.Unmarshal(rec, &end); err != nil {
+				return nil, err
+			}
+			if end.Err != "" {
+				return errors.New(end.Err), nil
+			}
+			return nil, nil
+		default:
+			return nil, errors.Errorf("unexpected worker record %q", typ)
+		}
+	}
+}
+
+// jobFeed writes the input of a job to its worker until the input ends or stop
+// is closed.
+type jobFeed func(w *bufio.Writer, stop <-chan struct{}) error
+
+// do runs a job on the next idle worker, with feed writing its input if set.
+func (p *WorkerPool) do(job *workerJob, feed jobFeed, emit func([][]byte) bool) error {
+	if job.Op != jobLive && !IsFileExist(job.Path) {
+		return errors.Wrap(ErrFileNotFound, job.Path)
+	}
+	body, err := sonic.Marshal(job)
+	if err != nil {
+		return err
+	}
+
+	w, err := p.acquire()
+	if err != nil {
+		return err
+	}
+	defer p.release(w)
+
+	return p.runOn(w, body, feed, emit)
+}
+
+// runOn runs the marshalled job body on the acquired worker w, restarting w if
+// it fails or outgrows the pool limits.
+func (p *WorkerPool) runOn(w *poolWorker, body []byte, feed jobFeed, emit func([][]byte) bool) error {
+	if w.proc == nil {
+		// A previous restart failed; try again before giving up on the job.
+		if err := p.spawn(w); err != nil {
+			return err
+		}
+	}
+
+	start := time.Now()
+	w.mu.Lock()
+	w.busySince = start
+	w.mu.Unlock()
+
+	jobErr, ioErr := w.proc.run(body, feed, emit)
+	w.proc.jobs++
+
+	w.mu.Lock()
+	w.busySince = time.Time{}
+	w.busyTime += time.Since(start)
+	w.jobs++
+	if ioErr != nil {
+		w.failures++
+	}
+	w.mu.Unlock()
+
+	if ioErr != nil {
+		slog.Warn("Dissection worker failed, restarting", "worker", w.id, "err", ioErr)
+		if err := p.restart(w, true); err != nil {
+			slog.Error("Restart dissection worker", "worker", w.id, "err", err)
+		}
+		return errors.Wrap(ErrWorkerCrashed, ioErr.Error())
+	}
+
+	if p.overLimits(w.proc) {
+		if err := p.restart(w, false); err != nil {
+			slog.Error("Recycle dissection worker", "worker", w.id, "err", err)
+		}
+	}
+
+	return jobErr
+}
+
+// source returns a frame source that runs job on the pool.
+func (p *WorkerPool) source(job *workerJob) frameSource {
+	return func(emit func([][]byte) bool) error {
+		return p.do(job, nil, emit)
+	}
+}
+
+// GetAllFrames is GetAllFrames, run on a worker.
+func (p *WorkerPool) GetAllFrames(path string, opts ...Option) ([]*FrameData, error) {
+	conf := NewConfig(opts...)
+
+	if err := validateFrameConf(conf); err != nil {
+		return []*FrameData{}, err
+	}
+
+	return collectFrames(conf, 1000, p.source(&workerJob{Op: jobAllFrames, Path: path, Conf: conf}))
+}
+
+// IterFrames is IterFrames, run on a worker. Breaking out of the loop drops the
+// rest of the worker's frames rather than interrupting it.
+func (p *WorkerPool) IterFrames(path string, opts ...Option) iter.Seq2[*FrameData, error] {
+	return func(yield func(*FrameData, error) bool) {
+		conf := NewConfig(opts...)
+
+		if err := validateFrameConf(conf); err != nil {
+			yield(nil, err)
+			return
+		}
+
+		iterFrames(conf, p.source(&workerJob{Op: jobAllFrames, Path: path, Conf: conf}), yield)
+	}
+}
+
+// GetFramesByPage is GetFramesByPage, run on a worker.
+func (p *WorkerPool) GetFramesByPage(path string, page, size int, opts ...Option) (frames []*FrameData, hasMore bool, err error) {
+	_, size, startFrameIdx, fetchSize := pageBounds(page, size)
+
+	conf := NewConfig(opts...)
+
+	if err := validateFrameConf(conf); err != nil {
+		return []*FrameData{}, false, err
+	}
+
+	frames, err = collectFrames(conf, fetchSize, p.source(&workerJob{
+		Op:    jobFramesByRange,
+		Path:  path,
+		Start: startFrameIdx,
+		Limit: fetchSize,
+		Conf:  conf,
+	}))
+	if err != nil {
+		return frames, false, err
+	}
+
+	frames, hasMore = trimPage(frames, size)
+	return frames, hasMore, nil
+}
+
+// GetStreamData is GetStreamData, run on a worker.
+func (p *WorkerPool) GetStreamData(path string, filter string, proto string, opts ...Option) (*StreamResult, error) {
+	conf := NewConfig(opts...)
+
+	if filter != "" {
+		if err := ValidateFilter(filter); err != nil {
+			return nil, err
+		}
+	}
+
+	return collectStreamPayloads(p.source(&workerJob{
+		Op:     jobStreamPayloads,
+		Path:   path,
+		Filter: filter,
+		Proto:  proto,
+		Conf:   conf,
+	}))
+}
+
+// WriteStreamData is WriteStreamData, run on a worker. The raw payloads come
+// back over the worker socket; sink runs in this process.
+func (p *WorkerPool) WriteStreamData(path string, filter string, proto string, sink StreamSink, opts ...Option) (*StreamSummary, error) {
+	conf := NewConfig(opts...)
+
+	if filter != "" {
+		if err := ValidateFilter(filter); err != nil {
+			return nil, err
+		}
+	}
+
+	return writeStreamPayloads(p.source(&workerJob{
+		Op:     jobRawPayloads,
+		Path:   path,
+		Filter: filter,
+		Proto:  proto,
+		Conf:   conf,
+	}), sink)
+}
+
+// liveAcquireTimeout is how long WorkerPool.StartLivePacketCapture waits for
+// its workers to become idle.
+var liveAcquireTimeout = 5 * time.Second
+
+// StartLivePacketCapture is StartLivePacketCapture with the dissection spread
+// over workers of the pool. The calling thread only captures and hashes each
+// packet by its conversation, symmetrically, so both directions of a flow reach
+// the same worker and its reassembly stays intact; each worker dissects its
+// share with its own epan session. The frames of all workers merge into the
+// interface channel, in order within a conversation but not across them.
+//
+// The capture takes WithLiveWorkers workers (default: all but one) for as long
+// as it runs, and fails with ErrPoolBusy if they are not idle within 5s. If a
+// worker fails, its ring is closed at once, so the capture never blocks on it,
+// and the capture is stopped and returns the error. WithRingSize is split
+// between the per-worker rings; StopLivePacketCapture and GetLiveCaptureStats
+// work as for an in-process capture.
+func (p *WorkerPool) StartLivePacketCapture(interfaceName, bpfFilter string, packetCount, promisc, timeout int, opts ...Option) error {
+	if interfaceName == "" {
+		return errors.New("device name is blank")
+	}
+	conf := NewConfig(opts...)
+	job, err := sonic.Marshal(&workerJob{Op: jobLive, Conf: conf})
+	if err != nil {
+		return err
+	}
+
+	n := conf.LiveWorkers
+	if n <= 0 {
+		n = len(p.workers) - 1
+	}
+	n = min(max(n, 1), len(p.workers))
+	workers, err := p.acquireN(n, liveAcquireTimeout)
+	if err != nil {
+		return err
+	}
+	var wg sync.WaitGroup
+	defer func() {
+		// Workers that never ran a job go straight back.
+		wg.Wait()
+		for _, w := range workers {
+			if w != nil {
+				p.release(w)
+			}
+		}
+	}()
+
+	rings, err := newFanoutRings(n, conf)
+	if err != nil {
+		return err
+	}
+	defer rings.free()
+
+	if err := openLiveChannel(interfaceName, conf); err != nil {
+		return err
+	}
+
+	emit := func(batch [][]byte) bool {
+		for _, frame := range batch {
+			deliverLiveFrame(interfaceName, frame)
+		}
+		return true
+	}
+
+	// abort gives up on worker i: nothing drains its ring anymore, so it must
+	// not hold up or silently swallow the capture. The capture is stopped as
+	// soon as it has started.
+	captureDone := make(chan struct{})
+	var abortOnce sync.Once
+	abort := func(i int) {
+		rings.closeOne(i)
+		abortOnce.Do(func() { go stopLiveCaptureWhenStarted(interfaceName, captureDone) })
+	}
+
+	workerErrs := make([]error, n)
+	for i, w := range workers {
+		workers[i] = nil
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			defer p.release(w)
+			feed := func(bw *bufio.Writer, stop <-chan struct{}) error {
+				err := rings.feed(i, bw, stop)
+				if err != nil {
+					abort(i)
+				}
+				return err
+			}
+			if workerErrs[i] = p.runOn(w, job, feed, emit); workerErrs[i] != nil {
+				abort(i)
+			}
+		}()
+	}
+
+	err = captureLive(interfaceName, bpfFilter, packetCount, promisc, timeout, conf, rings)
+	close(captureDone)
+	// Already closed unless the capture failed to start.
+	rings.close()
+	wg.Wait()
+	closeLiveChannel(interfaceName)
+
+	for i, workerErr := range workerErrs {
+		if workerErr != nil {
+			return errors.Wrapf(workerErr, "live dissection worker %d", i)
+		}
+	}
+	return err
+}
+
+// stopLiveCaptureWhenStarted stops the capture on interfaceName, retrying while
+// it has not registered its device yet, until done is closed.
+func stopLiveCaptureWhenStarted(interfaceName string, done <-chan struct{}) {
+	for StopLivePacketCapture(interfaceName) != nil {
+		select {
+		case <-done:
+			return
+		case <-time.After(10 * time.Millisecond):
+		}
+	}
+}
+
+// Stats reports the state and load of every worker.
+func (p *WorkerPool) Stats() []WorkerStats {
+	now := time.Now()
+	life := now.Sub(p.started)
+
+	stats := make([]WorkerStats, 0, len(p.workers))
+	for _, w := range p.workers {
+		w.mu.Lock()
+		s := WorkerStats{
+			ID:       w.id,
+			PID:      w.pid,
+			Busy:     !w.busySince.IsZero(),
+			Jobs:     w.jobs,
+			Failures: w.failures,
+			Restarts: w.restarts,
+			BusyTime: w.busyTime,
+		}
+		if s.Busy {
+			s.BusyTime += now.Sub(w.busySince)
+		}
+		if !w.procStart.IsZero() && w.pid != 0 {
+			s.Uptime = now.Sub(w.procStart)
+		}
+		w.mu.Unlock()
+
+		if s.PID != 0 {
+			s.RSS = processRSS(s.PID)
+		}
+		if life > 0 {
+			s.Utilisation = float64(s.BusyTime) / float64(life)
+		}
+		stats = append(stats, s)
+	}
+
+	return stats
+}
+
+// Close stops the workers. Idle workers stop at once; busy ones are killed
+// when their job returns.
+func (p *WorkerPool) Close() {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+
+	if p.closed {
+		return
+	}
+	p.closed = true
+	close(p.done)
+
+	for {
+		select {
+		case w := <-p.idle:
+			if w.proc != nil {
+				w.proc.stop(false)
+				w.proc = nil
+			}
+		default:
+			return
+		}
+	}
+}
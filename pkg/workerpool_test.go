@@ -0,0 +1,146 @@
+package pkg
+
+import (
+	"os"
+	"sync"
+	"testing"
+	"time"
+
+	"github.com/pkg/errors"
+)
+
+// TestWorkerPool_MatchesInProcess checks that pages served by worker processes
+// match the in-process API, under concurrent load and after a worker restart.
+func TestWorkerPool_MatchesInProcess(t *testing.T) {
+	if _, err := os.Stat(testPcapFile); os.IsNotExist(err) {
+		t.Skip("skipping test; pcap file not found")
+	}
+
+	p, err := NewWorkerPool(WithWorkers(2), WithMaxWorkerJobs(3))
+	if err != nil {
+		t.Fatalf("NewWorkerPool failed: %v", err)
+	}
+	defer p.Close()
+
+	want, wantMore, err := GetFramesByPage(testPcapFile, 3, 10)
+	if err != nil {
+		t.Fatalf("GetFramesByPage failed: %v", err)
+	}
+
+	var wg sync.WaitGroup
+	for i := 0; i < 8; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			got, gotMore, err := p.GetFramesByPage(testPcapFile, 3, 10)
+			if err != nil {
+				t.Errorf("WorkerPool.GetFramesByPage failed: %v", err)
+				return
+			}
+			if len(got) != len(want) || gotMore != wantMore {
+				t.Errorf("got %d frames (more=%v), want %d (more=%v)", len(got), gotMore, len(want), wantMore)
+				return
+			}
+			for i := range want {
+				if got[i].BaseLayers.Frame.Number != want[i].BaseLayers.Frame.Number {
+					t.Errorf("[%d]: got frame %d, want %d", i, got[i].BaseLayers.Frame.Number, want[i].BaseLayers.Frame.Number)
+				}
+			}
+		}()
+	}
+	wg.Wait()
+
+	jobs, restarts := 0, 0
+	for _, s := range p.Stats() {
+		jobs += s.Jobs
+		restarts += s.Restarts
+		if s.PID == 0 {
+			t.Errorf("worker %d has no process", s.ID)
+		}
+	}
+	if jobs != 8 {
+		t.Errorf("got %d jobs in stats, want 8", jobs)
+	}
+	if restarts == 0 {
+		t.Errorf("expected workers to be recycled after %d jobs", 3)
+	}
+
+	if _, _, err := p.GetFramesByPage("not_exist.pcap", 1, 10); err == nil {
+		t.Error("expected an error for a missing file")
+	}
+}
+
+// TestWorkerPool_Sharded checks that a sharded pass returns every frame once, in
+// frame order, with an edge after each boundary the warm-up does not cover.
+func TestWorkerPool_Sharded(t *testing.T) {
+	if _, err := os.Stat(testPcapFile); os.IsNotExist(err) {
+		t.Skip("skipping test; pcap file not found")
+	}
+
+	p, err := NewWorkerPool(WithWorkers(3))
+	if err != nil {
+		t.Fatalf("NewWorkerPool failed: %v", err)
+	}
+	defer p.Close()
+
+	want, err := GetAllFrames(testPcapFile)
+	if err != nil {
+		t.Fatalf("GetAllFrames failed: %v", err)
+	}
+
+	res, err := p.GetAllFramesSharded(testPcapFile, 3, WithShardOverlap(5))
+	if err != nil {
+		t.Fatalf("GetAllFramesSharded failed: %v", err)
+	}
+	if len(res.Frames) != len(want) {
+		t.Fatalf("got %d frames, want %d", len(res.Frames), len(want))
+	}
+	for i := range want {
+		if res.Frames[i].BaseLayers.Frame.Number != want[i].BaseLayers.Frame.Number {
+			t.Fatalf("[%d]: got frame %d, want %d", i, res.Frames[i].BaseLayers.Frame.Number, want[i].BaseLayers.Frame.Number)
+		}
+	}
+
+	if len(res.Shards) < 2 {
+		t.Fatalf("expected the capture to be split, got %d shards", len(res.Shards))
+	}
+	for i, s := range res.Shards[1:] {
+		if s.First != res.Shards[i].Last+1 {
+			t.Errorf("shard %d starts at %d, previous ends at %d", i+1, s.First, res.Shards[i].Last)
+		}
+		if s.First > 6 && !res.IsEdgeFrame(s.First) {
+			t.Errorf("frame %d after a shard boundary is not reported as edge", s.First)
+		}
+	}
+}
+
+// TestWorkerPool_LiveCaptureBusy checks that a live capture fails instead of
+// waiting for workers held by other jobs, and keeps none of the idle ones.
+func TestWorkerPool_LiveCaptureBusy(t *testing.T) {
+	p, err := NewWorkerPool(WithWorkers(2))
+	if err != nil {
+		t.Fatalf("NewWorkerPool failed: %v", err)
+	}
+	defer p.Close()
+
+	held, err := p.acquire()
+	if err != nil {
+		t.Fatalf("acquire failed: %v", err)
+	}
+	defer p.release(held)
+
+	defer func(d time.Duration) { liveAcquireTimeout = d }(liveAcquireTimeout)
+	liveAcquireTimeout = 100 * time.Millisecond
+
+	err = p.StartLivePacketCapture("gowireshark-busy", "", 1, 0, 100, WithLiveWorkers(2))
+	if !errors.Is(err, ErrPoolBusy) {
+		t.Fatalf("got %v, want ErrPoolBusy", err)
+	}
+
+	// The worker that was idle went back to the pool.
+	ws, err := p.acquireN(1, time.Second)
+	if err != nil {
+		t.Fatalf("idle worker not returned: %v", err)
+	}
+	p.release(ws[0])
+}